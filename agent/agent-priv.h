@@ -92,6 +92,8 @@ nice_input_message_iter_compare (const NiceInputMessageIter *a,
 #include "stream.h"
 #include "conncheck.h"
 #include "component.h"
+#include "slab.h"
+#include "eventlog.h"
 #include "random.h"
 #include "stun/stunagent.h"
 #include "stun/usages/turn.h"
@@ -107,6 +109,7 @@ nice_input_message_iter_compare (const NiceInputMessageIter *a,
 #define NICE_AGENT_TIMER_TA_DEFAULT 20      /* timer Ta, msecs (impl. defined) */
 #define NICE_AGENT_TIMER_TR_DEFAULT 25000   /* timer Tr, msecs (impl. defined) */
 #define NICE_AGENT_MAX_CONNECTIVITY_CHECKS_DEFAULT 100 /* see RFC 8445 6.1.2.5 */
+#define NICE_AGENT_CONSENT_TIMEOUT 30      /* consent freshness, secs (RFC 7675) */
 
 
 /* An upper limit to size of STUN packets handled (based on Ethernet
@@ -122,6 +125,9 @@ nice_input_message_iter_compare (const NiceInputMessageIter *a,
   ((obj)->compatibility == NICE_COMPATIBILITY_RFC5245 || \
   (obj)->compatibility == NICE_COMPATIBILITY_OC2007R2)
 
+/* A signal queued while holding the agent lock; defined in agent.c */
+typedef struct _QueuedSignal QueuedSignal;
+
 struct _NiceAgent
 {
   GObject parent;                 /* gobject pointer */
@@ -175,7 +181,15 @@ struct _NiceAgent
   gboolean reliable;               /* property: reliable */
   gboolean keepalive_conncheck;    /* property: keepalive_conncheck */
 
-  GQueue pending_signals;
+  QueuedSignal *pending_signals;      /* FIFO list of signals to emit on
+                                         unlock */
+  QueuedSignal *pending_signals_tail;
+  QueuedSignal *free_signals;         /* atomic; stack of records to reuse */
+  QueuedSignal *preallocated_signals; /* owned; block of records */
+  GMainContext *signal_context;       /* property: signal-context */
+  QueuedSignal *async_signals;        /* atomic; stack of signals to emit on
+                                         signal_context, newest first */
+  gint signal_dispatch_scheduled;     /* atomic */
   guint16 rfc4571_expecting_length;
   gboolean use_ice_udp;
   gboolean use_ice_tcp;
@@ -184,6 +198,20 @@ struct _NiceAgent
   guint conncheck_ongoing_idle_delay; /* ongoing delay before timer stop */
   gboolean controlling_mode;          /* controlling mode used by the
                                          conncheck */
+  guint n_io_threads;                 /* property: io-threads */
+  GPtrArray *io_threads;              /* owned NiceIOThreads, started on
+                                         the first receive ring */
+  guint next_io_thread;               /* round-robin thread assignment */
+  gboolean shared_socket_source;      /* property: shared-socket-source */
+  gboolean use_io_uring;              /* property: io-uring */
+  guint recv_buffer_size;             /* property: recv-buffer-size */
+  guint send_buffer_size;             /* property: send-buffer-size */
+  guint stats_interval;               /* property: stats-interval */
+  GSource *stats_timer_source;        /* emits component-stats */
+  NiceSlab *stun_slab;                /* STUN requests awaiting a response */
+  guint event_log_size;               /* property: event-log-size */
+  NiceEventLog *event_log;            /* NULL if event-log-size is 0 */
+  gboolean turn_tls_insecure;         /* property: turn-tls-insecure */
   /* XXX: add pointer to internal data struct for ABI-safe extensions */
 };
 
@@ -250,6 +278,10 @@ void agent_remove_local_candidate (NiceAgent *agent, NiceStream *stream,
 void nice_agent_init_stun_agent (NiceAgent *agent, StunAgent *stun_agent);
 
 void _priv_set_socket_tos (NiceAgent *agent, NiceSocket *sock, gint tos);
+void _priv_set_socket_buffer_sizes (NiceAgent *agent, NiceSocket *sock,
+    NiceStream *stream);
+
+NiceSocket *agent_udp_socket_new (NiceAgent *agent, NiceAddress *addr);
 
 void _tcp_sock_is_writable (NiceSocket *sock, gpointer user_data);
 
@@ -318,10 +350,30 @@ static inline gboolean nice_debug_is_verbose (void) { return FALSE; }
 static inline void nice_debug (const char *fmt, ...) { }
 static inline void nice_debug_verbose (const char *fmt, ...) { }
 #else
-gboolean nice_debug_is_enabled (void);
-gboolean nice_debug_is_verbose (void);
-void nice_debug (const char *fmt, ...) G_GNUC_PRINTF (1, 2);
-void nice_debug_verbose (const char *fmt, ...) G_GNUC_PRINTF (1, 2);
+/* Read inline so that disabled messages cost a single test: the arguments
+ * of nice_debug() and nice_debug_verbose() are only evaluated when the
+ * message is actually printed. */
+extern gboolean nice_debug_enabled;
+extern gboolean nice_debug_verbose_enabled;
+
+static inline gboolean nice_debug_is_enabled (void)
+{
+  return G_UNLIKELY (nice_debug_enabled);
+}
+static inline gboolean nice_debug_is_verbose (void)
+{
+  return G_UNLIKELY (nice_debug_verbose_enabled);
+}
+void nice_debug_log (const char *fmt, ...) G_GNUC_PRINTF (1, 2);
+
+#define nice_debug(...) G_STMT_START { \
+  if (nice_debug_is_enabled ()) \
+    nice_debug_log (__VA_ARGS__); \
+} G_STMT_END
+#define nice_debug_verbose(...) G_STMT_START { \
+  if (nice_debug_is_enabled () && nice_debug_is_verbose ()) \
+    nice_debug_log (__VA_ARGS__); \
+} G_STMT_END
 #endif
 
 #if !GLIB_CHECK_VERSION(2, 59, 0)
@@ -46,7 +46,6 @@
 #endif
 
 #include <glib.h>
-#include <gobject/gvaluecollector.h>
 
 #include <string.h>
 #include <errno.h>
@@ -68,11 +67,13 @@
 #include "agent.h"
 #include "agent-priv.h"
 #include "iostream.h"
+#include "iothread.h"
 
 #include "stream.h"
 #include "interfaces.h"
 
 #include "pseudotcp.h"
+#include "trace.h"
 #include "agent-enum-types.h"
 
 /* Maximum size of a UDP packet’s payload, as the packet’s length field is 16b
@@ -81,9 +82,12 @@
 
 #define DEFAULT_STUN_PORT  3478
 #define DEFAULT_UPNP_TIMEOUT 200  /* milliseconds */
+#define DEFAULT_IO_THREADS 1
+#define MAX_IO_THREADS 64
 #define DEFAULT_IDLE_TIMEOUT 5000 /* milliseconds */
 
 #define MAX_TCP_MTU 1400 /* Use 1400 because of VPNs and we assume IEE 802.3 */
+#define MAX_TCP_ACCEPTS_PER_WAKEUP 64
 
 
 static void
@@ -123,6 +127,15 @@ enum
   PROP_ICE_TRICKLE,
   PROP_SUPPORT_RENOMINATION,
   PROP_IDLE_TIMEOUT,
+  PROP_IO_THREADS,
+  PROP_SHARED_SOCKET_SOURCE,
+  PROP_IO_URING,
+  PROP_SIGNAL_CONTEXT,
+  PROP_RECV_BUFFER_SIZE,
+  PROP_SEND_BUFFER_SIZE,
+  PROP_STATS_INTERVAL,
+  PROP_EVENT_LOG_SIZE,
+  PROP_TURN_TLS_INSECURE,
 };
 
 
@@ -139,6 +152,7 @@ enum
   SIGNAL_NEW_SELECTED_PAIR_FULL,
   SIGNAL_NEW_CANDIDATE_FULL,
   SIGNAL_NEW_REMOTE_CANDIDATE_FULL,
+  SIGNAL_COMPONENT_STATS,
 
   N_SIGNALS,
 };
@@ -176,45 +190,243 @@ G_DEFINE_POINTER_TYPE (_NiceAgentStreamIds, _nice_agent_stream_ids);
 
 #define NICE_TYPE_AGENT_STREAM_IDS _nice_agent_stream_ids_get_type ()
 
-typedef struct {
+/* The most parameters of any NiceAgent signal */
+#define MAX_SIGNAL_PARAMS 4
+/* Signal records allocated with each agent, enough for the burst of signals
+ * of a typical gathering or connectivity check phase */
+#define N_PREALLOCATED_SIGNALS 32
+
+/* The parameters of a queued signal, stored without a GValue. Strings and
+ * boxed values are owned, and are handed over to the GValues at emission. */
+struct _QueuedSignal {
+  QueuedSignal *next;
   guint signal_id;
-  GSignalQuery query;
-  GValue *params;
-} QueuedSignal;
+  guint n_params;
+  const GType *param_types;  /* owned by GSignal */
+  gboolean preallocated;
+  union {
+    guint v_uint;
+    gpointer v_pointer;
+  } params[MAX_SIGNAL_PARAMS];
+};
+
+static GType
+queued_signal_param_type (QueuedSignal *sig, guint i)
+{
+  return sig->param_types[i] & ~G_SIGNAL_TYPE_STATIC_SCOPE;
+}
+
+/* Free the parameters of a signal which won’t be emitted. */
+static void
+queued_signal_clear (QueuedSignal *sig)
+{
+  guint i;
+
+  for (i = 0; i < sig->n_params; i++) {
+    GType type = queued_signal_param_type (sig, i);
 
+    if (type == NICE_TYPE_AGENT_STREAM_IDS || type == G_TYPE_STRING)
+      g_free (sig->params[i].v_pointer);
+    else if (G_TYPE_FUNDAMENTAL (type) == G_TYPE_BOXED &&
+        sig->params[i].v_pointer != NULL)
+      g_boxed_free (type, sig->params[i].v_pointer);
+  }
+
+  sig->n_params = 0;
+}
 
 static void
-free_queued_signal (QueuedSignal *sig)
+queued_signal_emit (NiceAgent *agent, QueuedSignal *sig)
 {
+  GValue values[MAX_SIGNAL_PARAMS + 1];
   guint i;
 
-  g_value_unset (&sig->params[0]);
+  memset (values, 0, sizeof (values));
+
+  g_value_init (&values[0], G_TYPE_OBJECT);
+  g_value_set_object (&values[0], agent);
+
+  for (i = 0; i < sig->n_params; i++) {
+    GType type = queued_signal_param_type (sig, i);
+    GValue *value = &values[i + 1];
+
+    g_value_init (value, type);
+
+    if (type == G_TYPE_UINT)
+      g_value_set_uint (value, sig->params[i].v_uint);
+    else if (type == G_TYPE_STRING)
+      g_value_take_string (value, sig->params[i].v_pointer);
+    else if (G_TYPE_FUNDAMENTAL (type) == G_TYPE_BOXED)
+      g_value_take_boxed (value, sig->params[i].v_pointer);
+    else
+      g_value_set_pointer (value, sig->params[i].v_pointer);
+  }
+
+  g_signal_emitv (values, sig->signal_id, 0, NULL);
+
+  g_value_unset (&values[0]);
+
+  for (i = 0; i < sig->n_params; i++) {
+    if (G_VALUE_HOLDS (&values[i + 1], NICE_TYPE_AGENT_STREAM_IDS))
+      g_free (g_value_get_pointer (&values[i + 1]));
+    g_value_unset (&values[i + 1]);
+  }
+
+  sig->n_params = 0;
+}
+
+/* Push the chain from @first to @last onto one of the lock-free stacks.
+ * Any thread may push. */
+static void
+signal_stack_push (QueuedSignal **stack, QueuedSignal *first,
+    QueuedSignal *last)
+{
+  QueuedSignal *head;
+
+  do {
+    head = g_atomic_pointer_get (stack);
+    last->next = head;
+  } while (!g_atomic_pointer_compare_and_exchange (stack, head, first));
+}
+
+/* Take the whole content of a lock-free stack. */
+static QueuedSignal *
+signal_stack_take (QueuedSignal **stack)
+{
+  QueuedSignal *head;
+
+  do {
+    head = g_atomic_pointer_get (stack);
+  } while (head != NULL &&
+      !g_atomic_pointer_compare_and_exchange (stack, head, NULL));
+
+  return head;
+}
+
+/* Must be called with the agent lock held, which makes this the only thread
+ * popping from free_signals, so the compare-and-exchange can’t suffer from
+ * ABA. */
+static QueuedSignal *
+queued_signal_alloc (NiceAgent *agent)
+{
+  QueuedSignal *sig;
+
+  do {
+    sig = g_atomic_pointer_get (&agent->free_signals);
+    if (sig == NULL)
+      return g_slice_new0 (QueuedSignal);
+  } while (!g_atomic_pointer_compare_and_exchange (&agent->free_signals, sig,
+          sig->next));
+
+  return sig;
+}
+
+static void
+queued_signal_release (NiceAgent *agent, QueuedSignal *sig)
+{
+  signal_stack_push (&agent->free_signals, sig, sig);
+}
+
+/* Signals for which only the latest of a batch matters, per component */
+static gboolean
+signal_is_coalescable (guint signal_id)
+{
+  return signal_id == signals[SIGNAL_COMPONENT_STATE_CHANGED] ||
+      signal_id == signals[SIGNAL_NEW_SELECTED_PAIR] ||
+      signal_id == signals[SIGNAL_NEW_SELECTED_PAIR_FULL];
+}
+
+/* Whether @later makes emitting @sig pointless */
+static gboolean
+queued_signal_supersedes (QueuedSignal *later, QueuedSignal *sig)
+{
+  return later->signal_id == sig->signal_id &&
+      later->params[0].v_uint == sig->params[0].v_uint &&
+      later->params[1].v_uint == sig->params[1].v_uint;
+}
+
+static gboolean
+agent_emit_async_signals_cb (gpointer user_data)
+{
+  NiceAgent *agent = NICE_AGENT (user_data);
+  QueuedSignal *sig, *next, *fifo = NULL;
+
+  /* Anything pushed after the take below schedules another dispatch. */
+  g_atomic_int_set (&agent->signal_dispatch_scheduled, FALSE);
+
+  /* The stack is newest first */
+  for (sig = signal_stack_take (&agent->async_signals); sig; sig = next) {
+    next = sig->next;
+    sig->next = fifo;
+    fifo = sig;
+  }
+
+  for (sig = fifo; sig; sig = next) {
+    gboolean superseded = FALSE;
+
+    next = sig->next;
+
+    if (signal_is_coalescable (sig->signal_id)) {
+      QueuedSignal *later;
 
-  for (i = 0; i < sig->query.n_params; i++) {
-    if (G_VALUE_HOLDS(&sig->params[i + 1], NICE_TYPE_AGENT_STREAM_IDS))
-      g_free (g_value_get_pointer (&sig->params[i + 1]));
-    g_value_unset (&sig->params[i + 1]);
+      for (later = next; later && !superseded; later = later->next)
+        superseded = queued_signal_supersedes (later, sig);
+    }
+
+    if (superseded)
+      queued_signal_clear (sig);
+    else
+      queued_signal_emit (agent, sig);
+
+    queued_signal_release (agent, sig);
   }
 
-  g_slice_free1 (sizeof(GValue) * (sig->query.n_params + 1), sig->params);
-  g_slice_free (QueuedSignal, sig);
+  return G_SOURCE_REMOVE;
 }
 
 void
 agent_unlock_and_emit (NiceAgent *agent)
 {
-  GQueue queue = G_QUEUE_INIT;
-  QueuedSignal *sig;
+  QueuedSignal *sig, *next;
 
-  queue = agent->pending_signals;
-  g_queue_init (&agent->pending_signals);
+  sig = agent->pending_signals;
+  agent->pending_signals = NULL;
+  agent->pending_signals_tail = NULL;
 
-  agent_unlock (agent);
+  if (agent->signal_context != NULL && sig != NULL) {
+    QueuedSignal *newest = NULL, *oldest = sig;
+
+    agent_unlock (agent);
+
+    /* Reverse the list, so the async stack stays newest first */
+    for (; sig; sig = next) {
+      next = sig->next;
+      sig->next = newest;
+      newest = sig;
+    }
+    signal_stack_push (&agent->async_signals, newest, oldest);
+
+    if (g_atomic_int_compare_and_exchange (&agent->signal_dispatch_scheduled,
+            FALSE, TRUE)) {
+      GSource *source = g_idle_source_new ();
+
+      g_source_set_priority (source, G_PRIORITY_DEFAULT);
+      g_source_set_name (source, "libnice agent signals");
+      g_source_set_callback (source, agent_emit_async_signals_cb,
+          g_object_ref (agent), g_object_unref);
+      g_source_attach (source, agent->signal_context);
+      g_source_unref (source);
+    }
 
-  while ((sig = g_queue_pop_head (&queue))) {
-    g_signal_emitv (sig->params, sig->signal_id, 0, NULL);
+    return;
+  }
+
+  agent_unlock (agent);
 
-    free_queued_signal (sig);
+  for (; sig; sig = next) {
+    next = sig->next;
+    queued_signal_emit (agent, sig);
+    queued_signal_release (agent, sig);
   }
 }
 
@@ -222,36 +434,44 @@ static void
 agent_queue_signal (NiceAgent *agent, guint signal_id, ...)
 {
   QueuedSignal *sig;
+  GSignalQuery query;
   guint i;
-  gchar *error = NULL;
   va_list var_args;
 
-  sig = g_slice_new (QueuedSignal);
-  g_signal_query (signal_id, &sig->query);
+  g_signal_query (signal_id, &query);
+  g_assert (query.n_params <= MAX_SIGNAL_PARAMS);
 
+  sig = queued_signal_alloc (agent);
+  sig->next = NULL;
   sig->signal_id = signal_id;
-  sig->params = g_slice_alloc0 (sizeof(GValue) * (sig->query.n_params + 1));
-
-  g_value_init (&sig->params[0], G_TYPE_OBJECT);
-  g_value_set_object (&sig->params[0], agent);
+  sig->n_params = query.n_params;
+  sig->param_types = query.param_types;
 
   va_start (var_args, signal_id);
-  for (i = 0; i < sig->query.n_params; i++) {
-    G_VALUE_COLLECT_INIT (&sig->params[i + 1], sig->query.param_types[i],
-        var_args, 0, &error);
-    if (error)
-      break;
-  }
-  va_end (var_args);
+  for (i = 0; i < query.n_params; i++) {
+    GType type = queued_signal_param_type (sig, i);
 
-  if (error) {
-    free_queued_signal (sig);
-    g_critical ("Error collecting values for signal: %s", error);
-    g_free (error);
-    return;
+    if (type == G_TYPE_UINT) {
+      sig->params[i].v_uint = va_arg (var_args, guint);
+    } else if (type == G_TYPE_STRING) {
+      sig->params[i].v_pointer = g_strdup (va_arg (var_args, const gchar *));
+    } else if (G_TYPE_FUNDAMENTAL (type) == G_TYPE_BOXED) {
+      gpointer boxed = va_arg (var_args, gpointer);
+
+      sig->params[i].v_pointer = boxed ? g_boxed_copy (type, boxed) : NULL;
+    } else {
+      /* Ownership of NICE_TYPE_AGENT_STREAM_IDS is transferred. */
+      g_assert (G_TYPE_FUNDAMENTAL (type) == G_TYPE_POINTER);
+      sig->params[i].v_pointer = va_arg (var_args, gpointer);
+    }
   }
+  va_end (var_args);
 
-  g_queue_push_tail (&agent->pending_signals, sig);
+  if (agent->pending_signals_tail != NULL)
+    agent->pending_signals_tail->next = sig;
+  else
+    agent->pending_signals = sig;
+  agent->pending_signals_tail = sig;
 }
 
 
@@ -890,6 +1110,204 @@ nice_agent_class_init (NiceAgentClass *klass)
         FALSE,
         G_PARAM_READWRITE));
 
+   /**
+    * NiceAgent:io-threads
+    *
+    * The number of network threads the agent runs for components attached
+    * with nice_agent_attach_recv_ring(). Each thread iterates its own
+    * #GMainContext, and the threads are only started when the first ring is
+    * attached.
+    *
+    * Since: 0.1.19
+    */
+   g_object_class_install_property (gobject_class, PROP_IO_THREADS,
+      g_param_spec_uint (
+        "io-threads",
+        "Network threads",
+        "Number of network threads serving components with receive rings.",
+        1, MAX_IO_THREADS,
+        DEFAULT_IO_THREADS,
+        G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY));
+
+   /**
+    * NiceAgent:shared-socket-source
+    *
+    * Whether to poll the sockets of all components through one epoll-based
+    * #GSource per #GMainContext, instead of creating a #GSource for every
+    * socket. Readiness is edge-triggered, so dispatching costs nothing for
+    * idle sockets, and reattaching sockets (e.g. when changing the I/O
+    * context of a component) doesn’t churn sources.
+    *
+    * This is ignored on platforms without epoll, and sockets which can’t be
+    * added to an epoll set still get a #GSource of their own.
+    *
+    * Since: 0.1.19
+    */
+   g_object_class_install_property (gobject_class, PROP_SHARED_SOCKET_SOURCE,
+      g_param_spec_boolean (
+        "shared-socket-source",
+        "Shared socket source",
+        "Poll all sockets through a single epoll-based source per context.",
+        FALSE,
+        G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY));
+
+   /**
+    * NiceAgent:io-uring
+    *
+    * Whether to receive and send on UDP sockets through io_uring, if libnice
+    * was built with liburing and the running kernel supports multishot
+    * receive (Linux 6.0). Incoming datagrams are then received without any
+    * syscall, and all the messages of a send call are submitted at once.
+    *
+    * Datagrams longer than 2048 bytes are dropped, and counted by
+    * nice_agent_get_component_kernel_drops().
+    *
+    * This is ignored for reliable agents. Sockets fall back to plain UDP
+    * sockets whenever io_uring is not available.
+    *
+    * Since: 0.1.19
+    */
+   g_object_class_install_property (gobject_class, PROP_IO_URING,
+      g_param_spec_boolean (
+        "io-uring",
+        "Use io_uring",
+        "Use io_uring for UDP sockets when available.",
+        FALSE,
+        G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY));
+
+   /**
+    * NiceAgent:signal-context
+    *
+    * A #GMainContext on which to emit the agent’s signals, or %NULL to emit
+    * them from whichever thread the agent is running in, as soon as its
+    * internal lock is released (the default).
+    *
+    * When set, signals are handed over to this context without blocking,
+    * so application callbacks never run from the agent’s receive path, and
+    * are emitted in order in batches. Within a batch,
+    * #NiceAgent::component-state-changed, #NiceAgent::new-selected-pair and
+    * #NiceAgent::new-selected-pair-full are only emitted for the last change of
+    * each component, skipping states it has already moved on from.
+    *
+    * The agent is kept alive until the context has emitted its pending
+    * signals.
+    *
+    * Since: 0.1.19
+    */
+   g_object_class_install_property (gobject_class, PROP_SIGNAL_CONTEXT,
+      g_param_spec_pointer (
+        "signal-context",
+        "The GMainContext to emit signals on",
+        "The GMainContext to emit signals on, or NULL to emit them directly",
+        G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY));
+
+   /**
+    * NiceAgent:recv-buffer-size
+    *
+    * Size in bytes of the kernel receive buffer of the sockets created by the
+    * agent, or 0 to keep the system default. This is applied with
+    * SO_RCVBUFFORCE when the process is allowed to (CAP_NET_ADMIN on Linux),
+    * so it is not capped by net.core.rmem_max, and with SO_RCVBUF otherwise.
+    *
+    * Changing it only affects the sockets created afterwards, and it can be
+    * overridden per stream with nice_agent_set_stream_buffer_sizes().
+    * Datagrams dropped by the kernel because this buffer was full are
+    * reported by nice_agent_get_component_kernel_drops().
+    *
+    * Since: 0.1.19
+    */
+   g_object_class_install_property (gobject_class, PROP_RECV_BUFFER_SIZE,
+      g_param_spec_uint (
+        "recv-buffer-size",
+        "Socket receive buffer size",
+        "Size of the kernel receive buffer of the sockets, 0 for the default",
+        0, G_MAXINT,
+        0,
+        G_PARAM_READWRITE));
+
+   /**
+    * NiceAgent:send-buffer-size
+    *
+    * Size in bytes of the kernel send buffer of the sockets created by the
+    * agent, or 0 to keep the system default. This is applied with
+    * SO_SNDBUFFORCE when the process is allowed to, and with SO_SNDBUF
+    * otherwise.
+    *
+    * Changing it only affects the sockets created afterwards, and it can be
+    * overridden per stream with nice_agent_set_stream_buffer_sizes().
+    *
+    * Since: 0.1.19
+    */
+   g_object_class_install_property (gobject_class, PROP_SEND_BUFFER_SIZE,
+      g_param_spec_uint (
+        "send-buffer-size",
+        "Socket send buffer size",
+        "Size of the kernel send buffer of the sockets, 0 for the default",
+        0, G_MAXINT,
+        0,
+        G_PARAM_READWRITE));
+
+   /**
+    * NiceAgent:stats-interval
+    *
+    * Interval in milliseconds at which #NiceAgent::component-stats is
+    * emitted for every component, or 0 to never emit it (the default).
+    * nice_agent_get_component_stats() works either way.
+    *
+    * Since: 0.1.19
+    */
+   g_object_class_install_property (gobject_class, PROP_STATS_INTERVAL,
+      g_param_spec_uint (
+        "stats-interval",
+        "Statistics interval",
+        "Interval in ms at which component-stats is emitted, 0 to disable",
+        0, G_MAXUINT,
+        0,
+        G_PARAM_READWRITE));
+
+   /**
+    * NiceAgent:event-log-size
+    *
+    * Number of events kept in the binary event log of the agent, or 0 to
+    * disable it (the default). Each event takes 48 bytes, and recording one
+    * costs a copy into a ring buffer, so the log can be left enabled in
+    * production and retrieved with nice_agent_dump_event_log() only for
+    * the sessions which failed.
+    *
+    * Changing it clears the log.
+    *
+    * Since: 0.1.19
+    */
+   g_object_class_install_property (gobject_class, PROP_EVENT_LOG_SIZE,
+      g_param_spec_uint (
+        "event-log-size",
+        "Event log size",
+        "Number of events kept in the binary event log, 0 to disable",
+        0, G_MAXINT / sizeof (NiceEventRecord),
+        0,
+        G_PARAM_READWRITE));
+
+   /**
+    * NiceAgent:turn-tls-insecure
+    *
+    * Whether to accept any certificate from %NICE_RELAY_TYPE_TURN_TLS relays.
+    * By default, the certificate of the relay must chain up to the system
+    * trust store and be issued for the IP address given to
+    * nice_agent_set_relay_info(), or the relay is not used.
+    *
+    * Only set this for relays with self-signed certificates, e.g. in tests:
+    * anyone on the path can then pose as the relay.
+    *
+    * Since: 0.1.19
+    */
+   g_object_class_install_property (gobject_class, PROP_TURN_TLS_INSECURE,
+      g_param_spec_boolean (
+        "turn-tls-insecure",
+        "Insecure TURN over TLS",
+        "Do not verify the certificates of TURN over TLS relays.",
+        FALSE,
+        G_PARAM_READWRITE));
+
   /* install signals */
 
   /**
@@ -1186,6 +1604,32 @@ nice_agent_class_init (NiceAgentClass *klass)
           NICE_TYPE_CANDIDATE,
           G_TYPE_INVALID);
 
+  /**
+   * NiceAgent::component-stats
+   * @agent: The #NiceAgent object
+   * @stream_id: The ID of the stream
+   * @component_id: The ID of the component
+   *
+   * This signal is fired for every component each #NiceAgent:stats-interval
+   * milliseconds, so the handler can fetch its counters with
+   * nice_agent_get_component_stats().
+   *
+   * Since: 0.1.19
+   */
+  signals[SIGNAL_COMPONENT_STATS] =
+      g_signal_new (
+          "component-stats",
+          G_OBJECT_CLASS_TYPE (klass),
+          G_SIGNAL_RUN_LAST,
+          0,
+          NULL,
+          NULL,
+          NULL,
+          G_TYPE_NONE,
+          2,
+          G_TYPE_UINT, G_TYPE_UINT,
+          G_TYPE_INVALID);
+
   /* Init debug options depending on env variables */
   nice_debug_init ();
 }
@@ -1239,6 +1683,8 @@ priv_update_controlling_mode (NiceAgent *agent, gboolean value)
 static void
 nice_agent_init (NiceAgent *agent)
 {
+  guint i;
+
   agent->next_candidate_id = 1;
   agent->next_stream_id = 1;
 
@@ -1250,6 +1696,7 @@ nice_agent_init (NiceAgent *agent)
   agent->nomination_mode = NICE_NOMINATION_MODE_AGGRESSIVE;
   agent->support_renomination = FALSE;
   agent->idle_timeout = DEFAULT_IDLE_TIMEOUT;
+  agent->n_io_threads = DEFAULT_IO_THREADS;
 
   agent->discovery_list = NULL;
   agent->discovery_unsched_items = 0;
@@ -1266,9 +1713,14 @@ nice_agent_init (NiceAgent *agent)
   agent->use_ice_tcp = TRUE;
 
   agent->rng = nice_rng_new ();
+  agent->stun_slab = nice_slab_new ();
   priv_generate_tie_breaker (agent);
 
-  g_queue_init (&agent->pending_signals);
+  agent->preallocated_signals = g_new0 (QueuedSignal, N_PREALLOCATED_SIGNALS);
+  for (i = 0; i < N_PREALLOCATED_SIGNALS; i++) {
+    agent->preallocated_signals[i].preallocated = TRUE;
+    queued_signal_release (agent, &agent->preallocated_signals[i]);
+  }
 
   g_mutex_init (&agent->agent_mutex);
 }
@@ -1378,6 +1830,42 @@ nice_agent_get_property (
       g_value_set_uint (value, agent->idle_timeout);
       break;
 
+    case PROP_IO_THREADS:
+      g_value_set_uint (value, agent->n_io_threads);
+      break;
+
+    case PROP_SHARED_SOCKET_SOURCE:
+      g_value_set_boolean (value, agent->shared_socket_source);
+      break;
+
+    case PROP_IO_URING:
+      g_value_set_boolean (value, agent->use_io_uring);
+      break;
+
+    case PROP_SIGNAL_CONTEXT:
+      g_value_set_pointer (value, agent->signal_context);
+      break;
+
+    case PROP_RECV_BUFFER_SIZE:
+      g_value_set_uint (value, agent->recv_buffer_size);
+      break;
+
+    case PROP_SEND_BUFFER_SIZE:
+      g_value_set_uint (value, agent->send_buffer_size);
+      break;
+
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint (value, agent->stats_interval);
+      break;
+
+    case PROP_EVENT_LOG_SIZE:
+      g_value_set_uint (value, agent->event_log_size);
+      break;
+
+    case PROP_TURN_TLS_INSECURE:
+      g_value_set_boolean (value, agent->turn_tls_insecure);
+      break;
+
     case PROP_PROXY_IP:
       g_value_set_string (value, agent->proxy_ip);
       break;
@@ -1532,6 +2020,39 @@ nice_agent_reset_all_stun_agents (NiceAgent *agent, gboolean only_software)
   }
 }
 
+static gboolean
+priv_stats_tick_agent_locked (NiceAgent *agent, gpointer user_data)
+{
+  GSList *i, *j;
+
+  for (i = agent->streams; i; i = i->next) {
+    NiceStream *stream = i->data;
+
+    for (j = stream->components; j; j = j->next) {
+      NiceComponent *component = j->data;
+
+      agent_queue_signal (agent, signals[SIGNAL_COMPONENT_STATS],
+          stream->id, component->id);
+    }
+  }
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+priv_update_stats_timer (NiceAgent *agent)
+{
+  if (agent->stats_interval > 0) {
+    agent_timeout_add_with_context (agent, &agent->stats_timer_source,
+        "Component stats", agent->stats_interval,
+        priv_stats_tick_agent_locked, NULL);
+  } else if (agent->stats_timer_source != NULL) {
+    g_source_destroy (agent->stats_timer_source);
+    g_source_unref (agent->stats_timer_source);
+    agent->stats_timer_source = NULL;
+  }
+}
+
 static void
 nice_agent_set_property (
   GObject *object,
@@ -1598,6 +2119,48 @@ nice_agent_set_property (
       agent->idle_timeout = g_value_get_uint (value);
       break;
 
+    case PROP_IO_THREADS:
+      agent->n_io_threads = g_value_get_uint (value);
+      break;
+
+    case PROP_SHARED_SOCKET_SOURCE:
+      agent->shared_socket_source = g_value_get_boolean (value);
+      break;
+
+    case PROP_IO_URING:
+      agent->use_io_uring = g_value_get_boolean (value);
+      break;
+
+    case PROP_SIGNAL_CONTEXT:
+      agent->signal_context = g_value_get_pointer (value);
+      if (agent->signal_context != NULL)
+        g_main_context_ref (agent->signal_context);
+      break;
+
+    case PROP_RECV_BUFFER_SIZE:
+      agent->recv_buffer_size = g_value_get_uint (value);
+      break;
+
+    case PROP_SEND_BUFFER_SIZE:
+      agent->send_buffer_size = g_value_get_uint (value);
+      break;
+
+    case PROP_STATS_INTERVAL:
+      agent->stats_interval = g_value_get_uint (value);
+      priv_update_stats_timer (agent);
+      break;
+
+    case PROP_EVENT_LOG_SIZE:
+      agent->event_log_size = g_value_get_uint (value);
+      nice_event_log_free (agent->event_log);
+      agent->event_log = agent->event_log_size > 0 ?
+          nice_event_log_new (agent->event_log_size) : NULL;
+      break;
+
+    case PROP_TURN_TLS_INSECURE:
+      agent->turn_tls_insecure = g_value_get_boolean (value);
+      break;
+
     case PROP_PROXY_IP:
       g_free (agent->proxy_ip);
       agent->proxy_ip = g_value_dup_string (value);
@@ -2081,6 +2644,7 @@ pseudo_tcp_socket_write_packet (PseudoTcpSocket *psocket,
   if (component->selected_pair.local != NULL) {
     NiceSocket *sock;
     NiceAddress *addr;
+    gssize ret;
 
     sock = component->selected_pair.local->sockptr;
     addr = &component->selected_pair.remote->c.addr;
@@ -2102,7 +2666,15 @@ pseudo_tcp_socket_write_packet (PseudoTcpSocket *psocket,
      * will eventually pick up this loss and go into recovery mode, reducing
      * its transmission rate and, hopefully, the usage of system resources
      * which caused the EWOULDBLOCK in the first place. */
-    if (nice_socket_send (sock, addr, len, buffer) >= 0) {
+    ret = nice_socket_send (sock, addr, len, buffer);
+    NICE_TRACE (pseudotcp__write, agent, component->stream_id, component->id,
+        len);
+    if (ret >= 0) {
+      if (ret > 0)
+        nice_component_count_media_sent (component, 1, len);
+      else
+        component->stats.send_drops++;
+
       g_object_unref (agent);
       return WR_SUCCESS;
     }
@@ -2458,6 +3030,10 @@ void agent_signal_new_selected_pair (NiceAgent *agent, guint stream_id,
         "PEER-RFLX" : "???");
   }
 
+  nice_event_log_add (agent->event_log, NICE_EVENT_SELECTED_PAIR, stream_id,
+      component_id, lcandidate->type, rcandidate->type,
+      component->selected_pair.priority, NULL);
+
   agent_queue_signal (agent, signals[SIGNAL_NEW_SELECTED_PAIR_FULL],
       stream_id, component_id, lcandidate, rcandidate);
   agent_queue_signal (agent, signals[SIGNAL_NEW_SELECTED_PAIR],
@@ -2470,6 +3046,9 @@ void agent_signal_new_selected_pair (NiceAgent *agent, guint stream_id,
 
 void agent_signal_new_candidate (NiceAgent *agent, NiceCandidate *candidate)
 {
+  nice_event_log_add (agent->event_log, NICE_EVENT_CANDIDATE_GATHERED,
+      candidate->stream_id, candidate->component_id, candidate->type,
+      candidate->transport, candidate->priority, NULL);
   agent_queue_signal (agent, signals[SIGNAL_NEW_CANDIDATE_FULL],
       candidate);
   agent_queue_signal (agent, signals[SIGNAL_NEW_CANDIDATE],
@@ -2478,6 +3057,9 @@ void agent_signal_new_candidate (NiceAgent *agent, NiceCandidate *candidate)
 
 void agent_signal_new_remote_candidate (NiceAgent *agent, NiceCandidate *candidate)
 {
+  nice_event_log_add (agent->event_log, NICE_EVENT_REMOTE_CANDIDATE,
+      candidate->stream_id, candidate->component_id, candidate->type,
+      candidate->transport, candidate->priority, NULL);
   agent_queue_signal (agent, signals[SIGNAL_NEW_REMOTE_CANDIDATE_FULL],
       candidate);
   agent_queue_signal (agent, signals[SIGNAL_NEW_REMOTE_CANDIDATE],
@@ -2530,6 +3112,9 @@ void agent_signal_component_state_change (NiceAgent *agent, guint stream_id, gui
       stream_id, component_id, nice_component_state_to_string (old_state),
       nice_component_state_to_string (new_state));
 
+  nice_event_log_add (agent->event_log, NICE_EVENT_COMPONENT_STATE, stream_id,
+      component_id, new_state, old_state, 0, NULL);
+
   /* Check whether it’s a valid state transition. */
 #define TRANSITION(OLD, NEW) \
   (old_state == NICE_COMPONENT_STATE_##OLD && \
@@ -2630,6 +3215,7 @@ agent_create_tcp_turn_socket (NiceAgent *agent, NiceStream *stream,
 
     if (nicesock) {
       _priv_set_socket_tos (agent, nicesock, stream->tos);
+      _priv_set_socket_buffer_sizes (agent, nicesock, stream);
       if (agent->proxy_type == NICE_PROXY_TYPE_SOCKS5) {
         nicesock = nice_socks5_socket_new (nicesock, server,
             agent->proxy_username, agent->proxy_password);
@@ -2647,8 +3233,10 @@ agent_create_tcp_turn_socket (NiceAgent *agent, NiceStream *stream,
     nicesock = nice_tcp_bsd_socket_new (agent->main_context, &local_address,
         server, reliable_tcp);
 
-    if (nicesock)
+    if (nicesock) {
       _priv_set_socket_tos (agent, nicesock, stream->tos);
+      _priv_set_socket_buffer_sizes (agent, nicesock, stream);
+    }
   }
 
   /* The TURN server may be invalid or not listening */
@@ -2667,6 +3255,14 @@ agent_create_tcp_turn_socket (NiceAgent *agent, NiceStream *stream,
           agent->compatibility == NICE_COMPATIBILITY_OC2007R2)) {
     nicesock = nice_pseudossl_socket_new (nicesock,
         NICE_PSEUDOSSL_SOCKET_COMPATIBILITY_MSOC);
+  } else if (type == NICE_RELAY_TYPE_TURN_TLS) {
+    gchar server_ip[INET6_ADDRSTRLEN];
+
+    nice_address_to_string (server, server_ip);
+    nicesock = nice_tls_socket_new (nicesock, server_ip,
+        !agent->turn_tls_insecure);
+    if (nicesock == NULL)
+      return NULL;
   }
   return nice_udp_turn_over_tcp_socket_new (nicesock,
       agent_to_turn_socket_compatibility (agent));
@@ -2696,9 +3292,10 @@ priv_add_new_candidate_discovery_turn (NiceAgent *agent,
       NiceSocket *new_socket;
       nice_address_set_port (&addr, 0);
 
-      new_socket = nice_udp_bsd_socket_new (&addr);
+      new_socket = agent_udp_socket_new (agent, &addr);
       if (new_socket) {
         _priv_set_socket_tos (agent, new_socket, stream->tos);
+        _priv_set_socket_buffer_sizes (agent, new_socket, stream);
         nice_component_attach_socket (component, new_socket);
         nicesock = new_socket;
       }
@@ -3894,6 +4491,9 @@ static gboolean priv_add_remote_candidate (
 
     component->remote_candidates = g_slist_append (component->remote_candidates,
         candidate);
+    nice_event_log_add (agent->event_log, NICE_EVENT_REMOTE_CANDIDATE,
+        stream_id, component->id, candidate->type, candidate->transport,
+        candidate->priority, NULL);
   }
   return TRUE;
 
@@ -4231,17 +4831,23 @@ agent_recv_message_unlocked (
     } else {
       if (nicesock->type == NICE_SOCKET_TYPE_TCP_PASSIVE) {
         NiceSocket *new_socket;
-
-        /* Passive candidates when readable should accept and create a new
-         * socket. When established, the connchecks will create a peer reflexive
-         * candidate for it */
-        new_socket = nice_tcp_passive_socket_accept (nicesock);
-        if (new_socket) {
+        guint n_accepted = 0;
+
+        /* Passive candidates when readable should accept and create new
+         * sockets. The backlog is drained in one go, up to a bound so that a
+         * flood of connections can't starve the other sources; the listening
+         * socket stays readable for the rest. When established, the
+         * connchecks will create a peer reflexive candidate for each */
+        while (n_accepted < MAX_TCP_ACCEPTS_PER_WAKEUP &&
+            (new_socket = nice_tcp_passive_socket_accept (nicesock)) != NULL) {
+          n_accepted++;
           _priv_set_socket_tos (agent, new_socket, stream->tos);
+          _priv_set_socket_buffer_sizes (agent, new_socket, stream);
           nice_debug ("Agent %p: add to tcp-pass socket %p a new "
               "tcp accept socket %p in s/c %d/%d",
               agent, nicesock, new_socket, stream->id, component->id);
-          nice_component_attach_socket (component, new_socket);
+          nice_component_attach_tcp_accepted_socket (agent, component,
+              new_socket);
         }
         sockret = 0;
       } else {
@@ -4393,6 +4999,9 @@ agent_recv_message_unlocked (
         nice_address_get_port (message->from), message->length);
   }
 
+  NICE_TRACE (recv, agent, stream->id, component->id, message->length,
+      nicesock);
+
   is_turn = _agent_recv_turn_message_unlocked (agent, stream, component, &nicesock,
       message, &retval);
 
@@ -4434,6 +5043,7 @@ agent_recv_message_unlocked (
       if (handled) {
         /* Handled STUN message. */
         nice_debug ("%s: Valid STUN packet received.", G_STRFUNC);
+        nice_component_count_stun_received (component, big_buf_len);
         retval = RECV_OOB;
         g_free (big_buf);
         goto done;
@@ -4462,6 +5072,7 @@ agent_recv_message_unlocked (
   }
 
   agent->media_after_tick = TRUE;
+  nice_component_count_media_received (component, message->length, is_turn);
 
   /* Unhandled STUN; try handling TCP data, then pass to the client. */
   if (message->length > 0  && agent->reliable) {
@@ -4490,6 +5101,8 @@ agent_recv_message_unlocked (
 
       nice_debug_verbose ("%s: notifying pseudo-TCP of packet, length %" G_GSIZE_FORMAT,
           G_STRFUNC, message->length);
+      NICE_TRACE (pseudotcp__recv, agent, stream->id, component->id,
+          message->length);
       pseudo_tcp_socket_notify_message (component->tcp, message);
 
       adjust_tcp_clock (agent, stream, component);
@@ -4514,7 +5127,85 @@ done:
   return retval;
 }
 
-/* Print the composition of an array of messages. No-op if debugging is
+/*
+ * agent_recv_message_with_scratch_unlocked:
+ *
+ * Like agent_recv_message_unlocked(), but copes with user-provided messages
+ * which are too small to hold a STUN packet. In non-reliable mode, the
+ * component’s scratch buffer is appended to such a message as an extra buffer,
+ * so control packets can still be parsed (and handled out-of-band) in full,
+ * while data is received straight into the user’s buffers. Any data which
+ * spills over into the scratch buffer is dropped.
+ *
+ * This must be called with the agent’s lock held.
+ */
+static RecvStatus
+agent_recv_message_with_scratch_unlocked (
+  NiceAgent *agent,
+  NiceStream *stream,
+  NiceComponent *component,
+  NiceSocket *nicesock,
+  NiceInputMessage *message)
+{
+  GInputVector *local_bufs;
+  NiceInputMessage local_message;
+  RecvStatus retval;
+  gsize capacity = 0;
+  guint n_bufs = 0;
+  guint i;
+
+  if (agent->reliable)
+    return agent_recv_message_unlocked (agent, stream, component, nicesock,
+        message);
+
+  /* Count the number of buffers. */
+  if (message->n_buffers == -1) {
+    for (i = 0; message->buffers[i].buffer != NULL; i++)
+      n_bufs++;
+  } else {
+    n_bufs = message->n_buffers;
+  }
+
+  for (i = 0; i < n_bufs; i++)
+    capacity += message->buffers[i].size;
+
+  if (capacity >= NICE_COMPONENT_RECV_SCRATCH_SIZE)
+    return agent_recv_message_unlocked (agent, stream, component, nicesock,
+        message);
+
+  if (component->recv_scratch == NULL)
+    component->recv_scratch = g_malloc (NICE_COMPONENT_RECV_SCRATCH_SIZE);
+
+  local_bufs = g_alloca ((n_bufs + 1) * sizeof (GInputVector));
+  for (i = 0; i < n_bufs; i++) {
+    local_bufs[i].buffer = message->buffers[i].buffer;
+    local_bufs[i].size = message->buffers[i].size;
+  }
+  local_bufs[n_bufs].buffer = component->recv_scratch;
+  local_bufs[n_bufs].size = NICE_COMPONENT_RECV_SCRATCH_SIZE;
+
+  local_message.buffers = local_bufs;
+  local_message.n_buffers = n_bufs + 1;
+  local_message.from = message->from;
+  /* May already hold the start of an RFC4571 frame from a previous read. */
+  local_message.length = message->length;
+
+  retval = agent_recv_message_unlocked (agent, stream, component, nicesock,
+      &local_message);
+
+  message->length = local_message.length;
+
+  if (retval == RECV_SUCCESS && message->length > capacity) {
+    g_warning ("Dropped %" G_GSIZE_FORMAT " bytes of data from the end of a "
+        "%" G_GSIZE_FORMAT " byte packet due to not fitting in message %p",
+        message->length - capacity, message->length, message);
+    message->length = capacity;
+  }
+
+  return retval;
+}
+
+/* Print the composition of an array of messages. No-op if debugging is
  * disabled. */
 static void
 nice_debug_input_message_composition (const NiceInputMessage *messages,
@@ -4847,8 +5538,6 @@ nice_agent_recv_messages_blocking_or_nonblocking (NiceAgent *agent,
   gboolean all_sockets_would_block = FALSE;
   gboolean reached_eos = FALSE;
   GError *child_error = NULL;
-  NiceInputMessage *messages_orig = NULL;
-  guint i;
 
   g_return_val_if_fail (NICE_IS_AGENT (agent), -1);
   g_return_val_if_fail (stream_id >= 1, -1);
@@ -4867,24 +5556,6 @@ nice_agent_recv_messages_blocking_or_nonblocking (NiceAgent *agent,
     return -1;
   }
 
-  /* Receive buffer size must be at least 1280 for STUN */
-  if (!agent->reliable) {
-    for (i = 0; i < n_messages; i++) {
-      if (input_message_get_size (&messages[i]) < 1280) {
-        GInputVector *vec;
-
-        if (messages_orig == NULL)
-          messages_orig = g_memdup (messages,
-              sizeof (NiceInputMessage) * n_messages);
-        vec = g_slice_new (GInputVector);
-        vec->buffer = g_slice_alloc (1280);
-        vec->size = 1280;
-        messages[i].buffers = vec;
-        messages[i].n_buffers = 1;
-      }
-    }
-  }
-
   agent_lock (agent);
 
   if (!agent_find_component (agent, stream_id, component_id,
@@ -5045,25 +5716,6 @@ done:
 
   agent_unlock_and_emit (agent);
 
-  if (messages_orig) {
-    for (i = 0; i < n_messages; i++) {
-      if (messages[i].buffers != messages_orig[i].buffers) {
-        g_assert_cmpint (messages[i].n_buffers, ==, 1);
-
-        memcpy_buffer_to_input_message (&messages_orig[i],
-            messages[i].buffers[0].buffer, messages[i].length);
-
-        g_slice_free1 (1280, messages[i].buffers[0].buffer);
-        g_slice_free (GInputVector, messages[i].buffers);
-
-        messages[i].buffers = messages_orig[i].buffers;
-        messages[i].n_buffers = messages_orig[i].n_buffers;
-        messages[i].length = messages_orig[i].length;
-      }
-    }
-    g_free (messages_orig);
-  }
-
   return n_valid_messages;
 }
 
@@ -5318,6 +5970,19 @@ nice_agent_send_messages_nonblocking_internal (
         n_sent = nice_socket_send_messages (sock, addr, messages, n_messages);
       }
 
+      if (n_sent > 0) {
+        gsize n_bytes = 0;
+        gint i;
+
+        for (i = 0; i < n_sent; i++)
+          n_bytes += output_message_get_size (&messages[i]);
+        nice_component_count_media_sent (component, n_sent, n_bytes);
+        NICE_TRACE (send, agent, stream_id, component_id, n_messages, n_sent);
+      } else if (n_sent == 0) {
+        component->stats.send_drops++;
+        NICE_TRACE (send__drop, agent, stream_id, component_id, n_messages);
+      }
+
       if (n_sent < 0) {
         g_set_error (&child_error, G_IO_ERROR, G_IO_ERROR_FAILED,
             "Error writing data to socket.");
@@ -5382,6 +6047,175 @@ nice_agent_send_messages_nonblocking (
       component_id, messages, n_messages, FALSE, error);
 }
 
+/* A destination of nice_agent_send_fanout() sent on a non-reliable socket */
+typedef struct {
+  NiceComponent *component;
+  NiceSocket *sock;
+  const NiceAddress *addr;
+  guint index;  /* in the destinations array */
+} FanoutEntry;
+
+static gint
+fanout_entry_compare (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+  const FanoutEntry *ea = a, *eb = b;
+
+  if (ea->sock != eb->sock)
+    return (ea->sock < eb->sock) ? -1 : 1;
+
+  return (ea->index < eb->index) ? -1 : (ea->index > eb->index);
+}
+
+NICEAPI_EXPORT gint
+nice_agent_send_fanout (
+  NiceAgent *agent,
+  const NiceOutputMessage *payload,
+  NiceFanoutDestination *destinations,
+  guint n_destinations)
+{
+  FanoutEntry *entries;
+  guint *fallback;
+  GOutputVector *vectors;
+  NiceOutputMessage *messages;
+  const NiceAddress **tos;
+  guint n_entries = 0, n_fallback = 0;
+  guint n_payload_buffers = 0;
+  guint n_vectors;
+  gint n_sent = 0;
+  guint i, j;
+
+  g_return_val_if_fail (NICE_IS_AGENT (agent), -1);
+  g_return_val_if_fail (payload != NULL, -1);
+  g_return_val_if_fail (n_destinations == 0 || destinations != NULL, -1);
+
+  if (payload->n_buffers >= 0)
+    n_payload_buffers = payload->n_buffers;
+  else
+    while (payload->buffers[n_payload_buffers].buffer != NULL)
+      n_payload_buffers++;
+
+  /* Room for the header */
+  n_vectors = n_payload_buffers + 1;
+
+  entries = g_new (FanoutEntry, n_destinations);
+  fallback = g_new (guint, n_destinations);
+
+  agent_lock (agent);
+
+  for (i = 0; i < n_destinations; i++) {
+    NiceFanoutDestination *dest = &destinations[i];
+    NiceComponent *component;
+    NiceSocket *sock;
+
+    dest->sent = FALSE;
+
+    if (!agent_find_component (agent, dest->stream_id, dest->component_id,
+            NULL, &component) ||
+        component->selected_pair.local == NULL)
+      continue;
+
+    sock = component->selected_pair.local->sockptr;
+
+    /* Pseudo-TCP and RFC4571 framing are left to the usual path. */
+    if (agent->reliable || nice_socket_is_reliable (sock)) {
+      fallback[n_fallback++] = i;
+      continue;
+    }
+
+    entries[n_entries].component = component;
+    entries[n_entries].sock = sock;
+    entries[n_entries].addr = &component->selected_pair.remote->c.addr;
+    entries[n_entries].index = i;
+    n_entries++;
+  }
+
+  g_qsort_with_data (entries, n_entries, sizeof (FanoutEntry),
+      fanout_entry_compare, NULL);
+
+  /* The first message’s vectors are reused for the fallback sends. */
+  vectors = g_new (GOutputVector, MAX (n_entries, 1) * n_vectors);
+  messages = g_new (NiceOutputMessage, n_entries);
+  tos = g_new (const NiceAddress *, n_entries);
+
+  for (i = 0; i < n_entries; i++) {
+    NiceFanoutDestination *dest = &destinations[entries[i].index];
+    GOutputVector *message_vectors = &vectors[i * n_vectors];
+    guint n = 0;
+
+    if (dest->header.buffer != NULL && dest->header.size > 0)
+      message_vectors[n++] = dest->header;
+    for (j = 0; j < n_payload_buffers; j++)
+      message_vectors[n++] = payload->buffers[j];
+
+    messages[i].buffers = message_vectors;
+    messages[i].n_buffers = n;
+    tos[i] = entries[i].addr;
+  }
+
+  /* Send all the messages of each socket at once. A destination which fails
+   * or would block is skipped, so that it doesn’t hold back the others. */
+  i = 0;
+  while (i < n_entries) {
+    guint end = i;
+
+    while (end < n_entries && entries[end].sock == entries[i].sock)
+      end++;
+
+    while (i < end) {
+      guint n_remaining = end - i;
+      gint ret;
+
+      ret = nice_socket_send_messages_to (entries[i].sock, &tos[i],
+          &messages[i], n_remaining);
+
+      if (ret > 0) {
+        for (j = 0; j < (guint) ret; j++) {
+          destinations[entries[i + j].index].sent = TRUE;
+          nice_component_count_media_sent (entries[i + j].component, 1,
+              output_message_get_size (&messages[i + j]));
+        }
+        n_sent += ret;
+        i += ret;
+      }
+
+      if (ret < (gint) n_remaining) {
+        if (ret >= 0)
+          entries[i].component->stats.send_drops++;
+        i++;
+      }
+    }
+  }
+
+  nice_debug_verbose ("Agent %p: fanned out a message to %d of %u "
+      "destinations", agent, n_sent, n_destinations);
+
+  agent_unlock_and_emit (agent);
+
+  for (i = 0; i < n_fallback; i++) {
+    NiceFanoutDestination *dest = &destinations[fallback[i]];
+    NiceOutputMessage message = { vectors, 0 };
+
+    if (dest->header.buffer != NULL && dest->header.size > 0)
+      vectors[message.n_buffers++] = dest->header;
+    for (j = 0; j < n_payload_buffers; j++)
+      vectors[message.n_buffers++] = payload->buffers[j];
+
+    if (nice_agent_send_messages_nonblocking_internal (agent, dest->stream_id,
+            dest->component_id, &message, 1, FALSE, NULL) > 0) {
+      dest->sent = TRUE;
+      n_sent++;
+    }
+  }
+
+  g_free (tos);
+  g_free (messages);
+  g_free (vectors);
+  g_free (fallback);
+  g_free (entries);
+
+  return n_sent;
+}
+
 NICEAPI_EXPORT gint
 nice_agent_send (
   NiceAgent *agent,
@@ -5527,6 +6361,8 @@ nice_agent_dispose (GObject *object)
 {
   GSList *i;
   QueuedSignal *sig;
+  QueuedSignal *next_sig;
+  GPtrArray *io_threads;
   NiceAgent *agent = NICE_AGENT (object);
 
   agent_lock (agent);
@@ -5540,6 +6376,12 @@ nice_agent_dispose (GObject *object)
 
   priv_remove_keepalive_timer (agent);
 
+  if (agent->stats_timer_source != NULL) {
+    g_source_destroy (agent->stats_timer_source);
+    g_source_unref (agent->stats_timer_source);
+    agent->stats_timer_source = NULL;
+  }
+
   for (i = agent->local_addresses; i; i = i->next)
     {
       NiceAddress *a = i->data;
@@ -5570,9 +6412,13 @@ nice_agent_dispose (GObject *object)
         agent->pruning_streams);
   }
 
-  while ((sig = g_queue_pop_head (&agent->pending_signals))) {
-    free_queued_signal (sig);
+  for (sig = agent->pending_signals; sig; sig = next_sig) {
+    next_sig = sig->next;
+    queued_signal_clear (sig);
+    queued_signal_release (agent, sig);
   }
+  agent->pending_signals = NULL;
+  agent->pending_signals_tail = NULL;
 
   g_free (agent->stun_server_ip);
   agent->stun_server_ip = NULL;
@@ -5587,6 +6433,13 @@ nice_agent_dispose (GObject *object)
   nice_rng_free (agent->rng);
   agent->rng = NULL;
 
+  /* All pairs and selected pairs are gone with the streams */
+  nice_slab_free (agent->stun_slab);
+  agent->stun_slab = NULL;
+
+  nice_event_log_free (agent->event_log);
+  agent->event_log = NULL;
+
 #ifdef HAVE_GUPNP
   if (agent->upnp) {
     g_object_unref (agent->upnp);
@@ -5601,8 +6454,33 @@ nice_agent_dispose (GObject *object)
     g_main_context_unref (agent->main_context);
   agent->main_context = NULL;
 
+  io_threads = agent->io_threads;
+  agent->io_threads = NULL;
+
   agent_unlock (agent);
 
+  /* The network threads may be waiting for the agent lock. */
+  if (io_threads != NULL)
+    g_ptr_array_unref (io_threads);
+
+  /* Signals still waiting for the signal context are dropped. */
+  for (sig = signal_stack_take (&agent->async_signals); sig; sig = next_sig) {
+    next_sig = sig->next;
+    queued_signal_clear (sig);
+    queued_signal_release (agent, sig);
+  }
+
+  for (sig = signal_stack_take (&agent->free_signals); sig; sig = next_sig) {
+    next_sig = sig->next;
+    if (!sig->preallocated)
+      g_slice_free (QueuedSignal, sig);
+  }
+  g_clear_pointer (&agent->preallocated_signals, g_free);
+
+  if (agent->signal_context != NULL)
+    g_main_context_unref (agent->signal_context);
+  agent->signal_context = NULL;
+
   g_mutex_clear (&agent->agent_mutex);
 
   if (G_OBJECT_CLASS (nice_agent_parent_class)->dispose)
@@ -5610,6 +6488,21 @@ nice_agent_dispose (GObject *object)
 
 }
 
+/* Whether the socket source or epoll watch which invoked component_io_cb() has
+ * been removed since, e.g. by nice_component_detach_all_sockets(). */
+static gboolean
+component_io_source_is_destroyed (void)
+{
+#ifdef HAVE_SYS_EPOLL_H
+  gboolean removed;
+
+  if (nice_epoll_watch_get_current_removed (&removed))
+    return removed;
+#endif
+
+  return g_source_is_destroyed (g_main_current_source ());
+}
+
 gboolean
 component_io_cb (GSocket *gsocket, GIOCondition condition, gpointer user_data)
 {
@@ -5638,7 +6531,7 @@ component_io_cb (GSocket *gsocket, GIOCondition condition, gpointer user_data)
     return G_SOURCE_REMOVE;
   }
 
-  if (g_source_is_destroyed (g_main_current_source ())) {
+  if (component_io_source_is_destroyed ()) {
     /* Silently return FALSE. */
     nice_debug ("%s: source %p destroyed", G_STRFUNC, g_main_current_source ());
 
@@ -5775,7 +6668,7 @@ component_io_cb (GSocket *gsocket, GIOCondition condition, gpointer user_data)
         }
       }
 
-      if (g_source_is_destroyed (g_main_current_source ())) {
+      if (component_io_source_is_destroyed ()) {
         nice_debug ("Component IO source disappeared during the callback");
         goto out;
       }
@@ -5795,9 +6688,10 @@ component_io_cb (GSocket *gsocket, GIOCondition condition, gpointer user_data)
        * to ensure is big enough to avoid data loss (since we’re in non-reliable
        * mode). Iterate to receive as many messages as possible.
        *
-       * STUN packets will be parsed in-place. */
-      retval = agent_recv_message_unlocked (agent, stream, component,
-          socket_source->socket,
+       * STUN packets will be parsed in-place, spilling over into the
+       * component’s scratch buffer if the user’s one is too small. */
+      retval = agent_recv_message_with_scratch_unlocked (agent, stream,
+          component, socket_source->socket,
           &component->recv_messages[component->recv_messages_iter.message]);
 
       nice_debug_verbose ("%s: %p: received %d valid messages", G_STRFUNC, agent,
@@ -5822,6 +6716,51 @@ component_io_cb (GSocket *gsocket, GIOCondition condition, gpointer user_data)
         break;
       } /* else if (retval == RECV_OOB) { ignore me and continue; } */
     }
+  } else if (component->recv_ring != NULL) {
+    NiceRecvRing *ring = component->recv_ring;
+
+    /* Receive straight into the ring’s free slots, handing each packet over
+     * to the application as soon as it is known not to be a STUN packet. */
+    while (TRUE) {
+      GInputVector slot_buf;
+      NiceInputMessage slot_message;
+      RecvStatus retval;
+
+      if (nice_recv_ring_reserve (ring, &slot_message, &slot_buf)) {
+        retval = agent_recv_message_with_scratch_unlocked (agent, stream,
+            component, socket_source->socket, &slot_message);
+
+        if (retval == RECV_SUCCESS)
+          nice_recv_ring_commit (ring, &slot_message);
+        else
+          nice_recv_ring_keep_pending (ring,
+              (retval == RECV_WOULD_BLOCK) ? slot_message.length : 0);
+      } else {
+        /* The application is not keeping up: still drain the socket so STUN
+         * keeps being processed, but drop the data. */
+        GInputVector local_bufs;
+        NiceInputMessage local_message = { &local_bufs, 1, NULL, 0 };
+
+        if (component->recv_discard == NULL)
+          component->recv_discard = g_malloc (MAX_BUFFER_SIZE);
+        local_bufs.buffer = component->recv_discard;
+        local_bufs.size = MAX_BUFFER_SIZE;
+
+        retval = agent_recv_message_unlocked (agent, stream, component,
+            socket_source->socket, &local_message);
+
+        if (retval == RECV_SUCCESS)
+          nice_recv_ring_drop (ring);
+      }
+
+      if (retval == RECV_WOULD_BLOCK) {
+        break;
+      } else if (retval == RECV_ERROR) {
+        nice_debug ("%s: %p: error receiving message", G_STRFUNC, agent);
+        remove_source = TRUE;
+        break;
+      }
+    }
   }
 
 done:
@@ -5881,6 +6820,11 @@ nice_agent_attach_recv (
   if (ctx == NULL)
     ctx = g_main_context_default ();
 
+  if (component->recv_ring != NULL) {
+    nice_recv_ring_close (component->recv_ring);
+    g_clear_pointer (&component->recv_ring, nice_recv_ring_unref);
+  }
+
   /* Set the component’s I/O context. */
   nice_component_set_io_context (component, ctx);
   nice_component_set_io_callback (component, func, data, NULL, 0, NULL);
@@ -5903,6 +6847,69 @@ nice_agent_attach_recv (
   return ret;
 }
 
+NICEAPI_EXPORT NiceRecvRing *
+nice_agent_attach_recv_ring (
+  NiceAgent *agent,
+  guint stream_id,
+  guint component_id,
+  guint n_slots,
+  gsize slot_size)
+{
+  NiceComponent *component = NULL;
+  NiceStream *stream = NULL;
+  NiceIOThread *io_thread;
+  NiceRecvRing *ring = NULL;
+
+  g_return_val_if_fail (NICE_IS_AGENT (agent), NULL);
+  g_return_val_if_fail (stream_id >= 1, NULL);
+  g_return_val_if_fail (component_id >= 1, NULL);
+  g_return_val_if_fail (n_slots > 0, NULL);
+  g_return_val_if_fail (slot_size > 0, NULL);
+
+  agent_lock (agent);
+
+  if (agent->reliable) {
+    g_critical ("Receive rings are not supported by reliable agents");
+    goto done;
+  }
+
+  if (!agent_find_component (agent, stream_id, component_id, &stream,
+          &component)) {
+    g_warning ("Could not find component %u in stream %u", component_id,
+        stream_id);
+    goto done;
+  }
+
+  if (agent->io_threads == NULL) {
+    guint i;
+
+    agent->io_threads = g_ptr_array_new_full (agent->n_io_threads,
+        (GDestroyNotify) nice_io_thread_free);
+    for (i = 0; i < agent->n_io_threads; i++)
+      g_ptr_array_add (agent->io_threads, nice_io_thread_new (i));
+  }
+
+  io_thread = g_ptr_array_index (agent->io_threads,
+      agent->next_io_thread++ % agent->io_threads->len);
+
+  if (component->recv_ring != NULL)
+    nice_recv_ring_close (component->recv_ring);
+  g_clear_pointer (&component->recv_ring, nice_recv_ring_unref);
+
+  ring = nice_recv_ring_new (n_slots, slot_size);
+  component->recv_ring = nice_recv_ring_ref (ring);
+
+  nice_debug ("Agent %p: s%d:%d receives into ring %p on network thread %p",
+      agent, stream_id, component_id, ring, io_thread->thread);
+
+  nice_component_set_io_callback (component, NULL, NULL, NULL, 0, NULL);
+  nice_component_set_io_context (component, io_thread->context);
+
+ done:
+  agent_unlock_and_emit (agent);
+  return ring;
+}
+
 NICEAPI_EXPORT gboolean
 nice_agent_set_selected_pair (
   NiceAgent *agent,
@@ -6243,6 +7250,22 @@ nice_agent_set_selected_remote_candidate (
   return ret;
 }
 
+/* Create a UDP socket bound to @addr, on top of io_uring if the agent asked
+ * for it and the kernel supports it. */
+NiceSocket *
+agent_udp_socket_new (NiceAgent *agent, NiceAddress *addr)
+{
+  NiceSocket *nicesock = NULL;
+
+  if (agent->use_io_uring && !agent->reliable)
+    nicesock = nice_udp_uring_socket_new (addr);
+
+  if (nicesock == NULL)
+    nicesock = nice_udp_bsd_socket_new (addr);
+
+  return nicesock;
+}
+
 void
 _priv_set_socket_tos (NiceAgent *agent, NiceSocket *sock, gint tos)
 {
@@ -6263,6 +7286,53 @@ _priv_set_socket_tos (NiceAgent *agent, NiceSocket *sock, gint tos)
 #endif
 }
 
+static void
+set_socket_buffer_size (NiceAgent *agent, NiceSocket *sock, gint option,
+    gint force_option, guint size)
+{
+  gint value = MIN (size, G_MAXINT);
+
+  /* Not capped by net.core.[rw]mem_max, but needs CAP_NET_ADMIN */
+  if (force_option != 0 &&
+      setsockopt (g_socket_get_fd (sock->fileno), SOL_SOCKET, force_option,
+          (const char *) &value, sizeof (value)) == 0)
+    return;
+
+  if (setsockopt (g_socket_get_fd (sock->fileno), SOL_SOCKET, option,
+          (const char *) &value, sizeof (value)) < 0) {
+    nice_debug ("Agent %p: Could not set socket buffer size to %u: %s", agent,
+        size, g_strerror (errno));
+  }
+}
+
+void
+_priv_set_socket_buffer_sizes (NiceAgent *agent, NiceSocket *sock,
+    NiceStream *stream)
+{
+  guint recv_size, send_size;
+  gint recv_force = 0, send_force = 0;
+
+  if (sock->fileno == NULL)
+    return;
+
+  recv_size = stream->recv_buffer_size ? stream->recv_buffer_size :
+      agent->recv_buffer_size;
+  send_size = stream->send_buffer_size ? stream->send_buffer_size :
+      agent->send_buffer_size;
+
+#ifdef SO_RCVBUFFORCE
+  recv_force = SO_RCVBUFFORCE;
+#endif
+#ifdef SO_SNDBUFFORCE
+  send_force = SO_SNDBUFFORCE;
+#endif
+
+  if (recv_size > 0)
+    set_socket_buffer_size (agent, sock, SO_RCVBUF, recv_force, recv_size);
+  if (send_size > 0)
+    set_socket_buffer_size (agent, sock, SO_SNDBUF, send_force, send_size);
+}
+
 
 NICEAPI_EXPORT void
 nice_agent_set_stream_tos (NiceAgent *agent,
@@ -6295,6 +7365,238 @@ nice_agent_set_stream_tos (NiceAgent *agent,
   agent_unlock_and_emit (agent);
 }
 
+NICEAPI_EXPORT void
+nice_agent_set_stream_buffer_sizes (NiceAgent *agent,
+  guint stream_id, guint recv_size, guint send_size)
+{
+  GSList *i, *j;
+  NiceStream *stream;
+
+  g_return_if_fail (NICE_IS_AGENT (agent));
+  g_return_if_fail (stream_id >= 1);
+  g_return_if_fail (recv_size <= G_MAXINT);
+  g_return_if_fail (send_size <= G_MAXINT);
+
+  agent_lock (agent);
+
+  stream = agent_find_stream (agent, stream_id);
+  if (stream == NULL)
+    goto done;
+
+  stream->recv_buffer_size = recv_size;
+  stream->send_buffer_size = send_size;
+  for (i = stream->components; i; i = i->next) {
+    NiceComponent *component = i->data;
+
+    for (j = component->local_candidates; j; j = j->next) {
+      NiceCandidateImpl *local_candidate = j->data;
+
+      _priv_set_socket_buffer_sizes (agent, local_candidate->sockptr, stream);
+    }
+  }
+
+ done:
+  agent_unlock_and_emit (agent);
+}
+
+static guint64
+priv_component_get_kernel_drops (NiceComponent *component)
+{
+  guint64 drops = 0;
+  GSList *i;
+
+  for (i = component->socket_sources; i; i = i->next) {
+    SocketSource *socket_source = i->data;
+
+    drops += nice_socket_get_kernel_drops (socket_source->socket);
+  }
+
+  return drops;
+}
+
+NICEAPI_EXPORT guint64
+nice_agent_get_component_kernel_drops (NiceAgent *agent,
+  guint stream_id, guint component_id)
+{
+  NiceComponent *component;
+  guint64 drops = 0;
+
+  g_return_val_if_fail (NICE_IS_AGENT (agent), 0);
+  g_return_val_if_fail (stream_id >= 1, 0);
+  g_return_val_if_fail (component_id >= 1, 0);
+
+  agent_lock (agent);
+
+  if (agent_find_component (agent, stream_id, component_id, NULL,
+          &component))
+    drops = priv_component_get_kernel_drops (component);
+
+  agent_unlock_and_emit (agent);
+
+  return drops;
+}
+
+NICEAPI_EXPORT gboolean
+nice_agent_get_component_stats (NiceAgent *agent,
+  guint stream_id, guint component_id, NiceComponentStats *stats)
+{
+  NiceComponent *component;
+  gboolean ret = FALSE;
+
+  g_return_val_if_fail (NICE_IS_AGENT (agent), FALSE);
+  g_return_val_if_fail (stream_id >= 1, FALSE);
+  g_return_val_if_fail (component_id >= 1, FALSE);
+  g_return_val_if_fail (stats != NULL, FALSE);
+
+  agent_lock (agent);
+
+  if (!agent_find_component (agent, stream_id, component_id, NULL,
+          &component))
+    goto done;
+
+  *stats = component->stats;
+  stats->kernel_drops = priv_component_get_kernel_drops (component);
+
+  if (component->tcp != NULL) {
+    guint32 cwnd, srtt, retransmits;
+
+    pseudo_tcp_socket_get_stats (component->tcp, &cwnd, &srtt, &retransmits);
+    stats->tcp_cwnd = cwnd;
+    stats->tcp_srtt = srtt;
+    stats->tcp_retransmits = retransmits;
+  }
+
+  ret = TRUE;
+
+ done:
+  agent_unlock_and_emit (agent);
+
+  return ret;
+}
+
+NICEAPI_EXPORT GSList *
+nice_agent_get_candidate_pair_stats (NiceAgent *agent,
+  guint stream_id, guint component_id)
+{
+  NiceStream *stream;
+  NiceComponent *component;
+  GSList *ret = NULL;
+  GSList *i;
+
+  g_return_val_if_fail (NICE_IS_AGENT (agent), NULL);
+  g_return_val_if_fail (stream_id >= 1, NULL);
+  g_return_val_if_fail (component_id >= 1, NULL);
+
+  agent_lock (agent);
+
+  if (!agent_find_component (agent, stream_id, component_id, &stream,
+          &component))
+    goto done;
+
+  for (i = stream->conncheck_list; i; i = i->next) {
+    CandidateCheckPair *p = i->data;
+    NiceCandidatePairStats *stats;
+
+    if (p->component_id != component_id)
+      continue;
+
+    stats = g_slice_new (NiceCandidatePairStats);
+    *stats = p->stats;
+    stats->local = nice_candidate_copy (p->local);
+    stats->remote = nice_candidate_copy (p->remote);
+    stats->priority = p->priority;
+    stats->nominated = p->nominated;
+    stats->selected =
+        (NiceCandidate *) component->selected_pair.local == p->local &&
+        (NiceCandidate *) component->selected_pair.remote == p->remote;
+
+    ret = g_slist_prepend (ret, stats);
+  }
+
+  ret = g_slist_reverse (ret);
+
+ done:
+  agent_unlock_and_emit (agent);
+
+  return ret;
+}
+
+NICEAPI_EXPORT void
+nice_candidate_pair_stats_free (NiceCandidatePairStats *stats)
+{
+  if (stats == NULL)
+    return;
+
+  nice_candidate_free (stats->local);
+  nice_candidate_free (stats->remote);
+  g_slice_free (NiceCandidatePairStats, stats);
+}
+
+NICEAPI_EXPORT void
+nice_agent_get_memory_footprint (NiceAgent *agent,
+  NiceAgentMemoryFootprint *footprint)
+{
+  GSList *i, *j;
+
+  g_return_if_fail (NICE_IS_AGENT (agent));
+  g_return_if_fail (footprint != NULL);
+
+  memset (footprint, 0, sizeof (*footprint));
+
+  agent_lock (agent);
+
+  for (i = agent->streams; i; i = i->next) {
+    NiceStream *stream = i->data;
+
+    footprint->n_streams++;
+    footprint->stream_bytes += sizeof (NiceStream) + sizeof (GSList);
+
+    for (j = stream->components; j; j = j->next) {
+      NiceComponent *component = j->data;
+
+      footprint->n_components++;
+      footprint->component_bytes += sizeof (NiceComponent) + sizeof (GSList) +
+          (g_slist_length (component->local_candidates) +
+           g_slist_length (component->remote_candidates)) *
+          (sizeof (NiceCandidateImpl) + sizeof (GSList));
+    }
+
+    for (j = stream->conncheck_list; j; j = j->next) {
+      CandidateCheckPair *pair = j->data;
+      StunTransaction *stun;
+
+      footprint->n_pairs++;
+      footprint->pair_bytes += sizeof (CandidateCheckPair) + sizeof (GSList);
+
+      for (stun = pair->stun_transactions; stun; stun = stun->next)
+        footprint->n_stun_transactions++;
+    }
+  }
+
+  footprint->stun_bytes = nice_slab_get_bytes_in_use (agent->stun_slab);
+  footprint->stun_reserved_bytes =
+      nice_slab_get_bytes_reserved (agent->stun_slab);
+
+  agent_unlock_and_emit (agent);
+}
+
+NICEAPI_EXPORT GBytes *
+nice_agent_dump_event_log (NiceAgent *agent)
+{
+  GBytes *bytes = NULL;
+
+  g_return_val_if_fail (NICE_IS_AGENT (agent), NULL);
+
+  agent_lock (agent);
+
+  if (agent->event_log)
+    bytes = nice_event_log_dump (agent->event_log);
+
+  agent_unlock_and_emit (agent);
+
+  return bytes;
+}
+
 NICEAPI_EXPORT void
 nice_agent_set_software (NiceAgent *agent, const gchar *software)
 {
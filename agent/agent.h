@@ -223,6 +223,170 @@ typedef struct {
   gint n_buffers;
 } NiceOutputMessage;
 
+/**
+ * NiceFanoutDestination:
+ * @stream_id: the ID of the stream to send to
+ * @component_id: the ID of the component to send to
+ * @header: data sent to this destination only, in front of the shared
+ * payload, or a %NULL buffer for none
+ * @sent: set by nice_agent_send_fanout() to whether the message was sent to
+ * this destination
+ *
+ * One of the destinations of a message sent with nice_agent_send_fanout().
+ * The header can hold anything which differs between destinations, such as
+ * a rewritten RTP header.
+ *
+ * Since: 0.1.19
+ */
+typedef struct {
+  guint stream_id;
+  guint component_id;
+  GOutputVector header;
+  gboolean sent;
+} NiceFanoutDestination;
+
+/**
+ * NiceAgentMemoryFootprint:
+ * @n_streams: the number of streams
+ * @n_components: the number of components, over all streams
+ * @n_pairs: the number of candidate pairs on the check lists
+ * @n_stun_transactions: the number of connectivity checks awaiting a
+ * response
+ * @stream_bytes: memory used by the streams themselves
+ * @component_bytes: memory used by the components and their candidates
+ * @pair_bytes: memory used by the candidate pairs
+ * @stun_bytes: memory used by the connectivity checks and keepalives
+ * awaiting a response
+ * @stun_reserved_bytes: memory reserved for connectivity checks, which is
+ * at least @stun_bytes, and includes room recycled from earlier checks
+ *
+ * Approximate memory usage of an agent, as returned by
+ * nice_agent_get_memory_footprint(). Dividing the byte counts by the
+ * matching counts gives the cost of one more stream, component or pair.
+ * Sockets, receive buffers and application data are not included.
+ *
+ * Since: 0.1.19
+ */
+typedef struct {
+  guint n_streams;
+  guint n_components;
+  guint n_pairs;
+  guint n_stun_transactions;
+  gsize stream_bytes;
+  gsize component_bytes;
+  gsize pair_bytes;
+  gsize stun_bytes;
+  gsize stun_reserved_bytes;
+} NiceAgentMemoryFootprint;
+
+/**
+ * NiceComponentStats:
+ * @media_packets_sent: application packets sent, or pseudo-TCP segments in
+ * reliable mode
+ * @media_bytes_sent: bytes of application packets sent
+ * @media_packets_received: application packets received, or pseudo-TCP
+ * segments in reliable mode
+ * @media_bytes_received: bytes of application packets received
+ * @stun_packets_sent: connectivity checks, keepalives and their responses
+ * sent
+ * @stun_bytes_sent: bytes of STUN packets sent
+ * @stun_packets_received: STUN packets received and handled by the agent
+ * @stun_bytes_received: bytes of STUN packets received
+ * @relayed_packets_sent: application packets sent through a TURN relay,
+ * included in @media_packets_sent
+ * @relayed_packets_received: application packets received through a TURN
+ * relay, included in @media_packets_received
+ * @send_drops: application packets or pseudo-TCP segments which couldn't be
+ * sent because the socket would block
+ * @kernel_drops: incoming datagrams dropped by the kernel, as returned by
+ * nice_agent_get_component_kernel_drops()
+ * @ice_tcp_accepted: connections accepted on passive ICE-TCP candidates
+ * @ice_tcp_evicted: accepted ICE-TCP connections closed because too many
+ * others were also still waiting for their first connectivity check
+ * @consent_rtt: round-trip time of the last answered keepalive connectivity
+ * check of the selected pair, in microseconds, or 0 if none was answered yet
+ * @tcp_cwnd: congestion window of the pseudo-TCP socket, in bytes
+ * @tcp_srtt: smoothed round-trip time of the pseudo-TCP socket, in
+ * milliseconds
+ * @tcp_retransmits: segments the pseudo-TCP socket had to send again
+ *
+ * Traffic counters of a component, as returned by
+ * nice_agent_get_component_stats(). The counters start at 0 when the
+ * component is created and only ever grow. The pseudo-TCP fields are 0
+ * unless the agent is reliable.
+ *
+ * Since: 0.1.19
+ */
+typedef struct {
+  guint64 media_packets_sent;
+  guint64 media_bytes_sent;
+  guint64 media_packets_received;
+  guint64 media_bytes_received;
+  guint64 stun_packets_sent;
+  guint64 stun_bytes_sent;
+  guint64 stun_packets_received;
+  guint64 stun_bytes_received;
+  guint64 relayed_packets_sent;
+  guint64 relayed_packets_received;
+  guint64 send_drops;
+  guint64 kernel_drops;
+  guint64 ice_tcp_accepted;
+  guint64 ice_tcp_evicted;
+  guint64 consent_rtt;
+  guint tcp_cwnd;
+  guint tcp_srtt;
+  guint tcp_retransmits;
+} NiceComponentStats;
+
+/**
+ * NiceCandidatePairStats:
+ * @local: the local candidate of the pair
+ * @remote: the remote candidate of the pair
+ * @priority: the priority of the pair
+ * @nominated: whether the pair has been nominated
+ * @selected: whether the pair is the selected pair of its component
+ * @current_rtt: round-trip time of the last answered connectivity check, in
+ * microseconds, or 0 if none was answered yet
+ * @total_rtt: sum of the round-trip times measured, in microseconds
+ * @n_rtt_samples: number of round-trip times summed in @total_rtt; answers to
+ * retransmitted checks are not measured, as they are ambiguous
+ * @requests_sent: connectivity checks sent, not counting retransmissions
+ * @requests_received: connectivity checks received
+ * @responses_sent: responses sent to connectivity checks
+ * @responses_received: responses received to connectivity checks
+ * @retransmissions: connectivity checks sent again for lack of a response
+ * @consent_expiry: monotonic time, as returned by g_get_monotonic_time(), at
+ * which the consent to send on this pair expires (30 seconds after the last
+ * response, see RFC 7675), or 0 if no check was answered yet. Once a pair is
+ * selected, it is only refreshed with #NiceAgent:keepalive-conncheck.
+ * @bytes_sent: application bytes sent while the pair was selected
+ * @bytes_received: application bytes received while the pair was selected
+ *
+ * Statistics of a candidate pair of the connectivity check list, as returned
+ * by nice_agent_get_candidate_pair_stats(). Free it with
+ * nice_candidate_pair_stats_free().
+ *
+ * Since: 0.1.19
+ */
+typedef struct {
+  NiceCandidate *local;
+  NiceCandidate *remote;
+  guint64 priority;
+  gboolean nominated;
+  gboolean selected;
+  guint64 current_rtt;
+  guint64 total_rtt;
+  guint64 n_rtt_samples;
+  guint64 requests_sent;
+  guint64 requests_received;
+  guint64 responses_sent;
+  guint64 responses_received;
+  guint64 retransmissions;
+  gint64 consent_expiry;
+  guint64 bytes_sent;
+  guint64 bytes_received;
+} NiceCandidatePairStats;
+
 
 #define NICE_TYPE_AGENT nice_agent_get_type()
 
@@ -853,6 +1017,41 @@ nice_agent_send_messages_nonblocking (
     GCancellable *cancellable,
     GError **error);
 
+/**
+ * nice_agent_send_fanout:
+ * @agent: a #NiceAgent
+ * @payload: the data to send to every destination
+ * @destinations: (array length=n_destinations): the stream/component pairs to
+ * send to, each with an optional header
+ * @n_destinations: number of entries in @destinations
+ *
+ * Sends the same message, made of each destination’s header followed by
+ * @payload, to many components at once, as an SFU forwarding a packet to its
+ * subscribers would. Transmission is non-blocking.
+ *
+ * This is equivalent to calling nice_agent_send_messages_nonblocking() for
+ * every destination, but all selected pairs are resolved under a single lock
+ * and the messages are grouped by local socket, so that every socket is
+ * written to with a single system call where the platform supports it
+ * (sendmmsg() on Linux). The payload buffers are shared between all the
+ * messages rather than copied.
+ *
+ * A destination which is not ready, whose send buffer is full or whose send
+ * fails does not prevent sending to the others; #NiceFanoutDestination.sent
+ * tells which destinations the message was sent to. Reliable components are
+ * supported, but gain nothing over separate sends.
+ *
+ * Returns: the number of destinations the message was sent to
+ *
+ * Since: 0.1.19
+ */
+gint
+nice_agent_send_fanout (
+    NiceAgent *agent,
+    const NiceOutputMessage *payload,
+    NiceFanoutDestination *destinations,
+    guint n_destinations);
+
 /**
  * nice_agent_get_local_candidates:
  * @agent: The #NiceAgent Object
@@ -1278,6 +1477,158 @@ void nice_agent_set_stream_tos (
   guint stream_id,
   gint tos);
 
+/**
+ * nice_agent_set_stream_buffer_sizes:
+ * @agent: The #NiceAgent Object
+ * @stream_id: The ID of the stream
+ * @recv_size: The receive buffer size in bytes, or 0 to use
+ * #NiceAgent:recv-buffer-size
+ * @send_size: The send buffer size in bytes, or 0 to use
+ * #NiceAgent:send-buffer-size
+ *
+ * Sets the size of the kernel receive and send buffers of the stream's
+ * sockets, overriding the agent's #NiceAgent:recv-buffer-size and
+ * #NiceAgent:send-buffer-size for this stream. This applies to the sockets
+ * the stream already has and to those it gets later.
+ *
+ * SO_RCVBUFFORCE and SO_SNDBUFFORCE are used when the process is allowed to,
+ * otherwise the kernel caps the sizes to its configured maximum.
+ *
+ * Since: 0.1.19
+ */
+void nice_agent_set_stream_buffer_sizes (
+  NiceAgent *agent,
+  guint stream_id,
+  guint recv_size,
+  guint send_size);
+
+/**
+ * nice_agent_get_component_kernel_drops:
+ * @agent: The #NiceAgent Object
+ * @stream_id: The ID of the stream
+ * @component_id: The ID of the component
+ *
+ * Gets the number of incoming datagrams the kernel dropped on the
+ * component's UDP sockets because their receive buffer was full, summed over
+ * the sockets the component currently has. A growing count means the
+ * application doesn't read fast enough for the incoming bursts, and that
+ * #NiceAgent:recv-buffer-size (or nice_agent_set_stream_buffer_sizes())
+ * should be raised.
+ *
+ * This is only supported on Linux, through SO_RXQ_OVFL, and is always 0
+ * elsewhere. The count is updated whenever a datagram is received. With
+ * #NiceAgent:io-uring, it also includes the datagrams dropped for being
+ * too long.
+ *
+ * Returns: the number of datagrams dropped by the kernel
+ *
+ * Since: 0.1.19
+ */
+guint64
+nice_agent_get_component_kernel_drops (
+  NiceAgent *agent,
+  guint stream_id,
+  guint component_id);
+
+/**
+ * nice_agent_get_component_stats:
+ * @agent: The #NiceAgent Object
+ * @stream_id: The ID of the stream
+ * @component_id: The ID of the component
+ * @stats: (out caller-allocates): return location for the statistics
+ *
+ * Gets the traffic counters of a component. The counters are maintained on
+ * the send and receive paths at the cost of a few additions per packet, so
+ * this can be polled as often as needed; see also #NiceAgent:stats-interval
+ * to be notified periodically instead.
+ *
+ * Returns: %TRUE if @stats was filled in, %FALSE if the stream or component
+ * doesn't exist
+ *
+ * Since: 0.1.19
+ */
+gboolean
+nice_agent_get_component_stats (
+  NiceAgent *agent,
+  guint stream_id,
+  guint component_id,
+  NiceComponentStats *stats);
+
+/**
+ * nice_agent_get_candidate_pair_stats:
+ * @agent: The #NiceAgent Object
+ * @stream_id: The ID of the stream
+ * @component_id: The ID of the component
+ *
+ * Gets the statistics of every candidate pair of the connectivity check list
+ * of a component, by decreasing priority. The statistics of the selected pair
+ * keep being updated by the keepalive connectivity checks once the checks are
+ * over (see #NiceAgent:keepalive-conncheck).
+ *
+ * The check list is dropped when the selected pair is forced with
+ * nice_agent_set_selected_pair(), after which the list is empty.
+ *
+ * Returns: (element-type NiceCandidatePairStats) (transfer full): a list of
+ * #NiceCandidatePairStats, to be freed with nice_candidate_pair_stats_free()
+ *
+ * Since: 0.1.19
+ */
+GSList *
+nice_agent_get_candidate_pair_stats (
+  NiceAgent *agent,
+  guint stream_id,
+  guint component_id);
+
+/**
+ * nice_candidate_pair_stats_free:
+ * @stats: (transfer full): a #NiceCandidatePairStats
+ *
+ * Frees a #NiceCandidatePairStats returned by
+ * nice_agent_get_candidate_pair_stats().
+ *
+ * Since: 0.1.19
+ */
+void
+nice_candidate_pair_stats_free (NiceCandidatePairStats *stats);
+
+/**
+ * nice_agent_dump_event_log:
+ * @agent: The #NiceAgent Object
+ *
+ * Retrieves the binary event log of the agent, see
+ * #NiceAgent:event-log-size. The log holds the most recent structured
+ * events, such as gathered candidates, candidate pair state changes,
+ * connectivity checks with their transaction ID, TURN allocations and
+ * selected pair changes, oldest first.
+ *
+ * The dump is meant to be saved along with a failed session and decoded
+ * with the niceevtdec tool shipped with libnice. Its layout is versioned
+ * and is not part of the API.
+ *
+ * Returns: (transfer full) (nullable): the serialized log, or %NULL if
+ * #NiceAgent:event-log-size is 0
+ *
+ * Since: 0.1.19
+ */
+GBytes *
+nice_agent_dump_event_log (NiceAgent *agent);
+
+/**
+ * nice_agent_get_memory_footprint:
+ * @agent: The #NiceAgent Object
+ * @footprint: (out caller-allocates): return location for the footprint
+ *
+ * Reports how much memory @agent uses for its streams, components,
+ * candidate pairs and connectivity checks, to help size hosts running many
+ * agents or streams.
+ *
+ * Since: 0.1.19
+ */
+void
+nice_agent_get_memory_footprint (
+  NiceAgent *agent,
+  NiceAgentMemoryFootprint *footprint);
+
 
 
 /**
@@ -1704,6 +2055,77 @@ nice_agent_close_async (NiceAgent *agent, GAsyncReadyCallback callback,
 GPtrArray *
 nice_agent_get_sockets (NiceAgent *agent, guint stream_id, guint component_id);
 
+/**
+ * NiceRecvRing:
+ *
+ * A fixed-size queue of packets received on a single component by one of the
+ * agent’s network threads (see #NiceAgent:io-threads), created with
+ * nice_agent_attach_recv_ring(). The network thread is its only producer and
+ * the application, draining it with nice_recv_ring_recv_messages(), its only
+ * consumer; neither side takes the agent’s lock to hand packets over.
+ *
+ * Since: 0.1.19
+ */
+typedef struct _NiceRecvRing NiceRecvRing;
+
+GType nice_recv_ring_get_type (void);
+#define NICE_TYPE_RECV_RING (nice_recv_ring_get_type ())
+
+/**
+ * nice_agent_attach_recv_ring:
+ * @agent: The #NiceAgent Object
+ * @stream_id: The ID of the stream
+ * @component_id: The ID of the component
+ * @n_slots: The number of packets the ring can hold, rounded up to a power of
+ * two and capped at 65536
+ * @slot_size: The size of each packet slot, in bytes; longer packets are
+ * truncated
+ *
+ * Moves the sockets of a component to one of the agent’s network threads and
+ * makes it deliver received packets into a new #NiceRecvRing, instead of an
+ * I/O callback. The application drains the ring with
+ * nice_recv_ring_recv_messages(), from any single thread. STUN packets are
+ * still handled internally and never reach the ring. Packets arriving while
+ * the ring is full are dropped and counted by nice_recv_ring_get_n_dropped().
+ *
+ * Components are spread over the #NiceAgent:io-threads threads in the order
+ * they are attached. Calling nice_agent_attach_recv() afterwards detaches the
+ * ring again. When the component is removed, the ring is closed: once it has
+ * been drained, nice_recv_ring_recv_messages() returns
+ * %G_IO_ERROR_BROKEN_PIPE.
+ *
+ * This is only supported for non-reliable agents.
+ *
+ * Returns: (transfer full): the new #NiceRecvRing, or %NULL if the component
+ * could not be found. Free with nice_recv_ring_unref().
+ *
+ * Since: 0.1.19
+ */
+NiceRecvRing *
+nice_agent_attach_recv_ring (
+  NiceAgent *agent,
+  guint stream_id,
+  guint component_id,
+  guint n_slots,
+  gsize slot_size);
+
+NiceRecvRing *
+nice_recv_ring_ref (NiceRecvRing *ring);
+
+void
+nice_recv_ring_unref (NiceRecvRing *ring);
+
+gint
+nice_recv_ring_recv_messages (
+  NiceRecvRing *ring,
+  NiceInputMessage *messages,
+  guint n_messages,
+  gint64 timeout_us,
+  GError **error);
+
+guint
+nice_recv_ring_get_n_dropped (NiceRecvRing *ring);
+
 G_END_DECLS
 
 #endif /* __LIBNICE_AGENT_H__ */
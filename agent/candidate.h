@@ -127,6 +127,13 @@ typedef enum
  * @NICE_RELAY_TYPE_TURN_TLS: A TURN relay using TLS over TCP
  *
  * An enum representing the type of relay to use
+ *
+ * With %NICE_COMPATIBILITY_GOOGLE, %NICE_COMPATIBILITY_OC2007 and
+ * %NICE_COMPATIBILITY_OC2007R2, %NICE_RELAY_TYPE_TURN_TLS only performs the
+ * fixed pseudo-TLS handshake those servers expect. Otherwise a real TLS
+ * session is set up, verifying the server certificate unless
+ * #NiceAgent:turn-tls-insecure is set, and on Linux it is handed over to
+ * kernel TLS when the negotiated cipher allows it.
  */
 typedef enum {
   NICE_RELAY_TYPE_TURN_UDP,
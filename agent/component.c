@@ -58,6 +58,7 @@ static volatile unsigned int n_components_destroyed = 0;
 #include "component.h"
 #include "discovery.h"
 #include "agent-priv.h"
+#include "iothread.h"
 
 G_DEFINE_TYPE (NiceComponent, nice_component, G_TYPE_OBJECT);
 
@@ -88,6 +89,44 @@ static void
 nice_component_clear_selected_pair (NiceComponent *component);
 
 
+/* Counter shared between a component and the ComponentSources mirroring its
+ * sockets. Writers hold the agent lock; readers may poll it without. */
+struct _SocketSourcesAge {
+  gint ref_count;
+  gint age;
+};
+
+static SocketSourcesAge *
+socket_sources_age_new (void)
+{
+  SocketSourcesAge *age = g_slice_new0 (SocketSourcesAge);
+
+  age->ref_count = 1;
+
+  return age;
+}
+
+static SocketSourcesAge *
+socket_sources_age_ref (SocketSourcesAge *age)
+{
+  g_atomic_int_inc (&age->ref_count);
+
+  return age;
+}
+
+static void
+socket_sources_age_unref (SocketSourcesAge *age)
+{
+  if (g_atomic_int_dec_and_test (&age->ref_count))
+    g_slice_free (SocketSourcesAge, age);
+}
+
+static void
+socket_sources_age_bump (NiceComponent *component)
+{
+  g_atomic_int_inc (&component->socket_sources_age->age);
+}
+
 void
 incoming_check_free (IncomingCheck *icheck)
 {
@@ -112,9 +151,26 @@ socket_source_attach (SocketSource *socket_source, GMainContext *context)
   if (socket_source->socket->type == NICE_SOCKET_TYPE_UDP_TURN)
     return;
 
+#ifdef HAVE_SYS_EPOLL_H
+  if (socket_source->component->shared_socket_source &&
+      socket_source->socket->create_source == NULL) {
+    g_assert (socket_source->watch == NULL);
+    socket_source->watch = nice_epoll_watch_add (context,
+        socket_source->socket->fileno, component_io_cb, socket_source);
+
+    if (socket_source->watch != NULL) {
+      nice_debug ("Watching socket %p (FD %d) from the epoll source of "
+          "context %p", socket_source->socket,
+          g_socket_get_fd (socket_source->socket->fileno), context);
+      return;
+    }
+
+    /* Fall back to a source of its own. */
+  }
+#endif
+
   /* Create a source. */
-  source = g_socket_create_source (socket_source->socket->fileno,
-      G_IO_IN, NULL);
+  source = nice_socket_create_source (socket_source->socket);
   g_source_set_callback (source, (GSourceFunc) G_CALLBACK (component_io_cb),
       socket_source, NULL);
 
@@ -142,6 +198,12 @@ socket_source_detach (SocketSource *source)
     g_source_unref (source->source);
   }
   source->source = NULL;
+
+#ifdef HAVE_SYS_EPOLL_H
+  if (source->watch != NULL)
+    nice_epoll_watch_remove (source->watch);
+  source->watch = NULL;
+#endif
 }
 
 static void
@@ -319,6 +381,8 @@ nice_component_clear_selected_pair (NiceComponent *component)
     component->selected_pair.keepalive.tick_source = NULL;
   }
 
+  nice_slab_release (component->selected_pair.keepalive.stun_message.buffer);
+
   memset (&component->selected_pair, 0, sizeof(CandidatePair));
 }
 
@@ -383,6 +447,11 @@ nice_component_close (NiceAgent *agent, NiceStream *stream, NiceComponent *cmp)
   while ((data = g_queue_pop_head (&cmp->pending_io_messages)) != NULL)
     io_callback_data_free (data);
 
+  if (cmp->recv_ring != NULL) {
+    nice_recv_ring_close (cmp->recv_ring);
+    g_clear_pointer (&cmp->recv_ring, nice_recv_ring_unref);
+  }
+
   nice_component_deschedule_io_callback (cmp);
 
   g_cancellable_cancel (cmp->stop_cancellable);
@@ -505,6 +574,7 @@ nice_component_update_selected_pair (NiceAgent *agent, NiceComponent *component,
   component->selected_pair.remote = pair->remote;
   component->selected_pair.priority = pair->priority;
   component->selected_pair.stun_priority = pair->stun_priority;
+  component->selected_pair.check_pair = pair->check_pair;
 
   nice_component_add_valid_candidate (agent, component,
       (NiceCandidate *) pair->remote);
@@ -634,7 +704,7 @@ nice_component_attach_socket (NiceComponent *component, NiceSocket *nicesock)
     component->socket_sources =
         g_slist_prepend (component->socket_sources, socket_source);
     if (nicesock->fileno != NULL)
-      component->socket_sources_age++;
+      socket_sources_age_bump (component);
   }
 
   /* Create and attach a source */
@@ -680,6 +750,8 @@ nice_component_detach_socket (NiceComponent *component, NiceSocket *nicesock)
   nice_debug ("Detach socket %p.", nicesock);
 
   /* Remove the socket from various lists. */
+  g_queue_remove (&component->tcp_half_open, nicesock);
+
   for (l = component->incoming_checks.head; l != NULL;) {
     IncomingCheck *icheck = l->data;
     GList *next = l->next;
@@ -701,7 +773,7 @@ nice_component_detach_socket (NiceComponent *component, NiceSocket *nicesock)
   /* Detach the source. */
   socket_source = s->data;
   component->socket_sources = g_slist_delete_link (component->socket_sources, s);
-  component->socket_sources_age++;
+  socket_sources_age_bump (component);
 
   socket_source_free (socket_source);
 }
@@ -734,7 +806,8 @@ nice_component_free_socket_sources (NiceComponent *component)
   g_slist_free_full (component->socket_sources,
       (GDestroyNotify) socket_source_free);
   component->socket_sources = NULL;
-  component->socket_sources_age++;
+  socket_sources_age_bump (component);
+  g_queue_clear (&component->tcp_half_open);
 
   nice_component_clear_selected_pair (component);
 }
@@ -1092,6 +1165,7 @@ nice_component_init (NiceComponent *component)
   component->restart_candidate = NULL;
   component->tcp = NULL;
   g_weak_ref_init (&component->agent_ref, NULL);
+  component->socket_sources_age = socket_sources_age_new ();
 
   g_mutex_init (&component->io_mutex);
   g_queue_init (&component->pending_io_messages);
@@ -1113,6 +1187,7 @@ nice_component_init (NiceComponent *component)
 
   g_queue_init (&component->queued_tcp_packets);
   g_queue_init (&component->incoming_checks);
+  g_queue_init (&component->tcp_half_open);
 }
 
 static void
@@ -1126,6 +1201,7 @@ nice_component_constructed (GObject *obj)
   agent = g_weak_ref_get (&component->agent_ref);
   g_assert (agent != NULL);
   nice_agent_init_stun_agent (agent, &component->stun_agent);
+  component->shared_socket_source = agent->shared_socket_source;
 
   g_object_unref (agent);
 
@@ -1224,6 +1300,8 @@ nice_component_finalize (GObject *obj)
   g_clear_object (&cmp->stop_cancellable);
   g_clear_object (&cmp->iostream);
   g_mutex_clear (&cmp->io_mutex);
+  g_free (cmp->recv_scratch);
+  g_free (cmp->recv_discard);
 
   if (cmp->stop_cancellable_source != NULL) {
     g_source_destroy (cmp->stop_cancellable_source);
@@ -1238,6 +1316,7 @@ nice_component_finalize (GObject *obj)
   g_main_context_unref (cmp->own_ctx);
 
   g_weak_ref_clear (&cmp->agent_ref);
+  socket_sources_age_unref (cmp->socket_sources_age);
 
   g_atomic_int_inc (&n_components_destroyed);
   nice_debug ("Destroyed NiceComponent (%u created, %u destroyed)",
@@ -1264,8 +1343,9 @@ nice_component_finalize (GObject *obj)
  * Component. Changes to the Component’s list of sockets are detected on each
  * call to component_source_prepare(), which compares a stored age with the
  * current age of the Component’s socket list — if the socket list has changed,
- * the age will have increased (indicating added sockets) or will have been
- * reset to 0 (indicating all sockets have been closed).
+ * the age will have increased. The age counter is shared with the Component
+ * and read atomically, so the agent lock is only taken when the socket list
+ * actually changed rather than on every main loop iteration.
  */
 typedef struct {
   GSource parent;
@@ -1275,6 +1355,8 @@ typedef struct {
   GWeakRef agent_ref;
   guint stream_id;
   guint component_id;
+  SocketSourcesAge *socket_sources_age;  /* owned; NULL until the component
+                                            is found */
   guint component_socket_sources_age;
 
   /* SocketSource, free with free_child_socket_source() */
@@ -1290,6 +1372,14 @@ component_source_prepare (GSource *source, gint *timeout_)
   NiceAgent *agent;
   NiceComponent *component;
   GSList *parentl, *childl;
+  guint age;
+
+  /* Fast path: nothing to resynchronise, so don’t contend on the agent lock
+   * on every iteration of the main loop. */
+  if (component_source->socket_sources_age != NULL &&
+      (guint) g_atomic_int_get (&component_source->socket_sources_age->age) ==
+      component_source->component_socket_sources_age)
+    return FALSE;
 
   agent = g_weak_ref_get (&component_source->agent_ref);
   if (!agent)
@@ -1303,9 +1393,14 @@ component_source_prepare (GSource *source, gint *timeout_)
           &component))
     goto done;
 
+  if (component_source->socket_sources_age == NULL)
+    component_source->socket_sources_age =
+        socket_sources_age_ref (component->socket_sources_age);
 
-  if (component->socket_sources_age ==
-      component_source->component_socket_sources_age)
+  /* Writers only bump the age with the agent lock held, so it is stable now
+   * and the socket list below matches it. */
+  age = g_atomic_int_get (&component->socket_sources_age->age);
+  if (age == component_source->component_socket_sources_age)
     goto done;
 
   /* If the age has changed, either
@@ -1338,8 +1433,7 @@ component_source_prepare (GSource *source, gint *timeout_)
     child_socket_source = g_slice_new0 (SocketSource);
     child_socket_source->socket = parent_socket_source->socket;
     child_socket_source->source =
-        g_socket_create_source (child_socket_source->socket->fileno, G_IO_IN,
-            NULL);
+        nice_socket_create_source (child_socket_source->socket);
     source_set_dummy_callback (child_socket_source->source);
     g_source_add_child_source (source, child_socket_source->source);
     g_source_unref (child_socket_source->source);
@@ -1369,7 +1463,7 @@ component_source_prepare (GSource *source, gint *timeout_)
 
 
   /* Update the age. */
-  component_source->component_socket_sources_age = component->socket_sources_age;
+  component_source->component_socket_sources_age = age;
 
  done:
 
@@ -1403,6 +1497,8 @@ component_source_finalize (GSource *source)
   ComponentSource *component_source = (ComponentSource *) source;
 
   g_slist_free_full (component_source->socket_sources, free_child_socket_source);
+  if (component_source->socket_sources_age != NULL)
+    socket_sources_age_unref (component_source->socket_sources_age);
 
   g_weak_ref_clear (&component_source->agent_ref);
   g_object_unref (component_source->pollable_stream);
@@ -1642,3 +1738,83 @@ nice_component_get_sockets (NiceComponent *component)
 
   return array;
 }
+
+/* Traffic accounting for nice_agent_get_component_stats(). These must be
+ * called with the agent lock held, which every send and receive path already
+ * holds, so plain additions are enough. */
+void
+nice_component_count_media_sent (NiceComponent *component, gsize n_packets,
+    gsize n_bytes)
+{
+  component->stats.media_packets_sent += n_packets;
+  component->stats.media_bytes_sent += n_bytes;
+
+  if (component->selected_pair.local != NULL &&
+      component->selected_pair.local->c.type == NICE_CANDIDATE_TYPE_RELAYED)
+    component->stats.relayed_packets_sent += n_packets;
+
+  if (component->selected_pair.check_pair != NULL)
+    component->selected_pair.check_pair->stats.bytes_sent += n_bytes;
+}
+
+void
+nice_component_count_media_received (NiceComponent *component, gsize n_bytes,
+    gboolean relayed)
+{
+  component->stats.media_packets_received++;
+  component->stats.media_bytes_received += n_bytes;
+
+  if (relayed)
+    component->stats.relayed_packets_received++;
+
+  if (component->selected_pair.check_pair != NULL)
+    component->selected_pair.check_pair->stats.bytes_received += n_bytes;
+}
+
+void
+nice_component_count_stun_sent (NiceComponent *component, gsize n_bytes)
+{
+  component->stats.stun_packets_sent++;
+  component->stats.stun_bytes_sent += n_bytes;
+}
+
+void
+nice_component_count_stun_received (NiceComponent *component, gsize n_bytes)
+{
+  component->stats.stun_packets_received++;
+  component->stats.stun_bytes_received += n_bytes;
+}
+
+/* Attaches @nicesock, just accepted on a passive ICE-TCP candidate, and keeps
+ * track of it until nice_component_tcp_socket_checked() is called. Anyone can
+ * open connections to a passive candidate, so once more than
+ * NICE_COMPONENT_MAX_TCP_HALF_OPEN of them wait for a check, the oldest ones
+ * are closed. */
+void
+nice_component_attach_tcp_accepted_socket (NiceAgent *agent,
+    NiceComponent *component, NiceSocket *nicesock)
+{
+  nice_component_attach_socket (component, nicesock);
+  g_queue_push_tail (&component->tcp_half_open, nicesock);
+  component->stats.ice_tcp_accepted++;
+
+  while (g_queue_get_length (&component->tcp_half_open) >
+      NICE_COMPONENT_MAX_TCP_HALF_OPEN) {
+    NiceSocket *oldest = g_queue_pop_head (&component->tcp_half_open);
+
+    nice_debug ("Component %p: closing tcp accept socket %p, which never "
+        "received a connectivity check", component, oldest);
+    component->stats.ice_tcp_evicted++;
+    nice_component_remove_socket (agent, component, oldest);
+  }
+}
+
+/* Called for every authenticated connectivity check; the socket it came in
+ * on is no longer a half-open connection, if it was one */
+void
+nice_component_tcp_socket_checked (NiceComponent *component,
+    NiceSocket *nicesock)
+{
+  if (component->tcp_half_open.length > 0)
+    g_queue_remove (&component->tcp_half_open, nicesock);
+}
@@ -52,6 +52,7 @@ typedef struct _NiceComponent NiceComponent;
 #include "pseudotcp.h"
 #include "stream.h"
 #include "socket.h"
+#include "epollsource.h"
 
 G_BEGIN_DECLS
 
@@ -66,6 +67,7 @@ G_BEGIN_DECLS
 typedef struct _CandidatePair CandidatePair;
 typedef struct _CandidatePairKeepalive CandidatePairKeepalive;
 typedef struct _IncomingCheck IncomingCheck;
+typedef struct _SocketSourcesAge SocketSourcesAge;
 
 struct _CandidatePairKeepalive
 {
@@ -74,8 +76,10 @@ struct _CandidatePairKeepalive
   guint stream_id;
   guint component_id;
   StunTimer timer;
-  uint8_t stun_buffer[STUN_MAX_MESSAGE_SIZE_IPV6];
-  StunMessage stun_message;
+  StunMessage stun_message;   /* buffer allocated from the agent’s slab
+                                 while the request is ongoing */
+  gint64 sent_time;           /* monotonic time the ongoing request was
+                                 first sent */
 };
 
 struct _CandidatePair
@@ -85,6 +89,9 @@ struct _CandidatePair
   guint64 priority;           /* candidate pair priority */
   guint32 stun_priority;
   CandidatePairKeepalive keepalive;
+  struct _CandidateCheckPair *check_pair;  /* the pair of the check list
+                                              this was selected from, if it
+                                              still exists; for its stats */
 };
 
 struct _IncomingCheck
@@ -105,12 +112,15 @@ incoming_check_free (IncomingCheck *icheck);
  * component->ctx.
  *
  * Socket must be non-NULL, but source may be NULL if it has been detached.
+ * When the agent uses a shared socket source, the socket is polled through
+ * watch instead, and source stays NULL.
  *
  * The Component is stored so this may be used as the user data for a GSource
  * callback. */
 typedef struct {
   NiceSocket *socket;
   GSource *source;
+  NiceEpollWatch *watch;
   NiceComponent *component;
 } SocketSource;
 
@@ -150,6 +160,13 @@ io_callback_data_free (IOCallbackData *data);
 #define NICE_COMPONENT_GET_CLASS(obj) \
   (G_TYPE_INSTANCE_GET_CLASS ((obj), NICE_TYPE_COMPONENT, NiceComponentClass))
 
+/* Minimum receive buffer size needed to parse any STUN packet */
+#define NICE_COMPONENT_RECV_SCRATCH_SIZE 1280
+
+/* Connections accepted on passive ICE-TCP candidates which may wait for
+ * their first connectivity check at the same time */
+#define NICE_COMPONENT_MAX_TCP_HALF_OPEN 32
+
 struct _NiceComponent {
   /*< private >*/
   GObject parent;
@@ -161,8 +178,13 @@ struct _NiceComponent {
   GSList *remote_candidates;   /* list of NiceCandidate objs */
   GList *valid_candidates;     /* list of owned remote NiceCandidates that are part of valid pairs */
   GSList *socket_sources;      /* list of SocketSource objs; must only grow monotonically */
-  guint socket_sources_age;    /* incremented when socket_sources changes */
+  SocketSourcesAge *socket_sources_age; /* owned; incremented atomically
+                                            when socket_sources changes,
+                                            shared with ComponentSources */
   GQueue incoming_checks;     /* list of IncomingCheck objs */
+  GQueue tcp_half_open;       /* unowned accepted ICE-TCP NiceSockets which
+                                 haven't carried a valid check yet, oldest
+                                 first */
   GList *turn_servers;             /* List of TurnServer objs */
   CandidatePair selected_pair; /* independent from checklists, 
 				    see ICE 11.1. "Sending Media" (ID-19) */
@@ -199,9 +221,27 @@ struct _NiceComponent {
   NiceInputMessageIter recv_messages_iter; /* current write position in
                                                 recv_messages */
   GError **recv_buf_error;          /* error information about failed reads */
+  NiceRecvRing *recv_ring;          /* owned; set by
+                                         nice_agent_attach_recv_ring(), filled
+                                         in component_io_cb() */
+  guint8 *recv_scratch;             /* owned; spill-over area appended to
+                                         recv_messages smaller than
+                                         NICE_COMPONENT_RECV_SCRATCH_SIZE so
+                                         that STUN packets are never
+                                         truncated; allocated on first use */
+  guint8 *recv_discard;             /* owned; receive area for packets
+                                         dropped because recv_ring is full,
+                                         kept off the network thread’s
+                                         stack; allocated on first use */
+  NiceComponentStats stats;         /* traffic counters, updated with the
+                                       agent lock held; the kernel drop and
+                                       pseudo-TCP fields are filled in by
+                                       nice_agent_get_component_stats() */
 
   GWeakRef agent_ref;
   guint stream_id;
+  gboolean shared_socket_source;    /* copied from the agent; poll sockets
+                                       through the context’s epoll source */
 
   StunAgent stun_agent; /* This stun agent is used to validate all stun requests */
 
@@ -314,6 +354,28 @@ nice_component_verify_remote_candidate (NiceComponent *component,
 GPtrArray *
 nice_component_get_sockets (NiceComponent *component);
 
+void
+nice_component_count_media_sent (NiceComponent *component, gsize n_packets,
+    gsize n_bytes);
+
+void
+nice_component_count_media_received (NiceComponent *component, gsize n_bytes,
+    gboolean relayed);
+
+void
+nice_component_count_stun_sent (NiceComponent *component, gsize n_bytes);
+
+void
+nice_component_count_stun_received (NiceComponent *component, gsize n_bytes);
+
+void
+nice_component_attach_tcp_accepted_socket (NiceAgent *agent,
+    NiceComponent *component, NiceSocket *nicesock);
+
+void
+nice_component_tcp_socket_checked (NiceComponent *component,
+    NiceSocket *nicesock);
+
 G_END_DECLS
 
 #endif /* _NICE_COMPONENT_H */
@@ -57,6 +57,7 @@
 #include "agent-priv.h"
 #include "conncheck.h"
 #include "discovery.h"
+#include "trace.h"
 #include "stun/stun5389.h"
 #include "stun/usages/ice.h"
 #include "stun/usages/bind.h"
@@ -136,6 +137,8 @@ priv_state_to_string (NiceCheckState state)
   p->state = s; \
   nice_debug ("Agent %p : pair %p state %s (%s)", \
       a, p, priv_state_to_string (s), G_STRFUNC); \
+  nice_event_log_add (a->event_log, NICE_EVENT_PAIR_STATE, p->stream_id, \
+      p->component_id, s, 0, p->priority, NULL); \
 }G_STMT_END
 
 static const gchar *
@@ -189,6 +192,8 @@ priv_socket_type_to_string (NiceSocketType type)
       return "tcp-pass";
     case NICE_SOCKET_TYPE_TCP_SO:
       return "tcp-so";
+    case NICE_SOCKET_TYPE_TLS:
+      return "tls";
     default:
       g_assert_not_reached ();
   }
@@ -225,7 +230,8 @@ print_component_incoming_checks (NiceAgent *agent, NiceStream *stream,
 static void
 priv_print_conn_check_lists (NiceAgent *agent, const gchar *where, const gchar *detail)
 {
-  GSList *i, *k, *l;
+  GSList *i, *k;
+  StunTransaction *stun;
   guint j, m;
   gint64 now;
 
@@ -276,8 +282,8 @@ priv_print_conn_check_lists (NiceAgent *agent, const gchar *where, const gchar *
               pair->use_candidate_on_next_check ? "C" : "",
               g_slist_find (agent->triggered_check_queue, pair) ? "T" : "");
 
-          for (l = pair->stun_transactions, m = 0; l; l = l->next, m++) {
-            StunTransaction *stun = l->data;
+          for (stun = pair->stun_transactions, m = 0; stun;
+               stun = stun->next, m++) {
             nice_debug ("Agent %p : *** sc=%d/%d : pair %p :   "
                 "stun#=%d timer=%d/%d %" G_GINT64_FORMAT "/%dms buf=%p %s",
                 agent, pair->stream_id, pair->component_id, pair, m,
@@ -534,26 +540,39 @@ conn_check_stun_transactions_count (NiceAgent *agent)
     NiceStream *s = i->data;
     for (j = s->conncheck_list; j ; j = j->next) {
       CandidateCheckPair *p = j->data;
+      StunTransaction *stun;
 
-      if (p->stun_transactions)
-        count += g_slist_length (p->stun_transactions);
+      for (stun = p->stun_transactions; stun; stun = stun->next)
+        count++;
     }
   }
   return count;
 }
 
 /*
- * Create a new STUN transaction and add it to the list
- * of ongoing stun transactions of a pair.
+ * Create a new STUN transaction holding a copy of a request, and add it to
+ * the list of ongoing stun transactions of a pair.
  *
+ * @agent the agent whose slab the transaction is allocated from.
  * @pair the pair the new stun transaction should be added to.
+ * @message the request, @len bytes long.
  * @return the created stun transaction.
  */
 static StunTransaction *
-priv_add_stun_transaction (CandidateCheckPair *pair)
+priv_add_stun_transaction (NiceAgent *agent, CandidateCheckPair *pair,
+  const StunMessage *message, gsize len)
 {
-  StunTransaction *stun = g_slice_new0 (StunTransaction);
-  pair->stun_transactions = g_slist_prepend (pair->stun_transactions, stun);
+  StunTransaction *stun;
+
+  stun = nice_slab_alloc (agent->stun_slab, sizeof (StunTransaction) + len);
+  memset (stun, 0, sizeof (StunTransaction));
+  stun->message = *message;
+  stun->message.buffer = (uint8_t *) (stun + 1);
+  stun->message.buffer_len = len;
+  memcpy (stun->message.buffer, message->buffer, len);
+
+  stun->next = pair->stun_transactions;
+  pair->stun_transactions = stun;
   pair->retransmit = TRUE;
   return stun;
 }
@@ -561,26 +580,16 @@ priv_add_stun_transaction (CandidateCheckPair *pair)
 /*
  * Forget a STUN transaction.
  *
- * @data the stun transaction to be forgotten.
- * @user_data the component contained the concerned stun agent.
+ * @stun the stun transaction to be forgotten.
+ * @component the component contained the concerned stun agent.
  */
 static void
-priv_forget_stun_transaction (gpointer data, gpointer user_data)
+priv_forget_stun_transaction (StunTransaction *stun, NiceComponent *component)
 {
-  StunTransaction *stun = data;
-  NiceComponent *component = user_data;
   StunTransactionId id;
 
-  if (stun->message.buffer != NULL) {
-    stun_message_id (&stun->message, id);
-    stun_agent_forget_transaction (&component->stun_agent, id);
-  }
-}
-
-static void
-priv_free_stun_transaction (gpointer data)
-{
-  g_slice_free (StunTransaction, data);
+  stun_message_id (&stun->message, id);
+  stun_agent_forget_transaction (&component->stun_agent, id);
 }
 
 /*
@@ -596,9 +605,18 @@ static void
 priv_remove_stun_transaction (CandidateCheckPair *pair,
   StunTransaction *stun, NiceComponent *component)
 {
+  StunTransaction **link;
+
   priv_forget_stun_transaction (stun, component);
-  pair->stun_transactions = g_slist_remove (pair->stun_transactions, stun);
-  priv_free_stun_transaction (stun);
+
+  for (link = &pair->stun_transactions; *link; link = &(*link)->next) {
+    if (*link == stun) {
+      *link = stun->next;
+      break;
+    }
+  }
+
+  nice_slab_release (stun);
   if (pair->stun_transactions == NULL)
     pair->retransmit = FALSE;
 }
@@ -615,9 +633,14 @@ static void
 priv_free_all_stun_transactions (CandidateCheckPair *pair,
   NiceComponent *component)
 {
-  if (component)
-    g_slist_foreach (pair->stun_transactions, priv_forget_stun_transaction, component);
-  g_slist_free_full (pair->stun_transactions, priv_free_stun_transaction);
+  StunTransaction *stun, *next;
+
+  for (stun = pair->stun_transactions; stun; stun = next) {
+    next = stun->next;
+    if (component)
+      priv_forget_stun_transaction (stun, component);
+    nice_slab_release (stun);
+  }
   pair->stun_transactions = NULL;
   pair->retransmit = FALSE;
 }
@@ -644,7 +667,7 @@ static gboolean
 priv_conn_check_tick_stream (NiceAgent *agent, NiceStream *stream)
 {
   gboolean pair_failed = FALSE;
-  GSList *i, *j;
+  GSList *i;
   unsigned int timeout;
   gint64 now;
 
@@ -655,6 +678,7 @@ priv_conn_check_tick_stream (NiceAgent *agent, NiceStream *stream)
     CandidateCheckPair *p = i->data;
     gchar tmpbuf1[INET6_ADDRSTRLEN], tmpbuf2[INET6_ADDRSTRLEN];
     NiceComponent *component;
+    StunTransaction *stun;
     guint index = 0, remaining = 0;
 
     if (p->stun_transactions == NULL)
@@ -664,10 +688,9 @@ priv_conn_check_tick_stream (NiceAgent *agent, NiceStream *stream)
         NULL, &component))
       continue;
 
-    j = p->stun_transactions;
-    while (j) {
-      StunTransaction *stun = j->data;
-      GSList *next = j->next;
+    stun = p->stun_transactions;
+    while (stun) {
+      StunTransaction *next = stun->next;
 
       if (now < stun->next_tick)
         remaining++;
@@ -696,7 +719,20 @@ timer_return_timeout:
 
             agent_socket_send (p->sockptr, &p->remote->addr,
                 stun_message_length (&stun->message),
-                (gchar *)stun->buffer);
+                (gchar *)stun->message.buffer);
+            nice_component_count_stun_sent (component,
+                stun_message_length (&stun->message));
+            p->stats.retransmissions++;
+            NICE_TRACE (stun__request__sent, agent, p->stream_id,
+                p->component_id, p, stun->timer.retransmissions);
+            if (agent->event_log) {
+              StunTransactionId id;
+
+              stun_message_id (&stun->message, id);
+              nice_event_log_add (agent->event_log, NICE_EVENT_CHECK_SENT,
+                  p->stream_id, p->component_id, stun->timer.retransmissions,
+                  0, p->priority, id);
+            }
 
             /* note: convert from milli to microseconds for g_time_val_add() */
             stun->next_tick = now + timeout * 1000;
@@ -712,7 +748,7 @@ timer_return_timeout:
             g_assert_not_reached();
             break;
         }
-      j = next;
+      stun = next;
       index++;
     }
 
@@ -1260,6 +1296,7 @@ static gboolean priv_conn_keepalive_retransmissions_tick_agent_locked (
 
         stun_message_id (&pair->keepalive.stun_message, id);
         stun_agent_forget_transaction (&component->stun_agent, id);
+        nice_slab_release (pair->keepalive.stun_message.buffer);
         pair->keepalive.stun_message.buffer = NULL;
 
         if (agent->media_after_tick) {
@@ -1276,14 +1313,24 @@ static gboolean priv_conn_keepalive_retransmissions_tick_agent_locked (
         break;
       }
     case STUN_USAGE_TIMER_RETURN_RETRANSMIT:
-      /* Retransmit */
-      agent_socket_send (pair->local->sockptr, &pair->remote->c.addr,
-          stun_message_length (&pair->keepalive.stun_message),
-          (gchar *)pair->keepalive.stun_buffer);
+      {
+        NiceComponent *component;
 
-      nice_debug ("Agent %p : Retransmitting keepalive conncheck",
-          agent);
+        /* Retransmit */
+        agent_socket_send (pair->local->sockptr, &pair->remote->c.addr,
+            stun_message_length (&pair->keepalive.stun_message),
+            (gchar *)pair->keepalive.stun_message.buffer);
 
+        if (agent_find_component (agent, pair->keepalive.stream_id,
+                pair->keepalive.component_id, NULL, &component))
+          nice_component_count_stun_sent (component,
+              stun_message_length (&pair->keepalive.stun_message));
+        if (pair->check_pair)
+          pair->check_pair->stats.retransmissions++;
+
+        nice_debug ("Agent %p : Retransmitting keepalive conncheck",
+            agent);
+      }
       G_GNUC_FALLTHROUGH;
     case STUN_USAGE_TIMER_RETURN_SUCCESS:
       agent_timeout_add_with_context (agent,
@@ -1398,6 +1445,8 @@ static gboolean priv_conn_keepalive_tick_unlocked (NiceAgent *agent)
   guint64 now;
   guint64 min_next_tick;
   guint64 next_timer_tick;
+  StunMessage message;
+  uint8_t buffer[STUN_MAX_MESSAGE_SIZE_IPV6];
 
   now = g_get_monotonic_time ();
   min_next_tick = now + 1000 * NICE_AGENT_TIMER_TR_DEFAULT;
@@ -1459,8 +1508,7 @@ static gboolean priv_conn_keepalive_tick_unlocked (NiceAgent *agent)
           }
           if (uname_len > 0) {
             buf_len = stun_usage_ice_conncheck_create (&component->stun_agent,
-                &p->keepalive.stun_message, p->keepalive.stun_buffer,
-                sizeof(p->keepalive.stun_buffer),
+                &message, buffer, sizeof(buffer),
                 uname, uname_len, password, password_len,
                 agent->controlling_mode, agent->controlling_mode,
                 p->stun_priority,
@@ -1469,9 +1517,16 @@ static gboolean priv_conn_keepalive_tick_unlocked (NiceAgent *agent)
                 agent_to_ice_compatibility (agent));
 
             nice_debug ("Agent %p: conncheck created %zd - %p",
-                agent, buf_len, p->keepalive.stun_message.buffer);
+                agent, buf_len, message.buffer);
 
             if (buf_len > 0) {
+              /* Keep the request for retransmissions */
+              p->keepalive.stun_message = message;
+              p->keepalive.stun_message.buffer =
+                  nice_slab_alloc (agent->stun_slab, buf_len);
+              p->keepalive.stun_message.buffer_len = buf_len;
+              memcpy (p->keepalive.stun_message.buffer, buffer, buf_len);
+
               stun_timer_start (&p->keepalive.timer,
                   agent->stun_initial_timeout,
                   agent->stun_max_retransmissions);
@@ -1480,7 +1535,11 @@ static gboolean priv_conn_keepalive_tick_unlocked (NiceAgent *agent)
 
               /* send the conncheck */
               agent_socket_send (p->local->sockptr, &p->remote->c.addr,
-                  buf_len, (gchar *)p->keepalive.stun_buffer);
+                  buf_len, (gchar *)p->keepalive.stun_message.buffer);
+              nice_component_count_stun_sent (component, buf_len);
+              p->keepalive.sent_time = now;
+              if (p->check_pair)
+                p->check_pair->stats.requests_sent++;
 
               p->keepalive.stream_id = stream->id;
               p->keepalive.component_id = component->id;
@@ -1498,18 +1557,19 @@ static gboolean priv_conn_keepalive_tick_unlocked (NiceAgent *agent)
             }
           }
         } else {
+          /* Indications are never retransmitted, nor kept */
           buf_len = stun_usage_bind_keepalive (&component->stun_agent,
-              &p->keepalive.stun_message, p->keepalive.stun_buffer,
-              sizeof(p->keepalive.stun_buffer));
+              &message, buffer, sizeof(buffer));
 
           if (buf_len > 0) {
             agent_socket_send (p->local->sockptr, &p->remote->c.addr, buf_len,
-                (gchar *)p->keepalive.stun_buffer);
+                (gchar *)buffer);
+            nice_component_count_stun_sent (component, buf_len);
 
             p->keepalive.next_tick = now + 1000 * NICE_AGENT_TIMER_TR_DEFAULT;
 
             if (agent->compatibility == NICE_COMPATIBILITY_OC2007R2) {
-              ms_ice2_legacy_conncheck_send (&p->keepalive.stun_message,
+              ms_ice2_legacy_conncheck_send (&message,
                   p->local->sockptr, &p->remote->c.addr);
             }
 
@@ -2082,6 +2142,7 @@ conn_check_update_selected_pair (NiceAgent *agent, NiceComponent *component,
     cpair.remote = (NiceCandidateImpl *) pair->remote;
     cpair.priority = pair->priority;
     cpair.stun_priority = pair->stun_priority;
+    cpair.check_pair = pair;
 
     nice_component_update_selected_pair (agent, component, &cpair);
 
@@ -2561,6 +2622,13 @@ int conn_check_add_for_local_candidate (NiceAgent *agent, guint stream_id, NiceC
 static void candidate_check_pair_free (NiceAgent *agent,
     CandidateCheckPair *pair)
 {
+  NiceComponent *component;
+
+  if (agent_find_component (agent, pair->stream_id, pair->component_id, NULL,
+          &component) &&
+      component->selected_pair.check_pair == pair)
+    component->selected_pair.check_pair = NULL;
+
   priv_remove_pair_from_triggered_check_queue (agent, pair);
   priv_free_all_stun_transactions (pair, NULL);
   g_slice_free (CandidateCheckPair, pair);
@@ -2847,6 +2915,8 @@ int conn_check_send (NiceAgent *agent, CandidateCheckPair *pair)
   size_t buffer_len;
   unsigned int timeout;
   StunTransaction *stun;
+  StunMessage message;
+  uint8_t buffer[STUN_MAX_MESSAGE_SIZE_IPV6];
 
   if (!agent_find_component (agent, pair->stream_id, pair->component_id,
           &stream, &component))
@@ -2913,10 +2983,8 @@ int conn_check_send (NiceAgent *agent, CandidateCheckPair *pair)
     return -1;
   }
 
-  stun = priv_add_stun_transaction (pair);
-
   buffer_len = stun_usage_ice_conncheck_create (&component->stun_agent,
-      &stun->message, stun->buffer, sizeof(stun->buffer),
+      &message, buffer, sizeof(buffer),
       uname, uname_len, password, password_len,
       cand_use, controlling, pair->stun_priority,
       agent->tie_breaker,
@@ -2924,7 +2992,7 @@ int conn_check_send (NiceAgent *agent, CandidateCheckPair *pair)
       agent_to_ice_compatibility (agent));
 
   nice_debug ("Agent %p: conncheck created %zd - %p", agent, buffer_len,
-      stun->message.buffer);
+      message.buffer);
 
   if (agent->compatibility == NICE_COMPATIBILITY_MSN ||
       agent->compatibility == NICE_COMPATIBILITY_OC2007) {
@@ -2933,10 +3001,11 @@ int conn_check_send (NiceAgent *agent, CandidateCheckPair *pair)
 
   if (buffer_len == 0) {
     nice_debug ("Agent %p: buffer is empty, cancelling conncheck", agent);
-    priv_remove_stun_transaction (pair, stun, component);
     return -1;
   }
 
+  stun = priv_add_stun_transaction (agent, pair, &message, buffer_len);
+
   if (nice_socket_is_reliable(pair->sockptr)) {
     timeout = agent->stun_reliable_timeout;
     stun_timer_start_reliable(&stun->timer, timeout);
@@ -2945,7 +3014,8 @@ int conn_check_send (NiceAgent *agent, CandidateCheckPair *pair)
     stun_timer_start (&stun->timer, timeout, agent->stun_max_retransmissions);
   }
 
-  stun->next_tick = g_get_monotonic_time () + timeout * 1000;
+  stun->sent_time = g_get_monotonic_time ();
+  stun->next_tick = stun->sent_time + timeout * 1000;
 
   /* TCP-ACTIVE candidate must create a new socket before sending
    * by connecting to the peer. The new socket is stored in the candidate
@@ -2967,6 +3037,7 @@ int conn_check_send (NiceAgent *agent, CandidateCheckPair *pair)
             agent, pair->sockptr, new_socket, pair, stream->id, component->id);
         pair->sockptr = new_socket;
         _priv_set_socket_tos (agent, pair->sockptr, stream2->tos);
+        _priv_set_socket_buffer_sizes (agent, pair->sockptr, stream2);
 
         nice_socket_set_writable_callback (pair->sockptr, _tcp_sock_is_writable,
             component2);
@@ -2977,7 +3048,18 @@ int conn_check_send (NiceAgent *agent, CandidateCheckPair *pair)
   }
   /* send the conncheck */
   agent_socket_send (pair->sockptr, &pair->remote->addr,
-      buffer_len, (gchar *)stun->buffer);
+      buffer_len, (gchar *)stun->message.buffer);
+  nice_component_count_stun_sent (component, buffer_len);
+  pair->stats.requests_sent++;
+  NICE_TRACE (stun__request__sent, agent, pair->stream_id, pair->component_id,
+      pair, 1);
+  if (agent->event_log) {
+    StunTransactionId id;
+
+    stun_message_id (&stun->message, id);
+    nice_event_log_add (agent->event_log, NICE_EVENT_CHECK_SENT,
+        pair->stream_id, pair->component_id, 1, 0, pair->priority, id);
+  }
 
   if (agent->compatibility == NICE_COMPATIBILITY_OC2007R2)
     ms_ice2_legacy_conncheck_send (&stun->message, pair->sockptr,
@@ -3195,6 +3277,31 @@ static gboolean priv_schedule_triggered_check (NiceAgent *agent, NiceStream *str
 }
 
 
+/*
+ * Finds the pair of the check list an inbound check received on @sockptr
+ * from @rcand belongs to, or NULL if there is none (yet).
+ */
+static CandidateCheckPair *
+priv_find_pair_for_inbound_check (NiceStream *stream, NiceComponent *component,
+    NiceSocket *sockptr, NiceCandidate *rcand)
+{
+  GSList *i;
+
+  for (i = stream->conncheck_list; i; i = i->next) {
+    CandidateCheckPair *p = i->data;
+
+    if (p->component_id == component->id && p->remote == rcand &&
+        p->sockptr == sockptr) {
+      /* Peer-reflexive discovered pairs stand for their parent */
+      if (p->succeeded_pair != NULL)
+        p = p->succeeded_pair;
+      return p;
+    }
+  }
+
+  return NULL;
+}
+
 /*
  * Sends a reply to a successfully received STUN connectivity
  * check request. Implements parts of the ICE spec section 7.2 (STUN
@@ -3242,6 +3349,7 @@ static void priv_reply_to_conn_check (NiceAgent *agent, NiceStream *stream,
   }
 
   agent_socket_send (sockptr, toaddr, rbuf_len, (const gchar*)msg->buffer);
+  nice_component_count_stun_sent (component, rbuf_len);
   if (agent->compatibility == NICE_COMPATIBILITY_OC2007R2) {
     ms_ice2_legacy_conncheck_send(msg, sockptr, toaddr);
   }
@@ -3256,6 +3364,16 @@ static void priv_reply_to_conn_check (NiceAgent *agent, NiceStream *stream,
     if (use_candidate)
       priv_mark_pair_nominated (agent, stream, component, lcand, rcand);
   }
+
+  if (rcand) {
+    CandidateCheckPair *p;
+
+    p = priv_find_pair_for_inbound_check (stream, component, sockptr, rcand);
+    if (p) {
+      p->stats.requests_received++;
+      p->stats.responses_sent++;
+    }
+  }
 }
 
 /*
@@ -3501,6 +3619,28 @@ static CandidateCheckPair *priv_process_response_check_for_reflexive(NiceAgent *
   return new_pair;
 }
 
+/*
+ * Updates the statistics of @pair for a response to a request first sent at
+ * @sent_time, and sent @retransmissions times in total.
+ */
+static void
+priv_pair_stats_record_response (CandidateCheckPair *pair, gint64 sent_time,
+    guint retransmissions)
+{
+  gint64 now = g_get_monotonic_time ();
+
+  pair->stats.responses_received++;
+  pair->stats.consent_expiry = now + NICE_AGENT_CONSENT_TIMEOUT * G_USEC_PER_SEC;
+
+  /* Like TCP (RFC 6298), don't take a sample from a retransmitted request,
+   * as the response could be answering any of the copies. */
+  if (retransmissions == 1) {
+    pair->stats.current_rtt = now - sent_time;
+    pair->stats.total_rtt += pair->stats.current_rtt;
+    pair->stats.n_rtt_samples++;
+  }
+}
+
 /*
  * Tries to match STUN reply in 'buf' to an existing STUN connectivity
  * check transaction. If found, the reply is processed. Implements
@@ -3515,7 +3655,8 @@ static gboolean priv_map_reply_to_conn_check_request (NiceAgent *agent, NiceStre
     struct sockaddr addr;
   } sockaddr;
   socklen_t socklen = sizeof (sockaddr);
-  GSList *i, *j;
+  GSList *i;
+  StunTransaction *stun;
   guint k;
   StunUsageIceReturn res;
   StunTransactionId discovery_id;
@@ -3525,9 +3666,7 @@ static gboolean priv_map_reply_to_conn_check_request (NiceAgent *agent, NiceStre
   for (i = stream->conncheck_list; i; i = i->next) {
     CandidateCheckPair *p = i->data;
 
-    for (j = p->stun_transactions, k = 0; j; j = j->next, k++) {
-      StunTransaction *stun = j->data;
-
+    for (stun = p->stun_transactions, k = 0; stun; stun = stun->next, k++) {
       stun_message_id (&stun->message, discovery_id);
 
       if (memcmp (discovery_id, response_id, sizeof(StunTransactionId)))
@@ -3549,6 +3688,8 @@ static gboolean priv_map_reply_to_conn_check_request (NiceAgent *agent, NiceStre
 	CandidateCheckPair *ok_pair = NULL;
 
 	nice_debug ("Agent %p : pair %p MATCHED.", agent, p);
+	priv_pair_stats_record_response (p, stun->sent_time,
+	    stun->timer.retransmissions);
 	priv_remove_stun_transaction (p, stun, component);
 
 	/* step: verify that response came from the same IP address we
@@ -3927,6 +4068,24 @@ static void priv_handle_turn_alternate_server (NiceAgent *agent,
   }
 }
 
+/* The value of a TURN event in the event log: the granted lifetime on
+ * success, the error code on failure. */
+static guint32
+priv_turn_event_value (StunMessage *resp, StunUsageTurnReturn res,
+    uint32_t lifetime)
+{
+  int code = 0;
+
+  if (res == STUN_USAGE_TURN_RETURN_RELAY_SUCCESS ||
+      res == STUN_USAGE_TURN_RETURN_MAPPED_SUCCESS)
+    return lifetime;
+
+  if (stun_message_get_class (resp) == STUN_ERROR)
+    stun_message_find_error (resp, &code);
+
+  return code;
+}
+
 /*
  * Tries to match STUN reply in 'buf' to an existing STUN discovery
  * transaction. If found, a reply is sent.
@@ -3953,7 +4112,7 @@ static gboolean priv_map_reply_to_relay_request (NiceAgent *agent, StunMessage *
   } relayaddr;
   socklen_t relayaddrlen = sizeof (relayaddr);
 
-  uint32_t lifetime;
+  uint32_t lifetime = 0;
   uint32_t bandwidth;
   GSList *i;
   StunUsageTurnReturn res;
@@ -3977,6 +4136,9 @@ static gboolean priv_map_reply_to_relay_request (NiceAgent *agent, StunMessage *
             &bandwidth, &lifetime, agent_to_turn_compatibility (agent));
         nice_debug ("Agent %p : stun_turn_process/disc for %p res %d.",
             agent, d, (int)res);
+        nice_event_log_add (agent->event_log, NICE_EVENT_TURN_ALLOCATE,
+            d->stream_id, d->component_id, res,
+            priv_turn_event_value (resp, res, lifetime), 0, response_id);
 
         if (res == STUN_USAGE_TURN_RETURN_ALTERNATE_SERVER) {
           NiceAddress addr;
@@ -4172,7 +4334,7 @@ static gboolean priv_map_reply_to_relay_request (NiceAgent *agent, StunMessage *
  */
 static gboolean priv_map_reply_to_relay_refresh (NiceAgent *agent, StunMessage *resp)
 {
-  uint32_t lifetime;
+  uint32_t lifetime = 0;
   GSList *i;
   StunUsageTurnReturn res;
   gboolean trans_found = FALSE;
@@ -4192,6 +4354,9 @@ static gboolean priv_map_reply_to_relay_refresh (NiceAgent *agent, StunMessage *
             &lifetime, agent_to_turn_compatibility (agent));
         nice_debug ("Agent %p : stun_turn_refresh_process for %p res %d with lifetime %u.",
             agent, cand, (int)res, lifetime);
+        nice_event_log_add (agent->event_log, NICE_EVENT_TURN_REFRESH,
+            cand->stream_id, cand->component_id, res,
+            priv_turn_event_value (resp, res, lifetime), 0, response_id);
         if (res == STUN_USAGE_TURN_RETURN_RELAY_SUCCESS) {
           /* refresh should be sent 1 minute before it expires */
           agent_timeout_add_seconds_with_context (agent,
@@ -4301,11 +4466,21 @@ static gboolean priv_map_reply_to_keepalive_conncheck (NiceAgent *agent,
       if (memcmp (conncheck_id, response_id, sizeof(StunTransactionId)) == 0) {
         nice_debug ("Agent %p : Keepalive for selected pair received.",
             agent);
+        /* See priv_pair_stats_record_response() */
+        if (component->selected_pair.keepalive.timer.retransmissions == 1)
+          component->stats.consent_rtt = g_get_monotonic_time () -
+              component->selected_pair.keepalive.sent_time;
+        if (component->selected_pair.check_pair)
+          priv_pair_stats_record_response (
+              component->selected_pair.check_pair,
+              component->selected_pair.keepalive.sent_time,
+              component->selected_pair.keepalive.timer.retransmissions);
         if (component->selected_pair.keepalive.tick_source) {
           g_source_destroy (component->selected_pair.keepalive.tick_source);
           g_source_unref (component->selected_pair.keepalive.tick_source);
           component->selected_pair.keepalive.tick_source = NULL;
         }
+        nice_slab_release (component->selected_pair.keepalive.stun_message.buffer);
         component->selected_pair.keepalive.stun_message.buffer = NULL;
         return TRUE;
       }
@@ -4565,6 +4740,16 @@ gboolean conn_check_handle_inbound_stun (NiceAgent *agent, NiceStream *stream,
     return FALSE;
   }
 
+  NICE_TRACE (stun__recv, agent, stream->id, component->id, buf, len);
+  if (agent->event_log) {
+    StunTransactionId id;
+
+    stun_message_id (&req, id);
+    nice_event_log_add (agent->event_log, NICE_EVENT_STUN_RECEIVED,
+        stream->id, component->id, stun_message_get_class (&req),
+        stun_message_get_method (&req), 0, id);
+  }
+
   if (valid == STUN_VALIDATION_UNKNOWN_REQUEST_ATTRIBUTE) {
     nice_debug ("Agent %p : Unknown mandatory attributes in message.", agent);
 
@@ -4754,6 +4939,8 @@ gboolean conn_check_handle_inbound_stun (NiceAgent *agent, NiceStream *stream,
           stun_usage_ice_conncheck_use_candidate (&req);
       uint32_t priority = stun_usage_ice_conncheck_priority (&req);
 
+      nice_component_tcp_socket_checked (component, nicesock);
+
       if (agent->compatibility == NICE_COMPATIBILITY_GOOGLE ||
           agent->compatibility == NICE_COMPATIBILITY_MSN ||
           agent->compatibility == NICE_COMPATIBILITY_OC2007)
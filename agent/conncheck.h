@@ -73,11 +73,14 @@ typedef enum
 typedef struct _CandidateCheckPair CandidateCheckPair;
 typedef struct _StunTransaction StunTransaction;
 
+/* Allocated from the agent’s slab together with the request, which follows
+ * it and is just as long as it needs to be. */
 struct _StunTransaction
 {
+  StunTransaction *next;  /* next ongoing request of the same pair */
   gint64 next_tick;       /* next tick timestamp */
+  gint64 sent_time;       /* monotonic time the request was first sent */
   StunTimer timer;
-  uint8_t buffer[STUN_MAX_MESSAGE_SIZE_IPV6];
   StunMessage message;
 };
 
@@ -99,7 +102,10 @@ struct _CandidateCheckPair
   CandidateCheckPair *succeeded_pair;
   guint64 priority;
   guint32 stun_priority;
-  GSList *stun_transactions; /* a list of ongoing stun requests */
+  StunTransaction *stun_transactions; /* ongoing stun requests, newest
+                                         first */
+  NiceCandidatePairStats stats;       /* the candidates, priority and flags
+                                         are filled in when read */
 };
 
 int conn_check_add_for_candidate (NiceAgent *agent, guint stream_id, NiceComponent *component, NiceCandidate *remote);
@@ -47,8 +47,14 @@
 
 #include "agent-priv.h"
 
-static int debug_enabled = 0;
-static int debug_verbose_enabled = 0;
+#ifndef NDEBUG
+/* Read by the nice_debug() macros in agent-priv.h. */
+gboolean nice_debug_enabled = FALSE;
+gboolean nice_debug_verbose_enabled = FALSE;
+#else
+static gboolean nice_debug_enabled = FALSE;
+static gboolean nice_debug_verbose_enabled = FALSE;
+#endif
 
 #define NICE_DEBUG_STUN 1
 #define NICE_DEBUG_NICE 2
@@ -105,14 +111,14 @@ void nice_debug_init (void)
     }
 
     stun_set_debug_handler (stun_handler);
-    debug_enabled = !!(flags & NICE_DEBUG_NICE);
+    nice_debug_enabled = !!(flags & NICE_DEBUG_NICE);
     if (flags & NICE_DEBUG_STUN)
       stun_debug_enable ();
     else
       stun_debug_disable ();
 
     if (flags & NICE_DEBUG_NICE_VERBOSE)
-      debug_verbose_enabled = TRUE;
+      nice_debug_verbose_enabled = TRUE;
 
     /* Set verbose before normal so that if we use 'all', then only
        normal debug is enabled, we'd need to set pseudotcp-verbose without the
@@ -124,52 +130,30 @@ void nice_debug_init (void)
   }
 }
 
-#ifndef NDEBUG
-gboolean nice_debug_is_enabled (void)
-{
-  return debug_enabled;
-}
-gboolean nice_debug_is_verbose (void)
-{
-  return debug_verbose_enabled;
-}
-#else
-/* Defined in agent-priv.h. */
-#endif
-
 void nice_debug_enable (gboolean with_stun)
 {
   nice_debug_init ();
-  debug_enabled = 1;
+  nice_debug_enabled = TRUE;
   if (with_stun)
     stun_debug_enable ();
 }
 void nice_debug_disable (gboolean with_stun)
 {
   nice_debug_init ();
-  debug_enabled = 0;
+  nice_debug_enabled = FALSE;
   if (with_stun)
     stun_debug_disable ();
 }
 
 #ifndef NDEBUG
-void nice_debug (const char *fmt, ...)
+/* Only called by the nice_debug() macros once they checked the flags. */
+void nice_debug_log (const char *fmt, ...)
 {
   va_list ap;
-  if (debug_enabled) {
-    va_start (ap, fmt);
-    g_logv (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, fmt, ap);
-    va_end (ap);
-  }
-}
-void nice_debug_verbose (const char *fmt, ...)
-{
-  va_list ap;
-  if (debug_enabled && debug_verbose_enabled) {
-    va_start (ap, fmt);
-    g_logv (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, fmt, ap);
-    va_end (ap);
-  }
+
+  va_start (ap, fmt);
+  g_logv (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, fmt, ap);
+  va_end (ap);
 }
 #else
 /* Defined in agent-priv.h. */
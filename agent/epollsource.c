@@ -0,0 +1,435 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * (C) 2026 Collabora Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the Nice GLib ICE library.
+ *
+ * The Initial Developers of the Original Code are Collabora Ltd and Nokia
+ * Corporation. All Rights Reserved.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+
+/*
+ * @file epollsource.c
+ * @brief Shared epoll-based GSource for component sockets
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "epollsource.h"
+
+#ifdef HAVE_SYS_EPOLL_H
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "debug.h"
+
+/* Events fetched from the kernel per epoll_wait() call */
+#define MAX_EVENTS 64
+
+typedef struct {
+  GSource source;
+
+  GMainContext *context;  /* unowned; key in epoll_sources */
+  gint epfd;
+  gpointer epfd_tag;
+
+  GMutex mutex;           /* protects ready and the state of the watches */
+  GQueue ready;           /* NiceEpollWatches to dispatch; each one holds a
+                             reference */
+  guint n_watches;        /* protected by epoll_sources_mutex */
+} NiceEpollSource;
+
+struct _NiceEpollWatch {
+  volatile gint ref_count;
+  NiceEpollSource *source;  /* owned */
+  GSocket *socket;          /* owned */
+  NiceEpollWatchFunc func;
+  gpointer user_data;
+
+  GIOCondition condition;   /* seen since the last dispatch */
+  gboolean queued;
+  gboolean removed;
+};
+
+static GMutex epoll_sources_mutex;
+static GHashTable *epoll_sources;  /* GMainContext → owned NiceEpollSource */
+
+/* Watch being dispatched in the current thread */
+static GPrivate current_watch = G_PRIVATE_INIT (NULL);
+
+static void
+epoll_watch_unref (NiceEpollWatch *watch)
+{
+  if (!g_atomic_int_dec_and_test (&watch->ref_count))
+    return;
+
+  g_object_unref (watch->socket);
+  g_source_unref ((GSource *) watch->source);
+  g_slice_free (NiceEpollWatch, watch);
+}
+
+static GIOCondition
+epoll_events_to_condition (guint32 events)
+{
+  GIOCondition condition = 0;
+
+  if (events & EPOLLIN)
+    condition |= G_IO_IN;
+  if (events & EPOLLHUP)
+    condition |= G_IO_HUP;
+  if (events & EPOLLERR)
+    condition |= G_IO_ERR;
+
+  return condition;
+}
+
+/* Must be called with the source’s mutex held. */
+static void
+epoll_watch_queue (NiceEpollSource *self, NiceEpollWatch *watch,
+    GIOCondition condition)
+{
+  if (watch->removed)
+    return;
+
+  watch->condition |= condition;
+
+  if (!watch->queued) {
+    watch->queued = TRUE;
+    g_atomic_int_inc (&watch->ref_count);
+    g_queue_push_tail (&self->ready, watch);
+  }
+}
+
+/* Move everything the kernel reports as ready to the ready queue. Must be
+ * called with the source’s mutex held. */
+static void
+epoll_source_collect (NiceEpollSource *self)
+{
+  struct epoll_event events[MAX_EVENTS];
+  gint n, i;
+
+  do {
+    n = epoll_wait (self->epfd, events, MAX_EVENTS, 0);
+
+    for (i = 0; i < n; i++)
+      epoll_watch_queue (self, events[i].data.ptr,
+          epoll_events_to_condition (events[i].events));
+  } while (n == MAX_EVENTS);
+}
+
+static gboolean
+epoll_source_prepare (GSource *source, gint *timeout)
+{
+  NiceEpollSource *self = (NiceEpollSource *) source;
+  gboolean ready;
+
+  *timeout = -1;
+
+  g_mutex_lock (&self->mutex);
+  ready = !g_queue_is_empty (&self->ready);
+  g_mutex_unlock (&self->mutex);
+
+  return ready;
+}
+
+static gboolean
+epoll_source_check (GSource *source)
+{
+  NiceEpollSource *self = (NiceEpollSource *) source;
+  gboolean ready;
+
+  if (g_source_query_unix_fd (source, self->epfd_tag) & G_IO_IN)
+    return TRUE;
+
+  g_mutex_lock (&self->mutex);
+  ready = !g_queue_is_empty (&self->ready);
+  g_mutex_unlock (&self->mutex);
+
+  return ready;
+}
+
+static void
+epoll_source_release_watch (NiceEpollSource *self)
+{
+  g_mutex_lock (&epoll_sources_mutex);
+
+  if (--self->n_watches == 0) {
+    nice_debug ("Destroying epoll source %p for context %p", self,
+        self->context);
+    g_hash_table_remove (epoll_sources, self->context);
+    g_source_destroy ((GSource *) self);
+    g_source_unref ((GSource *) self);
+  }
+
+  g_mutex_unlock (&epoll_sources_mutex);
+}
+
+static void
+epoll_watch_cancel (NiceEpollWatch *watch)
+{
+  NiceEpollSource *self = watch->source;
+  gboolean was_queued;
+
+  g_mutex_lock (&self->mutex);
+
+  if (watch->removed) {
+    g_mutex_unlock (&self->mutex);
+    return;
+  }
+
+  watch->removed = TRUE;
+
+  /* A closed socket has already left the set, and its FD may have been
+   * reused since. */
+  if (!g_socket_is_closed (watch->socket))
+    epoll_ctl (self->epfd, EPOLL_CTL_DEL, g_socket_get_fd (watch->socket),
+        NULL);
+
+  was_queued = watch->queued;
+  if (was_queued) {
+    g_queue_remove (&self->ready, watch);
+    watch->queued = FALSE;
+  }
+
+  g_mutex_unlock (&self->mutex);
+
+  /* The caller still holds a reference. */
+  if (was_queued)
+    g_atomic_int_add (&watch->ref_count, -1);
+
+  epoll_source_release_watch (self);
+}
+
+static gboolean
+epoll_source_dispatch (GSource *source, GSourceFunc callback,
+    gpointer user_data)
+{
+  NiceEpollSource *self = (NiceEpollSource *) source;
+  NiceEpollWatch *previous = g_private_get (&current_watch);
+  guint n_ready;
+
+  g_mutex_lock (&self->mutex);
+  epoll_source_collect (self);
+  /* Only dispatch what was ready on entry, so that a socket which stays
+   * readable cannot starve the rest of the context. */
+  n_ready = g_queue_get_length (&self->ready);
+  g_mutex_unlock (&self->mutex);
+
+  while (n_ready-- > 0) {
+    NiceEpollWatch *watch;
+    GIOCondition condition;
+    gboolean removed;
+
+    g_mutex_lock (&self->mutex);
+    watch = g_queue_pop_head (&self->ready);
+    if (watch != NULL) {
+      watch->queued = FALSE;
+      condition = watch->condition;
+      watch->condition = 0;
+      removed = watch->removed;
+    }
+    g_mutex_unlock (&self->mutex);
+
+    if (watch == NULL)
+      break;
+
+    if (!removed) {
+      gboolean keep;
+
+      g_private_set (&current_watch, watch);
+      keep = watch->func (watch->socket, condition, watch->user_data);
+      g_private_set (&current_watch, previous);
+
+      if (!keep) {
+        epoll_watch_cancel (watch);
+      } else if (g_socket_condition_check (watch->socket, G_IO_IN)) {
+        /* Edge-triggered: nothing will tell us again about data the callback
+         * left behind. */
+        g_mutex_lock (&self->mutex);
+        epoll_watch_queue (self, watch, G_IO_IN);
+        g_mutex_unlock (&self->mutex);
+      }
+    }
+
+    epoll_watch_unref (watch);
+  }
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+epoll_source_finalize (GSource *source)
+{
+  NiceEpollSource *self = (NiceEpollSource *) source;
+
+  g_assert (g_queue_is_empty (&self->ready));
+
+  close (self->epfd);
+  g_mutex_clear (&self->mutex);
+}
+
+static GSourceFuncs epoll_source_funcs = {
+  epoll_source_prepare,
+  epoll_source_check,
+  epoll_source_dispatch,
+  epoll_source_finalize,
+};
+
+static NiceEpollSource *
+epoll_source_new (GMainContext *context)
+{
+  GSource *source;
+  NiceEpollSource *self;
+  gint epfd;
+
+  epfd = epoll_create1 (EPOLL_CLOEXEC);
+  if (epfd < 0) {
+    nice_debug ("Could not create epoll set: %s", g_strerror (errno));
+    return NULL;
+  }
+
+  source = g_source_new (&epoll_source_funcs, sizeof (NiceEpollSource));
+  g_source_set_name (source, "libnice epoll source");
+
+  self = (NiceEpollSource *) source;
+  self->context = context;
+  self->epfd = epfd;
+  g_mutex_init (&self->mutex);
+  g_queue_init (&self->ready);
+  self->epfd_tag = g_source_add_unix_fd (source, epfd, G_IO_IN);
+
+  nice_debug ("Attaching epoll source %p (FD %d) to context %p", self, epfd,
+      context);
+  g_source_attach (source, context);
+
+  return self;
+}
+
+/*
+ * nice_epoll_watch_add:
+ *
+ * Watch @socket for readability through the epoll source of @context, which
+ * is created for the first watch of a context and destroyed with its last
+ * one. @func is invoked from the context like a #GSocketSourceFunc, and the
+ * watch is removed if it returns %FALSE.
+ *
+ * Returns: the new watch, or %NULL if @socket can’t be added to an epoll set
+ * (in which case a #GSource of its own should be used instead)
+ */
+NiceEpollWatch *
+nice_epoll_watch_add (GMainContext *context, GSocket *socket,
+    NiceEpollWatchFunc func, gpointer user_data)
+{
+  NiceEpollSource *self;
+  NiceEpollWatch *watch;
+  struct epoll_event event;
+  gint ret;
+
+  g_mutex_lock (&epoll_sources_mutex);
+
+  if (epoll_sources == NULL)
+    epoll_sources = g_hash_table_new (NULL, NULL);
+
+  self = g_hash_table_lookup (epoll_sources, context);
+  if (self == NULL) {
+    self = epoll_source_new (context);
+    if (self == NULL) {
+      g_mutex_unlock (&epoll_sources_mutex);
+      return NULL;
+    }
+    g_hash_table_insert (epoll_sources, context, self);
+  }
+
+  self->n_watches++;
+
+  g_mutex_unlock (&epoll_sources_mutex);
+
+  watch = g_slice_new0 (NiceEpollWatch);
+  watch->ref_count = 1;
+  watch->source = (NiceEpollSource *) g_source_ref ((GSource *) self);
+  watch->socket = g_object_ref (socket);
+  watch->func = func;
+  watch->user_data = user_data;
+
+  memset (&event, 0, sizeof (event));
+  event.events = EPOLLIN | EPOLLET;
+  event.data.ptr = watch;
+
+  g_mutex_lock (&self->mutex);
+  ret = epoll_ctl (self->epfd, EPOLL_CTL_ADD, g_socket_get_fd (socket), &event);
+  if (ret < 0)
+    watch->removed = TRUE;
+  g_mutex_unlock (&self->mutex);
+
+  if (ret < 0) {
+    nice_debug ("Could not add FD %d to epoll source %p: %s",
+        g_socket_get_fd (socket), self, g_strerror (errno));
+    epoll_source_release_watch (self);
+    epoll_watch_unref (watch);
+    return NULL;
+  }
+
+  return watch;
+}
+
+/* Stop watching and drop the caller’s reference. A watch currently being
+ * dispatched is not freed until its callback has returned. */
+void
+nice_epoll_watch_remove (NiceEpollWatch *watch)
+{
+  epoll_watch_cancel (watch);
+  epoll_watch_unref (watch);
+}
+
+/*
+ * nice_epoll_watch_get_current_removed:
+ *
+ * If the current thread is dispatching a watch, store in @removed whether it
+ * has been removed since its callback was invoked, like g_source_is_destroyed()
+ * on g_main_current_source() for a #GSource of its own.
+ *
+ * Returns: %TRUE if the current callback was invoked for a watch
+ */
+gboolean
+nice_epoll_watch_get_current_removed (gboolean *removed)
+{
+  NiceEpollWatch *watch = g_private_get (&current_watch);
+
+  if (watch == NULL ||
+      (GSource *) watch->source != g_main_current_source ())
+    return FALSE;
+
+  g_mutex_lock (&watch->source->mutex);
+  *removed = watch->removed;
+  g_mutex_unlock (&watch->source->mutex);
+
+  return TRUE;
+}
+
+#endif /* HAVE_SYS_EPOLL_H */
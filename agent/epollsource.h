@@ -0,0 +1,64 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * (C) 2026 Collabora Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the Nice GLib ICE library.
+ *
+ * The Initial Developers of the Original Code are Collabora Ltd and Nokia
+ * Corporation. All Rights Reserved.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+
+#ifndef _NICE_EPOLL_SOURCE_H
+#define _NICE_EPOLL_SOURCE_H
+
+#include <glib.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* A socket registered in the epoll set shared by all watches of one
+ * #GMainContext. The set is dispatched by a single #GSource per context,
+ * which only visits the sockets which became ready. */
+typedef struct _NiceEpollWatch NiceEpollWatch;
+
+typedef gboolean (*NiceEpollWatchFunc) (GSocket *socket,
+    GIOCondition condition, gpointer user_data);
+
+#ifdef HAVE_SYS_EPOLL_H
+
+NiceEpollWatch *
+nice_epoll_watch_add (GMainContext *context, GSocket *socket,
+    NiceEpollWatchFunc func, gpointer user_data);
+
+void
+nice_epoll_watch_remove (NiceEpollWatch *watch);
+
+gboolean
+nice_epoll_watch_get_current_removed (gboolean *removed);
+
+#endif
+
+G_END_DECLS
+
+#endif /* _NICE_EPOLL_SOURCE_H */
@@ -0,0 +1,105 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * (C) 2026 Collabora Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the Nice GLib ICE library.
+ *
+ * The Initial Developers of the Original Code are Collabora Ltd and Nokia
+ * Corporation. All Rights Reserved.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+
+
+#ifndef _NICE_EVENT_LOG_FORMAT_H
+#define _NICE_EVENT_LOG_FORMAT_H
+
+/*
+ * Layout of the binary event log returned by nice_agent_dump_event_log().
+ *
+ * This header only uses <stdint.h> types so that tools outside of the
+ * library (see stun/tools/niceevtdec.c) can decode dumps without GLib.
+ *
+ * A dump is a #NiceEventLogHeader followed by @n_records #NiceEventRecord,
+ * oldest first. All fields are in the byte order of the machine that
+ * produced the dump, which is recorded in @byte_order.
+ */
+
+#include <stdint.h>
+
+#define NICE_EVENT_LOG_MAGIC "NICEEVTL"
+#define NICE_EVENT_LOG_VERSION 1
+#define NICE_EVENT_LOG_BYTE_ORDER 0x01020304
+
+typedef enum
+{
+  NICE_EVENT_NONE = 0,
+  /* arg: NiceCandidateType, value: NiceCandidateTransport, id: priority */
+  NICE_EVENT_CANDIDATE_GATHERED,
+  /* arg: NiceCandidateType, value: NiceCandidateTransport, id: priority */
+  NICE_EVENT_REMOTE_CANDIDATE,
+  /* arg: new NiceComponentState, value: old NiceComponentState */
+  NICE_EVENT_COMPONENT_STATE,
+  /* arg: new NiceCheckState, id: pair priority */
+  NICE_EVENT_PAIR_STATE,
+  /* arg: transmission count, id: pair priority, transaction_id */
+  NICE_EVENT_CHECK_SENT,
+  /* arg: StunClass, value: StunMethod, transaction_id */
+  NICE_EVENT_STUN_RECEIVED,
+  /* arg: StunUsageTurnReturn, value: lifetime or error code, transaction_id */
+  NICE_EVENT_TURN_ALLOCATE,
+  /* arg: StunUsageTurnReturn, value: lifetime or error code, transaction_id */
+  NICE_EVENT_TURN_REFRESH,
+  /* arg: local NiceCandidateType, value: remote NiceCandidateType,
+   * id: pair priority */
+  NICE_EVENT_SELECTED_PAIR,
+  NICE_EVENT_LAST
+} NiceEventType;
+
+typedef struct
+{
+  char magic[8];            /* NICE_EVENT_LOG_MAGIC, not NUL-terminated */
+  uint16_t version;         /* NICE_EVENT_LOG_VERSION */
+  uint16_t record_size;     /* sizeof (NiceEventRecord) */
+  uint32_t byte_order;      /* NICE_EVENT_LOG_BYTE_ORDER */
+  uint32_t n_records;       /* records following this header */
+  uint32_t reserved;
+  uint64_t n_dropped;       /* records overwritten before the dump */
+  int64_t monotonic_time;   /* g_get_monotonic_time() at dump time */
+  int64_t real_time;        /* g_get_real_time() at dump time */
+} NiceEventLogHeader;
+
+typedef struct
+{
+  int64_t time;             /* g_get_monotonic_time() */
+  uint16_t type;            /* NiceEventType */
+  uint16_t stream_id;
+  uint16_t component_id;
+  uint16_t arg;
+  uint32_t value;
+  uint32_t reserved;
+  uint64_t id;
+  uint8_t transaction_id[12];
+  uint32_t reserved2;
+} NiceEventRecord;
+
+#endif /* _NICE_EVENT_LOG_FORMAT_H */
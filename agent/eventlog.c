@@ -0,0 +1,136 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * (C) 2026 Collabora Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the Nice GLib ICE library.
+ *
+ * The Initial Developers of the Original Code are Collabora Ltd and Nokia
+ * Corporation. All Rights Reserved.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <string.h>
+
+#include "eventlog.h"
+
+G_STATIC_ASSERT (sizeof (NiceEventLogHeader) == 48);
+G_STATIC_ASSERT (sizeof (NiceEventRecord) == 48);
+
+struct _NiceEventLog {
+  NiceEventRecord *records;
+  guint n_records;
+  guint head;       /* next record to write */
+  guint64 n_added;  /* since creation */
+};
+
+NiceEventLog *
+nice_event_log_new (guint n_records)
+{
+  NiceEventLog *log;
+
+  g_return_val_if_fail (n_records > 0, NULL);
+
+  log = g_new0 (NiceEventLog, 1);
+  log->records = g_new0 (NiceEventRecord, n_records);
+  log->n_records = n_records;
+
+  return log;
+}
+
+void
+nice_event_log_free (NiceEventLog *log)
+{
+  if (log == NULL)
+    return;
+
+  g_free (log->records);
+  g_free (log);
+}
+
+void
+nice_event_log_add (NiceEventLog *log, NiceEventType type, guint stream_id,
+    guint component_id, guint arg, guint32 value, guint64 id,
+    const guint8 *transaction_id)
+{
+  NiceEventRecord record = { 0, };
+
+  if (log == NULL)
+    return;
+
+  record.time = g_get_monotonic_time ();
+  record.type = type;
+  record.stream_id = stream_id;
+  record.component_id = component_id;
+  record.arg = arg;
+  record.value = value;
+  record.id = id;
+  if (transaction_id)
+    memcpy (record.transaction_id, transaction_id,
+        sizeof (record.transaction_id));
+
+  memcpy (&log->records[log->head], &record, sizeof (record));
+  log->head = (log->head + 1) % log->n_records;
+  log->n_added++;
+}
+
+GBytes *
+nice_event_log_dump (NiceEventLog *log)
+{
+  NiceEventLogHeader *header;
+  guint8 *data;
+  guint n, first;
+  gsize size;
+
+  n = MIN (log->n_added, log->n_records);
+  /* Oldest record, the ring is full once it wrapped around */
+  first = log->n_added > log->n_records ? log->head : 0;
+
+  size = sizeof (NiceEventLogHeader) + n * sizeof (NiceEventRecord);
+  data = g_malloc0 (size);
+
+  header = (NiceEventLogHeader *) data;
+  memcpy (header->magic, NICE_EVENT_LOG_MAGIC, sizeof (header->magic));
+  header->version = NICE_EVENT_LOG_VERSION;
+  header->record_size = sizeof (NiceEventRecord);
+  header->byte_order = NICE_EVENT_LOG_BYTE_ORDER;
+  header->n_records = n;
+  header->n_dropped = log->n_added - n;
+  header->monotonic_time = g_get_monotonic_time ();
+  header->real_time = g_get_real_time ();
+
+  if (n > 0) {
+    guint8 *out = data + sizeof (NiceEventLogHeader);
+    guint n_tail = MIN (n, log->n_records - first);
+
+    memcpy (out, &log->records[first], n_tail * sizeof (NiceEventRecord));
+    memcpy (out + n_tail * sizeof (NiceEventRecord), log->records,
+        (n - n_tail) * sizeof (NiceEventRecord));
+  }
+
+  return g_bytes_new_take (data, size);
+}
@@ -0,0 +1,70 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * (C) 2026 Collabora Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the Nice GLib ICE library.
+ *
+ * The Initial Developers of the Original Code are Collabora Ltd and Nokia
+ * Corporation. All Rights Reserved.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+
+
+#ifndef _NICE_EVENT_LOG_H
+#define _NICE_EVENT_LOG_H
+
+#include <glib.h>
+
+#include "eventlog-format.h"
+
+G_BEGIN_DECLS
+
+/* Fixed-size ring of structured #NiceEventRecord, kept by an agent for
+ * post-mortem diagnostics. Adding an event fills a record on the stack and
+ * copies it into the ring, overwriting the oldest one when full; nothing is
+ * formatted or allocated.
+ *
+ * An event log is not thread-safe; an agent’s log is protected by its
+ * lock. */
+typedef struct _NiceEventLog NiceEventLog;
+
+NiceEventLog *
+nice_event_log_new (guint n_records);
+
+void
+nice_event_log_free (NiceEventLog *log);
+
+/* Does nothing if @log is %NULL, so callers don’t have to check whether
+ * logging is enabled. @transaction_id may be %NULL. */
+void
+nice_event_log_add (NiceEventLog *log, NiceEventType type, guint stream_id,
+    guint component_id, guint arg, guint32 value, guint64 id,
+    const guint8 *transaction_id);
+
+/* Serializes the log as described in eventlog-format.h */
+GBytes *
+nice_event_log_dump (NiceEventLog *log);
+
+G_END_DECLS
+
+#endif /* _NICE_EVENT_LOG_H */
@@ -0,0 +1,433 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * (C) 2026 Collabora Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the Nice GLib ICE library.
+ *
+ * The Initial Developers of the Original Code are Collabora Ltd and Nokia
+ * Corporation. All Rights Reserved.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+
+/*
+ * @file iothread.c
+ * @brief Agent-owned network threads and their receive rings
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#else
+#define NICEAPI_EXPORT
+#endif
+
+#include <errno.h>
+#include <string.h>
+
+#include "debug.h"
+
+#include "iothread.h"
+
+struct _NiceRecvRing {
+  volatile gint ref_count;
+
+  guint n_slots;        /* always a power of two */
+  gsize slot_size;
+  guint8 *data;         /* n_slots * slot_size bytes */
+  gsize *lengths;       /* valid bytes in each slot */
+  NiceAddress *from;    /* sender of each slot */
+
+  /* Free-running positions, only ever written by the consumer (head) and the
+   * producer (tail) respectively; slots in [head, tail) hold packets. */
+  volatile guint head;
+  volatile guint tail;
+
+  /* Producer only: bytes of a packet still being received into the slot at
+   * @tail, such as a partial RFC4571 frame. */
+  gsize pending_length;
+
+  volatile guint n_dropped;
+  volatile gint closed;
+
+  /* Only used to put the consumer to sleep when the ring is empty. */
+  volatile gint waiting;
+  GMutex mutex;
+  GCond cond;
+};
+
+G_DEFINE_BOXED_TYPE (NiceRecvRing, nice_recv_ring, nice_recv_ring_ref,
+    nice_recv_ring_unref);
+
+static gpointer
+io_thread_run (gpointer data)
+{
+  NiceIOThread *io_thread = data;
+
+  g_main_context_push_thread_default (io_thread->context);
+
+  while (!g_atomic_int_get (&io_thread->stop))
+    g_main_context_iteration (io_thread->context, TRUE);
+
+  g_main_context_pop_thread_default (io_thread->context);
+
+  /* The agent was disposed from one of our own callbacks, so nobody is going
+   * to join us. */
+  if (g_atomic_int_get (&io_thread->detached)) {
+    g_thread_unref (io_thread->thread);
+    g_main_context_unref (io_thread->context);
+    g_slice_free (NiceIOThread, io_thread);
+  }
+
+  return NULL;
+}
+
+NiceIOThread *
+nice_io_thread_new (guint index)
+{
+  NiceIOThread *io_thread;
+  gchar *name;
+
+  io_thread = g_slice_new0 (NiceIOThread);
+  io_thread->context = g_main_context_new ();
+
+  name = g_strdup_printf ("nice-io-%u", index);
+  io_thread->thread = g_thread_new (name, io_thread_run, io_thread);
+  g_free (name);
+
+  nice_debug ("Started network thread %u (%p)", index, io_thread->thread);
+
+  return io_thread;
+}
+
+/* Must be called without the agent lock held, since the thread may be waiting
+ * for it. */
+void
+nice_io_thread_free (NiceIOThread *io_thread)
+{
+  g_atomic_int_set (&io_thread->stop, TRUE);
+  g_main_context_wakeup (io_thread->context);
+
+  if (g_thread_self () == io_thread->thread) {
+    g_atomic_int_set (&io_thread->detached, TRUE);
+    return;
+  }
+
+  g_thread_join (io_thread->thread);
+  g_main_context_unref (io_thread->context);
+  g_slice_free (NiceIOThread, io_thread);
+}
+
+NiceRecvRing *
+nice_recv_ring_new (guint n_slots, gsize slot_size)
+{
+  NiceRecvRing *ring;
+  guint size;
+
+  /* Round up to a power of two without overflowing @size. */
+  n_slots = CLAMP (n_slots, 1, NICE_RECV_RING_MAX_SLOTS);
+  size = (n_slots == 1) ? 1 : 1U << g_bit_storage (n_slots - 1);
+
+  ring = g_slice_new0 (NiceRecvRing);
+  ring->ref_count = 1;
+  ring->n_slots = size;
+  ring->slot_size = slot_size;
+  ring->data = g_malloc_n (size, slot_size);
+  ring->lengths = g_new0 (gsize, size);
+  ring->from = g_new0 (NiceAddress, size);
+  g_mutex_init (&ring->mutex);
+  g_cond_init (&ring->cond);
+
+  return ring;
+}
+
+/**
+ * nice_recv_ring_ref:
+ * @ring: a #NiceRecvRing
+ *
+ * Increases the reference count of @ring.
+ *
+ * Returns: (transfer full): @ring
+ *
+ * Since: 0.1.19
+ */
+NICEAPI_EXPORT NiceRecvRing *
+nice_recv_ring_ref (NiceRecvRing *ring)
+{
+  g_return_val_if_fail (ring != NULL, NULL);
+
+  g_atomic_int_inc (&ring->ref_count);
+
+  return ring;
+}
+
+/**
+ * nice_recv_ring_unref:
+ * @ring: (transfer full): a #NiceRecvRing
+ *
+ * Decreases the reference count of @ring, freeing it and any packets still
+ * queued in it once the count drops to zero.
+ *
+ * Since: 0.1.19
+ */
+NICEAPI_EXPORT void
+nice_recv_ring_unref (NiceRecvRing *ring)
+{
+  g_return_if_fail (ring != NULL);
+
+  if (!g_atomic_int_dec_and_test (&ring->ref_count))
+    return;
+
+  g_mutex_clear (&ring->mutex);
+  g_cond_clear (&ring->cond);
+  g_free (ring->data);
+  g_free (ring->lengths);
+  g_free (ring->from);
+  g_slice_free (NiceRecvRing, ring);
+}
+
+static void
+nice_recv_ring_wake_consumer (NiceRecvRing *ring)
+{
+  if (!g_atomic_int_get (&ring->waiting))
+    return;
+
+  g_mutex_lock (&ring->mutex);
+  g_cond_broadcast (&ring->cond);
+  g_mutex_unlock (&ring->mutex);
+}
+
+/* Point @message at the next free slot, using @buffer as its only vector.
+ * Returns %FALSE if the consumer has not caught up and the ring is full. */
+gboolean
+nice_recv_ring_reserve (NiceRecvRing *ring, NiceInputMessage *message,
+    GInputVector *buffer)
+{
+  guint tail = ring->tail;
+  guint slot;
+
+  if (tail - g_atomic_int_get (&ring->head) == ring->n_slots)
+    return FALSE;
+
+  slot = tail & (ring->n_slots - 1);
+
+  buffer->buffer = ring->data + slot * ring->slot_size;
+  buffer->size = ring->slot_size;
+
+  message->buffers = buffer;
+  message->n_buffers = 1;
+  message->from = &ring->from[slot];
+  message->length = ring->pending_length;
+
+  return TRUE;
+}
+
+/* Publish the slot last handed out by nice_recv_ring_reserve(), now holding
+ * @message, to the consumer. */
+void
+nice_recv_ring_commit (NiceRecvRing *ring, const NiceInputMessage *message)
+{
+  guint tail = ring->tail;
+
+  ring->lengths[tail & (ring->n_slots - 1)] = message->length;
+  ring->pending_length = 0;
+
+  /* Full barrier: the slot contents are visible before the new tail, and the
+   * new tail before we look at @waiting. */
+  g_atomic_int_set (&ring->tail, tail + 1);
+
+  nice_recv_ring_wake_consumer (ring);
+}
+
+/* Keep the slot last handed out by nice_recv_ring_reserve() for the next
+ * receive attempt, with the first @length bytes of @message already valid. */
+void
+nice_recv_ring_keep_pending (NiceRecvRing *ring, gsize length)
+{
+  ring->pending_length = length;
+}
+
+/* Account for a packet which was received while the ring was full. */
+void
+nice_recv_ring_drop (NiceRecvRing *ring)
+{
+  g_atomic_int_inc (&ring->n_dropped);
+}
+
+/* Called when the ring’s component goes away: wake up the consumer, which
+ * gets an error once it has drained what is left. */
+void
+nice_recv_ring_close (NiceRecvRing *ring)
+{
+  g_atomic_int_set (&ring->closed, TRUE);
+
+  g_mutex_lock (&ring->mutex);
+  g_cond_broadcast (&ring->cond);
+  g_mutex_unlock (&ring->mutex);
+}
+
+static void
+copy_slot_to_input_message (NiceInputMessage *message, const guint8 *buffer,
+    gsize buffer_length)
+{
+  guint i;
+
+  message->length = 0;
+
+  for (i = 0;
+       buffer_length > 0 &&
+       ((message->n_buffers >= 0 && i < (guint) message->n_buffers) ||
+        (message->n_buffers < 0 && message->buffers[i].buffer != NULL));
+       i++) {
+    gsize len;
+
+    len = MIN (message->buffers[i].size, buffer_length);
+    memcpy (message->buffers[i].buffer, buffer, len);
+
+    buffer += len;
+    buffer_length -= len;
+
+    message->length += len;
+  }
+
+  if (buffer_length > 0) {
+    nice_debug ("Dropped %" G_GSIZE_FORMAT " bytes of data not fitting in "
+        "message %p", buffer_length, message);
+  }
+}
+
+/**
+ * nice_recv_ring_recv_messages:
+ * @ring: a #NiceRecvRing
+ * @messages: (array length=n_messages) (out caller-allocates): caller-allocated
+ * array of #NiceInputMessages to fill with the received packets
+ * @n_messages: number of entries in @messages
+ * @timeout_us: how long to wait for a packet if @ring is empty, in
+ * microseconds; 0 to return straight away, or -1 to wait indefinitely
+ * @error: (allow-none): return location for a #GError, or %NULL
+ *
+ * Copies up to @n_messages packets out of @ring, one per message, waiting up
+ * to @timeout_us for the first one to arrive. Packets which do not fit in
+ * their message are truncated. If a message’s @from is non-%NULL, it is
+ * filled with the address of the packet’s sender.
+ *
+ * This never takes the agent’s lock, and must only be called from one thread
+ * at a time.
+ *
+ * If the ring is empty, %G_IO_ERROR_WOULD_BLOCK is returned when @timeout_us
+ * is 0 and %G_IO_ERROR_TIMED_OUT when it expires. Once the ring’s component
+ * has been removed and the remaining packets drained,
+ * %G_IO_ERROR_BROKEN_PIPE is returned.
+ *
+ * Returns: the number of valid messages in @messages, or -1 on error
+ *
+ * Since: 0.1.19
+ */
+NICEAPI_EXPORT gint
+nice_recv_ring_recv_messages (NiceRecvRing *ring, NiceInputMessage *messages,
+    guint n_messages, gint64 timeout_us, GError **error)
+{
+  guint head, tail;
+  guint i;
+
+  g_return_val_if_fail (ring != NULL, -1);
+  g_return_val_if_fail (n_messages == 0 || messages != NULL, -1);
+  g_return_val_if_fail (error == NULL || *error == NULL, -1);
+
+  if (n_messages == 0)
+    return 0;
+
+  n_messages = MIN (n_messages, G_MAXINT);
+
+  head = ring->head;
+  tail = g_atomic_int_get (&ring->tail);
+
+  if (head == tail && timeout_us != 0) {
+    gint64 end_time = -1;
+
+    if (timeout_us > 0)
+      end_time = g_get_monotonic_time () + timeout_us;
+
+    g_mutex_lock (&ring->mutex);
+    /* Full barrier: the producer either sees @waiting, or we see its new
+     * tail below. */
+    g_atomic_int_set (&ring->waiting, TRUE);
+
+    while ((tail = g_atomic_int_get (&ring->tail)) == head &&
+        !g_atomic_int_get (&ring->closed)) {
+      if (end_time < 0) {
+        g_cond_wait (&ring->cond, &ring->mutex);
+      } else if (!g_cond_wait_until (&ring->cond, &ring->mutex, end_time)) {
+        tail = g_atomic_int_get (&ring->tail);
+        break;
+      }
+    }
+
+    g_atomic_int_set (&ring->waiting, FALSE);
+    g_mutex_unlock (&ring->mutex);
+  }
+
+  if (head == tail) {
+    if (g_atomic_int_get (&ring->closed))
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_BROKEN_PIPE,
+          "Component removed.");
+    else if (timeout_us == 0)
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK,
+          g_strerror (EAGAIN));
+    else
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+          "Timed out waiting for data.");
+    return -1;
+  }
+
+  for (i = 0; i < n_messages && head != tail; i++, head++) {
+    guint slot = head & (ring->n_slots - 1);
+
+    copy_slot_to_input_message (&messages[i],
+        ring->data + slot * ring->slot_size, ring->lengths[slot]);
+    if (messages[i].from != NULL)
+      *messages[i].from = ring->from[slot];
+  }
+
+  /* Hand the slots back to the producer. */
+  g_atomic_int_set (&ring->head, head);
+
+  return i;
+}
+
+/**
+ * nice_recv_ring_get_n_dropped:
+ * @ring: a #NiceRecvRing
+ *
+ * Gets the number of packets the network thread had to discard because @ring
+ * was full.
+ *
+ * Returns: the number of packets dropped so far
+ *
+ * Since: 0.1.19
+ */
+NICEAPI_EXPORT guint
+nice_recv_ring_get_n_dropped (NiceRecvRing *ring)
+{
+  g_return_val_if_fail (ring != NULL, 0);
+
+  return g_atomic_int_get (&ring->n_dropped);
+}
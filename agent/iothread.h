@@ -0,0 +1,84 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * (C) 2026 Collabora Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the Nice GLib ICE library.
+ *
+ * The Initial Developers of the Original Code are Collabora Ltd and Nokia
+ * Corporation. All Rights Reserved.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+
+#ifndef _NICE_IO_THREAD_H
+#define _NICE_IO_THREAD_H
+
+#include <glib.h>
+
+#include "agent.h"
+
+G_BEGIN_DECLS
+
+/* A network thread owned by a #NiceAgent. Each one iterates its own
+ * #GMainContext, to which the socket sources of the components assigned to it
+ * are attached. */
+typedef struct {
+  GThread *thread;
+  GMainContext *context;
+  gint stop;      /* atomic */
+  gint detached;  /* set if freed from the thread itself */
+} NiceIOThread;
+
+NiceIOThread *
+nice_io_thread_new (guint index);
+
+void
+nice_io_thread_free (NiceIOThread *io_thread);
+
+/* Producer side of a #NiceRecvRing. Only the network thread serving the
+ * ring’s component may call these. */
+gboolean
+nice_recv_ring_reserve (NiceRecvRing *ring, NiceInputMessage *message,
+    GInputVector *buffer);
+
+void
+nice_recv_ring_commit (NiceRecvRing *ring, const NiceInputMessage *message);
+
+void
+nice_recv_ring_keep_pending (NiceRecvRing *ring, gsize length);
+
+void
+nice_recv_ring_drop (NiceRecvRing *ring);
+
+/* Upper bound on the number of slots of a ring; larger requests are
+ * clamped. */
+#define NICE_RECV_RING_MAX_SLOTS (1U << 16)
+
+NiceRecvRing *
+nice_recv_ring_new (guint n_slots, gsize slot_size);
+
+void
+nice_recv_ring_close (NiceRecvRing *ring);
+
+G_END_DECLS
+
+#endif /* _NICE_IO_THREAD_H */
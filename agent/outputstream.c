@@ -94,9 +94,17 @@ struct _NiceOutputStreamPrivate
   guint component_id;
 
   GCancellable *closed_cancellable;
+  gulong closed_cancel_id;
+
+  /* Persistent writability notification for blocking writes: bumped by the
+   * reliable-transport-writable handler and on cancellation. */
+  GMutex write_mutex;
+  GCond write_cond;
+  guint writable_seq;
 };
 
 static void nice_output_stream_dispose (GObject *object);
+static void nice_output_stream_finalize (GObject *object);
 static void nice_output_stream_get_property (GObject *object, guint prop_id,
     GValue *value, GParamSpec *pspec);
 static void nice_output_stream_set_property (GObject *object, guint prop_id,
@@ -104,6 +112,11 @@ static void nice_output_stream_set_property (GObject *object, guint prop_id,
 
 static gssize nice_output_stream_write (GOutputStream *stream,
     const void *buffer, gsize count, GCancellable *cancellable, GError **error);
+#if GLIB_CHECK_VERSION (2, 60, 0)
+static gboolean nice_output_stream_writev (GOutputStream *stream,
+    const GOutputVector *vectors, gsize n_vectors, gsize *bytes_written,
+    GCancellable *cancellable, GError **error);
+#endif
 static gboolean nice_output_stream_close (GOutputStream *stream,
     GCancellable *cancellable, GError **error);
 
@@ -111,8 +124,16 @@ static gboolean nice_output_stream_is_writable (GPollableOutputStream *stream);
 static gssize nice_output_stream_write_nonblocking (
     GPollableOutputStream *stream, const void *buffer, gsize count,
     GError **error);
+#if GLIB_CHECK_VERSION (2, 60, 0)
+static GPollableReturn nice_output_stream_writev_nonblocking (
+    GPollableOutputStream *stream, const GOutputVector *vectors,
+    gsize n_vectors, gsize *bytes_written, GError **error);
+#endif
 static GSource *nice_output_stream_create_source (GPollableOutputStream *stream,
     GCancellable *cancellable);
+static void reliable_transport_writable_cb (NiceAgent *agent, guint stream_id,
+    guint component_id, gpointer user_data);
+static void write_cancelled_cb (GCancellable *cancellable, gpointer user_data);
 
 /* Output Stream */
 static void
@@ -124,11 +145,15 @@ nice_output_stream_class_init (NiceOutputStreamClass *klass)
   g_type_class_add_private (klass, sizeof (NiceOutputStreamPrivate));
 
   stream_class->write_fn = nice_output_stream_write;
+#if GLIB_CHECK_VERSION (2, 60, 0)
+  stream_class->writev_fn = nice_output_stream_writev;
+#endif
   stream_class->close_fn = nice_output_stream_close;
 
   gobject_class->set_property = nice_output_stream_set_property;
   gobject_class->get_property = nice_output_stream_get_property;
   gobject_class->dispose = nice_output_stream_dispose;
+  gobject_class->finalize = nice_output_stream_finalize;
 
   /***
    * NiceOutputStream:agent:
@@ -196,16 +221,34 @@ nice_output_stream_dispose (GObject *object)
   agent = g_weak_ref_get (&self->priv->agent_ref);
   if (agent != NULL) {
     g_signal_handlers_disconnect_by_func (agent, streams_removed_cb, self);
+    g_signal_handlers_disconnect_by_func (agent,
+        reliable_transport_writable_cb, self);
     g_object_unref (agent);
   }
 
   g_weak_ref_clear (&self->priv->agent_ref);
 
+  if (self->priv->closed_cancellable != NULL) {
+    g_cancellable_disconnect (self->priv->closed_cancellable,
+        self->priv->closed_cancel_id);
+    self->priv->closed_cancel_id = 0;
+  }
   g_clear_object (&self->priv->closed_cancellable);
 
   G_OBJECT_CLASS (nice_output_stream_parent_class)->dispose (object);
 }
 
+static void
+nice_output_stream_finalize (GObject *object)
+{
+  NiceOutputStream *self = NICE_OUTPUT_STREAM (object);
+
+  g_cond_clear (&self->priv->write_cond);
+  g_mutex_clear (&self->priv->write_mutex);
+
+  G_OBJECT_CLASS (nice_output_stream_parent_class)->finalize (object);
+}
+
 static void
 nice_output_stream_get_property (GObject *object, guint prop_id,
     GValue *value, GParamSpec *pspec)
@@ -245,6 +288,8 @@ nice_output_stream_set_property (GObject *object, guint prop_id,
       if (agent != NULL) {
         g_signal_connect (agent, "streams-removed",
             (GCallback) streams_removed_cb, self);
+        g_signal_connect (agent, "reliable-transport-writable",
+            (GCallback) reliable_transport_writable_cb, self);
         g_object_unref (agent);
       }
 
@@ -270,7 +315,13 @@ nice_output_stream_init (NiceOutputStream *stream)
       NiceOutputStreamPrivate);
 
   g_weak_ref_init (&stream->priv->agent_ref, NULL);
+  g_mutex_init (&stream->priv->write_mutex);
+  g_cond_init (&stream->priv->write_cond);
+  stream->priv->writable_seq = 0;
   stream->priv->closed_cancellable = g_cancellable_new ();
+  stream->priv->closed_cancel_id =
+      g_cancellable_connect (stream->priv->closed_cancellable,
+          (GCallback) write_cancelled_cb, stream, NULL);
 }
 
 static void
@@ -278,6 +329,9 @@ nice_output_stream_init_pollable (GPollableOutputStreamInterface *iface)
 {
   iface->is_writable = nice_output_stream_is_writable;
   iface->write_nonblocking = nice_output_stream_write_nonblocking;
+#if GLIB_CHECK_VERSION (2, 60, 0)
+  iface->writev_nonblocking = nice_output_stream_writev_nonblocking;
+#endif
   iface->create_source = nice_output_stream_create_source;
 }
 
@@ -312,54 +366,135 @@ nice_output_stream_new (NiceAgent *agent, guint stream_id, guint component_id)
       NULL);
 }
 
-typedef struct {
-  volatile gint ref_count;
-
-  GCond cond;
-  GMutex mutex;
-
-  gboolean writable;
-  gboolean cancelled;
-} WriteData;
-
-static WriteData *
-write_data_ref (WriteData *write_data)
+static void
+nice_output_stream_wake_writers (NiceOutputStream *self)
 {
-  g_atomic_int_inc (&write_data->ref_count);
-  return write_data;
+  g_mutex_lock (&self->priv->write_mutex);
+  self->priv->writable_seq++;
+  g_cond_broadcast (&self->priv->write_cond);
+  g_mutex_unlock (&self->priv->write_mutex);
 }
 
 static void
-write_data_unref (WriteData *write_data)
+write_cancelled_cb (GCancellable *cancellable, gpointer user_data)
 {
-  if (g_atomic_int_dec_and_test (&write_data->ref_count)) {
-    g_cond_clear (&write_data->cond);
-    g_mutex_clear (&write_data->mutex);
-    g_slice_free (WriteData, write_data);
-  }
+  nice_output_stream_wake_writers (NICE_OUTPUT_STREAM (user_data));
 }
 
 static void
-write_cancelled_cb (GCancellable *cancellable, gpointer user_data)
+reliable_transport_writable_cb (NiceAgent *agent, guint stream_id,
+    guint component_id, gpointer user_data)
 {
-  WriteData *write_data = user_data;
+  NiceOutputStream *self = NICE_OUTPUT_STREAM (user_data);
 
-  g_mutex_lock (&write_data->mutex);
-  g_cond_broadcast (&write_data->cond);
-  write_data->cancelled = TRUE;
-  g_mutex_unlock (&write_data->mutex);
+  if (stream_id == self->priv->stream_id &&
+      component_id == self->priv->component_id)
+    nice_output_stream_wake_writers (self);
 }
 
-static void
-reliable_transport_writeable_cb (NiceAgent *agent, guint stream_id,
-    guint component_id, gpointer user_data)
+/* Maximum number of vectors handled without a heap allocation */
+#define MAX_STACK_VECTORS 16
+
+/*
+ * Send @vectors, passing as many whole vectors as the transport accepts to a
+ * single nice_agent_send_messages_nonblocking() call, and splitting a vector
+ * only when it doesn’t fit in the send buffer on its own.
+ *
+ * If @blocking, wait for the reliable-transport-writable signal whenever the
+ * transport is full, until everything is sent or @cancellable or the stream
+ * gets cancelled. Otherwise return after the first attempt that would block.
+ *
+ * Returns: the number of bytes sent
+ */
+static gsize
+nice_output_stream_send_vectors (NiceOutputStream *self, NiceAgent *agent,
+    const GOutputVector *vectors, gsize n_vectors, gboolean blocking,
+    GCancellable *cancellable)
 {
-  WriteData *write_data = user_data;
+  NiceOutputStreamPrivate *priv = self->priv;
+  GOutputVector stack_vecs[MAX_STACK_VECTORS];
+  NiceOutputMessage stack_messages[MAX_STACK_VECTORS];
+  GOutputVector *vecs = stack_vecs;
+  NiceOutputMessage *messages = stack_messages;
+  gulong cancel_id = 0;
+  gsize first = 0;
+  gsize len = 0;
+  gsize i;
+
+  if (n_vectors > MAX_STACK_VECTORS) {
+    vecs = g_new (GOutputVector, n_vectors);
+    messages = g_new (NiceOutputMessage, n_vectors);
+  }
+
+  for (i = 0; i < n_vectors; i++) {
+    vecs[i] = vectors[i];
+    messages[i].buffers = &vecs[i];
+    messages[i].n_buffers = 1;
+  }
+
+  if (blocking && cancellable != NULL) {
+    cancel_id = g_cancellable_connect (cancellable,
+        (GCallback) write_cancelled_cb, self, NULL);
+  }
 
-  g_mutex_lock (&write_data->mutex);
-  write_data->writable = TRUE;
-  g_cond_broadcast (&write_data->cond);
-  g_mutex_unlock (&write_data->mutex);
+  while (first < n_vectors) {
+    guint writable_seq;
+    gint n_sent;
+
+    if (vecs[first].size == 0) {
+      first++;
+      continue;
+    }
+
+    if (g_cancellable_is_cancelled (cancellable) ||
+        g_cancellable_is_cancelled (priv->closed_cancellable))
+      break;
+
+    /* Sample the sequence before trying, so a writable signal emitted
+     * between a failed send and the wait below is not lost. */
+    g_mutex_lock (&priv->write_mutex);
+    writable_seq = priv->writable_seq;
+    g_mutex_unlock (&priv->write_mutex);
+
+    n_sent = nice_agent_send_messages_nonblocking (agent, priv->stream_id,
+        priv->component_id, &messages[first], n_vectors - first, NULL, NULL);
+
+    if (n_sent > 0) {
+      for (i = 0; i < (guint) n_sent; i++)
+        len += vecs[first + i].size;
+      first += n_sent;
+      continue;
+    }
+
+    /* The next vector doesn’t fit as a whole: send what fits of it. */
+    n_sent = nice_agent_send (agent, priv->stream_id, priv->component_id,
+        MIN (vecs[first].size, G_MAXINT), vecs[first].buffer);
+
+    if (n_sent > 0) {
+      len += n_sent;
+      vecs[first].buffer = (const guint8 *) vecs[first].buffer + n_sent;
+      vecs[first].size -= n_sent;
+      continue;
+    }
+
+    if (!blocking)
+      break;
+
+    g_mutex_lock (&priv->write_mutex);
+    while (priv->writable_seq == writable_seq)
+      g_cond_wait (&priv->write_cond, &priv->write_mutex);
+    g_mutex_unlock (&priv->write_mutex);
+  }
+
+  if (cancel_id)
+    g_cancellable_disconnect (cancellable, cancel_id);
+
+  if (vecs != stack_vecs) {
+    g_free (vecs);
+    g_free (messages);
+  }
+
+  return len;
 }
 
 static gssize
@@ -367,12 +502,9 @@ nice_output_stream_write (GOutputStream *stream, const void *buffer, gsize count
     GCancellable *cancellable, GError **error)
 {
   NiceOutputStream *self = NICE_OUTPUT_STREAM (stream);
-  const gchar* buf = buffer;
-  gssize len = 0;
-  gint n_sent;
+  GOutputVector vector = { buffer, count };
+  gssize len;
   NiceAgent *agent = NULL;  /* owned */
-  gulong cancel_id = 0, closed_cancel_id, writeable_id;
-  WriteData *write_data;
 
   /* Closed streams are not writeable. */
   if (g_output_stream_is_closed (stream)) {
@@ -394,82 +526,80 @@ nice_output_stream_write (GOutputStream *stream, const void *buffer, gsize count
     return 0;
   }
 
-  /* FIXME: nice_agent_send() is non-blocking, which is a bit unexpected
-   * since nice_agent_recv() is blocking. Currently this uses a fairly dodgy
-   * GCond solution; would be much better for nice_agent_send() to block
-   * properly in the main loop. */
-  write_data = g_slice_new0 (WriteData);
-  write_data->ref_count = 1;
-  g_mutex_init (&write_data->mutex);
-  g_cond_init (&write_data->cond);
+  len = nice_output_stream_send_vectors (self, agent, &vector, 1, TRUE,
+      cancellable);
 
-  if (cancellable != NULL) {
-    cancel_id = g_cancellable_connect (cancellable,
-        (GCallback) write_cancelled_cb, write_data_ref (write_data),
-        (GDestroyNotify) write_data_unref);
+  if (len == 0) {
+    len = -1;
+    if (!g_cancellable_set_error_if_cancelled (cancellable, error)) {
+      if (g_cancellable_is_cancelled (self->priv->closed_cancellable))
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_CLOSED,
+            "Stream has been removed from agent");
+    }
   }
 
-  closed_cancel_id = g_cancellable_connect (self->priv->closed_cancellable,
-      (GCallback) write_cancelled_cb, write_data_ref (write_data),
-      (GDestroyNotify) write_data_unref);
-
-  g_mutex_lock (&write_data->mutex);
+  g_object_unref (agent);
+  g_assert_cmpint (len, !=, 0);
 
-  writeable_id = g_signal_connect_data (G_OBJECT (agent),
-      "reliable-transport-writable",
-      (GCallback) reliable_transport_writeable_cb, write_data_ref (write_data),
-      (GClosureNotify) G_CALLBACK (write_data_unref), 0);
+  return len;
+}
 
+#if GLIB_CHECK_VERSION (2, 60, 0)
+static gboolean
+nice_output_stream_writev (GOutputStream *stream, const GOutputVector *vectors,
+    gsize n_vectors, gsize *bytes_written, GCancellable *cancellable,
+    GError **error)
+{
+  NiceOutputStream *self = NICE_OUTPUT_STREAM (stream);
+  NiceAgent *agent;  /* owned */
+  gsize count = 0;
+  gsize len;
+  gsize i;
 
-  do {
-    /* Have to unlock while calling into the agent because
-     * it will take the agent lock which will cause a deadlock if one of
-     * the callbacks is called.
-     */
-    if (g_cancellable_is_cancelled (cancellable) ||
-        g_cancellable_is_cancelled (self->priv->closed_cancellable))
-      break;
+  if (bytes_written)
+    *bytes_written = 0;
 
-    write_data->writable = FALSE;
-    g_mutex_unlock (&write_data->mutex);
+  /* Closed streams are not writeable. */
+  if (g_output_stream_is_closed (stream)) {
+    g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_CLOSED,
+        "Stream is closed.");
+    return FALSE;
+  }
 
-    n_sent = nice_agent_send (agent, self->priv->stream_id,
-        self->priv->component_id, count - len, buf + len);
+  /* Has the agent disappeared? */
+  agent = g_weak_ref_get (&self->priv->agent_ref);
+  if (agent == NULL) {
+    g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_CLOSED,
+        "Stream is closed due to the NiceAgent being finalised.");
+    return FALSE;
+  }
 
-    g_mutex_lock (&write_data->mutex);
+  for (i = 0; i < n_vectors; i++)
+    count += vectors[i].size;
 
-    if (n_sent <= 0) {
-      if (!write_data->writable && !write_data->cancelled)
-        g_cond_wait (&write_data->cond, &write_data->mutex);
-    } else if (n_sent > 0) {
-      /* Success. */
-      len += n_sent;
-    }
-  } while ((gsize) len < count);
+  if (count == 0) {
+    g_object_unref (agent);
+    return TRUE;
+  }
 
-  g_signal_handler_disconnect (G_OBJECT (agent), writeable_id);
-  g_mutex_unlock (&write_data->mutex);
+  len = nice_output_stream_send_vectors (self, agent, vectors, n_vectors, TRUE,
+      cancellable);
 
-  if (cancel_id)
-    g_cancellable_disconnect (cancellable, cancel_id);
-  g_cancellable_disconnect (self->priv->closed_cancellable, closed_cancel_id);
+  g_object_unref (agent);
 
   if (len == 0) {
-    len = -1;
-    if (!g_cancellable_set_error_if_cancelled (cancellable, error)) {
-      if (g_cancellable_is_cancelled (self->priv->closed_cancellable))
-        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_CLOSED,
-            "Stream has been removed from agent");
-    }
+    if (!g_cancellable_set_error_if_cancelled (cancellable, error))
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_CLOSED,
+          "Stream has been removed from agent");
+    return FALSE;
   }
 
-  write_data_unref (write_data);
-
-  g_object_unref (agent);
-  g_assert_cmpint (len, !=, 0);
+  if (bytes_written)
+    *bytes_written = len;
 
-  return len;
+  return TRUE;
 }
+#endif
 
 static gboolean
 nice_output_stream_close (GOutputStream *stream, GCancellable *cancellable,
@@ -589,6 +719,54 @@ nice_output_stream_write_nonblocking (GPollableOutputStream *stream,
   return n_sent;
 }
 
+#if GLIB_CHECK_VERSION (2, 60, 0)
+static GPollableReturn
+nice_output_stream_writev_nonblocking (GPollableOutputStream *stream,
+    const GOutputVector *vectors, gsize n_vectors, gsize *bytes_written,
+    GError **error)
+{
+  NiceOutputStream *self = NICE_OUTPUT_STREAM (stream);
+  NiceAgent *agent;  /* owned */
+  gsize count = 0;
+  gsize len;
+  gsize i;
+
+  if (bytes_written)
+    *bytes_written = 0;
+
+  /* Closed streams are not writeable. */
+  if (g_output_stream_is_closed (G_OUTPUT_STREAM (stream))) {
+    g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_CLOSED,
+        "Stream is closed.");
+    return G_POLLABLE_RETURN_FAILED;
+  }
+
+  /* Has the agent disappeared? */
+  agent = g_weak_ref_get (&self->priv->agent_ref);
+  if (agent == NULL) {
+    g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_CLOSED,
+        "Stream is closed due to the NiceAgent being finalised.");
+    return G_POLLABLE_RETURN_FAILED;
+  }
+
+  for (i = 0; i < n_vectors; i++)
+    count += vectors[i].size;
+
+  len = nice_output_stream_send_vectors (self, agent, vectors, n_vectors,
+      FALSE, NULL);
+
+  g_object_unref (agent);
+
+  if (bytes_written)
+    *bytes_written = len;
+
+  if (len == 0 && count > 0)
+    return G_POLLABLE_RETURN_WOULD_BLOCK;
+
+  return G_POLLABLE_RETURN_OK;
+}
+#endif
+
 static GSource *
 nice_output_stream_create_source (GPollableOutputStream *stream,
     GCancellable *cancellable)
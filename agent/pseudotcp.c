@@ -513,6 +513,7 @@ struct _PseudoTcpSocketPrivate {
   gboolean fast_recovery;
   guint32 t_ack;  /* time a delayed ack was scheduled; 0 if no acks scheduled */
   guint32 last_acked_ts;
+  guint32 n_retransmits;  /* segments sent more than once */
 
   gboolean use_nagling;
   guint32 ack_delay;
@@ -2138,6 +2139,8 @@ transmit(PseudoTcpSocket *self, SSegment *segment, guint32 now)
     /* FIN flags require acknowledgement. */
     if (segment->len == 0 && segment->flags & FLAG_FIN)
       priv->snd_nxt++;
+  } else {
+    priv->n_retransmits++;
   }
   segment->xmit += 1;
 
@@ -2536,6 +2539,20 @@ pseudo_tcp_socket_get_available_send_space (PseudoTcpSocket *self)
   return ret;
 }
 
+void
+pseudo_tcp_socket_get_stats (PseudoTcpSocket *self, guint32 *cwnd,
+    guint32 *srtt, guint32 *retransmits)
+{
+  PseudoTcpSocketPrivate *priv = self->priv;
+
+  if (cwnd)
+    *cwnd = priv->cwnd;
+  if (srtt)
+    *srtt = priv->rx_srtt;
+  if (retransmits)
+    *retransmits = priv->n_retransmits;
+}
+
 /* State names are capitalised and formatted as in RFC 793. */
 static const gchar *
 pseudo_tcp_state_get_name (PseudoTcpState state)
@@ -546,6 +546,22 @@ gboolean pseudo_tcp_socket_can_send (PseudoTcpSocket *self);
  */
 gsize pseudo_tcp_socket_get_available_send_space (PseudoTcpSocket *self);
 
+/**
+ * pseudo_tcp_socket_get_stats:
+ * @self: The #PseudoTcpSocket object.
+ * @cwnd: (out) (optional): return location for the congestion window, in bytes
+ * @srtt: (out) (optional): return location for the smoothed round-trip time,
+ * in milliseconds, or 0 if no round trip has been measured yet
+ * @retransmits: (out) (optional): return location for the number of segments
+ * transmitted more than once
+ *
+ * Gets the current congestion control state of the socket.
+ *
+ * Since: 0.1.19
+ */
+void pseudo_tcp_socket_get_stats (PseudoTcpSocket *self, guint32 *cwnd,
+    guint32 *srtt, guint32 *retransmits);
+
 /**
  * pseudo_tcp_socket_set_time:
  * @self: The #PseudoTcpSocket object.
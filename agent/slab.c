@@ -0,0 +1,174 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * (C) 2026 Collabora Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the Nice GLib ICE library.
+ *
+ * The Initial Developers of the Original Code are Collabora Ltd and Nokia
+ * Corporation. All Rights Reserved.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "slab.h"
+
+#define N_CLASSES (NICE_SLAB_MAX_SIZE / NICE_SLAB_STEP)
+#define PAGE_SIZE 16384
+
+/* Precedes every chunk. The union keeps the chunk data aligned as
+ * g_malloc() would. */
+typedef union {
+  struct {
+    NiceSlab *slab;
+    gsize size;  /* of the data, a multiple of NICE_SLAB_STEP for slab
+                  * chunks */
+  } s;
+  gint64 align_int;
+  gdouble align_double;
+} ChunkHeader;
+
+typedef struct _FreeChunk FreeChunk;
+
+struct _FreeChunk {
+  ChunkHeader header;
+  FreeChunk *next;
+};
+
+struct _NiceSlab {
+  FreeChunk *free_chunks[N_CLASSES];
+  GSList *pages;
+  gsize bytes_in_use;
+  gsize bytes_reserved;
+};
+
+NiceSlab *
+nice_slab_new (void)
+{
+  return g_new0 (NiceSlab, 1);
+}
+
+void
+nice_slab_free (NiceSlab *slab)
+{
+  if (slab == NULL)
+    return;
+
+  if (slab->bytes_in_use > 0)
+    g_warning ("Freeing slab %p with %" G_GSIZE_FORMAT " bytes still in use",
+        slab, slab->bytes_in_use);
+
+  g_slist_free_full (slab->pages, g_free);
+  g_free (slab);
+}
+
+static void
+slab_add_page (NiceSlab *slab, guint idx)
+{
+  gsize chunk_size = sizeof (ChunkHeader) + (idx + 1) * NICE_SLAB_STEP;
+  guint n_chunks = MAX (PAGE_SIZE / chunk_size, 1);
+  guint8 *page;
+  guint i;
+
+  page = g_malloc (n_chunks * chunk_size);
+  slab->pages = g_slist_prepend (slab->pages, page);
+  slab->bytes_reserved += n_chunks * chunk_size;
+
+  for (i = 0; i < n_chunks; i++) {
+    FreeChunk *chunk = (FreeChunk *) (page + i * chunk_size);
+
+    chunk->header.s.slab = slab;
+    chunk->header.s.size = (idx + 1) * NICE_SLAB_STEP;
+    chunk->next = slab->free_chunks[idx];
+    slab->free_chunks[idx] = chunk;
+  }
+}
+
+gpointer
+nice_slab_alloc (NiceSlab *slab, gsize size)
+{
+  ChunkHeader *header;
+  FreeChunk *chunk;
+  guint idx;
+
+  if (size > NICE_SLAB_MAX_SIZE) {
+    header = g_malloc (sizeof (ChunkHeader) + size);
+    header->s.slab = slab;
+    header->s.size = size;
+    slab->bytes_in_use += sizeof (ChunkHeader) + size;
+    slab->bytes_reserved += sizeof (ChunkHeader) + size;
+    return header + 1;
+  }
+
+  idx = size > 0 ? (size - 1) / NICE_SLAB_STEP : 0;
+
+  if (slab->free_chunks[idx] == NULL)
+    slab_add_page (slab, idx);
+
+  chunk = slab->free_chunks[idx];
+  slab->free_chunks[idx] = chunk->next;
+  slab->bytes_in_use += sizeof (ChunkHeader) + chunk->header.s.size;
+
+  return &chunk->header + 1;
+}
+
+void
+nice_slab_release (gpointer mem)
+{
+  ChunkHeader *header;
+  NiceSlab *slab;
+  FreeChunk *chunk;
+  guint idx;
+
+  if (mem == NULL)
+    return;
+
+  header = (ChunkHeader *) mem - 1;
+  slab = header->s.slab;
+  slab->bytes_in_use -= sizeof (ChunkHeader) + header->s.size;
+
+  if (header->s.size > NICE_SLAB_MAX_SIZE) {
+    slab->bytes_reserved -= sizeof (ChunkHeader) + header->s.size;
+    g_free (header);
+    return;
+  }
+
+  idx = header->s.size / NICE_SLAB_STEP - 1;
+  chunk = (FreeChunk *) header;
+  chunk->next = slab->free_chunks[idx];
+  slab->free_chunks[idx] = chunk;
+}
+
+gsize
+nice_slab_get_bytes_in_use (NiceSlab *slab)
+{
+  return slab->bytes_in_use;
+}
+
+gsize
+nice_slab_get_bytes_reserved (NiceSlab *slab)
+{
+  return slab->bytes_reserved;
+}
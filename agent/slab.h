@@ -0,0 +1,75 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * (C) 2026 Collabora Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the Nice GLib ICE library.
+ *
+ * The Initial Developers of the Original Code are Collabora Ltd and Nokia
+ * Corporation. All Rights Reserved.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+
+#ifndef _NICE_SLAB_H
+#define _NICE_SLAB_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Allocator for the small, short-lived buffers of an agent, such as its
+ * STUN transactions. Chunks are carved out of pages shared by all chunks of
+ * the same size, rounded up to NICE_SLAB_STEP bytes, and recycled through a
+ * free list per size. Pages are only returned to the system when the slab is
+ * freed.
+ *
+ * A slab is not thread-safe; an agent’s slab is protected by its lock. */
+typedef struct _NiceSlab NiceSlab;
+
+#define NICE_SLAB_STEP 32
+/* Larger chunks are allocated from the heap one by one */
+#define NICE_SLAB_MAX_SIZE 2048
+
+NiceSlab *
+nice_slab_new (void);
+
+void
+nice_slab_free (NiceSlab *slab);
+
+gpointer
+nice_slab_alloc (NiceSlab *slab, gsize size);
+
+/* Gives @mem back to the slab it was allocated from. */
+void
+nice_slab_release (gpointer mem);
+
+/* Bytes of the chunks currently allocated, headers included */
+gsize
+nice_slab_get_bytes_in_use (NiceSlab *slab);
+
+/* Bytes obtained from the system, including free chunks */
+gsize
+nice_slab_get_bytes_reserved (NiceSlab *slab);
+
+G_END_DECLS
+
+#endif /* _NICE_SLAB_H */
@@ -89,6 +89,8 @@ struct _NiceStream {
   gboolean gathering_started;
   gboolean peer_gathering_done;
   gint tos;
+  guint recv_buffer_size;          /* 0 to use the agent’s */
+  guint send_buffer_size;          /* 0 to use the agent’s */
   guint tick_counter;
 
 #ifdef HAVE_GUPNP
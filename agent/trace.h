@@ -0,0 +1,74 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * (C) 2026 Collabora Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the Nice GLib ICE library.
+ *
+ * The Initial Developers of the Original Code are Collabora Ltd and Nokia
+ * Corporation. All Rights Reserved.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+
+
+#ifndef _NICE_TRACE_H
+#define _NICE_TRACE_H
+
+/*
+ * Static tracepoints.
+ *
+ * When built with sys/sdt.h available (the 'tracepoints' meson option),
+ * NICE_TRACE() emits a USDT probe in the "libnice" provider which can be
+ * attached to with SystemTap, bpftrace or perf, e.g.:
+ *
+ *   bpftrace -e 'usdt:/usr/lib/libnice.so.10:libnice:recv { @[arg3] = count(); }'
+ *
+ * A disabled probe is a single nop in the instruction stream, so probe
+ * arguments must be plain scalars or pointers that are already at hand.
+ * Otherwise the macro expands to nothing.
+ *
+ * Probes and their arguments:
+ *
+ *   recv (agent, stream_id, component_id, len, nice_socket)
+ *   send (agent, stream_id, component_id, n_messages, n_sent)
+ *   send-drop (agent, stream_id, component_id, n_messages)
+ *   stun-request-sent (agent, stream_id, component_id, check_pair, retransmissions)
+ *   stun-recv (agent, stream_id, component_id, buf, len)
+ *   pseudotcp-write (agent, stream_id, component_id, len)
+ *   pseudotcp-recv (agent, stream_id, component_id, len)
+ *   turn-send (nice_socket, output_message, channel)
+ *   turn-recv (nice_socket, len, channel)
+ *
+ * stun-recv hands over the raw message rather than decoding it: the class
+ * and method are in its first two bytes, in network order.
+ *
+ * Dashes in probe names are written as double underscores in the source.
+ */
+
+#ifdef HAVE_SYS_SDT_H
+# include <sys/sdt.h>
+# define NICE_TRACE(name, ...) STAP_PROBEV (libnice, name, ## __VA_ARGS__)
+#else
+# define NICE_TRACE(name, ...) G_STMT_START { } G_STMT_END
+#endif
+
+#endif /* _NICE_TRACE_H */
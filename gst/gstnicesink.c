@@ -54,6 +54,11 @@ static GstFlowReturn
 gst_nice_sink_render_list (
   GstBaseSink *basesink,
   GstBufferList *buffer_list);
+
+static gboolean
+gst_nice_sink_event (
+  GstBaseSink *basesink,
+  GstEvent *event);
 #endif
 
 static gboolean
@@ -108,7 +113,8 @@ enum
 {
   PROP_AGENT = 1,
   PROP_STREAM,
-  PROP_COMPONENT
+  PROP_COMPONENT,
+  PROP_MAX_QUEUED_BYTES
 };
 
 static void
@@ -125,6 +131,7 @@ gst_nice_sink_class_init (GstNiceSinkClass *klass)
   gstbasesink_class->render = GST_DEBUG_FUNCPTR (gst_nice_sink_render);
 #if GST_CHECK_VERSION (1,0,0)
   gstbasesink_class->render_list = GST_DEBUG_FUNCPTR (gst_nice_sink_render_list);
+  gstbasesink_class->event = GST_DEBUG_FUNCPTR (gst_nice_sink_event);
 #endif
   gstbasesink_class->unlock = GST_DEBUG_FUNCPTR (gst_nice_sink_unlock);
   gstbasesink_class->unlock_stop = GST_DEBUG_FUNCPTR (gst_nice_sink_unlock_stop);
@@ -180,6 +187,20 @@ gst_nice_sink_class_init (GstNiceSinkClass *klass)
          G_MAXUINT,
          0,
          G_PARAM_READWRITE));
+
+#if GST_CHECK_VERSION (1,0,0)
+  g_object_class_install_property (gobject_class, PROP_MAX_QUEUED_BYTES,
+      g_param_spec_uint (
+         "max-queued-bytes",
+         "Maximum queued bytes",
+         "With a reliable agent, keep up to this many bytes queued while the "
+         "transport is not writable instead of blocking, dropping buffers "
+         "and sending QoS events upstream once full (0 = block)",
+         0,
+         G_MAXUINT,
+         0,
+         G_PARAM_READWRITE));
+#endif
 }
 
 static void
@@ -204,9 +225,110 @@ gst_nice_sink_init (GstNiceSink *sink)
 
   sink->n_messages = 1;
   sink->messages = g_new (NiceOutputMessage, sink->n_messages);
+
+  sink->max_queued_bytes = 0;
+  g_queue_init (&sink->queue);
+  sink->queued_bytes = 0;
+  sink->n_rendered = 0;
+  sink->n_dropped = 0;
+  sink->queue_messages = NULL;
+  sink->n_queue_messages = 0;
 #endif
 }
 
+#if GST_CHECK_VERSION (1,0,0)
+/* A buffer kept mapped in the send queue until the reliable transport has
+ * room for it */
+typedef struct
+{
+  GstBuffer *buffer;
+  gsize size;
+  guint n_mems;
+  GstMapInfo *maps;
+  GOutputVector *vecs;
+} GstNiceSinkQueuedBuffer;
+
+/* Takes over the memory mappings in @maps */
+static GstNiceSinkQueuedBuffer *
+queued_buffer_new (GstBuffer *buffer, GstMapInfo *maps, GOutputVector *vecs,
+    guint n_mems, gsize size)
+{
+  GstNiceSinkQueuedBuffer *qbuf = g_slice_new (GstNiceSinkQueuedBuffer);
+
+  qbuf->buffer = gst_buffer_ref (buffer);
+  qbuf->size = size;
+  qbuf->n_mems = n_mems;
+  qbuf->maps = g_memdup (maps, n_mems * sizeof (GstMapInfo));
+  qbuf->vecs = g_memdup (vecs, n_mems * sizeof (GOutputVector));
+
+  return qbuf;
+}
+
+static void
+queued_buffer_free (GstNiceSinkQueuedBuffer *qbuf)
+{
+  guint i;
+
+  for (i = 0; i < qbuf->n_mems; ++i)
+    gst_memory_unmap (qbuf->maps[i].memory, &qbuf->maps[i]);
+
+  gst_buffer_unref (qbuf->buffer);
+  g_free (qbuf->maps);
+  g_free (qbuf->vecs);
+  g_slice_free (GstNiceSinkQueuedBuffer, qbuf);
+}
+
+static void
+gst_nice_sink_clear_queue_locked (GstNiceSink *sink)
+{
+  GstNiceSinkQueuedBuffer *qbuf;
+
+  while ((qbuf = g_queue_pop_head (&sink->queue)) != NULL)
+    queued_buffer_free (qbuf);
+  sink->queued_bytes = 0;
+}
+
+/* Hand as much of the queue as the transport accepts to the agent, in a
+ * single send call. Must be called with the object lock held. */
+static void
+gst_nice_sink_flush_queue_locked (GstNiceSink *sink)
+{
+  guint n_queued = g_queue_get_length (&sink->queue);
+  GList *l;
+  guint i;
+  gint ret;
+
+  if (n_queued == 0)
+    return;
+
+  if (sink->n_queue_messages < n_queued) {
+    sink->n_queue_messages = GST_ROUND_UP_16 (n_queued);
+    g_free (sink->queue_messages);
+    sink->queue_messages = g_new (NiceOutputMessage, sink->n_queue_messages);
+  }
+
+  for (l = sink->queue.head, i = 0; l != NULL; l = l->next, ++i) {
+    GstNiceSinkQueuedBuffer *qbuf = l->data;
+
+    sink->queue_messages[i].buffers = qbuf->vecs;
+    sink->queue_messages[i].n_buffers = qbuf->n_mems;
+  }
+
+  ret = nice_agent_send_messages_nonblocking (sink->agent, sink->stream_id,
+      sink->component_id, sink->queue_messages, n_queued, NULL, NULL);
+
+  for (i = 0; ret > 0 && i < (guint) ret; ++i) {
+    GstNiceSinkQueuedBuffer *qbuf = g_queue_pop_head (&sink->queue);
+
+    sink->queued_bytes -= qbuf->size;
+    queued_buffer_free (qbuf);
+  }
+
+  GST_LOG_OBJECT (sink, "flushed %d of %u queued buffers, %" G_GSIZE_FORMAT
+      " bytes still queued", MAX (ret, 0), n_queued, sink->queued_bytes);
+}
+#endif
+
 static void
 _reliable_transport_writable (NiceAgent *agent, guint stream_id,
     guint component_id, GstNiceSink *sink)
@@ -214,6 +336,9 @@ _reliable_transport_writable (NiceAgent *agent, guint stream_id,
   GST_OBJECT_LOCK (sink);
   if (stream_id == sink->stream_id && component_id == sink->component_id) {
     g_cond_broadcast (&sink->writable_cond);
+#if GST_CHECK_VERSION (1,0,0)
+    gst_nice_sink_flush_queue_locked (sink);
+#endif
   }
   GST_OBJECT_UNLOCK (sink);
 }
@@ -244,6 +369,106 @@ fill_vectors (GOutputVector * vecs, GstMapInfo * maps, guint n, GstBuffer * buf)
   return size;
 }
 
+/* Tell upstream that the send queue overflowed and @buffer was dropped */
+static void
+gst_nice_sink_post_qos (GstNiceSink * sink, GstBuffer * buffer,
+    gdouble proportion, guint64 processed, guint64 dropped)
+{
+  GstBaseSink *basesink = GST_BASE_SINK (sink);
+  GstClockTime timestamp = GST_BUFFER_PTS (buffer);
+  GstClockTime running_time = GST_CLOCK_TIME_NONE;
+  GstClockTime stream_time = GST_CLOCK_TIME_NONE;
+  GstMessage *message;
+
+  if (GST_CLOCK_TIME_IS_VALID (timestamp)) {
+    GST_OBJECT_LOCK (sink);
+    running_time = gst_segment_to_running_time (&basesink->segment,
+        GST_FORMAT_TIME, timestamp);
+    stream_time = gst_segment_to_stream_time (&basesink->segment,
+        GST_FORMAT_TIME, timestamp);
+    GST_OBJECT_UNLOCK (sink);
+  }
+
+  GST_DEBUG_OBJECT (sink, "send queue full (%.2f), dropped %" G_GUINT64_FORMAT
+      " of %" G_GUINT64_FORMAT " buffers", proportion, dropped, processed);
+
+  if (GST_CLOCK_TIME_IS_VALID (running_time))
+    gst_pad_push_event (GST_BASE_SINK_PAD (sink),
+        gst_event_new_qos (GST_QOS_TYPE_OVERFLOW, proportion, 0,
+            running_time));
+
+  message = gst_message_new_qos (GST_OBJECT_CAST (sink), FALSE, running_time,
+      stream_time, timestamp, GST_BUFFER_DURATION (buffer));
+  gst_message_set_qos_values (message, 0, proportion, 1000000);
+  gst_message_set_qos_stats (message, GST_FORMAT_BUFFERS, processed, dropped);
+  gst_element_post_message (GST_ELEMENT_CAST (sink), message);
+}
+
+/* Non-blocking reliable mode: send directly while nothing is queued, then
+ * keep whatever the transport did not take mapped in the queue, to be
+ * flushed from the reliable-transport-writable signal, up to
+ * @max_queued_bytes, which is not 0. The mappings of queued buffers are
+ * taken over from @map_infos, the others are released. */
+static GstFlowReturn
+gst_nice_sink_queue_buffers (GstNiceSink * sink, GstBuffer ** buffers,
+    guint num_buffers, guint8 * mem_nums, NiceOutputMessage * msgs,
+    GstMapInfo * map_infos, guint max_queued_bytes)
+{
+  GstFlowReturn flow_ret = GST_FLOW_OK;
+  GstBuffer *dropped = NULL;
+  gdouble proportion;
+  guint64 n_rendered, n_dropped;
+  guint i, j, mem;
+  guint written = 0;
+  gint ret;
+
+  GST_OBJECT_LOCK (sink);
+  if (sink->flushing) {
+    flow_ret = GST_FLOW_FLUSHING;
+  } else if (g_queue_is_empty (&sink->queue)) {
+    ret = nice_agent_send_messages_nonblocking (sink->agent, sink->stream_id,
+        sink->component_id, msgs, num_buffers, NULL, NULL);
+    if (ret > 0)
+      written = ret;
+  }
+
+  for (i = 0, mem = 0; i < num_buffers; mem += mem_nums[i], ++i) {
+    gsize size = 0;
+
+    for (j = 0; j < mem_nums[i]; ++j)
+      size += msgs[i].buffers[j].size;
+
+    if (i < written || flow_ret != GST_FLOW_OK) {
+      /* sent, or flushing */
+    } else if (!g_queue_is_empty (&sink->queue) &&
+        sink->queued_bytes + size > max_queued_bytes) {
+      sink->n_dropped++;
+      gst_buffer_replace (&dropped, buffers[i]);
+    } else {
+      g_queue_push_tail (&sink->queue, queued_buffer_new (buffers[i],
+              &map_infos[mem], msgs[i].buffers, mem_nums[i], size));
+      sink->queued_bytes += size;
+      continue;
+    }
+
+    for (j = 0; j < mem_nums[i]; ++j)
+      gst_memory_unmap (map_infos[mem + j].memory, &map_infos[mem + j]);
+  }
+
+  sink->n_rendered += num_buffers;
+  n_rendered = sink->n_rendered;
+  n_dropped = sink->n_dropped;
+  proportion = (gdouble) sink->queued_bytes / max_queued_bytes;
+  GST_OBJECT_UNLOCK (sink);
+
+  if (dropped) {
+    gst_nice_sink_post_qos (sink, dropped, proportion, n_rendered, n_dropped);
+    gst_buffer_unref (dropped);
+  }
+
+  return flow_ret;
+}
+
 /* Buffer list code written by
  *   Tim-Philipp Müller <tim@centricular.com>
  * taken from
@@ -256,6 +481,7 @@ gst_nice_sink_render_buffers (GstNiceSink * sink, GstBuffer ** buffers,
   NiceOutputMessage *msgs;
   GOutputVector *vecs;
   GstMapInfo *map_infos;
+  guint max_queued_bytes;
   guint i, mem;
   guint written = 0;
   gint ret;
@@ -292,7 +518,20 @@ gst_nice_sink_render_buffers (GstNiceSink * sink, GstBuffer ** buffers,
     mem += mem_nums[i];
   }
 
+  /* Read once: the property may be changed from another thread */
   GST_OBJECT_LOCK (sink);
+  max_queued_bytes = sink->max_queued_bytes;
+  GST_OBJECT_UNLOCK (sink);
+
+  if (sink->reliable && max_queued_bytes > 0)
+    return gst_nice_sink_queue_buffers (sink, buffers, num_buffers, mem_nums,
+        msgs, map_infos, max_queued_bytes);
+
+  GST_OBJECT_LOCK (sink);
+  /* Buffers queued before max-queued-bytes was set to 0 go out first */
+  while (!g_queue_is_empty (&sink->queue) && !sink->flushing)
+    g_cond_wait (&sink->writable_cond, GST_OBJECT_GET_LOCK (sink));
+
   do {
     ret = nice_agent_send_messages_nonblocking(sink->agent, sink->stream_id,
         sink->component_id, msgs + written, num_buffers - written, NULL, NULL);
@@ -399,6 +638,26 @@ no_data:
 }
 #endif
 
+#if GST_CHECK_VERSION (1,0,0)
+static gboolean
+gst_nice_sink_event (GstBaseSink *basesink, GstEvent *event)
+{
+  GstNiceSink *nicesink = GST_NICE_SINK (basesink);
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_EOS) {
+    /* Only post EOS once the queued buffers are sent, the writable signal
+     * flushes the queue before waking us up */
+    GST_OBJECT_LOCK (nicesink);
+    while (!g_queue_is_empty (&nicesink->queue) && !nicesink->flushing)
+      g_cond_wait (&nicesink->writable_cond, GST_OBJECT_GET_LOCK (nicesink));
+    GST_OBJECT_UNLOCK (nicesink);
+  }
+
+  return GST_BASE_SINK_CLASS (gst_nice_sink_parent_class)->event (basesink,
+      event);
+}
+#endif
+
 static gboolean gst_nice_sink_unlock (GstBaseSink *basesink)
 {
   GstNiceSink *nicesink = GST_NICE_SINK (basesink);
@@ -406,6 +665,9 @@ static gboolean gst_nice_sink_unlock (GstBaseSink *basesink)
   GST_OBJECT_LOCK (nicesink);
   nicesink->flushing = TRUE;
   g_cond_broadcast (&nicesink->writable_cond);
+#if GST_CHECK_VERSION (1,0,0)
+  gst_nice_sink_clear_queue_locked (nicesink);
+#endif
   GST_OBJECT_UNLOCK (nicesink);
 
   return TRUE;
@@ -452,6 +714,10 @@ gst_nice_sink_finalize (GObject *object)
   g_free (sink->messages);
   sink->messages = NULL;
   sink->n_messages = 0;
+  gst_nice_sink_clear_queue_locked (sink);
+  g_free (sink->queue_messages);
+  sink->queue_messages = NULL;
+  sink->n_queue_messages = 0;
 
   G_OBJECT_CLASS (gst_nice_sink_parent_class)->finalize (object);
 }
@@ -500,6 +766,14 @@ gst_nice_sink_set_property (
       }
       break;
 
+#if GST_CHECK_VERSION (1,0,0)
+    case PROP_MAX_QUEUED_BYTES:
+      GST_OBJECT_LOCK (sink);
+      sink->max_queued_bytes = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (sink);
+      break;
+#endif
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -533,6 +807,14 @@ gst_nice_sink_get_property (
       GST_OBJECT_UNLOCK (sink);
       break;
 
+#if GST_CHECK_VERSION (1,0,0)
+    case PROP_MAX_QUEUED_BYTES:
+      GST_OBJECT_LOCK (sink);
+      g_value_set_uint (value, sink->max_queued_bytes);
+      GST_OBJECT_UNLOCK (sink);
+      break;
+#endif
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -78,6 +78,16 @@ struct _GstNiceSink
   guint n_maps;
   NiceOutputMessage *messages;
   guint n_messages;
+
+  /* non-blocking reliable mode: mapped buffers waiting for the transport to
+   * become writable, protected by the object lock */
+  guint max_queued_bytes;
+  GQueue queue;
+  gsize queued_bytes;
+  guint64 n_rendered;
+  guint64 n_dropped;
+  NiceOutputMessage *queue_messages;
+  guint n_queue_messages;
 #endif
 };
 
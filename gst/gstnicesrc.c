@@ -47,6 +47,7 @@ GST_DEBUG_CATEGORY_STATIC (nicesrc_debug);
 
 
 #define BUFFER_SIZE (65536)
+#define DEFAULT_MTU (1500)
 
 static GstFlowReturn
 gst_nice_src_create (
@@ -97,7 +98,8 @@ enum
 {
   PROP_AGENT = 1,
   PROP_STREAM,
-  PROP_COMPONENT
+  PROP_COMPONENT,
+  PROP_MTU
 };
 
 
@@ -166,6 +168,18 @@ gst_nice_src_class_init (GstNiceSrcClass *klass)
          G_MAXUINT,
          0,
          G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_MTU,
+      g_param_spec_uint (
+         "mtu",
+         "MTU",
+         "Maximum expected packet size. This is the size of the buffers "
+         "allocated from the receive buffer pool, bigger packets are still "
+         "received but need an extra memory block (non-reliable agents only)",
+         1280,
+         BUFFER_SIZE,
+         DEFAULT_MTU,
+         G_PARAM_READWRITE));
 }
 
 static void
@@ -177,11 +191,17 @@ gst_nice_src_init (GstNiceSrc *src)
   src->agent = NULL;
   src->stream_id = 0;
   src->component_id = 0;
+  src->mtu = DEFAULT_MTU;
+  src->reliable = FALSE;
   src->mainctx = g_main_context_new ();
   src->mainloop = g_main_loop_new (src->mainctx, FALSE);
   src->unlocked = FALSE;
   src->idle_source = NULL;
   src->outbufs = g_queue_new ();
+  src->cancellable = g_cancellable_new ();
+  src->pool = NULL;
+  memset (src->slot_bufs, 0, sizeof (src->slot_bufs));
+  memset (src->extra_bufs, 0, sizeof (src->extra_bufs));
 }
 
 static void
@@ -238,6 +258,7 @@ gst_nice_src_unlock (GstBaseSrc *src)
   GST_OBJECT_LOCK (src);
   nicesrc->unlocked = TRUE;
 
+  g_cancellable_cancel (nicesrc->cancellable);
   g_main_loop_quit (nicesrc->mainloop);
 
   if (!nicesrc->idle_source) {
@@ -258,6 +279,7 @@ gst_nice_src_unlock_stop (GstBaseSrc *src)
 
   GST_OBJECT_LOCK (src);
   nicesrc->unlocked = FALSE;
+  g_cancellable_reset (nicesrc->cancellable);
   if (nicesrc->idle_source) {
     g_source_destroy (nicesrc->idle_source);
     g_source_unref(nicesrc->idle_source);
@@ -268,18 +290,17 @@ gst_nice_src_unlock_stop (GstBaseSrc *src)
   return TRUE;
 }
 
+/* Reliable agents deliver a byte stream out of the pseudo-TCP socket, which
+ * only hands out data as it arrives through the I/O callback, so keep passing
+ * buffers over from the read callback's main loop in that case. */
 static GstFlowReturn
-gst_nice_src_create (
-  GstPushSrc *basesrc,
+gst_nice_src_create_reliable (
+  GstNiceSrc *nicesrc,
   GstBuffer **buffer)
 {
-  GstNiceSrc *nicesrc = GST_NICE_SRC (basesrc);
-
-  GST_LOG_OBJECT (nicesrc, "create called");
-
-  GST_OBJECT_LOCK (basesrc);
+  GST_OBJECT_LOCK (nicesrc);
   if (nicesrc->unlocked) {
-    GST_OBJECT_UNLOCK (basesrc);
+    GST_OBJECT_UNLOCK (nicesrc);
 #if GST_CHECK_VERSION (1,0,0)
     return GST_FLOW_FLUSHING;
 #else
@@ -287,13 +308,13 @@ gst_nice_src_create (
 #endif
   }
   if (g_queue_is_empty (nicesrc->outbufs)) {
-    GST_OBJECT_UNLOCK (basesrc);
+    GST_OBJECT_UNLOCK (nicesrc);
     g_main_loop_run (nicesrc->mainloop);
-    GST_OBJECT_LOCK (basesrc);
+    GST_OBJECT_LOCK (nicesrc);
   }
 
   *buffer = g_queue_pop_head (nicesrc->outbufs);
-  GST_OBJECT_UNLOCK (basesrc);
+  GST_OBJECT_UNLOCK (nicesrc);
 
   if (*buffer != NULL) {
     GST_LOG_OBJECT (nicesrc, "Got buffer, pushing");
@@ -306,7 +327,272 @@ gst_nice_src_create (
     return GST_FLOW_WRONG_STATE;
 #endif
   }
+}
+
+static GstClockTime
+gst_nice_src_get_running_time (GstNiceSrc *nicesrc)
+{
+  GstClock *clock;
+  GstClockTime running_time = GST_CLOCK_TIME_NONE;
+
+  clock = gst_element_get_clock (GST_ELEMENT (nicesrc));
+  if (clock) {
+    running_time = gst_clock_get_time (clock) -
+        gst_element_get_base_time (GST_ELEMENT (nicesrc));
+    gst_object_unref (clock);
+  }
 
+  return running_time;
+}
+
+/* Point receive slot @slot at a mapped pool buffer, unless it still has one
+ * from a previous call. Anything beyond the MTU spills into the slot's extra
+ * buffer. */
+static gboolean
+gst_nice_src_prepare_slot (
+  GstNiceSrc *nicesrc,
+  guint slot)
+{
+  GInputVector *vecs = nicesrc->slot_vecs[slot];
+  GstMapInfo *map = &nicesrc->slot_maps[slot];
+
+  if (nicesrc->slot_bufs[slot] != NULL)
+    return TRUE;
+
+  if (gst_buffer_pool_acquire_buffer (nicesrc->pool, &nicesrc->slot_bufs[slot],
+          NULL) != GST_FLOW_OK)
+    return FALSE;
+
+  if (!gst_buffer_map (nicesrc->slot_bufs[slot], map, GST_MAP_WRITE)) {
+    gst_buffer_unref (nicesrc->slot_bufs[slot]);
+    nicesrc->slot_bufs[slot] = NULL;
+    return FALSE;
+  }
+
+  if (nicesrc->extra_bufs[slot] == NULL)
+    nicesrc->extra_bufs[slot] = g_malloc (BUFFER_SIZE - nicesrc->mtu);
+
+  vecs[0].buffer = map->data;
+  vecs[0].size = map->size;
+  vecs[1].buffer = nicesrc->extra_bufs[slot];
+  vecs[1].size = BUFFER_SIZE - nicesrc->mtu;
+
+  nicesrc->messages[slot].buffers = vecs;
+  nicesrc->messages[slot].n_buffers = 2;
+  nicesrc->messages[slot].from = NULL;
+  nicesrc->messages[slot].length = 0;
+
+  return TRUE;
+}
+
+static void
+gst_nice_src_release_slots (GstNiceSrc *nicesrc)
+{
+  guint i;
+
+  for (i = 0; i < GST_NICE_SRC_MAX_MESSAGES; i++) {
+    if (nicesrc->slot_bufs[i] != NULL) {
+      gst_buffer_unmap (nicesrc->slot_bufs[i], &nicesrc->slot_maps[i]);
+      gst_buffer_unref (nicesrc->slot_bufs[i]);
+      nicesrc->slot_bufs[i] = NULL;
+    }
+  }
+}
+
+/* Take the packet received into slot @slot out of it, trimmed to its length.
+ * If the packet spilled past the MTU, the slot's extra buffer is handed over
+ * as a second memory block and a new one gets allocated for the next
+ * receive. */
+static GstBuffer *
+gst_nice_src_finish_slot (
+  GstNiceSrc *nicesrc,
+  guint slot)
+{
+  GstBuffer *buffer = nicesrc->slot_bufs[slot];
+  gsize length = nicesrc->messages[slot].length;
+
+  nicesrc->slot_bufs[slot] = NULL;
+  gst_buffer_unmap (buffer, &nicesrc->slot_maps[slot]);
+
+  if (length <= nicesrc->mtu) {
+    gst_buffer_resize (buffer, 0, length);
+  } else {
+    guint8 *extra = nicesrc->extra_bufs[slot];
+
+    nicesrc->extra_bufs[slot] = NULL;
+    gst_buffer_append_memory (buffer,
+        gst_memory_new_wrapped (0, extra, BUFFER_SIZE - nicesrc->mtu, 0,
+            length - nicesrc->mtu, extra, g_free));
+  }
+
+  return buffer;
+}
+
+/* Non-reliable agents are read straight into buffer pool memory: block until
+ * one packet arrives, then drain whatever else is already waiting on the
+ * sockets and push it all downstream as one buffer list. The slots left
+ * unused stay prepared for the next call, so only the buffers pushed
+ * downstream are replaced. */
+static GstFlowReturn
+gst_nice_src_create_unreliable (
+  GstNiceSrc *nicesrc,
+  GstBuffer **buffer)
+{
+  GstBuffer *bufs[GST_NICE_SRC_MAX_MESSAGES];
+  GstClockTime running_time;
+  GError *error = NULL;
+  guint n_prepared;
+  gint n_received;
+  guint i;
+
+  GST_OBJECT_LOCK (nicesrc);
+  if (nicesrc->unlocked) {
+    GST_OBJECT_UNLOCK (nicesrc);
+    return GST_FLOW_FLUSHING;
+  }
+
+  /* Left over from the previous batch if buffer lists are not available */
+  *buffer = g_queue_pop_head (nicesrc->outbufs);
+  GST_OBJECT_UNLOCK (nicesrc);
+
+  if (*buffer != NULL)
+    return GST_FLOW_OK;
+
+  if (!gst_nice_src_prepare_slot (nicesrc, 0)) {
+    GST_ELEMENT_ERROR (nicesrc, RESOURCE, NO_SPACE_LEFT, (NULL),
+        ("Could not acquire a buffer from the pool"));
+    return GST_FLOW_ERROR;
+  }
+
+  n_received = nice_agent_recv_messages (nicesrc->agent, nicesrc->stream_id,
+      nicesrc->component_id, nicesrc->messages, 1, nicesrc->cancellable,
+      &error);
+
+  if (n_received <= 0) {
+    if (error == NULL ||
+        g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+      GST_LOG_OBJECT (nicesrc, "Got interrupting, returning flushing");
+      g_clear_error (&error);
+      return GST_FLOW_FLUSHING;
+    }
+
+    GST_ELEMENT_ERROR (nicesrc, RESOURCE, READ, (NULL),
+        ("Could not receive from the agent: %s", error->message));
+    g_error_free (error);
+    return GST_FLOW_ERROR;
+  }
+
+  running_time = gst_nice_src_get_running_time (nicesrc);
+
+  /* Only the slots used by the previous batch need a new buffer */
+  for (n_prepared = 1; n_prepared < GST_NICE_SRC_MAX_MESSAGES; n_prepared++) {
+    if (!gst_nice_src_prepare_slot (nicesrc, n_prepared))
+      break;
+  }
+
+  if (n_prepared > 1) {
+    gint n_more;
+
+    n_more = nice_agent_recv_messages_nonblocking (nicesrc->agent,
+        nicesrc->stream_id, nicesrc->component_id, &nicesrc->messages[1],
+        n_prepared - 1, NULL, &error);
+
+    if (n_more > 0) {
+      n_received += n_more;
+    } else if (error != NULL &&
+        !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+      GST_DEBUG_OBJECT (nicesrc, "Could not drain the agent: %s",
+          error->message);
+    }
+    g_clear_error (&error);
+  }
+
+  for (i = 0; i < (guint) n_received; i++) {
+    bufs[i] = gst_nice_src_finish_slot (nicesrc, i);
+    GST_BUFFER_PTS (bufs[i]) = running_time;
+    GST_BUFFER_DTS (bufs[i]) = running_time;
+  }
+
+  GST_LOG_OBJECT (nicesrc, "Got %d buffers in one wakeup, pushing",
+      n_received);
+
+  if (n_received == 1) {
+    *buffer = bufs[0];
+    return GST_FLOW_OK;
+  }
+
+#if GST_CHECK_VERSION (1,14,0)
+  {
+    GstBufferList *list = gst_buffer_list_new_sized (n_received);
+
+    for (i = 0; i < (guint) n_received; i++)
+      gst_buffer_list_add (list, bufs[i]);
+
+    gst_base_src_submit_buffer_list (GST_BASE_SRC (nicesrc), list);
+    *buffer = NULL;
+  }
+#else
+  GST_OBJECT_LOCK (nicesrc);
+  for (i = 1; i < (guint) n_received; i++)
+    g_queue_push_tail (nicesrc->outbufs, bufs[i]);
+  GST_OBJECT_UNLOCK (nicesrc);
+  *buffer = bufs[0];
+#endif
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+gst_nice_src_create (
+  GstPushSrc *basesrc,
+  GstBuffer **buffer)
+{
+  GstNiceSrc *nicesrc = GST_NICE_SRC (basesrc);
+
+  GST_LOG_OBJECT (nicesrc, "create called");
+
+  if (nicesrc->reliable)
+    return gst_nice_src_create_reliable (nicesrc, buffer);
+  else
+    return gst_nice_src_create_unreliable (nicesrc, buffer);
+}
+
+static gboolean
+gst_nice_src_start_pool (GstNiceSrc *src)
+{
+  GstStructure *config;
+
+  src->pool = gst_buffer_pool_new ();
+  config = gst_buffer_pool_get_config (src->pool);
+  gst_buffer_pool_config_set_params (config, NULL, src->mtu, 0, 0);
+
+  if (!gst_buffer_pool_set_config (src->pool, config) ||
+      !gst_buffer_pool_set_active (src->pool, TRUE)) {
+    gst_object_unref (src->pool);
+    src->pool = NULL;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void
+gst_nice_src_stop_pool (GstNiceSrc *src)
+{
+  guint i;
+
+  gst_nice_src_release_slots (src);
+
+  if (src->pool) {
+    gst_buffer_pool_set_active (src->pool, FALSE);
+    gst_object_unref (src->pool);
+    src->pool = NULL;
+  }
+
+  for (i = 0; i < GST_NICE_SRC_MAX_MESSAGES; i++) {
+    g_free (src->extra_bufs[i]);
+    src->extra_bufs[i] = NULL;
+  }
 }
 
 static void
@@ -337,6 +623,12 @@ gst_nice_src_dispose (GObject *object)
   }
   src->idle_source = NULL;
 
+  gst_nice_src_stop_pool (src);
+
+  if (src->cancellable)
+    g_object_unref (src->cancellable);
+  src->cancellable = NULL;
+
   G_OBJECT_CLASS (gst_nice_src_parent_class)->dispose (object);
 }
 
@@ -367,6 +659,10 @@ gst_nice_src_set_property (
       src->component_id = g_value_get_uint (value);
       break;
 
+    case PROP_MTU:
+      src->mtu = g_value_get_uint (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -396,6 +692,10 @@ gst_nice_src_get_property (
       g_value_set_uint (value, src->component_id);
       break;
 
+    case PROP_MTU:
+      g_value_set_uint (value, src->mtu);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -440,6 +740,12 @@ gst_nice_src_change_state (GstElement * element, GstStateChange transition)
       GST_OBJECT_UNLOCK (src);
       break;
     case GST_STATE_CHANGE_READY_TO_PAUSED:
+      g_object_get (src->agent, "reliable", &src->reliable, NULL);
+      if (!src->reliable && !gst_nice_src_start_pool (src)) {
+        GST_ERROR_OBJECT (element, "Could not activate the buffer pool");
+        return GST_STATE_CHANGE_FAILURE;
+      }
+      break;
     case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
     case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
     case GST_STATE_CHANGE_READY_TO_NULL:
@@ -452,13 +758,21 @@ gst_nice_src_change_state (GstElement * element, GstStateChange transition)
 
   switch (transition) {
     case GST_STATE_CHANGE_READY_TO_PAUSED:
-      nice_agent_attach_recv (src->agent, src->stream_id, src->component_id,
-          src->mainctx, gst_nice_src_read_callback, (gpointer) src);
+      /* Without a callback the component's sockets are still moved to our
+       * context, which nice_agent_recv_messages() then iterates */
+      if (src->reliable)
+        nice_agent_attach_recv (src->agent, src->stream_id, src->component_id,
+            src->mainctx, gst_nice_src_read_callback, (gpointer) src);
+      else
+        nice_agent_attach_recv (src->agent, src->stream_id, src->component_id,
+            src->mainctx, NULL, NULL);
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      gst_nice_src_stop_pool (src);
       break;
     case GST_STATE_CHANGE_NULL_TO_READY:
     case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
     case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
-    case GST_STATE_CHANGE_PAUSED_TO_READY:
     case GST_STATE_CHANGE_READY_TO_NULL:
     default:
       break;
@@ -56,6 +56,9 @@ G_BEGIN_DECLS
 #define GST_IS_NICE_SRC_CLASS(klass) \
   (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_NICE_SRC))
 
+/* Maximum number of packets drained from the agent per create() call */
+#define GST_NICE_SRC_MAX_MESSAGES (32)
+
 typedef struct _GstNiceSrc GstNiceSrc;
 
 struct _GstNiceSrc
@@ -65,11 +68,25 @@ struct _GstNiceSrc
   NiceAgent *agent;
   guint stream_id;
   guint component_id;
+  guint mtu;
+  gboolean reliable;
   GMainContext *mainctx;
   GMainLoop *mainloop;
   GQueue *outbufs;
   gboolean unlocked;
   GSource *idle_source;
+
+  /* non-reliable mode: packets are received straight into pool memory */
+  GCancellable *cancellable;
+  GstBufferPool *pool;
+  /* receive slots, kept prepared across create() calls until a packet is
+   * received into them: a mapped pool buffer, and spill space for packets
+   * bigger than the MTU */
+  GstBuffer *slot_bufs[GST_NICE_SRC_MAX_MESSAGES];
+  GstMapInfo slot_maps[GST_NICE_SRC_MAX_MESSAGES];
+  GInputVector slot_vecs[GST_NICE_SRC_MAX_MESSAGES][2];
+  NiceInputMessage messages[GST_NICE_SRC_MAX_MESSAGES];
+  guint8 *extra_bufs[GST_NICE_SRC_MAX_MESSAGES];
 };
 
 typedef struct _GstNiceSrcClass GstNiceSrcClass;
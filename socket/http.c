@@ -96,6 +96,8 @@ static gboolean socket_can_send (NiceSocket *sock, NiceAddress *addr);
 static void socket_set_writable_callback (NiceSocket *sock,
     NiceSocketWritableCb callback, gpointer user_data);
 static gboolean socket_is_based_on (NiceSocket *sock, NiceSocket *other);
+static NiceSocket *socket_get_passthrough (NiceSocket *sock,
+    NiceAddress *from);
 
 NiceSocket *
 nice_http_socket_new (NiceSocket *base_socket,
@@ -128,6 +130,7 @@ nice_http_socket_new (NiceSocket *base_socket,
     sock->can_send = socket_can_send;
     sock->set_writable_callback = socket_set_writable_callback;
     sock->is_based_on = socket_is_based_on;
+    sock->get_passthrough = socket_get_passthrough;
     sock->close = socket_close;
 
     /* Send HTTP CONNECT */
@@ -245,10 +248,10 @@ memcpy_ring_buffer_to_buffer (HttpPriv *priv,
   return consumed;
 }
 
-/* Returns the number of messages touched. Silently drops any data from @buffer
- * which doesn’t fit in @messages. Updates the ring buffer to pop the copied
- * data off it. Treats all #GInputVectors in @messages the same; there is no
- * differentiation between different #NiceInputMessages. */
+/* Returns the number of messages touched. Data which doesn’t fit in @messages
+ * stays in the ring buffer for the next call. Updates the ring buffer to pop
+ * the copied data off it. Treats all #GInputVectors in @messages the same;
+ * there is no differentiation between different #NiceInputMessages. */
 static gint
 memcpy_ring_buffer_to_input_messages (HttpPriv *priv,
     NiceInputMessage *messages, guint n_messages)
@@ -258,24 +261,30 @@ memcpy_ring_buffer_to_input_messages (HttpPriv *priv,
   for (i = 0; priv->recv_buf_fill > 0 && i < n_messages; i++) {
     NiceInputMessage *message = &messages[i];
 
+    message->length = 0;
+
     for (j = 0;
          priv->recv_buf_fill > 0 &&
          ((message->n_buffers >= 0 && j < (guint) message->n_buffers) ||
           (message->n_buffers < 0 && message->buffers[j].buffer != NULL));
          j++) {
-      message->buffers[j].size =
+      message->length +=
           memcpy_ring_buffer_to_buffer (priv,
               message->buffers[j].buffer, message->buffers[j].size);
     }
+
+    if (message->from != NULL)
+      *message->from = priv->addr;
   }
 
   return i;
 }
 
-/* FIXME: The current implementation of socket_recv_message() is a fast
- * pass-through to nice_socket_recv_message() if the HTTP socket is connected,
- * but is a slow state machine otherwise, using multiple memcpy()s. Spruce it up
- * to better to use the recv_messages to avoid the memcpy()s. */
+/* socket_recv_message() is a fast pass-through to nice_socket_recv_message()
+ * once the HTTP socket is connected and the bytes which arrived behind the
+ * response headers are drained, but is a slow state machine otherwise, using
+ * multiple memcpy()s. Once in the fast path, socket_get_passthrough() lets the
+ * layer above skip this socket altogether. */
 static gint
 socket_recv_messages (NiceSocket *sock,
     NiceInputMessage *recv_messages, guint n_recv_messages)
@@ -286,7 +295,10 @@ socket_recv_messages (NiceSocket *sock,
   /* Make sure socket has not been freed: */
   g_assert (sock->priv != NULL);
 
-  if (priv->state == HTTP_STATE_CONNECTED) {
+  if (priv->state == HTTP_STATE_CONNECTED && priv->recv_buf_fill > 0) {
+    /* Hand out what arrived behind the headers first */
+    goto retry;
+  } else if (priv->state == HTTP_STATE_CONNECTED) {
     guint i;
 
     /* Fast path: pass through to the base socket once we’re connected. */
@@ -545,6 +557,14 @@ retry:
         len = memcpy_ring_buffer_to_input_messages (priv,
             recv_messages, n_recv_messages);
 
+        /* The ring buffer is only needed for the headers */
+        if (priv->recv_buf_fill == 0) {
+          g_free (priv->recv_buf);
+          priv->recv_buf = NULL;
+          priv->recv_buf_length = 0;
+          priv->recv_buf_pos = 0;
+        }
+
         /* Send the pending data */
         nice_socket_flush_send_queue (priv->base_socket,
             &priv->send_queue);
@@ -651,3 +671,17 @@ socket_is_based_on (NiceSocket *sock, NiceSocket *other)
   return (sock == other) ||
       (priv && nice_socket_is_based_on (priv->base_socket, other));
 }
+
+static NiceSocket *
+socket_get_passthrough (NiceSocket *sock, NiceAddress *from)
+{
+  HttpPriv *priv = sock->priv;
+
+  if (priv->state != HTTP_STATE_CONNECTED || priv->recv_buf_fill > 0 ||
+      !g_queue_is_empty (&priv->send_queue))
+    return NULL;
+
+  *from = priv->addr;
+
+  return priv->base_socket;
+}
@@ -117,6 +117,8 @@ static gboolean socket_can_send (NiceSocket *sock, NiceAddress *addr);
 static void socket_set_writable_callback (NiceSocket *sock,
     NiceSocketWritableCb callback, gpointer user_data);
 static gboolean socket_is_based_on (NiceSocket *sock, NiceSocket *other);
+static NiceSocket *socket_get_passthrough (NiceSocket *sock,
+    NiceAddress *from);
 
 NiceSocket *
 nice_pseudossl_socket_new (NiceSocket *base_socket,
@@ -154,6 +156,7 @@ nice_pseudossl_socket_new (NiceSocket *base_socket,
   sock->can_send = socket_can_send;
   sock->set_writable_callback = socket_set_writable_callback;
   sock->is_based_on = socket_is_based_on;
+  sock->get_passthrough = socket_get_passthrough;
   sock->close = socket_close;
 
   /* We send 'to' NULL because it will always be to an already connected
@@ -328,3 +331,15 @@ socket_is_based_on (NiceSocket *sock, NiceSocket *other)
   return (sock == other) ||
       (priv && nice_socket_is_based_on (priv->base_socket, other));
 }
+
+static NiceSocket *
+socket_get_passthrough (NiceSocket *sock, NiceAddress *from)
+{
+  PseudoSSLPriv *priv = sock->priv;
+
+  /* The send queue was flushed when the handshake completed */
+  if (!priv->handshaken)
+    return NULL;
+
+  return priv->base_socket;
+}
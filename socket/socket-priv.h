@@ -53,30 +53,6 @@ G_BEGIN_DECLS
 void nice_socket_queue_send (GQueue *send_queue, const NiceAddress *to,
     const NiceOutputMessage *messages, guint n_messages);
 
-/**
- * nice_socket_queue_send_with_callback:
- * @send_queue: The queue to add to
- * @message: The message to queue
- * @message_offset: Number of bytes to skip in the message
- * @message_len: Total length of the message
- * @head: Whether to add the message to the head of the queue or the tail
- * @gsock: The #GSocket to create the callback on
- * @io_source: Pointer to #GSource pointer to store the created source
- * @context: #GMainContext to attach the @io_source to
- * @cb: Callback function to call when the @gsock is writable
- * @user_data: User data for @cb
- *
- * Queue (partial) message to be sent later and create a source to call @cb
- * when the @gsock becomes writable.
- * The @message_offset can be used if a partial write happened and some bytes
- * were already written, in which case @head should be set to TRUE to add the
- * message to the head of the queue.
- */
-void nice_socket_queue_send_with_callback (GQueue *send_queue,
-    const NiceOutputMessage *message, gsize message_offset, gsize message_len,
-    gboolean head, GSocket *gsock, GSource **io_source, GMainContext *context,
-    GSocketSourceFunc cb, gpointer user_data);
-
 /**
  * nice_socket_flush_send_queue:
  * @base_socket: Base socket to send on
@@ -89,29 +65,74 @@ void nice_socket_queue_send_with_callback (GQueue *send_queue,
 void nice_socket_flush_send_queue (NiceSocket *base_socket, GQueue *send_queue);
 
 /**
- * nice_socket_flush_send_queue_to_socket:
- * @gsock: GSocket to send on
- * @send_queue: Queue to flush
+ * nice_socket_free_send_queue:
+ * @send_queue: The send queue
  *
- * Send all the queued messages to the socket. If any message fails to be sent
- * it will be readded to the queue and #FALSE will be returned, in which case
- * the IO source must be kept to allow flushing the next time the socket
- * is writable.
- * If the queue gets flushed, #TRUE will be returned, in which case, the IO
- * source should be destroyed.
+ * Frees every item in the send queue without sending them and empties the queue
+ */
+void nice_socket_free_send_queue (GQueue *send_queue);
+
+/**
+ * NiceSocketSendRing:
+ * @buf: Storage of the queued bytes
+ * @size: Allocated size of @buf
+ * @head: Offset of the first queued byte in @buf
+ * @length: Number of queued bytes, possibly wrapping around the end of @buf
  *
- * Returns: #TRUE if the queue was emptied, #FALSE if the socket would block.
+ * Contiguous queue of the bytes a stream socket could not send yet, so they
+ * can be flushed with a single sendmsg() and partial writes only move @head.
  */
-gboolean nice_socket_flush_send_queue_to_socket (GSocket *gsock,
-    GQueue *send_queue);
+typedef struct {
+  guint8 *buf;
+  gsize size;
+  gsize head;
+  gsize length;
+} NiceSocketSendRing;
 
 /**
- * nice_socket_free_send_queue:
- * @send_queue: The send queue
+ * nice_socket_send_ring_init:
+ * @ring: The send ring
  *
- * Frees every item in the send queue without sending them and empties the queue
+ * Initialises an empty send ring. No memory is allocated until bytes are
+ * queued.
  */
-void nice_socket_free_send_queue (GQueue *send_queue);
+void nice_socket_send_ring_init (NiceSocketSendRing *ring);
+
+/**
+ * nice_socket_send_ring_clear:
+ * @ring: The send ring
+ *
+ * Drops the queued bytes without sending them and frees the ring's storage
+ */
+void nice_socket_send_ring_clear (NiceSocketSendRing *ring);
+
+/**
+ * nice_socket_send_ring_push:
+ * @ring: The send ring
+ * @message: The message to queue
+ * @message_offset: Number of bytes of @message already sent
+ * @message_len: Total length of the message
+ *
+ * Appends the bytes of @message after @message_offset to the ring, growing
+ * it if needed.
+ */
+void nice_socket_send_ring_push (NiceSocketSendRing *ring,
+    const NiceOutputMessage *message, gsize message_offset, gsize message_len);
+
+/**
+ * nice_socket_send_ring_flush:
+ * @ring: The send ring
+ * @gsock: GSocket to send on
+ *
+ * Sends as much of the queued bytes as the socket accepts, in one system call
+ * per attempt. If the socket fails with an error other than
+ * %G_IO_ERROR_WOULD_BLOCK, the queued bytes are dropped.
+ *
+ * Returns: #TRUE if the ring was emptied, #FALSE if the socket would block,
+ * in which case the caller must flush again once @gsock is writable.
+ */
+gboolean nice_socket_send_ring_flush (NiceSocketSendRing *ring,
+    GSocket *gsock);
 
 G_END_DECLS
 
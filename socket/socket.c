@@ -153,6 +153,56 @@ nice_socket_send_messages (NiceSocket *sock, const NiceAddress *to,
   return sock->send_messages (sock, to, messages, n_messages);
 }
 
+/**
+ * nice_socket_send_messages_to:
+ * @sock: a #NiceSocket
+ * @to: (array length=n_messages): the destination of each message
+ * @messages: (array length=n_messages) (in caller-allocates):
+ * array of #NiceOutputMessages containing the messages to send
+ * @n_messages: number of elements in the @messages and @to arrays
+ *
+ * Like nice_socket_send_messages(), but each message is sent to its own
+ * address in @to. Sockets which can do so transmit all the messages with a
+ * single system call; otherwise, each run of messages to the same address is
+ * passed to nice_socket_send_messages() at once.
+ *
+ * Returns: number of messages successfully sent from @messages, or a negative
+ * value on error
+ *
+ * Since: 0.1.19
+ */
+gint
+nice_socket_send_messages_to (NiceSocket *sock, const NiceAddress * const *to,
+    const NiceOutputMessage *messages, guint n_messages)
+{
+  guint i = 0;
+
+  g_return_val_if_fail (sock != NULL, -1);
+  g_return_val_if_fail (n_messages == 0 || messages != NULL, -1);
+  g_return_val_if_fail (n_messages == 0 || to != NULL, -1);
+
+  if (sock->send_messages_to)
+    return sock->send_messages_to (sock, to, messages, n_messages);
+
+  while (i < n_messages) {
+    guint n_run = 1;
+    gint ret;
+
+    while (i + n_run < n_messages && nice_address_equal (to[i], to[i + n_run]))
+      n_run++;
+
+    ret = sock->send_messages (sock, to[i], &messages[i], n_run);
+    if (ret < 0)
+      return (i > 0) ? (gint) i : ret;
+
+    i += ret;
+    if ((guint) ret < n_run)
+      break;
+  }
+
+  return i;
+}
+
 /**
  * nice_socket_send_messages_reliable:
  * @sock: a #NiceSocket
@@ -273,6 +323,45 @@ nice_socket_is_based_on (NiceSocket *sock, NiceSocket *other)
   return (sock == other);
 }
 
+GSource *
+nice_socket_create_source (NiceSocket *sock)
+{
+  if (sock->create_source)
+    return sock->create_source (sock);
+  return g_socket_create_source (sock->fileno, G_IO_IN, NULL);
+}
+
+guint
+nice_socket_get_kernel_drops (NiceSocket *sock)
+{
+  if (sock->get_kernel_drops)
+    return sock->get_kernel_drops (sock);
+  return 0;
+}
+
+NiceSocket *
+nice_socket_get_passthrough (NiceSocket *sock, NiceAddress *from)
+{
+  nice_address_init (from);
+
+  while (sock->get_passthrough) {
+    NiceAddress layer_from;
+    NiceSocket *base;
+
+    nice_address_init (&layer_from);
+    base = sock->get_passthrough (sock, &layer_from);
+    if (base == NULL)
+      break;
+
+    /* The outermost rewrite is the one the layered path would report */
+    if (!nice_address_is_valid (from))
+      *from = layer_from;
+    sock = base;
+  }
+
+  return sock;
+}
+
 void
 nice_socket_free (NiceSocket *sock)
 {
@@ -337,33 +426,100 @@ nice_socket_queue_send (GQueue *send_queue, const NiceAddress *to,
   }
 }
 
-void nice_socket_queue_send_with_callback (GQueue *send_queue,
-    const NiceOutputMessage *message, gsize message_offset, gsize message_len,
-    gboolean head, GSocket *gsock, GSource **io_source, GMainContext *context,
-    GSocketSourceFunc cb, gpointer user_data)
+void nice_socket_flush_send_queue (NiceSocket *base_socket, GQueue *send_queue)
 {
   NiceSocketQueuedSend *tbs;
+
+  while ((tbs = g_queue_pop_head (send_queue))) {
+    NiceAddress *to = &tbs->to;
+
+    if (!nice_address_is_valid (to))
+      to = NULL;
+
+    /* We only queue reliable data */
+    nice_socket_send_reliable (base_socket, to,
+        tbs->length, (const gchar *) tbs->buf);
+    nice_socket_free_queued_send (tbs);
+  }
+}
+
+void
+nice_socket_free_send_queue (GQueue *send_queue)
+{
+  g_list_free_full (send_queue->head, (GDestroyNotify) nice_socket_free_queued_send);
+  g_queue_init (send_queue);
+}
+
+/* Smallest buffer allocated for a send ring */
+#define SEND_RING_MIN_SIZE 4096
+/* Buffers grown beyond this by a burst of reliable data are freed once
+ * drained */
+#define SEND_RING_MAX_IDLE_SIZE (256 * 1024)
+
+void
+nice_socket_send_ring_init (NiceSocketSendRing *ring)
+{
+  ring->buf = NULL;
+  ring->size = 0;
+  ring->head = 0;
+  ring->length = 0;
+}
+
+void
+nice_socket_send_ring_clear (NiceSocketSendRing *ring)
+{
+  g_free (ring->buf);
+  nice_socket_send_ring_init (ring);
+}
+
+/* Makes room for @needed more bytes, unwrapping the queued data to the start
+ * of the new buffer */
+static void
+send_ring_reserve (NiceSocketSendRing *ring, gsize needed)
+{
+  guint8 *buf;
+  gsize size, first;
+
+  if (ring->size - ring->length >= needed)
+    return;
+
+  size = MAX (ring->size, SEND_RING_MIN_SIZE);
+  while (size - ring->length < needed)
+    size *= 2;
+
+  buf = g_malloc (size);
+  first = MIN (ring->length, ring->size - ring->head);
+  if (first > 0)
+    memcpy (buf, ring->buf + ring->head, first);
+  if (ring->length > first)
+    memcpy (buf + first, ring->buf, ring->length - first);
+
+  g_free (ring->buf);
+  ring->buf = buf;
+  ring->size = size;
+  ring->head = 0;
+}
+
+void
+nice_socket_send_ring_push (NiceSocketSendRing *ring,
+    const NiceOutputMessage *message, gsize message_offset, gsize message_len)
+{
+  gsize tail, remaining;
   guint j;
-  gsize offset = 0;
 
   if (message_offset >= message_len)
     return;
 
-  tbs = g_slice_new0 (NiceSocketQueuedSend);
-  tbs->length = message_len - message_offset;
-  tbs->buf = g_malloc (tbs->length);
-
-  if (head)
-    g_queue_push_head (send_queue, tbs);
-  else
-    g_queue_push_tail (send_queue, tbs);
+  remaining = message_len - message_offset;
+  send_ring_reserve (ring, remaining);
+  tail = (ring->head + ring->length) % ring->size;
 
-  /* Move the data into the buffer. */
   for (j = 0;
        (message->n_buffers >= 0 && j < (guint) message->n_buffers) ||
        (message->n_buffers < 0 && message->buffers[j].buffer != NULL);
        j++) {
     const GOutputVector *buffer = &message->buffers[j];
+    const guint8 *data;
     gsize len;
 
     /* Skip this buffer if it’s within @message_offset. */
@@ -372,84 +528,74 @@ void nice_socket_queue_send_with_callback (GQueue *send_queue,
       continue;
     }
 
-    len = MIN (tbs->length - offset, buffer->size - message_offset);
-    memcpy (tbs->buf + offset, (guint8 *) buffer->buffer + message_offset, len);
-    offset += len;
-    if (message_offset >= len)
-      message_offset -= len;
-    else
-      message_offset = 0;
-  }
-
-  if (io_source && gsock && context && cb && *io_source == NULL) {
-    *io_source = g_socket_create_source(gsock, G_IO_OUT, NULL);
-    g_source_set_callback (*io_source, (GSourceFunc) G_CALLBACK (cb), user_data, NULL);
-    g_source_attach (*io_source, context);
-  }
-}
+    data = (const guint8 *) buffer->buffer + message_offset;
+    len = MIN (buffer->size - message_offset, remaining);
+    remaining -= len;
+    message_offset = 0;
 
-void nice_socket_flush_send_queue (NiceSocket *base_socket, GQueue *send_queue)
-{
-  NiceSocketQueuedSend *tbs;
+    while (len > 0) {
+      gsize chunk = MIN (len, ring->size - tail);
 
-  while ((tbs = g_queue_pop_head (send_queue))) {
-    NiceAddress *to = &tbs->to;
-
-    if (!nice_address_is_valid (to))
-      to = NULL;
+      memcpy (ring->buf + tail, data, chunk);
+      ring->length += chunk;
+      tail = (tail + chunk) % ring->size;
+      data += chunk;
+      len -= chunk;
+    }
 
-    /* We only queue reliable data */
-    nice_socket_send_reliable (base_socket, to,
-        tbs->length, (const gchar *) tbs->buf);
-    nice_socket_free_queued_send (tbs);
+    if (remaining == 0)
+      break;
   }
 }
 
-gboolean nice_socket_flush_send_queue_to_socket (GSocket *gsock,
-    GQueue *send_queue)
+gboolean
+nice_socket_send_ring_flush (NiceSocketSendRing *ring, GSocket *gsock)
 {
-  NiceSocketQueuedSend *tbs;
-  GError *gerr = NULL;
-
-
-  while ((tbs = g_queue_pop_head (send_queue)) != NULL) {
-    int ret;
+  while (ring->length > 0) {
+    GOutputVector bufs[2];
+    guint n_bufs = 1;
+    GError *gerr = NULL;
+    gssize ret;
+
+    /* The queued bytes are contiguous or wrap around once, so a single
+     * sendmsg() covers all of them */
+    bufs[0].buffer = ring->buf + ring->head;
+    bufs[0].size = MIN (ring->length, ring->size - ring->head);
+    if (bufs[0].size < ring->length) {
+      bufs[1].buffer = ring->buf;
+      bufs[1].size = ring->length - bufs[0].size;
+      n_bufs = 2;
+    }
 
-    GOutputVector local_bufs = { tbs->buf, tbs->length };
-    ret = g_socket_send_message (gsock, NULL, &local_bufs, 1, NULL, 0,
+    ret = g_socket_send_message (gsock, NULL, bufs, n_bufs, NULL, 0,
         G_SOCKET_MSG_NONE, NULL, &gerr);
 
     if (ret < 0) {
       if (g_error_matches (gerr, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
-        GOutputVector local_buf = { tbs->buf, tbs->length };
-        NiceOutputMessage local_message = {&local_buf, 1};
-
-        nice_socket_queue_send_with_callback (send_queue, &local_message,
-            0, local_buf.size, TRUE, NULL, NULL, NULL, NULL, NULL);
-        nice_socket_free_queued_send (tbs);
         g_error_free (gerr);
         return FALSE;
       }
-      g_clear_error (&gerr);
-    } else if (ret < (int) tbs->length) {
-      GOutputVector local_buf = { tbs->buf + ret, tbs->length - ret };
-      NiceOutputMessage local_message = {&local_buf, 1};
-
-      nice_socket_queue_send_with_callback (send_queue, &local_message,
-          0, local_buf.size, TRUE, NULL, NULL, NULL, NULL, NULL);
-      nice_socket_free_queued_send (tbs);
-      return FALSE;
+
+      /* The stream is broken, nothing queued can be delivered any more */
+      nice_debug ("Dropping %" G_GSIZE_FORMAT " queued bytes: %s",
+          ring->length, gerr->message);
+      g_error_free (gerr);
+      ring->head = 0;
+      ring->length = 0;
+      return TRUE;
     }
 
-    nice_socket_free_queued_send (tbs);
+    ring->head = (ring->head + ret) % ring->size;
+    ring->length -= ret;
+
+    /* The kernel buffer is full, wait until it is writable again */
+    if (ring->length > 0)
+      return FALSE;
   }
 
-  return TRUE;
-}
+  if (ring->size > SEND_RING_MAX_IDLE_SIZE)
+    nice_socket_send_ring_clear (ring);
+  ring->head = 0;
 
-void
-nice_socket_free_send_queue (GQueue *send_queue)
-{
-  g_list_free_full (send_queue->head, (GDestroyNotify) nice_socket_free_queued_send);
-  g_queue_init (send_queue);
+  return TRUE;
 }
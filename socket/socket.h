@@ -65,7 +65,8 @@ typedef enum {
   NICE_SOCKET_TYPE_UDP_TURN_OVER_TCP,
   NICE_SOCKET_TYPE_TCP_ACTIVE,
   NICE_SOCKET_TYPE_TCP_PASSIVE,
-  NICE_SOCKET_TYPE_TCP_SO
+  NICE_SOCKET_TYPE_TCP_SO,
+  NICE_SOCKET_TYPE_TLS
 } NiceSocketType;
 
 typedef void (*NiceSocketWritableCb) (NiceSocket *sock, gpointer user_data);
@@ -84,12 +85,28 @@ struct _NiceSocket
       const NiceOutputMessage *messages, guint n_messages);
   gint (*send_messages_reliable) (NiceSocket *sock, const NiceAddress *to,
       const NiceOutputMessage *messages, guint n_messages);
+  /* Optional; as send_messages, with one destination per message. */
+  gint (*send_messages_to) (NiceSocket *sock, const NiceAddress * const *to,
+      const NiceOutputMessage *messages, guint n_messages);
   gboolean (*is_reliable) (NiceSocket *sock);
   gboolean (*can_send) (NiceSocket *sock, NiceAddress *addr);
   void (*set_writable_callback) (NiceSocket *sock,
       NiceSocketWritableCb callback, gpointer user_data);
   gboolean (*is_based_on) (NiceSocket *sock, NiceSocket *other);
   void (*close) (NiceSocket *sock);
+  /* Optional; for sockets whose incoming data is not signalled by @fileno
+   * becoming readable. The source must invoke a #GSocketSourceFunc with
+   * @fileno. */
+  GSource *(*create_source) (NiceSocket *sock);
+  /* Optional; number of incoming datagrams the kernel dropped for lack of
+   * room in the socket’s receive buffer, or the socket dropped for lack of
+   * room in its own buffers. May be called from any thread. */
+  guint (*get_kernel_drops) (NiceSocket *sock);
+  /* Optional; for layers which only add a handshake, like proxies. Once it is
+   * done and nothing is buffered in @sock any more, returns the base socket
+   * that its I/O can go straight to, and sets @from if @sock reports another
+   * source address than the base socket; otherwise returns %NULL. */
+  NiceSocket *(*get_passthrough) (NiceSocket *sock, NiceAddress *from);
   void *priv;
 };
 
@@ -103,6 +120,9 @@ gint
 nice_socket_send_messages (NiceSocket *sock, const NiceAddress *addr,
     const NiceOutputMessage *messages, guint n_messages);
 gint
+nice_socket_send_messages_to (NiceSocket *sock, const NiceAddress * const *to,
+    const NiceOutputMessage *messages, guint n_messages);
+gint
 nice_socket_send_messages_reliable (NiceSocket *sock, const NiceAddress *addr,
     const NiceOutputMessage *messages, guint n_messages);
 gssize
@@ -142,10 +162,48 @@ nice_socket_set_writable_callback (NiceSocket *sock,
 gboolean
 nice_socket_is_based_on (NiceSocket *sock, NiceSocket *other);
 
+/*
+ * nice_socket_create_source:
+ * @sock: a #NiceSocket
+ *
+ * Creates a #GSource which is dispatched when @sock may have data to receive,
+ * and calls a #GSocketSourceFunc with @sock’s #GSocket.
+ *
+ * Returns: (transfer full): a new #GSource
+ */
+GSource *
+nice_socket_create_source (NiceSocket *sock);
+
+/*
+ * nice_socket_get_kernel_drops:
+ * @sock: a #NiceSocket
+ *
+ * Returns: the number of incoming datagrams the kernel dropped because
+ * @sock’s receive buffer was full, or 0 if this is not known
+ */
+guint
+nice_socket_get_kernel_drops (NiceSocket *sock);
+
+/*
+ * nice_socket_get_passthrough:
+ * @sock: a #NiceSocket
+ * @from: (out): return location for the source address to report for data
+ * received on the returned socket, or invalid if it needs no rewriting
+ *
+ * Skips the layers of @sock which have completed their handshake, so that
+ * steady-state I/O does not go through them.
+ *
+ * Returns: (transfer none): the innermost socket which can be used instead
+ * of @sock, or @sock itself
+ */
+NiceSocket *
+nice_socket_get_passthrough (NiceSocket *sock, NiceAddress *from);
+
 void
 nice_socket_free (NiceSocket *sock);
 
 #include "udp-bsd.h"
+#include "udp-uring.h"
 #include "tcp-bsd.h"
 #include "tcp-active.h"
 #include "tcp-passive.h"
@@ -154,6 +212,7 @@ nice_socket_free (NiceSocket *sock);
 #include "http.h"
 #include "udp-turn.h"
 #include "udp-turn-over-tcp.h"
+#include "tls.h"
 
 G_END_DECLS
 
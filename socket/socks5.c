@@ -82,6 +82,8 @@ static gboolean socket_can_send (NiceSocket *sock, NiceAddress *addr);
 static void socket_set_writable_callback (NiceSocket *sock,
     NiceSocketWritableCb callback, gpointer user_data);
 static gboolean socket_is_based_on (NiceSocket *sock, NiceSocket *other);
+static NiceSocket *socket_get_passthrough (NiceSocket *sock,
+    NiceAddress *from);
 
 
 NiceSocket *
@@ -110,6 +112,7 @@ nice_socks5_socket_new (NiceSocket *base_socket,
     sock->can_send = socket_can_send;
     sock->set_writable_callback = socket_set_writable_callback;
     sock->is_based_on = socket_is_based_on;
+    sock->get_passthrough = socket_get_passthrough;
     sock->close = socket_close;
 
     /* Send SOCKS5 handshake */
@@ -497,3 +500,18 @@ socket_is_based_on (NiceSocket *sock, NiceSocket *other)
   return (sock == other) ||
       (priv && nice_socket_is_based_on (priv->base_socket, other));
 }
+
+static NiceSocket *
+socket_get_passthrough (NiceSocket *sock, NiceAddress *from)
+{
+  Socks5Priv *priv = sock->priv;
+
+  /* The replies are read with their exact sizes, so nothing is left over, and
+   * the send queue was flushed on connection */
+  if (priv->state != SOCKS_STATE_CONNECTED)
+    return NULL;
+
+  *from = priv->addr;
+
+  return priv->base_socket;
+}
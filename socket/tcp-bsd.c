@@ -66,7 +66,7 @@ static GMutex mutex;
 
 typedef struct {
   NiceAddress remote_addr;
-  GQueue send_queue;
+  NiceSocketSendRing send_ring;
   GMainContext *context;
   GSource *io_source;
   gboolean error;
@@ -76,7 +76,10 @@ typedef struct {
   NiceSocket *passive_parent;
 } TcpPriv;
 
-#define MAX_QUEUE_LENGTH 20
+/* Above this many queued bytes, non-reliable messages are refused and
+ * nice_socket_can_send() fails so that the agent backs off; reliable
+ * messages are still queued */
+#define MAX_QUEUE_SIZE (64 * 1024)
 
 static void socket_close (NiceSocket *sock);
 static gint socket_recv_messages (NiceSocket *sock,
@@ -113,6 +116,7 @@ nice_tcp_bsd_socket_new_from_gsock (GMainContext *ctx, GSocket *gsock,
   priv->reliable = reliable;
   priv->writable_cb = NULL;
   priv->writable_data = NULL;
+  nice_socket_send_ring_init (&priv->send_ring);
 
   sock->type = NICE_SOCKET_TYPE_TCP_BSD;
   sock->fileno = g_object_ref (gsock);
@@ -234,7 +238,7 @@ socket_close (NiceSocket *sock)
     nice_tcp_passive_socket_remove_connection (priv->passive_parent, &priv->remote_addr);
   }
 
-  nice_socket_free_send_queue (&priv->send_queue);
+  nice_socket_send_ring_clear (&priv->send_ring);
 
   if (priv->context)
     g_main_context_unref (priv->context);
@@ -295,6 +299,24 @@ socket_recv_messages (NiceSocket *sock,
   return i;
 }
 
+/* Queues the end of @message and waits for the socket to be writable */
+static void
+queue_message (NiceSocket *sock, const NiceOutputMessage *message,
+    gsize message_offset, gsize message_len)
+{
+  TcpPriv *priv = sock->priv;
+
+  nice_socket_send_ring_push (&priv->send_ring, message, message_offset,
+      message_len);
+
+  if (priv->io_source == NULL) {
+    priv->io_source = g_socket_create_source (sock->fileno, G_IO_OUT, NULL);
+    g_source_set_callback (priv->io_source,
+        (GSourceFunc) G_CALLBACK (socket_send_more), sock, NULL);
+    g_source_attach (priv->io_source, priv->context);
+  }
+}
+
 static gssize
 socket_send_message (NiceSocket *sock,
     const NiceOutputMessage *message, gboolean reliable)
@@ -316,7 +338,7 @@ socket_send_message (NiceSocket *sock,
 
   /* First try to send the data, don't send it later if it can be sent now
    * this way we avoid allocating memory on every send */
-  if (g_queue_is_empty (&priv->send_queue)) {
+  if (priv->send_ring.length == 0) {
     ret = g_socket_send_message (sock->fileno, NULL, message->buffers,
         message->n_buffers, NULL, 0, G_SOCKET_MSG_NONE, NULL, &gerr);
 
@@ -324,32 +346,25 @@ socket_send_message (NiceSocket *sock,
       if (g_error_matches (gerr, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK) ||
           g_error_matches (gerr, G_IO_ERROR, G_IO_ERROR_FAILED)) {
         /* Queue the message and send it later. */
-        nice_socket_queue_send_with_callback (&priv->send_queue,
-            message, 0, message_len, FALSE, sock->fileno, &priv->io_source,
-            priv->context, socket_send_more, sock);
+        queue_message (sock, message, 0, message_len);
         ret = message_len;
       }
 
       g_error_free (gerr);
     } else if ((gsize) ret < message_len) {
       /* Partial send. */
-      nice_socket_queue_send_with_callback (&priv->send_queue,
-          message, ret, message_len, TRUE, sock->fileno, &priv->io_source,
-          priv->context, socket_send_more, sock);
+      queue_message (sock, message, ret, message_len);
       ret = message_len;
     }
+  } else if (reliable ||
+      priv->send_ring.length + message_len <= MAX_QUEUE_SIZE) {
+    /* Append behind the queued bytes, they all go out in the next flush. */
+    queue_message (sock, message, 0, message_len);
+    ret = message_len;
   } else {
-    /* Only queue if we're sending reliably  */
-    if (reliable) {
-      /* Queue the message and send it later. */
-      nice_socket_queue_send_with_callback (&priv->send_queue,
-          message, 0, message_len, FALSE, sock->fileno, &priv->io_source,
-          priv->context, socket_send_more, sock);
-      ret = message_len;
-    } else {
-      /* non reliable send, so we shouldn't queue the message */
-      ret = 0;
-    }
+    /* non reliable send and the queue is full, so we shouldn't queue the
+     * message */
+    ret = 0;
   }
 
   return ret;
@@ -416,7 +431,7 @@ socket_can_send (NiceSocket *sock, NiceAddress *addr)
 {
   TcpPriv *priv = sock->priv;
 
-  return g_queue_is_empty (&priv->send_queue);
+  return priv->send_ring.length < MAX_QUEUE_SIZE;
 }
 
 static void
@@ -451,8 +466,7 @@ socket_send_more (
 
   /* connection hangs up or queue was emptied */
   if (condition & G_IO_HUP ||
-      nice_socket_flush_send_queue_to_socket (sock->fileno,
-          &priv->send_queue)) {
+      nice_socket_send_ring_flush (&priv->send_ring, sock->fileno)) {
     g_source_destroy (priv->io_source);
     g_source_unref (priv->io_source);
     priv->io_source = NULL;
@@ -486,3 +500,11 @@ nice_tcp_bsd_socket_get_passive_parent (NiceSocket *sock)
 
   return priv->passive_parent;
 }
+
+gsize
+nice_tcp_bsd_socket_get_queued_bytes (NiceSocket *sock)
+{
+  TcpPriv *priv = sock->priv;
+
+  return priv->send_ring.length;
+}
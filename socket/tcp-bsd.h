@@ -55,6 +55,10 @@ nice_tcp_bsd_socket_set_passive_parent (NiceSocket *socket, NiceSocket *passive_
 NiceSocket *
 nice_tcp_bsd_socket_get_passive_parent (NiceSocket *socket);
 
+/* Number of bytes accepted by send calls but not handed to the kernel yet */
+gsize
+nice_tcp_bsd_socket_get_queued_bytes (NiceSocket *socket);
+
 G_END_DECLS
 
 #endif /* _TCP_BSD_H */
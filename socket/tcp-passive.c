@@ -277,9 +277,28 @@ nice_tcp_passive_socket_accept (NiceSocket *sock)
   } name;
   TcpPassivePriv *priv = sock->priv;
   GSocket *gsock = NULL;
-  GSocketAddress *gaddr;
   NiceAddress remote_addr;
   NiceSocket *new_socket = NULL;
+#ifdef HAVE_ACCEPT4
+  socklen_t name_len = sizeof (name);
+  gint fd;
+
+  /* Getting the peer address and the flags right away saves a
+   * getpeername() and two fcntl() calls per connection */
+  fd = accept4 (g_socket_get_fd (sock->fileno), &name.addr, &name_len,
+      SOCK_NONBLOCK | SOCK_CLOEXEC);
+  if (fd < 0)
+    return NULL;
+
+  gsock = g_socket_new_from_fd (fd, NULL);
+  if (gsock == NULL) {
+    close (fd);
+    return NULL;
+  }
+
+  g_socket_set_blocking (gsock, false);
+#else
+  GSocketAddress *gaddr;
 
   gsock = g_socket_accept (sock->fileno, NULL, NULL);
 
@@ -290,9 +309,6 @@ nice_tcp_passive_socket_accept (NiceSocket *sock)
   /* GSocket: All socket file descriptors are set to be close-on-exec. */
   g_socket_set_blocking (gsock, false);
 
-  /* setting TCP_NODELAY to TRUE in order to avoid packet batching */
-  g_socket_set_option (gsock, IPPROTO_TCP, TCP_NODELAY, TRUE, NULL);
-
   gaddr = g_socket_get_remote_address (gsock, NULL);
   if (gaddr == NULL ||
       !g_socket_address_to_native (gaddr, &name.addr, sizeof (name), NULL)) {
@@ -301,6 +317,10 @@ nice_tcp_passive_socket_accept (NiceSocket *sock)
     return NULL;
   }
   g_object_unref (gaddr);
+#endif
+
+  /* setting TCP_NODELAY to TRUE in order to avoid packet batching */
+  g_socket_set_option (gsock, IPPROTO_TCP, TCP_NODELAY, TRUE, NULL);
 
   nice_address_set_from_sockaddr (&remote_addr, &name.addr);
 
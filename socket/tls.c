@@ -0,0 +1,1051 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * TLS transport for TURN over TLS, with kernel TLS offload.
+ *
+ * (C) 2026 Collabora Ltd
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ *
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+
+/*
+ * TLS client socket used for TURN over TLS. The TLS library never touches a
+ * file descriptor: ciphertext goes through the base socket, so the proxy
+ * sockets can sit underneath, and only whole records are handed to the
+ * library so that the session can be moved to kernel TLS at any point where
+ * nothing is buffered.
+ */
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "tls.h"
+#include "agent-priv.h"
+#include "socket-priv.h"
+
+#include <string.h>
+#include <errno.h>
+
+#if defined(HAVE_GNUTLS)
+#include <gnutls/gnutls.h>
+#define NICE_TLS_GNUTLS
+#elif defined(HAVE_OPENSSL)
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/x509v3.h>
+#define NICE_TLS_OPENSSL
+#endif
+
+/* OpenSSL 3.0 has no public way to read the record keys back, so kernel TLS
+ * is only set up from GnuTLS sessions */
+#if defined(NICE_TLS_GNUTLS) && defined(HAVE_LINUX_TLS_H) && \
+    GNUTLS_VERSION_NUMBER >= 0x030400
+#define NICE_TLS_KTLS
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/tls.h>
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#endif
+
+#define TLS_RECORD_HEADER_SIZE 5
+/* Largest TLS 1.2 ciphertext record, header included */
+#define TLS_RECORD_MAX_SIZE (TLS_RECORD_HEADER_SIZE + 16384 + 2048)
+
+typedef enum {
+  TLS_STATE_HANDSHAKE,
+  TLS_STATE_ESTABLISHED,
+  TLS_STATE_ERROR,
+} TlsState;
+
+typedef struct {
+  TlsState state;
+  NiceSocket *base_socket;
+  GQueue send_queue;
+
+  /* Ciphertext read from the base socket. Only the complete records before
+   * @recv_records_end are given to the TLS library. */
+  GByteArray *recv_buf;
+  gsize recv_pos;
+  gsize recv_records_end;
+
+  /* Plaintext of a multi-buffer message, gathered before encryption */
+  guint8 *send_buf;
+  gsize send_buf_size;
+
+  gboolean ktls_possible;
+  gboolean ktls_rx;
+  gboolean ktls_tx;
+
+#if defined(NICE_TLS_GNUTLS)
+  gnutls_session_t session;
+#elif defined(NICE_TLS_OPENSSL)
+  SSL *ssl;
+  BIO *rbio;
+  BIO *wbio;
+#endif
+} TlsPriv;
+
+static void socket_close (NiceSocket *sock);
+static gint socket_recv_messages (NiceSocket *sock,
+    NiceInputMessage *recv_messages, guint n_recv_messages);
+static gint socket_send_messages (NiceSocket *sock, const NiceAddress *to,
+    const NiceOutputMessage *messages, guint n_messages);
+static gint socket_send_messages_reliable (NiceSocket *sock,
+    const NiceAddress *to, const NiceOutputMessage *messages, guint n_messages);
+static gboolean socket_is_reliable (NiceSocket *sock);
+static gboolean socket_can_send (NiceSocket *sock, NiceAddress *addr);
+static void socket_set_writable_callback (NiceSocket *sock,
+    NiceSocketWritableCb callback, gpointer user_data);
+static gboolean socket_is_based_on (NiceSocket *sock, NiceSocket *other);
+static NiceSocket *socket_get_passthrough (NiceSocket *sock,
+    NiceAddress *from);
+
+static gsize
+recv_buf_available (TlsPriv *priv)
+{
+  return priv->recv_records_end - priv->recv_pos;
+}
+
+/* Once the complete records are all consumed, only the start of a partial
+ * record may be left: move it to the front so that the buffer doesn't grow
+ * with every read */
+static void
+recv_buf_consume (TlsPriv *priv, gsize len)
+{
+  priv->recv_pos += len;
+
+  if (priv->recv_pos == priv->recv_records_end) {
+    g_byte_array_remove_range (priv->recv_buf, 0, priv->recv_pos);
+    priv->recv_pos = 0;
+    priv->recv_records_end = 0;
+  }
+}
+
+/* Moves @recv_records_end past every complete record in the buffer */
+static void
+recv_buf_scan_records (TlsPriv *priv)
+{
+  const guint8 *data = priv->recv_buf->data;
+  gsize end = priv->recv_records_end;
+
+  while (priv->recv_buf->len - end >= TLS_RECORD_HEADER_SIZE) {
+    gsize record_len = TLS_RECORD_HEADER_SIZE +
+        ((data[end + 3] << 8) | data[end + 4]);
+
+    if (priv->recv_buf->len - end < record_len)
+      break;
+    end += record_len;
+  }
+
+  priv->recv_records_end = end;
+}
+
+#if defined(NICE_TLS_GNUTLS)
+
+static gnutls_certificate_credentials_t tls_credentials;
+
+static ssize_t
+tls_pull (gnutls_transport_ptr_t ptr, void *data, size_t len)
+{
+  TlsPriv *priv = ptr;
+  gsize available = recv_buf_available (priv);
+
+  if (available == 0) {
+    gnutls_transport_set_errno (priv->session, EAGAIN);
+    return -1;
+  }
+
+  len = MIN (len, available);
+  memcpy (data, priv->recv_buf->data + priv->recv_pos, len);
+  recv_buf_consume (priv, len);
+
+  return len;
+}
+
+static int
+tls_pull_timeout (gnutls_transport_ptr_t ptr, unsigned int ms)
+{
+  TlsPriv *priv = ptr;
+
+  return recv_buf_available (priv) > 0 ? 1 : 0;
+}
+
+static ssize_t
+tls_push (gnutls_transport_ptr_t ptr, const void *data, size_t len)
+{
+  TlsPriv *priv = ptr;
+
+  /* We send 'to' NULL because it will always be to an already connected
+   * TCP base socket, which ignores the destination */
+  if (priv->base_socket == NULL ||
+      nice_socket_send_reliable (priv->base_socket, NULL, len, data) < 0) {
+    gnutls_transport_set_errno (priv->session, EIO);
+    return -1;
+  }
+
+  return len;
+}
+
+static gboolean
+tls_backend_init (TlsPriv *priv, const gchar *server_name, gboolean verify)
+{
+  static gsize credentials_init = 0;
+
+  if (g_once_init_enter (&credentials_init)) {
+    if (gnutls_certificate_allocate_credentials (&tls_credentials) < 0) {
+      tls_credentials = NULL;
+    } else {
+#if GNUTLS_VERSION_NUMBER >= 0x030406
+      gint ret = gnutls_certificate_set_x509_system_trust (tls_credentials);
+
+      if (ret < 0)
+        nice_debug ("Could not load the system trust store: %s",
+            gnutls_strerror (ret));
+#endif
+    }
+    g_once_init_leave (&credentials_init, 1);
+  }
+
+#if GNUTLS_VERSION_NUMBER < 0x030406
+  if (verify) {
+    nice_debug ("Verifying TLS certificates needs GnuTLS 3.4.6");
+    return FALSE;
+  }
+#endif
+
+  if (tls_credentials == NULL ||
+      gnutls_init (&priv->session, GNUTLS_CLIENT | GNUTLS_NONBLOCK) < 0)
+    return FALSE;
+
+  if (gnutls_set_default_priority (priv->session) < 0 ||
+      gnutls_credentials_set (priv->session, GNUTLS_CRD_CERTIFICATE,
+          tls_credentials) < 0 ||
+      (!g_hostname_is_ip_address (server_name) &&
+          gnutls_server_name_set (priv->session, GNUTLS_NAME_DNS, server_name,
+              strlen (server_name)) < 0)) {
+    gnutls_deinit (priv->session);
+    priv->session = NULL;
+    return FALSE;
+  }
+
+#if GNUTLS_VERSION_NUMBER >= 0x030406
+  /* The handshake then fails unless the chain leads to a trusted root and
+   * the certificate matches @server_name, as a DNS name or an IP address */
+  if (verify)
+    gnutls_session_set_verify_cert (priv->session, server_name, 0);
+#endif
+
+  gnutls_transport_set_ptr (priv->session, priv);
+  gnutls_transport_set_push_function (priv->session, tls_push);
+  gnutls_transport_set_pull_function (priv->session, tls_pull);
+  gnutls_transport_set_pull_timeout_function (priv->session,
+      tls_pull_timeout);
+
+  return TRUE;
+}
+
+static void
+tls_backend_free (TlsPriv *priv)
+{
+  if (priv->session)
+    gnutls_deinit (priv->session);
+}
+
+/* Returns 1 once the handshake is done, 0 if it needs more data and -1 on
+ * failure */
+static gint
+tls_backend_handshake (TlsPriv *priv)
+{
+  gint ret = gnutls_handshake (priv->session);
+
+  if (ret == GNUTLS_E_SUCCESS)
+    return 1;
+
+  if (gnutls_error_is_fatal (ret)) {
+#if GNUTLS_VERSION_NUMBER >= 0x030406
+    if (ret == GNUTLS_E_CERTIFICATE_VERIFICATION_ERROR) {
+      gnutls_datum_t status;
+
+      if (gnutls_certificate_verification_status_print (
+              gnutls_session_get_verify_cert_status (priv->session),
+              gnutls_certificate_type_get (priv->session), &status, 0) == 0) {
+        nice_debug ("TLS handshake failed: %s", status.data);
+        gnutls_free (status.data);
+        return -1;
+      }
+    }
+#endif
+    nice_debug ("TLS handshake failed: %s", gnutls_strerror (ret));
+    return -1;
+  }
+
+  return 0;
+}
+
+/* Returns the number of plaintext bytes read, 0 if a complete record is
+ * needed first and -1 on failure or once the server closed the session */
+static gssize
+tls_backend_read (TlsPriv *priv, guint8 *buf, gsize len)
+{
+  for (;;) {
+    gssize ret = gnutls_record_recv (priv->session, buf, len);
+
+    if (ret > 0)
+      return ret;
+    else if (ret == 0)
+      return -1;
+    else if (ret == GNUTLS_E_AGAIN || ret == GNUTLS_E_INTERRUPTED)
+      return 0;
+    else if (gnutls_error_is_fatal (ret)) {
+      nice_debug ("TLS receive failed: %s", gnutls_strerror (ret));
+      return -1;
+    }
+    /* Warning alerts and renegotiation requests are ignored */
+  }
+}
+
+static gboolean
+tls_backend_write (TlsPriv *priv, const guint8 *buf, gsize len)
+{
+  while (len > 0) {
+    /* At most one record is sent per call */
+    gssize ret = gnutls_record_send (priv->session, buf, len);
+
+    if (ret < 0) {
+      nice_debug ("TLS send failed: %s", gnutls_strerror (ret));
+      return FALSE;
+    }
+    buf += ret;
+    len -= ret;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+tls_backend_has_pending (TlsPriv *priv)
+{
+  return gnutls_record_check_pending (priv->session) > 0;
+}
+
+#elif defined(NICE_TLS_OPENSSL)
+
+static SSL_CTX *tls_ctx;
+
+/* Hands the complete records received so far over to OpenSSL */
+static void
+tls_feed_rbio (TlsPriv *priv)
+{
+  gsize available = recv_buf_available (priv);
+
+  if (available > 0) {
+    gint written = BIO_write (priv->rbio,
+        priv->recv_buf->data + priv->recv_pos, MIN (available, G_MAXINT));
+
+    if (written > 0)
+      recv_buf_consume (priv, written);
+  }
+}
+
+static gboolean
+tls_flush_wbio (TlsPriv *priv)
+{
+  char *data;
+  long len = BIO_get_mem_data (priv->wbio, &data);
+
+  if (len > 0) {
+    /* We send 'to' NULL because it will always be to an already connected
+     * TCP base socket, which ignores the destination */
+    if (priv->base_socket == NULL ||
+        nice_socket_send_reliable (priv->base_socket, NULL, len, data) < 0)
+      return FALSE;
+    (void) BIO_reset (priv->wbio);
+  }
+
+  return TRUE;
+}
+
+static gboolean
+tls_backend_init (TlsPriv *priv, const gchar *server_name, gboolean verify)
+{
+  static gsize ctx_init = 0;
+  gboolean ret;
+
+  if (g_once_init_enter (&ctx_init)) {
+    tls_ctx = SSL_CTX_new (TLS_client_method ());
+    if (tls_ctx && SSL_CTX_set_default_verify_paths (tls_ctx) != 1)
+      nice_debug ("Could not load the system trust store: %s",
+          ERR_reason_error_string (ERR_get_error ()));
+    g_once_init_leave (&ctx_init, 1);
+  }
+
+  if (tls_ctx == NULL)
+    return FALSE;
+
+  priv->ssl = SSL_new (tls_ctx);
+  if (priv->ssl == NULL)
+    return FALSE;
+
+  if (g_hostname_is_ip_address (server_name))
+    ret = X509_VERIFY_PARAM_set1_ip_asc (SSL_get0_param (priv->ssl),
+        server_name) == 1;
+  else
+    ret = SSL_set_tlsext_host_name (priv->ssl, server_name) == 1 &&
+        SSL_set1_host (priv->ssl, server_name) == 1;
+
+  if (!ret) {
+    SSL_free (priv->ssl);
+    priv->ssl = NULL;
+    return FALSE;
+  }
+
+  /* The handshake then fails unless the chain leads to a trusted root and
+   * the certificate matches @server_name */
+  SSL_set_verify (priv->ssl, verify ? SSL_VERIFY_PEER : SSL_VERIFY_NONE, NULL);
+
+  priv->rbio = BIO_new (BIO_s_mem ());
+  priv->wbio = BIO_new (BIO_s_mem ());
+  if (priv->rbio == NULL || priv->wbio == NULL) {
+    BIO_free (priv->rbio);
+    BIO_free (priv->wbio);
+    SSL_free (priv->ssl);
+    priv->ssl = NULL;
+    return FALSE;
+  }
+  BIO_set_mem_eof_return (priv->rbio, -1);
+
+  /* The session owns both BIOs from here on */
+  SSL_set_bio (priv->ssl, priv->rbio, priv->wbio);
+  SSL_set_connect_state (priv->ssl);
+
+  return TRUE;
+}
+
+static void
+tls_backend_free (TlsPriv *priv)
+{
+  SSL_free (priv->ssl);
+}
+
+static gint
+tls_backend_handshake (TlsPriv *priv)
+{
+  gint ret;
+
+  tls_feed_rbio (priv);
+  ret = SSL_do_handshake (priv->ssl);
+
+  if (!tls_flush_wbio (priv))
+    return -1;
+
+  if (ret == 1)
+    return 1;
+
+  switch (SSL_get_error (priv->ssl, ret)) {
+    case SSL_ERROR_WANT_READ:
+    case SSL_ERROR_WANT_WRITE:
+      return 0;
+    default:
+      if (SSL_get_verify_result (priv->ssl) != X509_V_OK)
+        nice_debug ("TLS handshake failed: %s",
+            X509_verify_cert_error_string (SSL_get_verify_result (priv->ssl)));
+      else
+        nice_debug ("TLS handshake failed: %s",
+            ERR_reason_error_string (ERR_get_error ()));
+      return -1;
+  }
+}
+
+static gssize
+tls_backend_read (TlsPriv *priv, guint8 *buf, gsize len)
+{
+  gint ret;
+
+  tls_feed_rbio (priv);
+  ret = SSL_read (priv->ssl, buf, MIN (len, G_MAXINT));
+
+  /* Reading may have produced alerts or post-handshake messages */
+  if (!tls_flush_wbio (priv))
+    return -1;
+
+  if (ret > 0)
+    return ret;
+
+  switch (SSL_get_error (priv->ssl, ret)) {
+    case SSL_ERROR_WANT_READ:
+    case SSL_ERROR_WANT_WRITE:
+      return 0;
+    default:
+      return -1;
+  }
+}
+
+static gboolean
+tls_backend_write (TlsPriv *priv, const guint8 *buf, gsize len)
+{
+  while (len > 0) {
+    /* Memory BIOs never block, so SSL_write() takes everything */
+    gint ret = SSL_write (priv->ssl, buf, MIN (len, G_MAXINT));
+
+    if (ret <= 0)
+      return FALSE;
+    buf += ret;
+    len -= ret;
+  }
+
+  return tls_flush_wbio (priv);
+}
+
+static gboolean
+tls_backend_has_pending (TlsPriv *priv)
+{
+  return SSL_pending (priv->ssl) > 0;
+}
+
+#else
+
+static gboolean
+tls_backend_init (TlsPriv *priv, const gchar *server_name, gboolean verify)
+{
+  nice_debug ("No TLS library available for TURN over TLS");
+  return FALSE;
+}
+
+static void
+tls_backend_free (TlsPriv *priv)
+{
+}
+
+static gint
+tls_backend_handshake (TlsPriv *priv)
+{
+  return -1;
+}
+
+static gssize
+tls_backend_read (TlsPriv *priv, guint8 *buf, gsize len)
+{
+  return -1;
+}
+
+static gboolean
+tls_backend_write (TlsPriv *priv, const guint8 *buf, gsize len)
+{
+  return FALSE;
+}
+
+static gboolean
+tls_backend_has_pending (TlsPriv *priv)
+{
+  return FALSE;
+}
+
+#endif
+
+#ifdef NICE_TLS_KTLS
+
+static gboolean
+ktls_set_keys (TlsPriv *priv, gint fd, gboolean read,
+    gnutls_cipher_algorithm_t cipher)
+{
+  gnutls_datum_t mac_key, iv, cipher_key;
+  guint8 seq[8];
+  gboolean ret = FALSE;
+
+  if (gnutls_record_get_state (priv->session, read, &mac_key, &iv,
+          &cipher_key, seq) < 0)
+    return FALSE;
+
+  /* For TLS 1.2 AES-GCM the implicit IV is the 4-byte salt, and the explicit
+   * part starts out as the record sequence number */
+#define KTLS_SET_KEYS(info_type, ktls_cipher) \
+  G_STMT_START { \
+    info_type info; \
+    \
+    memset (&info, 0, sizeof (info)); \
+    info.info.version = TLS_1_2_VERSION; \
+    info.info.cipher_type = ktls_cipher; \
+    if (cipher_key.size == sizeof (info.key) && \
+        iv.size >= sizeof (info.salt)) { \
+      memcpy (info.key, cipher_key.data, sizeof (info.key)); \
+      memcpy (info.salt, iv.data, sizeof (info.salt)); \
+      memcpy (info.iv, seq, sizeof (info.iv)); \
+      memcpy (info.rec_seq, seq, sizeof (info.rec_seq)); \
+      ret = setsockopt (fd, SOL_TLS, read ? TLS_RX : TLS_TX, &info, \
+          sizeof (info)) == 0; \
+    } \
+    memset (&info, 0, sizeof (info)); \
+  } G_STMT_END
+
+  if (cipher == GNUTLS_CIPHER_AES_128_GCM)
+    KTLS_SET_KEYS (struct tls12_crypto_info_aes_gcm_128,
+        TLS_CIPHER_AES_GCM_128);
+  else if (cipher == GNUTLS_CIPHER_AES_256_GCM)
+    KTLS_SET_KEYS (struct tls12_crypto_info_aes_gcm_256,
+        TLS_CIPHER_AES_GCM_256);
+
+#undef KTLS_SET_KEYS
+
+  return ret;
+}
+
+#endif
+
+/* Moves the session to kernel TLS once nothing is buffered on either side of
+ * it. Called again on later sends and receives until it either succeeds or
+ * turns out to be impossible. */
+static void
+tls_try_ktls (NiceSocket *sock)
+{
+#ifdef NICE_TLS_KTLS
+  TlsPriv *priv = sock->priv;
+  NiceSocket *tcp;
+  NiceAddress from;
+  gnutls_cipher_algorithm_t cipher;
+  gint fd;
+
+  if (!priv->ktls_possible)
+    return;
+
+  /* The kernel must start on a record boundary, so no ciphertext may be
+   * left over, not even the start of a record */
+  if (priv->recv_buf->len > 0 || tls_backend_has_pending (priv))
+    return;
+
+  tcp = nice_socket_get_passthrough (priv->base_socket, &from);
+  if (tcp->get_passthrough != NULL) {
+    /* A proxy which still buffers data; try again later */
+    return;
+  } else if (tcp->type != NICE_SOCKET_TYPE_TCP_BSD || tcp->fileno == NULL) {
+    priv->ktls_possible = FALSE;
+    return;
+  }
+
+  /* Records already encrypted by GnuTLS have to reach the wire first */
+  if (nice_tcp_bsd_socket_get_queued_bytes (tcp) > 0)
+    return;
+
+  priv->ktls_possible = FALSE;
+  fd = g_socket_get_fd (tcp->fileno);
+  cipher = gnutls_cipher_get (priv->session);
+
+  if (setsockopt (fd, IPPROTO_TCP, TCP_ULP, "tls", sizeof ("tls")) < 0) {
+    nice_debug ("Kernel TLS not available: %s", g_strerror (errno));
+    return;
+  }
+
+  priv->ktls_rx = ktls_set_keys (priv, fd, TRUE, cipher);
+  priv->ktls_tx = ktls_set_keys (priv, fd, FALSE, cipher);
+
+  nice_debug ("TLS socket %p: kernel TLS receive %s, send %s", sock,
+      priv->ktls_rx ? "on" : "off", priv->ktls_tx ? "on" : "off");
+#endif
+}
+
+static void
+tls_handshake_done (NiceSocket *sock)
+{
+  TlsPriv *priv = sock->priv;
+
+  priv->state = TLS_STATE_ESTABLISHED;
+
+#ifdef NICE_TLS_KTLS
+  {
+    gnutls_cipher_algorithm_t cipher = gnutls_cipher_get (priv->session);
+
+    priv->ktls_possible =
+        gnutls_protocol_get_version (priv->session) == GNUTLS_TLS1_2 &&
+        (cipher == GNUTLS_CIPHER_AES_128_GCM ||
+            cipher == GNUTLS_CIPHER_AES_256_GCM);
+  }
+#endif
+
+  /* Going through our own send function encrypts the queued data */
+  nice_socket_flush_send_queue (sock, &priv->send_queue);
+
+  tls_try_ktls (sock);
+}
+
+static void
+tls_fail (NiceSocket *sock)
+{
+  TlsPriv *priv = sock->priv;
+
+  priv->state = TLS_STATE_ERROR;
+  priv->ktls_possible = FALSE;
+}
+
+/* Reads once from the base socket into the ciphertext buffer. Returns the
+ * number of bytes read, 0 if none are available and -1 on failure. */
+static gssize
+tls_fill_recv_buf (NiceSocket *sock)
+{
+  TlsPriv *priv = sock->priv;
+  guint len = priv->recv_buf->len;
+  GInputVector local_buf;
+  NiceInputMessage local_message = { &local_buf, 1, NULL, 0 };
+  gint ret;
+
+  g_byte_array_set_size (priv->recv_buf, len + TLS_RECORD_MAX_SIZE);
+  local_buf.buffer = priv->recv_buf->data + len;
+  local_buf.size = TLS_RECORD_MAX_SIZE;
+
+  ret = nice_socket_recv_messages (priv->base_socket, &local_message, 1);
+  g_byte_array_set_size (priv->recv_buf,
+      len + (ret > 0 ? local_message.length : 0));
+
+  if (ret <= 0)
+    return ret;
+
+  recv_buf_scan_records (priv);
+
+  return local_message.length;
+}
+
+static gssize
+tls_read (NiceSocket *sock, guint8 *buf, gsize len)
+{
+  TlsPriv *priv = sock->priv;
+
+  for (;;) {
+    gssize ret = tls_backend_read (priv, buf, len);
+
+    if (ret != 0)
+      return ret;
+
+    ret = tls_fill_recv_buf (sock);
+    if (ret <= 0)
+      return ret;
+  }
+}
+
+NiceSocket *
+nice_tls_socket_new (NiceSocket *base_socket, const gchar *server_name,
+    gboolean verify)
+{
+  TlsPriv *priv;
+  NiceSocket *sock;
+
+  sock = g_slice_new0 (NiceSocket);
+  sock->priv = priv = g_slice_new0 (TlsPriv);
+
+  priv->state = TLS_STATE_HANDSHAKE;
+  priv->base_socket = base_socket;
+  priv->recv_buf = g_byte_array_new ();
+
+  sock->type = NICE_SOCKET_TYPE_TLS;
+  sock->fileno = priv->base_socket->fileno;
+  sock->addr = priv->base_socket->addr;
+  sock->send_messages = socket_send_messages;
+  sock->send_messages_reliable = socket_send_messages_reliable;
+  sock->recv_messages = socket_recv_messages;
+  sock->is_reliable = socket_is_reliable;
+  sock->can_send = socket_can_send;
+  sock->set_writable_callback = socket_set_writable_callback;
+  sock->is_based_on = socket_is_based_on;
+  sock->get_passthrough = socket_get_passthrough;
+  sock->close = socket_close;
+
+  if (!tls_backend_init (priv, server_name, verify)) {
+    nice_socket_free (sock);
+    return NULL;
+  }
+
+  /* Sends the ClientHello */
+  if (tls_backend_handshake (priv) < 0)
+    tls_fail (sock);
+
+  return sock;
+}
+
+gboolean
+nice_tls_socket_is_ktls (NiceSocket *sock)
+{
+  TlsPriv *priv = sock->priv;
+
+  g_return_val_if_fail (sock->type == NICE_SOCKET_TYPE_TLS, FALSE);
+
+  return priv->ktls_rx && priv->ktls_tx;
+}
+
+static void
+socket_close (NiceSocket *sock)
+{
+  TlsPriv *priv = sock->priv;
+
+  tls_backend_free (priv);
+
+  if (priv->base_socket)
+    nice_socket_free (priv->base_socket);
+
+  nice_socket_free_send_queue (&priv->send_queue);
+  g_byte_array_unref (priv->recv_buf);
+  g_free (priv->send_buf);
+
+  g_slice_free (TlsPriv, sock->priv);
+  sock->priv = NULL;
+}
+
+static gint
+socket_recv_messages (NiceSocket *sock,
+    NiceInputMessage *recv_messages, guint n_recv_messages)
+{
+  TlsPriv *priv = sock->priv;
+  guint i;
+
+  /* Make sure socket has not been freed: */
+  g_assert (sock->priv != NULL);
+
+  if (priv->state == TLS_STATE_ERROR || priv->base_socket == NULL)
+    return -1;
+
+  if (priv->ktls_rx) {
+    /* Fast path: the kernel decrypts the records */
+    return nice_socket_recv_messages (priv->base_socket,
+        recv_messages, n_recv_messages);
+  }
+
+  while (priv->state == TLS_STATE_HANDSHAKE) {
+    gint ret = tls_backend_handshake (priv);
+
+    if (ret > 0) {
+      tls_handshake_done (sock);
+    } else if (ret == 0) {
+      gssize len = tls_fill_recv_buf (sock);
+
+      if (len == 0)
+        return 0;
+      else if (len < 0)
+        ret = -1;
+    }
+
+    if (ret < 0) {
+      tls_fail (sock);
+      return -1;
+    }
+  }
+
+  /* Flushing the send queue can fail too */
+  if (priv->state == TLS_STATE_ERROR)
+    return -1;
+
+  for (i = 0; i < n_recv_messages; i++) {
+    NiceInputMessage *message = &recv_messages[i];
+    guint j;
+
+    message->length = 0;
+
+    for (j = 0;
+         (message->n_buffers >= 0 && j < (guint) message->n_buffers) ||
+         (message->n_buffers < 0 && message->buffers[j].buffer != NULL);
+         j++) {
+      GInputVector *buffer = &message->buffers[j];
+      gsize offset = 0;
+
+      while (offset < buffer->size) {
+        gssize ret = tls_read (sock, (guint8 *) buffer->buffer + offset,
+            buffer->size - offset);
+
+        if (ret < 0) {
+          /* Hand out what was decrypted so far, the next call fails */
+          tls_fail (sock);
+          if (i == 0 && message->length == 0)
+            return -1;
+          goto done;
+        } else if (ret == 0) {
+          goto done;
+        }
+        offset += ret;
+        message->length += ret;
+      }
+    }
+
+    if (message->from)
+      *message->from = priv->base_socket->addr;
+  }
+
+done:
+  if (i < n_recv_messages && recv_messages[i].length > 0) {
+    if (recv_messages[i].from)
+      *recv_messages[i].from = priv->base_socket->addr;
+    i++;
+  }
+
+  tls_try_ktls (sock);
+
+  return i;
+}
+
+static gboolean
+tls_send_message (NiceSocket *sock, const NiceOutputMessage *message)
+{
+  TlsPriv *priv = sock->priv;
+  gsize len = output_message_get_size (message);
+  guint i;
+
+  if (message->n_buffers == 1 ||
+      (message->n_buffers < 0 && message->buffers[1].buffer == NULL))
+    return tls_backend_write (priv, message->buffers[0].buffer, len);
+
+  /* Gather the buffers so that they don't each become a record */
+  if (priv->send_buf_size < len) {
+    g_free (priv->send_buf);
+    priv->send_buf = g_malloc (len);
+    priv->send_buf_size = len;
+  }
+
+  len = 0;
+  for (i = 0;
+       (message->n_buffers >= 0 && i < (guint) message->n_buffers) ||
+       (message->n_buffers < 0 && message->buffers[i].buffer != NULL);
+       i++) {
+    memcpy (priv->send_buf + len, message->buffers[i].buffer,
+        message->buffers[i].size);
+    len += message->buffers[i].size;
+  }
+
+  return tls_backend_write (priv, priv->send_buf, len);
+}
+
+static gint
+socket_send_messages (NiceSocket *sock, const NiceAddress *to,
+    const NiceOutputMessage *messages, guint n_messages)
+{
+  TlsPriv *priv = sock->priv;
+  guint i;
+
+  /* Make sure socket has not been freed: */
+  g_assert (sock->priv != NULL);
+
+  if (priv->state == TLS_STATE_ERROR || priv->base_socket == NULL)
+    return -1;
+  else if (priv->state == TLS_STATE_HANDSHAKE)
+    return 0;
+
+  tls_try_ktls (sock);
+
+  if (priv->ktls_tx) {
+    /* Fast path: the kernel encrypts the records */
+    return nice_socket_send_messages (priv->base_socket, to, messages,
+        n_messages);
+  }
+
+  for (i = 0; i < n_messages; i++) {
+    /* Once encrypted, a message can't be dropped without breaking the
+     * session, so only encrypt what the base socket will take */
+    if (!nice_socket_can_send (priv->base_socket, NULL))
+      break;
+
+    if (!tls_send_message (sock, &messages[i])) {
+      tls_fail (sock);
+      return i > 0 ? (gint) i : -1;
+    }
+  }
+
+  return i;
+}
+
+static gint
+socket_send_messages_reliable (NiceSocket *sock, const NiceAddress *to,
+    const NiceOutputMessage *messages, guint n_messages)
+{
+  TlsPriv *priv = sock->priv;
+  guint i;
+
+  if (priv->state == TLS_STATE_ERROR || priv->base_socket == NULL)
+    return -1;
+
+  if (priv->state == TLS_STATE_HANDSHAKE) {
+    nice_socket_queue_send (&priv->send_queue, to, messages, n_messages);
+    return n_messages;
+  }
+
+  tls_try_ktls (sock);
+
+  if (priv->ktls_tx) {
+    /* Fast path: the kernel encrypts the records */
+    return nice_socket_send_messages_reliable (priv->base_socket, to,
+        messages, n_messages);
+  }
+
+  for (i = 0; i < n_messages; i++) {
+    if (!tls_send_message (sock, &messages[i])) {
+      tls_fail (sock);
+      return -1;
+    }
+  }
+
+  return n_messages;
+}
+
+static gboolean
+socket_is_reliable (NiceSocket *sock)
+{
+  TlsPriv *priv = sock->priv;
+
+  return nice_socket_is_reliable (priv->base_socket);
+}
+
+static gboolean
+socket_can_send (NiceSocket *sock, NiceAddress *addr)
+{
+  TlsPriv *priv = sock->priv;
+
+  return nice_socket_can_send (priv->base_socket, addr);
+}
+
+static void
+socket_set_writable_callback (NiceSocket *sock,
+    NiceSocketWritableCb callback, gpointer user_data)
+{
+  TlsPriv *priv = sock->priv;
+
+  nice_socket_set_writable_callback (priv->base_socket, callback, user_data);
+}
+
+static gboolean
+socket_is_based_on (NiceSocket *sock, NiceSocket *other)
+{
+  TlsPriv *priv = sock->priv;
+
+  return (sock == other) ||
+      (priv && nice_socket_is_based_on (priv->base_socket, other));
+}
+
+static NiceSocket *
+socket_get_passthrough (NiceSocket *sock, NiceAddress *from)
+{
+  TlsPriv *priv = sock->priv;
+
+  /* Only once the kernel handles the records in both directions */
+  if (!priv->ktls_rx || !priv->ktls_tx)
+    return NULL;
+
+  return priv->base_socket;
+}
@@ -0,0 +1,72 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * TLS transport for TURN over TLS, with kernel TLS offload.
+ *
+ * (C) 2026 Collabora Ltd
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ *
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+
+#ifndef _TLS_H
+#define _TLS_H
+
+#include "socket.h"
+
+G_BEGIN_DECLS
+
+/*
+ * nice_tls_socket_new:
+ * @base_socket: (transfer full): a connected stream #NiceSocket
+ * @server_name: the host name or IP address of the server
+ * @verify: whether to verify the server certificate
+ *
+ * Wraps @base_socket in a TLS client session, as used for TURN over TLS
+ * (RFC 5766 section 2.1). The handshake starts right away; data sent reliably
+ * before it completes is queued, and unreliable sends are refused.
+ *
+ * If @verify is %TRUE, the handshake fails unless the server certificate
+ * chains up to the system trust store and is issued for @server_name.
+ *
+ * Once established, on Linux with GnuTLS and TLS 1.2 AES-GCM, the session
+ * keys are handed over to kernel TLS when @base_socket leads straight to a
+ * TCP socket, after which the socket only passes plaintext through.
+ *
+ * Returns: the new #NiceSocket, or %NULL if no TLS session could be created
+ */
+NiceSocket *
+nice_tls_socket_new (NiceSocket *base_socket, const gchar *server_name,
+    gboolean verify);
+
+/*
+ * nice_tls_socket_is_ktls:
+ * @sock: a TLS #NiceSocket
+ *
+ * Returns: %TRUE if the kernel encrypts and decrypts the records of @sock
+ */
+gboolean
+nice_tls_socket_is_ktls (NiceSocket *sock);
+
+G_END_DECLS
+
+#endif /* _TLS_H */
@@ -54,6 +54,8 @@
 
 #ifndef G_OS_WIN32
 #include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #endif
 
 
@@ -64,10 +66,16 @@ static gint socket_send_messages (NiceSocket *sock, const NiceAddress *to,
     const NiceOutputMessage *messages, guint n_messages);
 static gint socket_send_messages_reliable (NiceSocket *sock,
     const NiceAddress *to, const NiceOutputMessage *messages, guint n_messages);
+#ifdef HAVE_SENDMMSG
+static gint socket_send_messages_to (NiceSocket *sock,
+    const NiceAddress * const *to, const NiceOutputMessage *messages,
+    guint n_messages);
+#endif
 static gboolean socket_is_reliable (NiceSocket *sock);
 static gboolean socket_can_send (NiceSocket *sock, NiceAddress *addr);
 static void socket_set_writable_callback (NiceSocket *sock,
     NiceSocketWritableCb callback, gpointer user_data);
+static guint socket_get_kernel_drops (NiceSocket *sock);
 
 struct UdpBsdSocketPrivate
 {
@@ -76,6 +84,10 @@ struct UdpBsdSocketPrivate
   /* protected by mutex */
   NiceAddress niceaddr;
   GSocketAddress *gaddr;
+
+  /* Datagrams dropped by the kernel, as last reported by SO_RXQ_OVFL;
+   * atomic */
+  gint kernel_drops;
 };
 
 NiceSocket *
@@ -147,6 +159,12 @@ nice_udp_bsd_socket_new (NiceAddress *addr)
 
   nice_address_set_from_sockaddr (&sock->addr, &name.addr);
 
+#ifdef SO_RXQ_OVFL
+  /* Have the kernel attach its count of dropped datagrams to received ones */
+  if (!g_socket_set_option (gsock, SOL_SOCKET, SO_RXQ_OVFL, 1, NULL))
+    nice_debug ("Could not enable SO_RXQ_OVFL on socket %p", sock);
+#endif
+
   priv = sock->priv = g_slice_new0 (struct UdpBsdSocketPrivate);
   nice_address_init (&priv->niceaddr);
 
@@ -154,11 +172,15 @@ nice_udp_bsd_socket_new (NiceAddress *addr)
   sock->fileno = gsock;
   sock->send_messages = socket_send_messages;
   sock->send_messages_reliable = socket_send_messages_reliable;
+#ifdef HAVE_SENDMMSG
+  sock->send_messages_to = socket_send_messages_to;
+#endif
   sock->recv_messages = socket_recv_messages;
   sock->is_reliable = socket_is_reliable;
   sock->can_send = socket_can_send;
   sock->set_writable_callback = socket_set_writable_callback;
   sock->close = socket_close;
+  sock->get_kernel_drops = socket_get_kernel_drops;
 
   g_mutex_init (&priv->mutex);
 
@@ -182,6 +204,102 @@ socket_close (NiceSocket *sock)
   }
 }
 
+#ifdef SO_RXQ_OVFL
+/* Calls recvmsg() directly rather than g_socket_receive_message(), as GLib
+ * drops the control messages it has no #GSocketControlMessage type for, and
+ * SO_RXQ_OVFL comes with every datagram once the kernel has dropped one. */
+static gint
+socket_recv_messages (NiceSocket *sock,
+    NiceInputMessage *recv_messages, guint n_recv_messages)
+{
+  struct UdpBsdSocketPrivate *priv = sock->priv;
+  gint fd;
+  guint i;
+  gboolean error = FALSE;
+
+  G_STATIC_ASSERT (sizeof (GInputVector) == sizeof (struct iovec));
+  G_STATIC_ASSERT (G_STRUCT_OFFSET (GInputVector, buffer) ==
+      G_STRUCT_OFFSET (struct iovec, iov_base));
+  G_STATIC_ASSERT (G_STRUCT_OFFSET (GInputVector, size) ==
+      G_STRUCT_OFFSET (struct iovec, iov_len));
+
+  /* Make sure socket has not been freed: */
+  g_assert (sock->priv != NULL);
+
+  fd = g_socket_get_fd (sock->fileno);
+
+  /* Read messages into recv_messages until one fails or would block, or we
+   * reach the end. */
+  for (i = 0; i < n_recv_messages; i++) {
+    NiceInputMessage *recv_message = &recv_messages[i];
+    union {
+      struct sockaddr_storage storage;
+      struct sockaddr addr;
+    } sa;
+    union {
+      struct cmsghdr align;
+      guint8 buf[CMSG_SPACE (sizeof (guint32))];
+    } control;
+    struct msghdr msg = { 0, };
+    struct cmsghdr *cmsg;
+    gssize recvd;
+
+    msg.msg_name = &sa;
+    msg.msg_namelen = sizeof (sa);
+    msg.msg_iov = (struct iovec *) recv_message->buffers;
+    if (recv_message->n_buffers >= 0) {
+      msg.msg_iovlen = recv_message->n_buffers;
+    } else {
+      while (recv_message->buffers[msg.msg_iovlen].buffer != NULL)
+        msg.msg_iovlen++;
+    }
+    msg.msg_control = &control;
+    msg.msg_controllen = sizeof (control);
+
+    do {
+      recvd = recvmsg (fd, &msg, 0);
+    } while (recvd < 0 && errno == EINTR);
+
+    if (recvd < 0) {
+      /* Handle ECONNRESET here as if it were EWOULDBLOCK; see
+       * https://phabricator.freedesktop.org/T121 */
+      if (errno == EWOULDBLOCK || errno == EAGAIN || errno == ECONNRESET)
+        recvd = 0;
+      else if (errno == EMSGSIZE)
+        recvd = input_message_get_size (recv_message);
+      else
+        error = TRUE;
+    }
+
+    recv_message->length = MAX (recvd, 0);
+
+    if (recvd > 0) {
+      if (recv_message->from != NULL)
+        nice_address_set_from_sockaddr (recv_message->from, &sa.addr);
+
+      for (cmsg = CMSG_FIRSTHDR (&msg); cmsg != NULL;
+           cmsg = CMSG_NXTHDR (&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+          guint32 drops;
+
+          memcpy (&drops, CMSG_DATA (cmsg), sizeof (drops));
+          g_atomic_int_set (&priv->kernel_drops, drops);
+        }
+      }
+    }
+
+    /* Return early on error or EWOULDBLOCK. */
+    if (recvd <= 0)
+      break;
+  }
+
+  /* Was there an error processing the first message? */
+  if (error && i == 0)
+    return -1;
+
+  return i;
+}
+#else
 static gint
 socket_recv_messages (NiceSocket *sock,
     NiceInputMessage *recv_messages, guint n_recv_messages)
@@ -246,6 +364,7 @@ socket_recv_messages (NiceSocket *sock,
 
   return i;
 }
+#endif
 
 static gint
 socket_send_messages (NiceSocket *sock, const NiceAddress *to,
@@ -350,6 +469,82 @@ socket_send_messages (NiceSocket *sock, const NiceAddress *to,
   return len;
 }
 
+#ifdef HAVE_SENDMMSG
+/* Send every message to its own destination with as few sendmmsg() calls as
+ * the kernel allows. #GOutputVector has the layout of struct iovec, so the
+ * caller’s buffers are passed to the kernel as they are. */
+static gint
+socket_send_messages_to (NiceSocket *sock, const NiceAddress * const *to,
+    const NiceOutputMessage *messages, guint n_messages)
+{
+  struct mmsghdr *mmsgs;
+  struct sockaddr_storage *names;
+  guint n_sent = 0;
+  gint ret = 0;
+  guint i;
+
+  G_STATIC_ASSERT (sizeof (GOutputVector) == sizeof (struct iovec));
+  G_STATIC_ASSERT (G_STRUCT_OFFSET (GOutputVector, buffer) ==
+      G_STRUCT_OFFSET (struct iovec, iov_base));
+  G_STATIC_ASSERT (G_STRUCT_OFFSET (GOutputVector, size) ==
+      G_STRUCT_OFFSET (struct iovec, iov_len));
+
+  /* Make sure socket has not been freed: */
+  g_assert (sock->priv != NULL);
+
+  if (n_messages == 0)
+    return 0;
+
+  mmsgs = g_new0 (struct mmsghdr, n_messages);
+  names = g_new (struct sockaddr_storage, n_messages);
+
+  for (i = 0; i < n_messages; i++) {
+    const NiceOutputMessage *message = &messages[i];
+    struct msghdr *msg = &mmsgs[i].msg_hdr;
+    guint n_buffers = 0;
+
+    if (message->n_buffers >= 0)
+      n_buffers = message->n_buffers;
+    else
+      while (message->buffers[n_buffers].buffer != NULL)
+        n_buffers++;
+
+    nice_address_copy_to_sockaddr (to[i], (struct sockaddr *) &names[i]);
+    msg->msg_name = &names[i];
+    msg->msg_namelen = (names[i].ss_family == AF_INET6) ?
+        sizeof (struct sockaddr_in6) : sizeof (struct sockaddr_in);
+    msg->msg_iov = (struct iovec *) message->buffers;
+    msg->msg_iovlen = n_buffers;
+  }
+
+  while (n_sent < n_messages) {
+    ret = sendmmsg (g_socket_get_fd (sock->fileno), mmsgs + n_sent,
+        n_messages - n_sent, 0);
+
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno != EWOULDBLOCK && errno != EAGAIN)
+        nice_debug_verbose ("%s: udp-bsd socket %p: sendmmsg failed: %s",
+            G_STRFUNC, sock, g_strerror (errno));
+      else
+        ret = 0;
+      break;
+    }
+
+    n_sent += ret;
+  }
+
+  g_free (mmsgs);
+  g_free (names);
+
+  if (ret < 0 && n_sent == 0)
+    return -1;
+
+  return n_sent;
+}
+#endif
+
 static gint
 socket_send_messages_reliable (NiceSocket *sock, const NiceAddress *to,
     const NiceOutputMessage *messages, guint n_messages)
@@ -375,3 +570,10 @@ socket_set_writable_callback (NiceSocket *sock,
 {
 }
 
+static guint
+socket_get_kernel_drops (NiceSocket *sock)
+{
+  struct UdpBsdSocketPrivate *priv = sock->priv;
+
+  return (guint) g_atomic_int_get (&priv->kernel_drops);
+}
@@ -62,6 +62,10 @@ typedef struct {
   gsize recv_buf_len;  /* in bytes */
   guint expecting_len;
   NiceSocket *base_socket;
+  /* Innermost socket of base_socket's chain whose handshake is done, which
+   * the framed data goes through; see nice_socket_get_passthrough() */
+  NiceSocket *io_socket;
+  NiceAddress io_from;
 } TurnTcpPriv;
 
 typedef enum {
@@ -98,6 +102,8 @@ nice_udp_turn_over_tcp_socket_new (NiceSocket *base_socket,
 
   priv->compatibility = compatibility;
   priv->base_socket = base_socket;
+  priv->io_socket = base_socket;
+  nice_address_init (&priv->io_from);
 
   sock->type = NICE_SOCKET_TYPE_UDP_TURN_OVER_TCP;
   sock->fileno = priv->base_socket->fileno;
@@ -127,6 +133,32 @@ socket_close (NiceSocket *sock)
   sock->priv = NULL;
 }
 
+/* Skips the proxy layers which are done with their handshake */
+static void
+update_io_socket (TurnTcpPriv *priv)
+{
+  if (priv->io_socket->get_passthrough == NULL)
+    return;
+
+  priv->io_socket = nice_socket_get_passthrough (priv->base_socket,
+      &priv->io_from);
+}
+
+static gint
+recv_from_io_socket (TurnTcpPriv *priv, NiceInputMessage *message)
+{
+  gint ret;
+
+  ret = nice_socket_recv_messages (priv->io_socket, message, 1);
+
+  /* Report the address the skipped layers would have */
+  if (ret > 0 && message->from != NULL &&
+      nice_address_is_valid (&priv->io_from))
+    *message->from = priv->io_from;
+
+  return ret;
+}
+
 static gssize
 socket_recv_message (NiceSocket *sock, NiceInputMessage *recv_message)
 {
@@ -139,6 +171,8 @@ socket_recv_message (NiceSocket *sock, NiceInputMessage *recv_message)
   /* Make sure socket has not been freed: */
   g_assert (sock->priv != NULL);
 
+  update_io_socket (priv);
+
   if (priv->expecting_len == 0) {
     guint headerlen = 0;
 
@@ -158,7 +192,7 @@ socket_recv_message (NiceSocket *sock, NiceInputMessage *recv_message)
     local_recv_message.from = recv_message->from;
     local_recv_message.length = 0;
 
-    ret = nice_socket_recv_messages (priv->base_socket, &local_recv_message, 1);
+    ret = recv_from_io_socket (priv, &local_recv_message);
     if (ret < 0)
         return ret;
 
@@ -215,7 +249,7 @@ socket_recv_message (NiceSocket *sock, NiceInputMessage *recv_message)
   local_recv_message.from = recv_message->from;
   local_recv_message.length = 0;
 
-  ret = nice_socket_recv_messages (priv->base_socket, &local_recv_message, 1);
+  ret = recv_from_io_socket (priv, &local_recv_message);
   if (ret < 0)
       return ret;
 
@@ -367,11 +401,13 @@ socket_send_message (NiceSocket *sock, const NiceAddress *to,
   }
 
 
+  update_io_socket (priv);
+
   if (reliable)
-    ret = nice_socket_send_messages_reliable (priv->base_socket, to,
+    ret = nice_socket_send_messages_reliable (priv->io_socket, to,
         &local_message, 1);
   else
-    ret = nice_socket_send_messages (priv->base_socket, to, &local_message, 1);
+    ret = nice_socket_send_messages (priv->io_socket, to, &local_message, 1);
 
   if (ret == 1)
     ret = output_message_get_size (&local_message);
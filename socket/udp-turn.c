@@ -50,6 +50,7 @@
 #include "stun/stunagent.h"
 #include "stun/usages/timer.h"
 #include "agent-priv.h"
+#include "trace.h"
 
 #define STUN_END_TIMEOUT 8000
 #define STUN_MAX_MS_REALM_LEN 128 // as defined in [MS-TURN]
@@ -59,11 +60,24 @@
 
 static GMutex mutex;
 
-typedef struct {
+/* Control messages are encoded on the stack, then kept for retransmission in
+ * a buffer rounded up to TURN_MESSAGE_SIZE_STEP bytes. Freed buffers are
+ * recycled through one free list per size, up to TURN_MESSAGE_POOL_DEPTH
+ * each. */
+#define TURN_MESSAGE_MAX_SIZE STUN_MAX_MESSAGE_SIZE_IPV6
+#define TURN_MESSAGE_SIZE_STEP 256
+#define TURN_MESSAGE_N_SIZES (TURN_MESSAGE_MAX_SIZE / TURN_MESSAGE_SIZE_STEP)
+#define TURN_MESSAGE_POOL_DEPTH 8
+
+typedef struct _TURNMessage TURNMessage;
+
+struct _TURNMessage {
   StunMessage message;
-  uint8_t buffer[STUN_MAX_MESSAGE_SIZE];
   StunTimer timer;
-} TURNMessage;
+  TURNMessage *next_free;
+  gsize size;         /* of buffer */
+  uint8_t buffer[];
+};
 
 typedef struct {
   NiceAddress peer;
@@ -108,6 +122,10 @@ typedef struct {
 
   GByteArray *fragment_buffer;
   NiceAddress from;
+
+  TURNMessage *free_messages[TURN_MESSAGE_N_SIZES];
+  guint n_free_messages[TURN_MESSAGE_N_SIZES];
+  NiceUdpTurnMemoryUsage memory;
 } UdpTurnPriv;
 
 
@@ -152,6 +170,68 @@ static gboolean priv_add_channel_binding (UdpTurnPriv *priv,
 static gboolean priv_forget_send_request_timeout (gpointer pointer);
 static void priv_clear_permissions (UdpTurnPriv *priv);
 
+/* Copies the @len bytes long @message into a pooled buffer. Must be called
+ * with the mutex held. */
+static TURNMessage *
+turn_message_new (UdpTurnPriv *priv, const StunMessage *message, gsize len)
+{
+  TURNMessage *msg;
+  guint idx;
+  gsize size;
+
+  g_assert (len > 0 && len <= TURN_MESSAGE_MAX_SIZE);
+
+  idx = (len - 1) / TURN_MESSAGE_SIZE_STEP;
+  size = (idx + 1) * TURN_MESSAGE_SIZE_STEP;
+
+  msg = priv->free_messages[idx];
+  if (msg != NULL) {
+    priv->free_messages[idx] = msg->next_free;
+    priv->n_free_messages[idx]--;
+    priv->memory.pooled_bytes -= sizeof (TURNMessage) + size;
+    priv->memory.n_reuses++;
+  } else {
+    msg = g_malloc (sizeof (TURNMessage) + size);
+    msg->size = size;
+    priv->memory.n_allocs++;
+  }
+
+  memcpy (msg->buffer, message->buffer, len);
+  msg->message = *message;
+  msg->message.buffer = msg->buffer;
+  msg->message.buffer_len = msg->size;
+  memset (&msg->timer, 0, sizeof (msg->timer));
+  msg->next_free = NULL;
+
+  priv->memory.control_bytes += sizeof (TURNMessage) + size;
+  priv->memory.control_bytes_peak = MAX (priv->memory.control_bytes_peak,
+      priv->memory.control_bytes);
+
+  return msg;
+}
+
+/* Must be called with the mutex held. */
+static void
+turn_message_free (UdpTurnPriv *priv, TURNMessage *msg)
+{
+  guint idx;
+
+  if (msg == NULL)
+    return;
+
+  idx = msg->size / TURN_MESSAGE_SIZE_STEP - 1;
+  priv->memory.control_bytes -= sizeof (TURNMessage) + msg->size;
+
+  if (priv->n_free_messages[idx] < TURN_MESSAGE_POOL_DEPTH) {
+    msg->next_free = priv->free_messages[idx];
+    priv->free_messages[idx] = msg;
+    priv->n_free_messages[idx]++;
+    priv->memory.pooled_bytes += sizeof (TURNMessage) + msg->size;
+  } else {
+    g_free (msg);
+  }
+}
+
 static void
 send_request_free (SendRequest *r)
 {
@@ -279,6 +359,7 @@ socket_close (NiceSocket *sock)
 {
   UdpTurnPriv *priv = (UdpTurnPriv *) sock->priv;
   GList *i = NULL;
+  guint j;
 
   g_mutex_lock (&mutex);
 
@@ -322,8 +403,18 @@ socket_close (NiceSocket *sock)
     g_main_context_unref (priv->ctx);
 
   g_free (priv->current_binding);
-  g_free (priv->current_binding_msg);
-  g_list_free_full (priv->pending_permissions, g_free);
+  turn_message_free (priv, priv->current_binding_msg);
+  for (i = priv->pending_permissions; i; i = i->next)
+    turn_message_free (priv, i->data);
+  g_list_free (priv->pending_permissions);
+  for (j = 0; j < TURN_MESSAGE_N_SIZES; j++) {
+    while (priv->free_messages[j] != NULL) {
+      TURNMessage *msg = priv->free_messages[j];
+
+      priv->free_messages[j] = msg->next_free;
+      g_free (msg);
+    }
+  }
   g_free (priv->username);
   g_free (priv->password);
   g_free (priv->cached_realm);
@@ -810,6 +901,8 @@ socket_send_message (NiceSocket *sock, const NiceAddress *to,
 
   nice_address_copy_to_sockaddr (to, &sa.addr);
 
+  NICE_TRACE (turn__send, sock, message, binding ? binding->channel : 0);
+
   if (binding) {
     if (priv->compatibility == NICE_TURN_SOCKET_COMPATIBILITY_DRAFT9 ||
         priv->compatibility == NICE_TURN_SOCKET_COMPATIBILITY_RFC5766) {
@@ -1388,7 +1481,7 @@ nice_udp_turn_socket_parse_recv (NiceSocket *sock, NiceSocket **from_sock,
           stun_message_id (&priv->current_binding_msg->message, request_id);
           if (memcmp (request_id, response_id,
                   sizeof(StunTransactionId)) == 0) {
-            g_free (priv->current_binding_msg);
+            turn_message_free (priv, priv->current_binding_msg);
             priv->current_binding_msg = NULL;
 
             if (stun_message_get_class (&msg) == STUN_RESPONSE &&
@@ -1468,7 +1561,7 @@ nice_udp_turn_socket_parse_recv (NiceSocket *sock, NiceSocket **from_sock,
                               memcmp (sent_realm, recv_realm,
                                   sent_realm_len) == 0)))) {
 
-                g_free (priv->current_binding_msg);
+                turn_message_free (priv, priv->current_binding_msg);
                 priv->current_binding_msg = NULL;
                 nice_udp_turn_socket_cache_realm_nonce_locked (sock, &msg);
                 if (binding)
@@ -1477,12 +1570,12 @@ nice_udp_turn_socket_parse_recv (NiceSocket *sock, NiceSocket **from_sock,
               } else {
                 g_free (priv->current_binding);
                 priv->current_binding = NULL;
-                g_free (priv->current_binding_msg);
+                turn_message_free (priv, priv->current_binding_msg);
                 priv->current_binding_msg = NULL;
                 priv_process_pending_bindings (priv);
               }
             } else if (stun_message_get_class (&msg) == STUN_RESPONSE) {
-              g_free (priv->current_binding_msg);
+              turn_message_free (priv, priv->current_binding_msg);
               priv->current_binding_msg = NULL;
 
               /* If it's a new channel binding, then add it to the list */
@@ -1572,7 +1665,7 @@ nice_udp_turn_socket_parse_recv (NiceSocket *sock, NiceSocket **from_sock,
 
                 priv->pending_permissions = g_list_delete_link (
                     priv->pending_permissions, i);
-                g_free (current_create_permission_msg);
+                turn_message_free (priv, current_create_permission_msg);
                 current_create_permission_msg = NULL;
 
                 nice_udp_turn_socket_cache_realm_nonce_locked (sock, &msg);
@@ -1603,7 +1696,7 @@ nice_udp_turn_socket_parse_recv (NiceSocket *sock, NiceSocket **from_sock,
 
             priv->pending_permissions = g_list_delete_link (
                 priv->pending_permissions, i);
-            g_free (current_create_permission_msg);
+            turn_message_free (priv, current_create_permission_msg);
             current_create_permission_msg = NULL;
 
             break;
@@ -1683,6 +1776,8 @@ nice_udp_turn_socket_parse_recv (NiceSocket *sock, NiceSocket **from_sock,
     *from = *recv_from;
   }
 
+  NICE_TRACE (turn__recv, sock, recv_len, binding ? binding->channel : 0);
+
   memmove (buf, recv_buf.u8, len > recv_len ? recv_len : len);
   g_mutex_unlock (&mutex);
   return len > recv_len ? recv_len : len;
@@ -1769,7 +1864,7 @@ priv_retransmissions_tick_unlocked (UdpTurnPriv *priv)
 
           g_free (priv->current_binding);
           priv->current_binding = NULL;
-          g_free (priv->current_binding_msg);
+          turn_message_free (priv, priv->current_binding_msg);
           priv->current_binding_msg = NULL;
 
 
@@ -1828,7 +1923,7 @@ priv_retransmissions_create_permission_tick_unlocked (UdpTurnPriv *priv, GList *
           priv_remove_sent_permission_for_peer (priv, &to);
           priv->pending_permissions = g_list_delete_link (
               priv->pending_permissions, list_element);
-          g_free (current_create_permission_msg);
+          turn_message_free (priv, current_create_permission_msg);
           current_create_permission_msg = NULL;
 
           /* we got a timeout when retransmitting a CreatePermission
@@ -1978,7 +2073,7 @@ priv_send_turn_message (UdpTurnPriv *priv, TURNMessage *msg)
   size_t stun_len = stun_message_length (&msg->message);
 
   if (priv->current_binding_msg) {
-    g_free (priv->current_binding_msg);
+    turn_message_free (priv, priv->current_binding_msg);
     priv->current_binding_msg = NULL;
   }
 
@@ -2006,7 +2101,9 @@ priv_send_create_permission(UdpTurnPriv *priv,
 {
   guint msg_buf_len;
   gboolean res = FALSE;
-  TURNMessage *msg = g_new0 (TURNMessage, 1);
+  StunMessage message;
+  uint8_t buffer[TURN_MESSAGE_MAX_SIZE];
+  TURNMessage *msg;
   union {
     struct sockaddr_storage storage;
     struct sockaddr addr;
@@ -2020,9 +2117,9 @@ priv_send_create_permission(UdpTurnPriv *priv,
   nice_address_copy_to_sockaddr (peer, &addr.addr);
 
   /* send CreatePermission */
-  msg_buf_len = stun_usage_turn_create_permission(&priv->agent, &msg->message,
-      msg->buffer,
-      sizeof(msg->buffer),
+  msg_buf_len = stun_usage_turn_create_permission(&priv->agent, &message,
+      buffer,
+      sizeof(buffer),
       priv->username,
       priv->username_len,
       priv->password,
@@ -2033,6 +2130,8 @@ priv_send_create_permission(UdpTurnPriv *priv,
       STUN_USAGE_TURN_COMPATIBILITY_RFC5766);
 
   if (msg_buf_len > 0) {
+    msg = turn_message_new (priv, &message, msg_buf_len);
+
     if (nice_socket_is_reliable (priv->base_socket)) {
       res = _socket_send_wrapped (priv->base_socket, &priv->server_addr,
           msg_buf_len, (gchar *) msg->buffer, TRUE);
@@ -2054,8 +2153,6 @@ priv_send_create_permission(UdpTurnPriv *priv,
 
     priv->pending_permissions = g_list_append (priv->pending_permissions, msg);
     priv_schedule_tick (priv);
-  } else {
-    g_free(msg);
   }
 
   return res;
@@ -2071,28 +2168,26 @@ priv_send_channel_bind (UdpTurnPriv *priv, uint16_t channel,
     struct sockaddr_storage storage;
     struct sockaddr addr;
   } sa;
-  TURNMessage *msg = g_new0 (TURNMessage, 1);
+  StunMessage message;
+  uint8_t buffer[TURN_MESSAGE_MAX_SIZE];
 
   nice_address_copy_to_sockaddr (peer, &sa.addr);
 
-  if (!stun_agent_init_request (&priv->agent, &msg->message,
-          msg->buffer, sizeof(msg->buffer),
+  if (!stun_agent_init_request (&priv->agent, &message,
+          buffer, sizeof(buffer),
           STUN_CHANNELBIND)) {
-    g_free (msg);
     return FALSE;
   }
 
-  if (stun_message_append32 (&msg->message, STUN_ATTRIBUTE_CHANNEL_NUMBER,
+  if (stun_message_append32 (&message, STUN_ATTRIBUTE_CHANNEL_NUMBER,
           channel_attr) != STUN_MESSAGE_RETURN_SUCCESS) {
-    g_free (msg);
     return FALSE;
   }
 
-  if (stun_message_append_xor_addr (&msg->message, STUN_ATTRIBUTE_PEER_ADDRESS,
+  if (stun_message_append_xor_addr (&message, STUN_ATTRIBUTE_PEER_ADDRESS,
           &sa.storage,
           sizeof(sa))
       != STUN_MESSAGE_RETURN_SUCCESS) {
-    g_free (msg);
     return FALSE;
   }
 
@@ -2100,37 +2195,33 @@ priv_send_channel_bind (UdpTurnPriv *priv, uint16_t channel,
       priv->cached_realm != NULL && priv->cached_realm_len > 0 &&
       priv->cached_nonce != NULL && priv->cached_nonce_len > 0) {
 
-    if (stun_message_append_bytes (&msg->message, STUN_ATTRIBUTE_USERNAME,
+    if (stun_message_append_bytes (&message, STUN_ATTRIBUTE_USERNAME,
             priv->username, priv->username_len)
         != STUN_MESSAGE_RETURN_SUCCESS) {
-      g_free (msg);
       return FALSE;
     }
 
-    if (stun_message_append_bytes (&msg->message, STUN_ATTRIBUTE_REALM,
+    if (stun_message_append_bytes (&message, STUN_ATTRIBUTE_REALM,
             priv->cached_realm,  priv->cached_realm_len)
         != STUN_MESSAGE_RETURN_SUCCESS) {
-      g_free (msg);
       return 0;
     }
 
-    if (stun_message_append_bytes (&msg->message, STUN_ATTRIBUTE_NONCE,
+    if (stun_message_append_bytes (&message, STUN_ATTRIBUTE_NONCE,
             priv->cached_nonce, priv->cached_nonce_len)
         != STUN_MESSAGE_RETURN_SUCCESS) {
-      g_free (msg);
       return 0;
     }
   }
 
-  stun_len = stun_agent_finish_message (&priv->agent, &msg->message,
+  stun_len = stun_agent_finish_message (&priv->agent, &message,
       priv->password, priv->password_len);
 
   if (stun_len > 0) {
-    priv_send_turn_message (priv, msg);
+    priv_send_turn_message (priv, turn_message_new (priv, &message, stun_len));
     return TRUE;
   }
 
-  g_free (msg);
   return FALSE;
 }
 
@@ -2177,57 +2268,55 @@ priv_add_channel_binding (UdpTurnPriv *priv, const NiceAddress *peer)
     return FALSE;
   } else if (priv->compatibility == NICE_TURN_SOCKET_COMPATIBILITY_MSN ||
       priv->compatibility == NICE_TURN_SOCKET_COMPATIBILITY_OC2007) {
-    TURNMessage *msg = g_new0 (TURNMessage, 1);
-    if (!stun_agent_init_request (&priv->agent, &msg->message,
-            msg->buffer, sizeof(msg->buffer),
+    StunMessage message;
+    uint8_t buffer[TURN_MESSAGE_MAX_SIZE];
+
+    if (!stun_agent_init_request (&priv->agent, &message,
+            buffer, sizeof(buffer),
             STUN_OLD_SET_ACTIVE_DST)) {
-      g_free (msg);
       return FALSE;
     }
 
-    if (stun_message_append32 (&msg->message, STUN_ATTRIBUTE_MAGIC_COOKIE,
+    if (stun_message_append32 (&message, STUN_ATTRIBUTE_MAGIC_COOKIE,
             TURN_MAGIC_COOKIE)
         != STUN_MESSAGE_RETURN_SUCCESS) {
-      g_free (msg);
       return FALSE;
     }
 
     if (priv->username != NULL && priv->username_len > 0) {
-      if (stun_message_append_bytes (&msg->message, STUN_ATTRIBUTE_USERNAME,
+      if (stun_message_append_bytes (&message, STUN_ATTRIBUTE_USERNAME,
               priv->username, priv->username_len)
           != STUN_MESSAGE_RETURN_SUCCESS) {
-        g_free (msg);
         return FALSE;
       }
     }
 
     if (priv->compatibility == NICE_TURN_SOCKET_COMPATIBILITY_OC2007) {
       if (priv->ms_connection_id_valid)
-        stun_message_append_ms_connection_id(&msg->message,
+        stun_message_append_ms_connection_id(&message,
             priv->ms_connection_id, ++priv->ms_sequence_num);
 
-      stun_message_ensure_ms_realm(&msg->message, priv->ms_realm);
+      stun_message_ensure_ms_realm(&message, priv->ms_realm);
     }
 
-    if (stun_message_append_addr (&msg->message,
+    if (stun_message_append_addr (&message,
             STUN_ATTRIBUTE_DESTINATION_ADDRESS,
             &sa.addr, sizeof(sa))
         != STUN_MESSAGE_RETURN_SUCCESS) {
-      g_free (msg);
       return FALSE;
     }
 
-    stun_len = stun_agent_finish_message (&priv->agent, &msg->message,
+    stun_len = stun_agent_finish_message (&priv->agent, &message,
         priv->password, priv->password_len);
 
     if (stun_len > 0) {
       priv->current_binding = g_new0 (ChannelBinding, 1);
       priv->current_binding->channel = 0;
       priv->current_binding->peer = *peer;
-      priv_send_turn_message (priv, msg);
+      priv_send_turn_message (priv,
+          turn_message_new (priv, &message, stun_len));
       return TRUE;
     }
-    g_free (msg);
     return FALSE;
   } else if (priv->compatibility == NICE_TURN_SOCKET_COMPATIBILITY_GOOGLE) {
     priv->current_binding = g_new0 (ChannelBinding, 1);
@@ -2273,3 +2362,16 @@ nice_udp_turn_socket_set_ms_connection_id (NiceSocket *sock, StunMessage *msg)
     g_mutex_unlock (&mutex);
   }
 }
+
+void
+nice_udp_turn_socket_get_memory_usage (NiceSocket *sock,
+    NiceUdpTurnMemoryUsage *usage)
+{
+  UdpTurnPriv *priv = (UdpTurnPriv *) sock->priv;
+
+  g_return_if_fail (sock->type == NICE_SOCKET_TYPE_UDP_TURN);
+
+  g_mutex_lock (&mutex);
+  *usage = priv->memory;
+  g_mutex_unlock (&mutex);
+}
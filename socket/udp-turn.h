@@ -79,6 +79,30 @@ nice_udp_turn_socket_set_ms_connection_id (NiceSocket *sock, StunMessage *msg);
 void
 nice_udp_turn_socket_cache_realm_nonce (NiceSocket *sock, StunMessage *msg);
 
+/*
+ * NiceUdpTurnMemoryUsage:
+ * @control_bytes: bytes held by control messages (Refresh excepted) awaiting
+ * a response from the server
+ * @control_bytes_peak: the highest @control_bytes has been
+ * @pooled_bytes: bytes kept for reuse by later control messages
+ * @n_allocs: number of control message buffers allocated from the heap
+ * @n_reuses: number of control message buffers taken from the pool instead
+ *
+ * Memory used by a TURN socket for its CreatePermission, ChannelBind and
+ * SetActiveDestination requests.
+ */
+typedef struct {
+  gsize control_bytes;
+  gsize control_bytes_peak;
+  gsize pooled_bytes;
+  guint64 n_allocs;
+  guint64 n_reuses;
+} NiceUdpTurnMemoryUsage;
+
+void
+nice_udp_turn_socket_get_memory_usage (NiceSocket *sock,
+    NiceUdpTurnMemoryUsage *usage);
+
 
 G_END_DECLS
 
@@ -0,0 +1,802 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * (C) 2026 Collabora Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the Nice GLib ICE library.
+ *
+ * The Initial Developers of the Original Code are Collabora Ltd and Nokia
+ * Corporation. All Rights Reserved.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+
+/*
+ * Implementation of the UDP socket interface on top of io_uring. Datagrams
+ * are received by a multishot recvmsg into a ring of kernel-provided buffers,
+ * so a burst of packets costs no syscall at all, and the socket's source is
+ * woken by completions rather than by readiness. Sends are copied into
+ * preallocated slots and all the messages of one send_messages() call are
+ * submitted, and their completions reaped, with a single io_uring_enter():
+ * they are linked and non-blocking, so that like with sendmmsg() the first
+ * failure stops the batch and is reported to the caller.
+ *
+ * The socket is bound, and oversized datagrams are sent, by a wrapped udp-bsd
+ * socket.
+ */
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "udp-uring.h"
+
+#ifdef HAVE_LIBURING
+
+#include <string.h>
+#include <errno.h>
+
+#include <liburing.h>
+
+#include "agent-priv.h"
+
+/* Receive buffers in the provided buffer ring; must be a power of two. */
+#define RECV_BUF_COUNT 256
+/* Large enough for any datagram on a standard MTU path; anything longer
+ * arrives truncated, and is dropped and counted with the kernel drops. */
+#define RECV_BUF_SIZE 2048
+#define RECV_BUF_GROUP 0
+
+#define SEND_SLOT_COUNT 128
+#define SEND_SLOT_SIZE 2048
+
+#define RECV_TAG 1
+#define CANCEL_TAG 2
+
+typedef struct {
+  struct msghdr msg;
+  struct iovec iov;
+  union {
+    struct sockaddr_storage storage;
+    struct sockaddr addr;
+  } name;
+  guint8 data[SEND_SLOT_SIZE];
+} SendSlot;
+
+typedef struct
+{
+  volatile gint ref_count;
+  NiceSocket *base_socket;  /* owned; NULL once closed */
+  gint closed;  /* atomic */
+
+  GMutex recv_mutex;
+  /* protected by recv_mutex */
+  struct io_uring recv_ring;
+  struct io_uring_buf_ring *buf_ring;
+  guint8 *recv_bufs;
+  struct msghdr recv_msg;  /* layout of the provided buffers */
+  gboolean recv_armed;
+  gint kernel_drops;  /* atomic; as last reported by SO_RXQ_OVFL */
+  gint truncated_drops;  /* atomic; datagrams longer than RECV_BUF_SIZE */
+
+  GMutex send_mutex;
+  /* protected by send_mutex */
+  struct io_uring send_ring;
+  SendSlot *send_slots;
+  guint *free_slots;  /* stack of indices into send_slots */
+  guint n_free_slots;
+} UdpUringPrivate;
+
+typedef struct {
+  GSource source;
+  UdpUringPrivate *priv;  /* owned */
+  GSocket *gsock;  /* owned */
+  gpointer tag;
+} UdpUringSource;
+
+static void socket_close (NiceSocket *sock);
+static gint socket_recv_messages (NiceSocket *sock,
+    NiceInputMessage *recv_messages, guint n_recv_messages);
+static gint socket_send_messages (NiceSocket *sock, const NiceAddress *to,
+    const NiceOutputMessage *messages, guint n_messages);
+static gint socket_send_messages_reliable (NiceSocket *sock,
+    const NiceAddress *to, const NiceOutputMessage *messages, guint n_messages);
+static gint socket_send_messages_to (NiceSocket *sock,
+    const NiceAddress * const *to, const NiceOutputMessage *messages,
+    guint n_messages);
+static gboolean socket_is_reliable (NiceSocket *sock);
+static gboolean socket_can_send (NiceSocket *sock, NiceAddress *addr);
+static void socket_set_writable_callback (NiceSocket *sock,
+    NiceSocketWritableCb callback, gpointer user_data);
+static gboolean socket_is_based_on (NiceSocket *sock, NiceSocket *other);
+static GSource *socket_create_source (NiceSocket *sock);
+static guint socket_get_kernel_drops (NiceSocket *sock);
+
+/* Multishot recvmsg landed in Linux 6.0, together with IORING_OP_SEND_ZC,
+ * which, unlike the former, can be probed for. */
+static gboolean
+kernel_supports_multishot_recv (struct io_uring *ring)
+{
+  struct io_uring_probe *probe;
+  gboolean ret;
+
+  probe = io_uring_get_probe_ring (ring);
+  if (probe == NULL)
+    return FALSE;
+
+  ret = io_uring_opcode_supported (probe, IORING_OP_SEND_ZC);
+  io_uring_free_probe (probe);
+
+  return ret;
+}
+
+/* Must be called with recv_mutex held. */
+static void
+recv_arm (UdpUringPrivate *priv)
+{
+  struct io_uring_sqe *sqe;
+
+  sqe = io_uring_get_sqe (&priv->recv_ring);
+  if (sqe == NULL)
+    return;
+
+  io_uring_prep_recvmsg_multishot (sqe,
+      g_socket_get_fd (priv->base_socket->fileno), &priv->recv_msg, 0);
+  sqe->flags |= IOSQE_BUFFER_SELECT;
+  sqe->buf_group = RECV_BUF_GROUP;
+  io_uring_sqe_set_data64 (sqe, RECV_TAG);
+
+  if (io_uring_submit (&priv->recv_ring) >= 0)
+    priv->recv_armed = TRUE;
+}
+
+/* Must be called with send_mutex held. */
+static void
+send_reap (UdpUringPrivate *priv)
+{
+  struct io_uring_cqe *cqe;
+
+  while (io_uring_peek_cqe (&priv->send_ring, &cqe) == 0) {
+    guint slot = io_uring_cqe_get_data64 (cqe);
+
+    if (cqe->res < 0)
+      nice_debug_verbose ("%s: udp-uring send failed: %s", G_STRFUNC,
+          g_strerror (-cqe->res));
+
+    priv->free_slots[priv->n_free_slots++] = slot;
+    io_uring_cqe_seen (&priv->send_ring, cqe);
+  }
+}
+
+/* Submits the @n_queued linked sends and reaps their completions. Returns
+ * how many were sent, stopping at the first failure, whose error is then
+ * returned in @error. Must be called with send_mutex held. */
+static guint
+send_submit (UdpUringPrivate *priv, guint n_queued, gint *error)
+{
+  struct io_uring_cqe *cqe;
+  guint n_sent = 0;
+  guint n_reaped = 0;
+  gint ret;
+
+  *error = 0;
+
+  /* The sends don’t block, so they all complete within this call */
+  ret = io_uring_submit_and_wait (&priv->send_ring, n_queued);
+  if (ret < 0 && ret != -EINTR) {
+    /* Nothing was submitted: the slots come back with the next batch */
+    *error = ret;
+    return 0;
+  }
+
+  while (n_reaped < n_queued) {
+    ret = io_uring_wait_cqe (&priv->send_ring, &cqe);
+
+    if (ret == -EINTR)
+      continue;
+    else if (ret < 0)
+      break;
+
+    /* Sends after a failed one in the chain complete with -ECANCELED */
+    if (cqe->res >= 0 && *error == 0)
+      n_sent++;
+    else if (*error == 0 || *error == -ECANCELED)
+      *error = cqe->res;
+
+    priv->free_slots[priv->n_free_slots++] = io_uring_cqe_get_data64 (cqe);
+    io_uring_cqe_seen (&priv->send_ring, cqe);
+    n_reaped++;
+  }
+
+  /* Completions left over would be taken for the next batch */
+  if (n_reaped < n_queued && *error == 0)
+    *error = -EIO;
+
+  return n_sent;
+}
+
+static UdpUringPrivate *
+udp_uring_private_ref (UdpUringPrivate *priv)
+{
+  g_atomic_int_inc (&priv->ref_count);
+  return priv;
+}
+
+static void
+udp_uring_private_unref (UdpUringPrivate *priv)
+{
+  if (!g_atomic_int_dec_and_test (&priv->ref_count))
+    return;
+
+  /* Don’t free slots the kernel may still be reading from. */
+  g_mutex_lock (&priv->send_mutex);
+  while (priv->n_free_slots < SEND_SLOT_COUNT) {
+    struct io_uring_cqe *cqe;
+
+    if (io_uring_wait_cqe (&priv->send_ring, &cqe) < 0)
+      break;
+    send_reap (priv);
+  }
+  g_mutex_unlock (&priv->send_mutex);
+
+  io_uring_free_buf_ring (&priv->recv_ring, priv->buf_ring, RECV_BUF_COUNT,
+      RECV_BUF_GROUP);
+  io_uring_queue_exit (&priv->recv_ring);
+  io_uring_queue_exit (&priv->send_ring);
+
+  g_free (priv->recv_bufs);
+  g_free (priv->send_slots);
+  g_free (priv->free_slots);
+  g_mutex_clear (&priv->recv_mutex);
+  g_mutex_clear (&priv->send_mutex);
+  g_slice_free (UdpUringPrivate, priv);
+}
+
+NiceSocket *
+nice_udp_uring_socket_new (NiceAddress *addr)
+{
+  NiceSocket *base_socket;
+  NiceSocket *sock;
+  UdpUringPrivate *priv;
+  struct io_uring_params params;
+  gint ret;
+  guint i;
+
+  priv = g_slice_new0 (UdpUringPrivate);
+
+  /* Every receive buffer may be waiting in the completion queue, plus the
+   * completion ending the multishot request when they run out. */
+  memset (&params, 0, sizeof (params));
+  params.flags = IORING_SETUP_CQSIZE;
+  params.cq_entries = 2 * RECV_BUF_COUNT;
+
+  ret = io_uring_queue_init_params (4, &priv->recv_ring, &params);
+  if (ret < 0) {
+    nice_debug ("io_uring is not available: %s", g_strerror (-ret));
+    g_slice_free (UdpUringPrivate, priv);
+    return NULL;
+  }
+
+  if (!kernel_supports_multishot_recv (&priv->recv_ring)) {
+    nice_debug ("io_uring lacks multishot receive");
+    io_uring_queue_exit (&priv->recv_ring);
+    g_slice_free (UdpUringPrivate, priv);
+    return NULL;
+  }
+
+  ret = io_uring_queue_init (SEND_SLOT_COUNT, &priv->send_ring, 0);
+  if (ret < 0) {
+    nice_debug ("Could not create io_uring send ring: %s", g_strerror (-ret));
+    io_uring_queue_exit (&priv->recv_ring);
+    g_slice_free (UdpUringPrivate, priv);
+    return NULL;
+  }
+
+  priv->buf_ring = io_uring_setup_buf_ring (&priv->recv_ring, RECV_BUF_COUNT,
+      RECV_BUF_GROUP, 0, &ret);
+  if (priv->buf_ring == NULL) {
+    nice_debug ("Could not register io_uring buffer ring: %s",
+        g_strerror (-ret));
+    io_uring_queue_exit (&priv->recv_ring);
+    io_uring_queue_exit (&priv->send_ring);
+    g_slice_free (UdpUringPrivate, priv);
+    return NULL;
+  }
+
+  base_socket = nice_udp_bsd_socket_new (addr);
+  if (base_socket == NULL) {
+    io_uring_free_buf_ring (&priv->recv_ring, priv->buf_ring, RECV_BUF_COUNT,
+        RECV_BUF_GROUP);
+    io_uring_queue_exit (&priv->recv_ring);
+    io_uring_queue_exit (&priv->send_ring);
+    g_slice_free (UdpUringPrivate, priv);
+    return NULL;
+  }
+
+  priv->ref_count = 1;
+  priv->base_socket = base_socket;
+  g_mutex_init (&priv->recv_mutex);
+  g_mutex_init (&priv->send_mutex);
+
+  priv->recv_bufs = g_malloc (RECV_BUF_COUNT * RECV_BUF_SIZE);
+  for (i = 0; i < RECV_BUF_COUNT; i++)
+    io_uring_buf_ring_add (priv->buf_ring, priv->recv_bufs + i * RECV_BUF_SIZE,
+        RECV_BUF_SIZE, i, io_uring_buf_ring_mask (RECV_BUF_COUNT), i);
+  io_uring_buf_ring_advance (priv->buf_ring, RECV_BUF_COUNT);
+
+  priv->recv_msg.msg_namelen = sizeof (struct sockaddr_storage);
+#ifdef SO_RXQ_OVFL
+  /* Room for the drop counter enabled on the base socket */
+  priv->recv_msg.msg_controllen = CMSG_SPACE (sizeof (guint32));
+#endif
+
+  priv->send_slots = g_new0 (SendSlot, SEND_SLOT_COUNT);
+  priv->free_slots = g_new (guint, SEND_SLOT_COUNT);
+  for (i = 0; i < SEND_SLOT_COUNT; i++) {
+    SendSlot *slot = &priv->send_slots[i];
+
+    slot->iov.iov_base = slot->data;
+    slot->msg.msg_iov = &slot->iov;
+    slot->msg.msg_iovlen = 1;
+    slot->msg.msg_name = &slot->name;
+    priv->free_slots[i] = SEND_SLOT_COUNT - 1 - i;
+  }
+  priv->n_free_slots = SEND_SLOT_COUNT;
+
+  g_mutex_lock (&priv->recv_mutex);
+  recv_arm (priv);
+  g_mutex_unlock (&priv->recv_mutex);
+
+  sock = g_slice_new0 (NiceSocket);
+  sock->type = NICE_SOCKET_TYPE_UDP_BSD;
+  sock->fileno = base_socket->fileno;
+  sock->addr = base_socket->addr;
+  sock->send_messages = socket_send_messages;
+  sock->send_messages_reliable = socket_send_messages_reliable;
+  sock->send_messages_to = socket_send_messages_to;
+  sock->recv_messages = socket_recv_messages;
+  sock->is_reliable = socket_is_reliable;
+  sock->can_send = socket_can_send;
+  sock->set_writable_callback = socket_set_writable_callback;
+  sock->is_based_on = socket_is_based_on;
+  sock->close = socket_close;
+  sock->create_source = socket_create_source;
+  sock->get_kernel_drops = socket_get_kernel_drops;
+  sock->priv = priv;
+
+  return sock;
+}
+
+static void
+socket_close (NiceSocket *sock)
+{
+  UdpUringPrivate *priv = sock->priv;
+  struct io_uring_sqe *sqe;
+
+  /* The ring holds its own reference to the file: stop receiving, so the port
+   * is released as soon as the base socket is closed. */
+  g_mutex_lock (&priv->recv_mutex);
+  sqe = io_uring_get_sqe (&priv->recv_ring);
+  if (sqe != NULL) {
+    io_uring_prep_cancel64 (sqe, RECV_TAG, 0);
+    io_uring_sqe_set_data64 (sqe, CANCEL_TAG);
+    io_uring_submit (&priv->recv_ring);
+  }
+  priv->recv_armed = TRUE;  /* never re-arm */
+
+  /* Sources may outlive the socket, but won’t dispatch once it is closed. */
+  g_atomic_int_set (&priv->closed, TRUE);
+  g_mutex_lock (&priv->send_mutex);
+  nice_socket_free (priv->base_socket);
+  priv->base_socket = NULL;
+  g_mutex_unlock (&priv->send_mutex);
+  g_mutex_unlock (&priv->recv_mutex);
+
+  sock->fileno = NULL;
+  sock->priv = NULL;
+  udp_uring_private_unref (priv);
+}
+
+/* Copy a received datagram into @message, truncating it like recvmsg()
+ * would. */
+static void
+copy_to_input_message (NiceInputMessage *message, const guint8 *data,
+    gsize length)
+{
+  guint i;
+
+  message->length = 0;
+
+  for (i = 0;
+       length > 0 &&
+       ((message->n_buffers >= 0 && i < (guint) message->n_buffers) ||
+        (message->n_buffers < 0 && message->buffers[i].buffer != NULL));
+       i++) {
+    gsize len = MIN (message->buffers[i].size, length);
+
+    memcpy (message->buffers[i].buffer, data, len);
+    data += len;
+    length -= len;
+    message->length += len;
+  }
+}
+
+static gint
+socket_recv_messages (NiceSocket *sock,
+    NiceInputMessage *recv_messages, guint n_recv_messages)
+{
+  UdpUringPrivate *priv = sock->priv;
+  struct io_uring_cqe *cqe;
+  gboolean error = FALSE;
+  guint i = 0;
+
+  /* Make sure socket has not been freed: */
+  g_assert (sock->priv != NULL);
+
+  g_mutex_lock (&priv->recv_mutex);
+
+  while (i < n_recv_messages &&
+      io_uring_peek_cqe (&priv->recv_ring, &cqe) == 0) {
+    NiceInputMessage *recv_message = &recv_messages[i];
+    struct io_uring_recvmsg_out *out;
+    guint8 *buf;
+    guint bid;
+
+    if (io_uring_cqe_get_data64 (cqe) != RECV_TAG) {
+      io_uring_cqe_seen (&priv->recv_ring, cqe);
+      continue;
+    }
+
+    /* The multishot request ends on errors, including running out of
+     * buffers; it is re-armed below. */
+    if (!(cqe->flags & IORING_CQE_F_MORE))
+      priv->recv_armed = FALSE;
+
+    if (!(cqe->flags & IORING_CQE_F_BUFFER)) {
+      if (cqe->res < 0 && cqe->res != -ENOBUFS && cqe->res != -ECANCELED) {
+        nice_debug ("%s: udp-uring socket %p: receive failed: %s", G_STRFUNC,
+            sock, g_strerror (-cqe->res));
+        error = TRUE;
+      }
+      io_uring_cqe_seen (&priv->recv_ring, cqe);
+      if (error)
+        break;
+      continue;
+    }
+
+    bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+    buf = priv->recv_bufs + bid * RECV_BUF_SIZE;
+
+    out = io_uring_recvmsg_validate (buf, cqe->res, &priv->recv_msg);
+    if (out != NULL && (out->flags & MSG_TRUNC)) {
+      nice_debug_verbose ("%s: udp-uring socket %p: dropping a datagram "
+          "longer than %u bytes", G_STRFUNC, sock, RECV_BUF_SIZE);
+      g_atomic_int_inc (&priv->truncated_drops);
+    } else if (out != NULL) {
+      copy_to_input_message (recv_message,
+          io_uring_recvmsg_payload (out, &priv->recv_msg),
+          io_uring_recvmsg_payload_length (out, cqe->res, &priv->recv_msg));
+
+      if (recv_message->from != NULL)
+        nice_address_set_from_sockaddr (recv_message->from,
+            io_uring_recvmsg_name (out));
+
+#ifdef SO_RXQ_OVFL
+      {
+        struct cmsghdr *cmsg;
+
+        for (cmsg = io_uring_recvmsg_cmsg_firsthdr (out, &priv->recv_msg);
+             cmsg != NULL;
+             cmsg = io_uring_recvmsg_cmsg_nexthdr (out, &priv->recv_msg,
+                 cmsg)) {
+          if (cmsg->cmsg_level == SOL_SOCKET &&
+              cmsg->cmsg_type == SO_RXQ_OVFL) {
+            guint32 drops;
+
+            memcpy (&drops, CMSG_DATA (cmsg), sizeof (drops));
+            g_atomic_int_set (&priv->kernel_drops, drops);
+          }
+        }
+      }
+#endif
+
+      i++;
+    }
+
+    /* Hand the buffer straight back to the kernel. */
+    io_uring_buf_ring_add (priv->buf_ring, buf, RECV_BUF_SIZE, bid,
+        io_uring_buf_ring_mask (RECV_BUF_COUNT), 0);
+    io_uring_buf_ring_advance (priv->buf_ring, 1);
+    io_uring_cqe_seen (&priv->recv_ring, cqe);
+  }
+
+  if (!priv->recv_armed)
+    recv_arm (priv);
+
+  g_mutex_unlock (&priv->recv_mutex);
+
+  /* Was there an error processing the first message? */
+  if (error && i == 0)
+    return -1;
+
+  return i;
+}
+
+/* Submits the chain of @n_queued sends which starts with message
+ * @chain_start of the call. Returns FALSE if one of them failed, with what
+ * udp-bsd returns in that case in @ret: the number of messages sent before,
+ * 0 if the socket would block, and -1 otherwise. Must be called with
+ * send_mutex held. */
+static gboolean
+send_flush (NiceSocket *sock, guint chain_start, guint n_queued, gint *ret)
+{
+  UdpUringPrivate *priv = sock->priv;
+  guint n_sent;
+  gint error;
+
+  if (n_queued == 0)
+    return TRUE;
+
+  n_sent = send_submit (priv, n_queued, &error);
+  if (n_sent == n_queued)
+    return TRUE;
+
+  if (chain_start + n_sent > 0) {
+    *ret = chain_start + n_sent;
+  } else if (error == -EAGAIN || error == -EWOULDBLOCK) {
+    *ret = 0;
+  } else {
+    nice_debug_verbose ("%s: udp-uring socket %p: send failed: %s", G_STRFUNC,
+        sock, g_strerror (-error));
+    *ret = -1;
+  }
+
+  return FALSE;
+}
+
+/* Sends message i to @tos[i] if @tos is set, and otherwise to @to */
+static gint
+socket_send_messages_internal (NiceSocket *sock, const NiceAddress *to,
+    const NiceAddress * const *tos, const NiceOutputMessage *messages,
+    guint n_messages)
+{
+  UdpUringPrivate *priv = sock->priv;
+  struct io_uring_sqe *prev_sqe = NULL;
+  guint n_queued = 0;
+  guint chain_start = 0;
+  guint i;
+  gint ret;
+
+  /* Make sure socket has not been freed: */
+  g_assert (sock->priv != NULL);
+
+  g_mutex_lock (&priv->send_mutex);
+
+  /* Only left over if waiting for a batch was interrupted */
+  send_reap (priv);
+
+  for (i = 0; i < n_messages; i++) {
+    const NiceOutputMessage *message = &messages[i];
+    const NiceAddress *dest = (tos != NULL) ? tos[i] : to;
+    struct io_uring_sqe *sqe;
+    SendSlot *slot;
+    gsize length;
+    guint j;
+
+    length = output_message_get_size (message);
+
+    if (length > SEND_SLOT_SIZE) {
+      /* Keep the messages in order. */
+      if (!send_flush (sock, chain_start, n_queued, &ret))
+        goto done;
+      n_queued = 0;
+      prev_sqe = NULL;
+
+      ret = nice_socket_send_messages (priv->base_socket, dest, message, 1);
+      if (ret <= 0) {
+        ret = (i > 0) ? (gint) i : ret;
+        goto done;
+      }
+      chain_start = i + 1;
+      continue;
+    }
+
+    if (priv->n_free_slots == 0 ||
+        io_uring_sq_space_left (&priv->send_ring) == 0) {
+      if (!send_flush (sock, chain_start, n_queued, &ret))
+        goto done;
+      n_queued = 0;
+      prev_sqe = NULL;
+      chain_start = i;
+    }
+
+    sqe = io_uring_get_sqe (&priv->send_ring);
+    if (sqe == NULL || priv->n_free_slots == 0)
+      break;
+
+    slot = &priv->send_slots[priv->free_slots[--priv->n_free_slots]];
+
+    slot->iov.iov_len = 0;
+    for (j = 0;
+         (message->n_buffers >= 0 && j < (guint) message->n_buffers) ||
+         (message->n_buffers < 0 && message->buffers[j].buffer != NULL);
+         j++) {
+      memcpy (slot->data + slot->iov.iov_len, message->buffers[j].buffer,
+          message->buffers[j].size);
+      slot->iov.iov_len += message->buffers[j].size;
+    }
+
+    nice_address_copy_to_sockaddr (dest, &slot->name.addr);
+    slot->msg.msg_namelen = (slot->name.storage.ss_family == AF_INET6) ?
+        sizeof (struct sockaddr_in6) : sizeof (struct sockaddr_in);
+
+    io_uring_prep_sendmsg (sqe, g_socket_get_fd (sock->fileno), &slot->msg,
+        MSG_DONTWAIT);
+    io_uring_sqe_set_data64 (sqe, slot - priv->send_slots);
+    if (prev_sqe != NULL)
+      prev_sqe->flags |= IOSQE_IO_LINK;
+    prev_sqe = sqe;
+    n_queued++;
+  }
+
+  if (send_flush (sock, chain_start, n_queued, &ret))
+    ret = i;
+
+done:
+  g_mutex_unlock (&priv->send_mutex);
+
+  return ret;
+}
+
+static gint
+socket_send_messages (NiceSocket *sock, const NiceAddress *to,
+    const NiceOutputMessage *messages, guint n_messages)
+{
+  return socket_send_messages_internal (sock, to, NULL, messages, n_messages);
+}
+
+static gint
+socket_send_messages_to (NiceSocket *sock, const NiceAddress * const *to,
+    const NiceOutputMessage *messages, guint n_messages)
+{
+  return socket_send_messages_internal (sock, NULL, to, messages, n_messages);
+}
+
+static gint
+socket_send_messages_reliable (NiceSocket *sock, const NiceAddress *to,
+    const NiceOutputMessage *messages, guint n_messages)
+{
+  return -1;
+}
+
+static gboolean
+socket_is_reliable (NiceSocket *sock)
+{
+  return FALSE;
+}
+
+static gboolean
+socket_can_send (NiceSocket *sock, NiceAddress *addr)
+{
+  return TRUE;
+}
+
+static void
+socket_set_writable_callback (NiceSocket *sock,
+    NiceSocketWritableCb callback, gpointer user_data)
+{
+}
+
+static gboolean
+socket_is_based_on (NiceSocket *sock, NiceSocket *other)
+{
+  UdpUringPrivate *priv = sock->priv;
+
+  return (sock == other) ||
+      (priv && priv->base_socket &&
+          nice_socket_is_based_on (priv->base_socket, other));
+}
+
+static gboolean
+udp_uring_source_prepare (GSource *source, gint *timeout)
+{
+  UdpUringSource *self = (UdpUringSource *) source;
+
+  *timeout = -1;
+
+  return io_uring_cq_ready (&self->priv->recv_ring) > 0;
+}
+
+static gboolean
+udp_uring_source_check (GSource *source)
+{
+  UdpUringSource *self = (UdpUringSource *) source;
+
+  return (g_source_query_unix_fd (source, self->tag) & G_IO_IN) ||
+      io_uring_cq_ready (&self->priv->recv_ring) > 0;
+}
+
+static gboolean
+udp_uring_source_dispatch (GSource *source, GSourceFunc callback,
+    gpointer user_data)
+{
+  UdpUringSource *self = (UdpUringSource *) source;
+  GSocketSourceFunc func = (GSocketSourceFunc) callback;
+
+  if (func == NULL || g_atomic_int_get (&self->priv->closed))
+    return G_SOURCE_REMOVE;
+
+  return func (self->gsock, G_IO_IN, user_data);
+}
+
+static void
+udp_uring_source_finalize (GSource *source)
+{
+  UdpUringSource *self = (UdpUringSource *) source;
+
+  g_object_unref (self->gsock);
+  udp_uring_private_unref (self->priv);
+}
+
+static GSourceFuncs udp_uring_source_funcs = {
+  udp_uring_source_prepare,
+  udp_uring_source_check,
+  udp_uring_source_dispatch,
+  udp_uring_source_finalize,
+};
+
+/* Woken by the completion queue of the receive ring rather than by the
+ * socket, which the multishot request keeps drained. */
+static GSource *
+socket_create_source (NiceSocket *sock)
+{
+  UdpUringPrivate *priv = sock->priv;
+  UdpUringSource *self;
+  GSource *source;
+
+  source = g_source_new (&udp_uring_source_funcs, sizeof (UdpUringSource));
+  g_source_set_name (source, "libnice udp-uring source");
+
+  self = (UdpUringSource *) source;
+  self->priv = udp_uring_private_ref (priv);
+  self->gsock = g_object_ref (sock->fileno);
+  self->tag = g_source_add_unix_fd (source, priv->recv_ring.ring_fd, G_IO_IN);
+
+  return source;
+}
+
+static guint
+socket_get_kernel_drops (NiceSocket *sock)
+{
+  UdpUringPrivate *priv = sock->priv;
+
+  return (guint) g_atomic_int_get (&priv->kernel_drops) +
+      (guint) g_atomic_int_get (&priv->truncated_drops);
+}
+
+#else /* !HAVE_LIBURING */
+
+NiceSocket *
+nice_udp_uring_socket_new (NiceAddress *addr)
+{
+  return NULL;
+}
+
+#endif /* HAVE_LIBURING */
@@ -0,0 +1,255 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * (C) 2026 Collabora Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the Nice GLib ICE library.
+ *
+ * The Initial Developers of the Original Code are Collabora Ltd and Nokia
+ * Corporation. All Rights Reserved.
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+
+
+/*
+ * Decodes a binary event log, as returned by nice_agent_dump_event_log(),
+ * into one line of text per event.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "agent/eventlog-format.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define N_ELEMENTS(arr) (sizeof (arr) / sizeof ((arr)[0]))
+
+static const char *const event_names[] = {
+  "none", "candidate-gathered", "remote-candidate", "component-state",
+  "pair-state", "check-sent", "stun-received", "turn-allocate",
+  "turn-refresh", "selected-pair",
+};
+
+/* NiceCandidateType */
+static const char *const candidate_types[] = {
+  "host", "srflx", "prflx", "relay",
+};
+
+/* NiceCandidateTransport */
+static const char *const transports[] = {
+  "udp", "tcp-active", "tcp-passive", "tcp-so",
+};
+
+/* NiceComponentState */
+static const char *const component_states[] = {
+  "disconnected", "gathering", "connecting", "connected", "ready", "failed",
+};
+
+/* NiceCheckState, which starts at 1 */
+static const char *const check_states[] = {
+  "?", "waiting", "in-progress", "succeeded", "failed", "frozen",
+  "discovered",
+};
+
+/* StunClass */
+static const char *const stun_classes[] = {
+  "request", "indication", "response", "error",
+};
+
+/* StunUsageTurnReturn */
+static const char *const turn_returns[] = {
+  "relay-success", "mapped-success", "error", "invalid", "alternate-server",
+};
+
+static const char *
+lookup (const char *const *names, size_t n_names, unsigned int value)
+{
+  return value < n_names ? names[value] : "?";
+}
+
+#define LOOKUP(names, value) lookup (names, N_ELEMENTS (names), value)
+
+static void
+print_transaction_id (const NiceEventRecord *ev)
+{
+  size_t i;
+
+  printf (" tid=");
+  for (i = 0; i < sizeof (ev->transaction_id); i++)
+    printf ("%02x", ev->transaction_id[i]);
+}
+
+static void
+print_record (const NiceEventLogHeader *header, const NiceEventRecord *ev)
+{
+  /* Convert the monotonic timestamp to wall clock time */
+  int64_t real = header->real_time - (header->monotonic_time - ev->time);
+  time_t secs = real / 1000000;
+  struct tm tm;
+  char date[32];
+
+#ifdef _WIN32
+  tm = *gmtime (&secs);
+#else
+  gmtime_r (&secs, &tm);
+#endif
+  strftime (date, sizeof (date), "%Y-%m-%dT%H:%M:%S", &tm);
+
+  printf ("%s.%06dZ s%u:%u %s", date, (int) (real % 1000000),
+      ev->stream_id, ev->component_id,
+      LOOKUP (event_names, ev->type));
+
+  switch (ev->type)
+  {
+    case NICE_EVENT_CANDIDATE_GATHERED:
+    case NICE_EVENT_REMOTE_CANDIDATE:
+      printf (" type=%s transport=%s priority=%" PRIu64,
+          LOOKUP (candidate_types, ev->arg), LOOKUP (transports, ev->value),
+          ev->id);
+      break;
+    case NICE_EVENT_COMPONENT_STATE:
+      printf (" %s -> %s", LOOKUP (component_states, ev->value),
+          LOOKUP (component_states, ev->arg));
+      break;
+    case NICE_EVENT_PAIR_STATE:
+      printf (" state=%s pair=%016" PRIx64, LOOKUP (check_states, ev->arg),
+          ev->id);
+      break;
+    case NICE_EVENT_CHECK_SENT:
+      printf (" transmission=%u pair=%016" PRIx64, ev->arg, ev->id);
+      print_transaction_id (ev);
+      break;
+    case NICE_EVENT_STUN_RECEIVED:
+      printf (" class=%s method=0x%03x", LOOKUP (stun_classes, ev->arg),
+          ev->value);
+      print_transaction_id (ev);
+      break;
+    case NICE_EVENT_TURN_ALLOCATE:
+    case NICE_EVENT_TURN_REFRESH:
+      printf (" result=%s", LOOKUP (turn_returns, ev->arg));
+      if (ev->arg <= 1)
+        printf (" lifetime=%u", ev->value);
+      else if (ev->value)
+        printf (" error=%u", ev->value);
+      print_transaction_id (ev);
+      break;
+    case NICE_EVENT_SELECTED_PAIR:
+      printf (" local=%s remote=%s pair=%016" PRIx64,
+          LOOKUP (candidate_types, ev->arg),
+          LOOKUP (candidate_types, ev->value), ev->id);
+      break;
+    default:
+      printf (" type=%u arg=%u value=%u id=%" PRIu64, ev->type, ev->arg,
+          ev->value, ev->id);
+      break;
+  }
+
+  printf ("\n");
+}
+
+static int
+decode (FILE *f, const char *name)
+{
+  NiceEventLogHeader header;
+  NiceEventRecord ev;
+  uint32_t i;
+
+  if (fread (&header, sizeof (header), 1, f) != 1 ||
+      memcmp (header.magic, NICE_EVENT_LOG_MAGIC, sizeof (header.magic)) != 0)
+  {
+    fprintf (stderr, "%s: not a libnice event log\n", name);
+    return -1;
+  }
+
+  if (header.byte_order != NICE_EVENT_LOG_BYTE_ORDER)
+  {
+    fprintf (stderr, "%s: written on a machine with another byte order\n",
+        name);
+    return -1;
+  }
+
+  if (header.version != NICE_EVENT_LOG_VERSION ||
+      header.record_size != sizeof (ev))
+  {
+    fprintf (stderr, "%s: unsupported version %u\n", name, header.version);
+    return -1;
+  }
+
+  printf ("# %u events, %" PRIu64 " older events dropped\n",
+      header.n_records, header.n_dropped);
+
+  for (i = 0; i < header.n_records; i++)
+  {
+    if (fread (&ev, sizeof (ev), 1, f) != 1)
+    {
+      fprintf (stderr, "%s: truncated after %u events\n", name, i);
+      return -1;
+    }
+    print_record (&header, &ev);
+  }
+
+  return 0;
+}
+
+
+int main (int argc, char *argv[])
+{
+  FILE *f;
+  int result;
+
+  if (argc > 2 || (argc == 2 &&
+      (strcmp (argv[1], "--help") == 0 || strcmp (argv[1], "-h") == 0)))
+  {
+    printf ("Usage: %s [file]\n"
+            "Decodes a libnice event log, read from standard input if no\n"
+            "file is given\n"
+            "\n", argv[0]);
+    return argc > 2 ? 2 : 0;
+  }
+
+  if (argc == 2 && strcmp (argv[1], "-") != 0)
+  {
+    f = fopen (argv[1], "rb");
+    if (f == NULL)
+    {
+      perror (argv[1]);
+      return 1;
+    }
+  }
+  else
+  {
+    f = stdin;
+  }
+
+  result = decode (f, argc == 2 ? argv[1] : "<stdin>") ? 1 : 0;
+
+  if (f != stdin)
+    fclose (f);
+
+  return result;
+}
@@ -50,6 +50,8 @@
 #include <sys/types.h>
 #include "stun/stunagent.h"
 #include "stun/usages/bind.h"
+#include "stun/usages/timer.h"
+#include "stun/usages/turn.h"
 
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
@@ -58,6 +60,18 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#ifdef HAVE_POLL
+# include <poll.h>
+#endif
+
+/* Load generation, see load_run() */
+#define LOAD_MAX_CLIENTS 1024
+#define LOAD_MAX_WINDOW 128  /* below STUN_AGENT_MAX_SAVED_IDS */
+#define LOAD_REQUEST_SIZE 256
+#define LOAD_TURN_LIFETIME 600
 
 static int ai_flags = 0;
 
@@ -76,8 +90,577 @@ printaddr (const char *str, const struct sockaddr *addr, socklen_t addrlen)
 }
 
 
+typedef struct
+{
+  unsigned int n_clients;
+  unsigned int window;
+  unsigned int duration;
+  unsigned int rate;          /* new requests per second, 0 for no limit */
+  const char *username;       /* TURN Allocate/Refresh instead of Binding */
+  const char *password;
+} LoadParams;
+
+#ifdef HAVE_POLL
+typedef enum
+{
+  LOAD_BINDING,
+  LOAD_ALLOCATE,
+  LOAD_REFRESH,
+  LOAD_N_KINDS
+} LoadKind;
+
+static const char *const load_kind_names[LOAD_N_KINDS] = {
+  "Binding", "Allocate", "Refresh"
+};
+
+typedef struct
+{
+  bool used;
+  LoadKind kind;
+  StunTransactionId id;
+  StunTimer timer;
+  uint64_t sent_us;
+  size_t len;
+  uint8_t buf[LOAD_REQUEST_SIZE];
+} LoadTransaction;
+
+typedef enum
+{
+  LOAD_CLIENT_IDLE,           /* TURN: no allocation yet */
+  LOAD_CLIENT_ALLOCATING,
+  LOAD_CLIENT_READY
+} LoadClientState;
+
+typedef struct
+{
+  int fd;
+  StunAgent agent;
+  LoadClientState state;
+  LoadTransaction *transactions;
+  unsigned int in_flight;
+
+  /* Last response from the TURN server, where the REALM and NONCE of the
+   * next requests come from */
+  StunMessage challenge;
+  uint8_t challenge_buf[STUN_MAX_MESSAGE_SIZE_IPV6];
+  bool has_challenge;
+} LoadClient;
+
+typedef struct
+{
+  uint64_t sent;
+  uint64_t retransmissions;
+  uint64_t responses;
+  uint64_t challenges;        /* 401 and 438 answers, retried with a nonce */
+  uint64_t errors;
+  uint64_t timeouts;
+  uint32_t *latencies;        /* in microseconds, one per response */
+  size_t n_latencies;
+  size_t latencies_size;
+} LoadStats;
+
+static uint64_t
+now_us (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void
+load_stats_add_latency (LoadStats *stats, uint64_t latency)
+{
+  if (stats->n_latencies == stats->latencies_size)
+  {
+    size_t size = stats->latencies_size ? stats->latencies_size * 2 : 4096;
+    uint32_t *latencies = realloc (stats->latencies,
+        size * sizeof (*latencies));
+
+    if (latencies == NULL)
+      return;
+    stats->latencies = latencies;
+    stats->latencies_size = size;
+  }
+
+  stats->latencies[stats->n_latencies++] =
+      latency > UINT32_MAX ? UINT32_MAX : (uint32_t) latency;
+}
+
+static int
+compare_latencies (const void *a, const void *b)
+{
+  uint32_t la = *(const uint32_t *) a;
+  uint32_t lb = *(const uint32_t *) b;
+
+  return (la > lb) - (la < lb);
+}
+
+/* Nearest-rank percentile of the sorted latencies, in milliseconds */
+static double
+load_stats_percentile (const LoadStats *stats, double percentile)
+{
+  size_t rank;
+
+  if (stats->n_latencies == 0)
+    return 0;
+
+  rank = (size_t) (percentile / 100 * stats->n_latencies + 0.5);
+  if (rank > 0)
+    rank--;
+  if (rank >= stats->n_latencies)
+    rank = stats->n_latencies - 1;
+
+  return stats->latencies[rank] / 1000.;
+}
+
+static void
+load_stats_print (LoadStats *stats, const char *name, uint64_t elapsed)
+{
+  if (stats->sent == 0)
+    return;
+
+  qsort (stats->latencies, stats->n_latencies, sizeof (*stats->latencies),
+      compare_latencies);
+
+  printf ("%s: %llu requests, %llu retransmissions, %llu responses, "
+      "%llu challenges, %llu errors, %llu timeouts, %.0f responses/s\n", name,
+      (unsigned long long) stats->sent,
+      (unsigned long long) stats->retransmissions,
+      (unsigned long long) stats->responses,
+      (unsigned long long) stats->challenges,
+      (unsigned long long) stats->errors,
+      (unsigned long long) stats->timeouts,
+      stats->responses * 1e6 / (elapsed ? elapsed : 1));
+  if (stats->n_latencies == 0)
+    return;
+
+  printf ("%s latency (ms): p50 %.3f, p90 %.3f, p99 %.3f, p99.9 %.3f, "
+      "max %.3f\n", name,
+      load_stats_percentile (stats, 50), load_stats_percentile (stats, 90),
+      load_stats_percentile (stats, 99), load_stats_percentile (stats, 99.9),
+      load_stats_percentile (stats, 100));
+}
+
+/* Builds the next request of @client into @trans */
+static size_t
+load_build (LoadClient *client, LoadKind kind, LoadTransaction *trans,
+    const LoadParams *params)
+{
+  StunMessage msg;
+  StunMessage *previous = client->has_challenge ? &client->challenge : NULL;
+  size_t len = 0;
+
+  switch (kind)
+  {
+    case LOAD_BINDING:
+      len = stun_usage_bind_create (&client->agent, &msg, trans->buf,
+          sizeof (trans->buf));
+      break;
+
+    case LOAD_ALLOCATE:
+      len = stun_usage_turn_create (&client->agent, &msg, trans->buf,
+          sizeof (trans->buf), previous, STUN_USAGE_TURN_REQUEST_PORT_NORMAL,
+          -1, LOAD_TURN_LIFETIME,
+          (uint8_t *) params->username, strlen (params->username),
+          (uint8_t *) params->password, strlen (params->password),
+          STUN_USAGE_TURN_COMPATIBILITY_RFC5766);
+      break;
+
+    case LOAD_REFRESH:
+      len = stun_usage_turn_create_refresh (&client->agent, &msg, trans->buf,
+          sizeof (trans->buf), previous, LOAD_TURN_LIFETIME,
+          (uint8_t *) params->username, strlen (params->username),
+          (uint8_t *) params->password, strlen (params->password),
+          STUN_USAGE_TURN_COMPATIBILITY_RFC5766);
+      break;
+
+    default:
+      break;
+  }
+
+  if (len > 0)
+    stun_message_id (&msg, trans->id);
+
+  return len;
+}
+
+/* Starts a new transaction, retransmitted by a #StunTimer until answered */
+static int
+load_send (LoadClient *client, LoadKind kind, LoadStats *stats,
+    const LoadParams *params, uint64_t now)
+{
+  LoadTransaction *trans = NULL;
+  unsigned int i;
+
+  for (i = 0; i < params->window && trans == NULL; i++)
+    if (!client->transactions[i].used)
+      trans = &client->transactions[i];
+  if (trans == NULL)
+    return -1;
+
+  trans->len = load_build (client, kind, trans, params);
+  if (trans->len == 0)
+    return -1;
+
+  if (send (client->fd, (const char *) trans->buf, trans->len, 0) < 0)
+  {
+    stun_agent_forget_transaction (&client->agent, trans->id);
+    return -1;
+  }
+
+  stun_timer_start (&trans->timer, STUN_TIMER_DEFAULT_TIMEOUT,
+      STUN_TIMER_DEFAULT_MAX_RETRANSMISSIONS);
+  trans->kind = kind;
+  trans->sent_us = now;
+  trans->used = true;
+  client->in_flight++;
+  stats[kind].sent++;
+  return 0;
+}
+
+static void
+load_finish (LoadClient *client, LoadTransaction *trans)
+{
+  trans->used = false;
+  client->in_flight--;
+}
+
+static LoadTransaction *
+load_find_transaction (LoadClient *client, const StunMessage *msg,
+    const LoadParams *params)
+{
+  StunTransactionId id;
+  unsigned int i;
+
+  stun_message_id (msg, id);
+  for (i = 0; i < params->window; i++)
+    if (client->transactions[i].used &&
+        memcmp (client->transactions[i].id, id, sizeof (id)) == 0)
+      return &client->transactions[i];
+
+  return NULL;
+}
+
+/* Handles the response to an Allocate or Refresh; returns 1 on success,
+ * 0 if the server asked for (new) credentials and -1 on errors */
+static int
+load_process_turn (LoadClient *client, LoadTransaction *trans,
+    StunMessage *msg)
+{
+  struct sockaddr_storage relay, addr, alternate;
+  socklen_t relaylen = sizeof (relay), addrlen = sizeof (addr);
+  socklen_t alternatelen = sizeof (alternate);
+  uint32_t bandwidth, lifetime;
+  StunUsageTurnReturn ret;
+  int code = 0;
+
+  if (trans->kind == LOAD_ALLOCATE)
+    ret = stun_usage_turn_process (msg, &relay, &relaylen, &addr, &addrlen,
+        &alternate, &alternatelen, &bandwidth, &lifetime,
+        STUN_USAGE_TURN_COMPATIBILITY_RFC5766);
+  else
+    ret = stun_usage_turn_refresh_process (msg, &lifetime,
+        STUN_USAGE_TURN_COMPATIBILITY_RFC5766);
+
+  if (ret == STUN_USAGE_TURN_RETURN_RELAY_SUCCESS ||
+      ret == STUN_USAGE_TURN_RETURN_MAPPED_SUCCESS)
+  {
+    if (trans->kind == LOAD_ALLOCATE)
+      client->state = LOAD_CLIENT_READY;
+    return 1;
+  }
+
+  if (trans->kind == LOAD_ALLOCATE)
+    client->state = LOAD_CLIENT_IDLE;
+
+  /* Keep the REALM and NONCE of a challenge to retry with credentials. A
+   * 401 to a request which already had them means they are wrong. */
+  if (stun_message_get_class (msg) == STUN_ERROR &&
+      stun_message_find_error (msg, &code) == STUN_MESSAGE_RETURN_SUCCESS &&
+      (code == STUN_ERROR_STALE_NONCE ||
+          (code == STUN_ERROR_UNAUTHORIZED && !client->has_challenge)) &&
+      msg->buffer_len <= sizeof (client->challenge_buf))
+  {
+    memcpy (client->challenge_buf, msg->buffer, msg->buffer_len);
+    client->challenge = *msg;
+    client->challenge.buffer = client->challenge_buf;
+    client->has_challenge = true;
+    return 0;
+  }
+
+  return -1;
+}
+
+static void
+load_receive (LoadClient *client, LoadStats *stats, const LoadParams *params)
+{
+  uint8_t buf[STUN_MAX_MESSAGE_SIZE_IPV6];
+  ssize_t len;
+
+  while ((len = recv (client->fd, (char *) buf, sizeof (buf),
+              MSG_DONTWAIT)) > 0)
+  {
+    StunMessage msg;
+    LoadTransaction *trans;
+    int result;
+
+    if (stun_agent_validate (&client->agent, &msg, buf, len, NULL, NULL) !=
+        STUN_VALIDATION_SUCCESS)
+      continue;
+
+    trans = load_find_transaction (client, &msg, params);
+    if (trans == NULL)
+      continue;
+
+    if (trans->kind == LOAD_BINDING)
+    {
+      struct sockaddr_storage addr, alternate;
+      socklen_t addrlen = sizeof (addr), alternatelen = sizeof (alternate);
+
+      result = stun_usage_bind_process (&msg, (struct sockaddr *) &addr,
+          &addrlen, (struct sockaddr *) &alternate, &alternatelen) ==
+          STUN_USAGE_BIND_RETURN_SUCCESS ? 1 : -1;
+    }
+    else
+    {
+      result = load_process_turn (client, trans, &msg);
+    }
+
+    if (result > 0)
+    {
+      stats[trans->kind].responses++;
+      load_stats_add_latency (&stats[trans->kind],
+          now_us () - trans->sent_us);
+    }
+    else if (result == 0)
+    {
+      stats[trans->kind].challenges++;
+    }
+    else
+    {
+      stats[trans->kind].errors++;
+    }
+
+    load_finish (client, trans);
+  }
+}
+
+/* Retransmits the requests whose timer fired, and gives up on those which
+ * ran out of retransmissions */
+static void
+load_refresh_timers (LoadClient *client, LoadStats *stats,
+    const LoadParams *params)
+{
+  unsigned int i;
+
+  for (i = 0; i < params->window && client->in_flight > 0; i++)
+  {
+    LoadTransaction *trans = &client->transactions[i];
+
+    if (!trans->used)
+      continue;
+
+    switch (stun_timer_refresh (&trans->timer))
+    {
+      case STUN_USAGE_TIMER_RETURN_TIMEOUT:
+        stun_agent_forget_transaction (&client->agent, trans->id);
+        stats[trans->kind].timeouts++;
+        if (trans->kind == LOAD_ALLOCATE)
+          client->state = LOAD_CLIENT_IDLE;
+        load_finish (client, trans);
+        break;
+
+      case STUN_USAGE_TIMER_RETURN_RETRANSMIT:
+        send (client->fd, (const char *) trans->buf, trans->len, 0);
+        stats[trans->kind].retransmissions++;
+        break;
+
+      case STUN_USAGE_TIMER_RETURN_SUCCESS:
+      default:
+        break;
+    }
+  }
+}
+
+/* Sends what @client may send right now; returns -1 once it cannot send
+ * anything more */
+static int
+load_send_next (LoadClient *client, LoadStats *stats, const LoadParams *params,
+    uint64_t now)
+{
+  if (client->in_flight >= params->window)
+    return -1;
+
+  if (params->username == NULL)
+    return load_send (client, LOAD_BINDING, stats, params, now);
+
+  /* One allocation per socket, then Refreshes may be pipelined */
+  switch (client->state)
+  {
+    case LOAD_CLIENT_IDLE:
+      if (load_send (client, LOAD_ALLOCATE, stats, params, now) < 0)
+        return -1;
+      client->state = LOAD_CLIENT_ALLOCATING;
+      return 0;
+
+    case LOAD_CLIENT_READY:
+      return load_send (client, LOAD_REFRESH, stats, params, now);
+
+    case LOAD_CLIENT_ALLOCATING:
+    default:
+      return -1;
+  }
+}
+
+/* Releases the allocation of @client, without waiting for an answer */
+static void
+load_deallocate (LoadClient *client, const LoadParams *params)
+{
+  uint8_t buf[LOAD_REQUEST_SIZE];
+  StunMessage msg;
+  size_t len;
+
+  if (client->state != LOAD_CLIENT_READY)
+    return;
+
+  len = stun_usage_turn_create_refresh (&client->agent, &msg, buf,
+      sizeof (buf), client->has_challenge ? &client->challenge : NULL, 0,
+      (uint8_t *) params->username, strlen (params->username),
+      (uint8_t *) params->password, strlen (params->password),
+      STUN_USAGE_TURN_COMPATIBILITY_RFC5766);
+  if (len > 0)
+    send (client->fd, (const char *) buf, len, 0);
+}
+
+/*
+ * Keeps up to params->window transactions in flight on each of
+ * params->n_clients sockets for params->duration seconds, starting at most
+ * params->rate new ones per second, then prints how many responses the
+ * server gave per second and their latency percentiles. The requests are
+ * built with the library's bind and turn usages and retransmitted with its
+ * #StunTimer, so its own codec is part of what gets measured. Each socket
+ * has its own source port, so a server spreading clients over threads by
+ * address sees them as distinct clients.
+ */
+static int
+load_run (const struct sockaddr *srv, socklen_t srvlen,
+    const LoadParams *params)
+{
+  struct pollfd *fds;
+  LoadClient *clients;
+  LoadStats stats[LOAD_N_KINDS];
+  uint64_t start, now, end, started = 0;
+  unsigned int i, n_open = 0, next = 0;
+  int k;
+  int ret = -1;
+
+  memset (stats, 0, sizeof (stats));
+  clients = calloc (params->n_clients, sizeof (*clients));
+  fds = calloc (params->n_clients, sizeof (*fds));
+  if (clients == NULL || fds == NULL)
+    goto out;
+
+  for (i = 0; i < params->n_clients; i++)
+  {
+    clients[i].transactions = calloc (params->window,
+        sizeof (*clients[i].transactions));
+    if (clients[i].transactions == NULL)
+      goto close;
+
+    clients[i].fd = socket (srv->sa_family, SOCK_DGRAM, 0);
+    if (clients[i].fd == -1)
+    {
+      perror ("Error opening client socket");
+      goto close;
+    }
+    n_open++;
+
+    if (connect (clients[i].fd, srv, srvlen))
+    {
+      perror ("Error connecting client socket");
+      goto close;
+    }
+
+    if (params->username != NULL)
+      stun_agent_init (&clients[i].agent, STUN_ALL_KNOWN_ATTRIBUTES,
+          STUN_COMPATIBILITY_RFC5389, STUN_AGENT_USAGE_LONG_TERM_CREDENTIALS);
+    else
+      stun_agent_init (&clients[i].agent, STUN_ALL_KNOWN_ATTRIBUTES,
+          STUN_COMPATIBILITY_RFC5389, STUN_AGENT_USAGE_USE_FINGERPRINT);
+    fds[i].fd = clients[i].fd;
+    fds[i].events = POLLIN;
+  }
+
+  start = now = now_us ();
+  end = start + (uint64_t) params->duration * 1000000;
+
+  while (now < end)
+  {
+    /* The number of transactions which may have been started by now */
+    uint64_t allowed = params->rate ?
+        (now - start) * params->rate / 1000000 + 1 : UINT64_MAX;
+    unsigned int n_blocked = 0;
+
+    for (i = 0; i < params->n_clients; i++)
+      load_refresh_timers (&clients[i], stats, params);
+
+    /* Go round the clients so that a rate limit spreads over all of them */
+    while (started < allowed && n_blocked < params->n_clients)
+    {
+      if (load_send_next (&clients[next], stats, params, now) < 0)
+      {
+        n_blocked++;
+      }
+      else
+      {
+        started++;
+        n_blocked = 0;
+      }
+      next = (next + 1) % params->n_clients;
+    }
+
+    if (poll (fds, params->n_clients, params->rate ? 1 : 10) < 0 &&
+        errno != EINTR)
+    {
+      perror ("poll");
+      goto close;
+    }
+
+    for (i = 0; i < params->n_clients; i++)
+      if (fds[i].revents & POLLIN)
+        load_receive (&clients[i], stats, params);
+
+    now = now_us ();
+  }
+
+  printf ("Clients: %u, window: %u, rate: %u/s, duration: %.2f s\n",
+      params->n_clients, params->window, params->rate, (now - start) / 1e6);
+  for (k = 0; k < LOAD_N_KINDS; k++)
+    load_stats_print (&stats[k], load_kind_names[k], now - start);
+  ret = 0;
+
+close:
+  for (i = 0; i < n_open; i++)
+  {
+    if (params->username != NULL)
+      load_deallocate (&clients[i], params);
+    close (clients[i].fd);
+  }
+  for (i = 0; i < params->n_clients; i++)
+    free (clients[i].transactions);
+out:
+  for (k = 0; k < LOAD_N_KINDS; k++)
+    free (stats[k].latencies);
+  free (clients);
+  free (fds);
+  return ret;
+}
+#endif
 
-static int run (int family, const char *hostname, const char *service)
+
+static int run (int family, const char *hostname, const char *service,
+    const LoadParams *load)
 {
   struct addrinfo hints, *res;
   const struct addrinfo *ptr;
@@ -109,6 +692,14 @@ static int run (int family, const char *hostname, const char *service)
 
     printaddr ("Server address", ptr->ai_addr, ptr->ai_addrlen);
 
+#ifdef HAVE_POLL
+    if (load != NULL)
+    {
+      ret = load_run (ptr->ai_addr, ptr->ai_addrlen, load);
+      break;
+    }
+#endif
+
     val = stun_usage_bind_run (ptr->ai_addr, ptr->ai_addrlen, &addr.storage,
         &addrlen);
     if (val)
@@ -129,6 +720,9 @@ int main (int argc, char *argv[])
 {
   const char *server = NULL, *port = NULL;
   int family = AF_UNSPEC;
+  LoadParams load = { 16, 16, 5, 0, NULL, NULL };
+  char *credentials = NULL;
+  bool load_mode = false;
   int i;
   int result;
 
@@ -160,9 +754,65 @@ int main (int argc, char *argv[])
               "  -4, --ipv4    Force IP version 4\n"
               "  -6, --ipv6    Force IP version 6\n"
               "  -n, --numeric Server in numeric form\n"
+              "\n"
+              "  -l, --load          Measure how many Binding responses/s the\n"
+              "                      server sustains instead\n"
+              "  -c, --clients N     Sockets sending requests (default: 16)\n"
+              "  -w, --window N      Requests in flight per socket"
+              " (default: 16)\n"
+              "  -d, --duration SEC  Length of the run (default: 5)\n"
+              "  -r, --rate N        New requests per second (default: no"
+              " limit)\n"
+              "  -t, --turn USER:PASSWORD\n"
+              "                      Allocate on a TURN server and measure"
+              " Refreshes\n"
               "\n", argv[0]);
       return 0;
     }
+    else if (strcmp (arg, "--load") == 0 || strcmp (arg, "-l") == 0)
+    {
+      load_mode = true;
+    }
+    else if (strcmp (arg, "--clients") == 0 || strcmp (arg, "-c") == 0 ||
+        strcmp (arg, "--window") == 0 || strcmp (arg, "-w") == 0 ||
+        strcmp (arg, "--duration") == 0 || strcmp (arg, "-d") == 0 ||
+        strcmp (arg, "--rate") == 0 || strcmp (arg, "-r") == 0)
+    {
+      unsigned int val;
+
+      if (++i >= argc || (val = strtoul (argv[i], NULL, 10)) == 0)
+      {
+        fprintf (stderr, "%s: %s needs a positive number\n", argv[0], arg);
+        return 2;
+      }
+
+      if (arg[1] == 'c' || arg[2] == 'c')
+        load.n_clients = val;
+      else if (arg[1] == 'w' || arg[2] == 'w')
+        load.window = val;
+      else if (arg[1] == 'r' || arg[2] == 'r')
+        load.rate = val;
+      else
+        load.duration = val;
+    }
+    else if (strcmp (arg, "--turn") == 0 || strcmp (arg, "-t") == 0)
+    {
+      char *sep;
+
+      if (++i >= argc || (sep = strchr (argv[i], ':')) == NULL)
+      {
+        fprintf (stderr, "%s: %s needs USER:PASSWORD\n", argv[0], arg);
+        return 2;
+      }
+
+      free (credentials);
+      credentials = strdup (argv[i]);
+      sep = credentials + (sep - argv[i]);
+      *sep = '\0';
+      load.username = credentials;
+      load.password = sep + 1;
+      load_mode = true;
+    }
     else if (strcmp (arg, "--numeric") == 0 || strcmp (arg, "-n") == 0)
     {
       ai_flags |= AI_NUMERICHOST;
@@ -188,7 +838,24 @@ int main (int argc, char *argv[])
     return 2;
   }
 
-  result = run (family, server, port) ? 1 : 0;
+  if (load.n_clients > LOAD_MAX_CLIENTS || load.window > LOAD_MAX_WINDOW)
+  {
+    fprintf (stderr, "%s: at most %u clients with %u requests in flight\n",
+        argv[0], LOAD_MAX_CLIENTS, LOAD_MAX_WINDOW);
+    return 2;
+  }
+
+#ifndef HAVE_POLL
+  if (load_mode)
+  {
+    fprintf (stderr, "%s: load mode is not supported on this platform\n",
+        argv[0]);
+    return 2;
+  }
+#endif
+
+  result = run (family, server, port, load_mode ? &load : NULL) ? 1 : 0;
+  free (credentials);
 
 #ifdef _WIN32
   WSACleanup();
@@ -0,0 +1,1535 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * (C) 2008-2009 Collabora Ltd.
+ *  Contact: Youness Alaoui
+ * (C) 2007-2009 Nokia Corporation. All rights reserved.
+ *  Contact: Rémi Denis-Courmont
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the Nice GLib ICE library.
+ *
+ * The Initial Developers of the Original Code are Collabora Ltd and Nokia
+ * Corporation. All Rights Reserved.
+ *
+ * Contributors:
+ *   Youness Alaoui, Collabora Ltd.
+ *   Rémi Denis-Courmont, Nokia
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#ifdef __sun
+#define _XPG4_2 1
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <sys/types.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#define poll WSAPoll
+#else
+#include <sys/socket.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#endif
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+# include <fcntl.h>
+#else
+# define close(fd) _close(fd)
+#endif
+
+#include <errno.h>
+#include <limits.h>
+
+#ifndef SOL_IP
+# define SOL_IP IPPROTO_IP
+#endif
+
+#ifndef SOL_IPV6
+# define SOL_IPV6 IPPROTO_IPV6
+#endif
+
+
+#ifndef IPV6_RECVPKTINFO
+# define IPV6_RECVPKTINFO IPV6_PKTINFO
+#endif
+
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif
+
+#include "stun/stunagent.h"
+#include "stund.h"
+
+#if defined(HAVE_RECVMMSG) && defined(HAVE_SENDMMSG)
+# define STUND_USE_MMSG 1
+#endif
+
+/* stund_server_stop() may be called from another thread than the one
+ * running the server */
+#ifdef _WIN32
+# define stopping_get(server) InterlockedCompareExchange (&(server)->stopping, 0, 0)
+# define stopping_set(server) InterlockedExchange (&(server)->stopping, 1)
+#else
+# define stopping_get(server) __atomic_load_n (&(server)->stopping, __ATOMIC_ACQUIRE)
+# define stopping_set(server) __atomic_store_n (&(server)->stopping, 1, __ATOMIC_RELEASE)
+#endif
+
+/* Limits of the relay; it is meant for tests and small deployments */
+#define STUND_MAX_CONNECTIONS 64
+#define STUND_MAX_ALLOCATIONS 256
+#define STUND_MAX_PERMISSIONS 16
+#define STUND_MAX_CHANNELS 16
+
+/* Lifetimes in seconds, from RFC 5766 */
+#define STUND_DEFAULT_LIFETIME 600
+#define STUND_MAX_LIFETIME 3600
+#define STUND_PERMISSION_LIFETIME 300
+#define STUND_CHANNEL_LIFETIME 600
+
+/* Largest frame on a TCP connection: a STUN header and 64k of attributes,
+ * or a ChannelData message padded to 4 bytes */
+#define STUND_TCP_BUFFER_SIZE (20 + 65535 + 3)
+
+/* Datagrams read and written per recvmmsg()/sendmmsg() call, and the
+ * largest datagram taken in a batch: anything longer is dropped */
+#define STUND_BATCH 32
+#define STUND_DGRAM_SIZE 8192
+
+static const uint16_t known_attributes[] =  {
+  0
+};
+
+typedef union {
+  struct sockaddr_storage storage;
+  struct sockaddr addr;
+  struct sockaddr_in in;
+  struct sockaddr_in6 in6;
+} StundAddress;
+
+typedef struct {
+  int fd;
+  StundAddress addr;
+  socklen_t addr_len;
+  size_t len;
+  uint8_t buf[STUND_TCP_BUFFER_SIZE];
+} StundConnection;
+
+typedef struct {
+  StundAddress addr;
+  socklen_t addr_len;
+  size_t len;
+  uint8_t buf[STUND_DGRAM_SIZE];
+} StundDatagram;
+
+typedef struct {
+  StundAddress addr;
+  socklen_t addr_len;
+  time_t expires;
+} StundPermission;
+
+typedef struct {
+  uint16_t number;
+  StundAddress peer;
+  socklen_t peer_len;
+  time_t expires;
+} StundChannel;
+
+typedef struct _StundAllocation StundAllocation;
+
+struct _StundAllocation {
+  StundAllocation *next;
+  StundConnection *conn;   /* NULL for allocations made over UDP */
+  StundAddress client;
+  socklen_t client_len;
+  int relay_fd;
+  StundAddress relay;
+  socklen_t relay_len;
+  time_t expires;
+  StundPermission permissions[STUND_MAX_PERMISSIONS];
+  unsigned int n_permissions;
+  StundChannel channels[STUND_MAX_CHANNELS];
+  unsigned int n_channels;
+};
+
+struct _StundServer {
+  int family;
+  unsigned int port;
+  int udp_fd;
+  int tcp_fd;
+  StunAgent oldagent;
+  StunAgent newagent;
+  StunAgent turnagent;
+
+  /* TURN relay, enabled by stund_server_set_credentials() */
+  bool relay;
+  char *username;
+  char *password;
+  char *realm;
+  char nonce[24];
+  StunDefaultValidaterData credentials[2];
+
+  StundConnection *connections[STUND_MAX_CONNECTIONS];
+  StundAllocation *allocations;
+  unsigned int n_allocations;
+
+  long stopping;
+  /* Written to by stund_server_stop() to interrupt poll(); -1 on Windows,
+   * where a datagram to the UDP socket does that */
+  int wakeup_fds[2];
+
+  uint8_t recv_buf[STUN_MAX_MESSAGE_SIZE];
+  uint8_t send_buf[STUN_MAX_MESSAGE_SIZE];
+
+#ifdef STUND_USE_MMSG
+  /* Replies to UDP clients are queued while a batch is being handled */
+  bool batching;
+  StundDatagram dgram_in[STUND_BATCH];
+  StundDatagram dgram_out[STUND_BATCH];
+  unsigned int n_dgram_out;
+#endif
+};
+
+/*
+ * Creates a listening socket, optionally sharing its port with the other
+ * sockets that set SO_REUSEPORT
+ */
+static int listen_socket_full (int fam, int type, int proto, unsigned int port,
+    bool reuse_port)
+{
+  int yes = 1;
+  int fd = socket (fam, type, proto);
+  union {
+    struct sockaddr addr;
+    struct sockaddr_in in;
+    struct sockaddr_in6 in6;
+    struct sockaddr_storage storage;
+  } addr;
+
+  if (fd == -1)
+  {
+    perror ("Error opening IP port");
+    return -1;
+  }
+
+  memset (&addr, 0, sizeof (addr));
+  addr.storage.ss_family = fam;
+#ifdef HAVE_SA_LEN
+  addr.storage.ss_len = sizeof (addr);
+#endif
+
+  switch (fam)
+  {
+    case AF_INET:
+      addr.in.sin_port = htons (port);
+      break;
+
+    case AF_INET6:
+#ifdef IPV6_V6ONLY
+      setsockopt (fd, SOL_IPV6, IPV6_V6ONLY, (const char *) &yes, sizeof (yes));
+#endif
+      addr.in6.sin6_port = htons (port);
+      break;
+
+    default:
+      assert (0);  /* should never be reached */
+  }
+
+  if (reuse_port)
+  {
+#ifdef SO_REUSEPORT
+    setsockopt (fd, SOL_SOCKET, SO_REUSEPORT, (const char *) &yes,
+        sizeof (yes));
+#else
+    fprintf (stderr, "SO_REUSEPORT is not supported on this platform\n");
+    goto error;
+#endif
+  }
+
+  if (bind (fd, &addr.addr, sizeof (struct sockaddr_storage)))
+  {
+    perror ("Error opening IP port");
+    goto error;
+  }
+
+  if ((type == SOCK_DGRAM) || (type == SOCK_RAW))
+  {
+    switch (fam)
+    {
+      case AF_INET:
+#ifdef IP_RECVERR
+        setsockopt (fd, SOL_IP, IP_RECVERR, (const char*) &yes, sizeof (yes));
+#endif
+        break;
+
+      case AF_INET6:
+#ifdef IPV6_RECVERR
+        setsockopt (fd, SOL_IPV6, IPV6_RECVERR, (const char*) &yes, sizeof (yes));
+#endif
+        break;
+
+      default:
+        assert (0);  /* should never be reached */
+    }
+  }
+  else
+  {
+    if (listen (fd, INT_MAX))
+    {
+      perror ("Error opening IP port");
+      goto error;
+    }
+  }
+
+  return fd;
+
+error:
+  close (fd);
+  return -1;
+}
+
+/*
+ * Creates a listening socket
+ */
+int listen_socket (int fam, int type, int proto, unsigned int port)
+{
+  return listen_socket_full (fam, type, proto, port, false);
+}
+
+
+static bool address_equal (const StundAddress *a, const StundAddress *b,
+    bool compare_port)
+{
+  if (a->storage.ss_family != b->storage.ss_family)
+    return false;
+
+  switch (a->storage.ss_family)
+  {
+    case AF_INET:
+      return a->in.sin_addr.s_addr == b->in.sin_addr.s_addr &&
+          (!compare_port || a->in.sin_port == b->in.sin_port);
+
+    case AF_INET6:
+      return memcmp (&a->in6.sin6_addr, &b->in6.sin6_addr,
+              sizeof (a->in6.sin6_addr)) == 0 &&
+          (!compare_port || a->in6.sin6_port == b->in6.sin6_port);
+
+    default:
+      return false;
+  }
+}
+
+
+static int send_all (int fd, const uint8_t *buf, size_t len)
+{
+  while (len > 0)
+  {
+    ssize_t ret = send (fd, (const char *) buf, len, MSG_NOSIGNAL);
+
+    if (ret < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    buf += ret;
+    len -= ret;
+  }
+
+  return 0;
+}
+
+#ifdef STUND_USE_MMSG
+/* Sends the queued replies with as few sendmmsg() calls as possible */
+static void dgram_flush (StundServer *server)
+{
+  struct mmsghdr msgs[STUND_BATCH];
+  struct iovec iov[STUND_BATCH];
+  unsigned int i, n_sent = 0;
+
+  for (i = 0; i < server->n_dgram_out; i++)
+  {
+    StundDatagram *dgram = &server->dgram_out[i];
+
+    iov[i].iov_base = dgram->buf;
+    iov[i].iov_len = dgram->len;
+    memset (&msgs[i], 0, sizeof (msgs[i]));
+    msgs[i].msg_hdr.msg_name = &dgram->addr;
+    msgs[i].msg_hdr.msg_namelen = dgram->addr_len;
+    msgs[i].msg_hdr.msg_iov = &iov[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  while (n_sent < server->n_dgram_out)
+  {
+    int ret = sendmmsg (server->udp_fd, msgs + n_sent,
+        server->n_dgram_out - n_sent, 0);
+
+    if (ret < 0 && errno == EINTR)
+      continue;
+
+    /* Skip over a datagram which could not be sent */
+    n_sent += (ret > 0) ? (unsigned int) ret : 1;
+  }
+
+  server->n_dgram_out = 0;
+}
+#endif
+
+/*
+ * Sends a message to a client, either over its TCP connection, framed and
+ * padded as RFC 5766 section 11.5 asks, or as a datagram from the listening
+ * UDP socket.
+ */
+static int client_send (StundServer *server, StundConnection *conn,
+    const StundAddress *addr, socklen_t addr_len,
+    const uint8_t *buf, size_t len)
+{
+  static const uint8_t padding[3] = { 0, 0, 0 };
+
+  if (len == 0)
+    return -1;
+
+  if (conn != NULL)
+  {
+    size_t padlen = (len % 4) ? 4 - (len % 4) : 0;
+
+    if (send_all (conn->fd, buf, len) < 0 ||
+        send_all (conn->fd, padding, padlen) < 0)
+      return -1;
+    return 0;
+  }
+
+#ifdef STUND_USE_MMSG
+  if (server->batching && len <= STUND_DGRAM_SIZE)
+  {
+    StundDatagram *dgram;
+
+    if (server->n_dgram_out == STUND_BATCH)
+      dgram_flush (server);
+
+    dgram = &server->dgram_out[server->n_dgram_out++];
+    dgram->addr = *addr;
+    dgram->addr_len = addr_len;
+    dgram->len = len;
+    memcpy (dgram->buf, buf, len);
+    return 0;
+  }
+#endif
+
+  if (sendto (server->udp_fd, (const char *) buf, len, 0, &addr->addr,
+          addr_len) < (ssize_t) len)
+    return -1;
+  return 0;
+}
+
+
+/*
+ * Permissions and channel bindings
+ */
+static StundPermission *permission_find (StundAllocation *alloc,
+    const StundAddress *peer)
+{
+  unsigned int i;
+
+  /* Permissions only look at the IP address, RFC 5766 section 8 */
+  for (i = 0; i < alloc->n_permissions; i++)
+    if (address_equal (&alloc->permissions[i].addr, peer, false))
+      return &alloc->permissions[i];
+
+  return NULL;
+}
+
+static bool permission_install (StundAllocation *alloc,
+    const StundAddress *peer, socklen_t peer_len, time_t now)
+{
+  StundPermission *perm = permission_find (alloc, peer);
+
+  if (perm == NULL)
+  {
+    if (alloc->n_permissions == STUND_MAX_PERMISSIONS)
+      return false;
+    perm = &alloc->permissions[alloc->n_permissions++];
+    perm->addr = *peer;
+    perm->addr_len = peer_len;
+  }
+  perm->expires = now + STUND_PERMISSION_LIFETIME;
+
+  return true;
+}
+
+static StundChannel *channel_find_number (StundAllocation *alloc,
+    uint16_t number)
+{
+  unsigned int i;
+
+  for (i = 0; i < alloc->n_channels; i++)
+    if (alloc->channels[i].number == number)
+      return &alloc->channels[i];
+
+  return NULL;
+}
+
+static StundChannel *channel_find_peer (StundAllocation *alloc,
+    const StundAddress *peer)
+{
+  unsigned int i;
+
+  for (i = 0; i < alloc->n_channels; i++)
+    if (address_equal (&alloc->channels[i].peer, peer, true))
+      return &alloc->channels[i];
+
+  return NULL;
+}
+
+
+/*
+ * Allocations
+ */
+static StundAllocation *allocation_find (StundServer *server,
+    StundConnection *conn, const StundAddress *client)
+{
+  StundAllocation *alloc;
+
+  for (alloc = server->allocations; alloc != NULL; alloc = alloc->next)
+  {
+    if (conn != NULL ? alloc->conn == conn :
+        (alloc->conn == NULL && address_equal (&alloc->client, client, true)))
+      return alloc;
+  }
+
+  return NULL;
+}
+
+/*
+ * Opens the relayed transport address of an allocation, on the local address
+ * the client reaches us on: the one a socket connect()ed towards the client
+ * gets bound to.
+ */
+static int relay_socket_open (StundServer *server, const StundAddress *client,
+    socklen_t client_len, StundAddress *relay, socklen_t *relay_len)
+{
+  int fd;
+
+  fd = socket (server->family, SOCK_DGRAM, IPPROTO_UDP);
+  if (fd == -1)
+    return -1;
+
+  *relay_len = sizeof (relay->storage);
+  if (connect (fd, &client->addr, client_len) ||
+      getsockname (fd, &relay->addr, relay_len))
+    goto error;
+  close (fd);
+
+  if (relay->storage.ss_family == AF_INET)
+    relay->in.sin_port = 0;
+  else
+    relay->in6.sin6_port = 0;
+
+  fd = socket (server->family, SOCK_DGRAM, IPPROTO_UDP);
+  if (fd == -1)
+    return -1;
+
+  if (bind (fd, &relay->addr, *relay_len) ||
+      getsockname (fd, &relay->addr, relay_len))
+    goto error;
+
+  return fd;
+
+error:
+  close (fd);
+  return -1;
+}
+
+static StundAllocation *allocation_new (StundServer *server,
+    StundConnection *conn, const StundAddress *client, socklen_t client_len)
+{
+  StundAllocation *alloc;
+
+  if (server->n_allocations == STUND_MAX_ALLOCATIONS)
+    return NULL;
+
+  alloc = calloc (1, sizeof (*alloc));
+  if (alloc == NULL)
+    return NULL;
+
+  alloc->relay_fd = relay_socket_open (server, client, client_len,
+      &alloc->relay, &alloc->relay_len);
+  if (alloc->relay_fd == -1)
+  {
+    free (alloc);
+    return NULL;
+  }
+
+  alloc->conn = conn;
+  alloc->client = *client;
+  alloc->client_len = client_len;
+
+  alloc->next = server->allocations;
+  server->allocations = alloc;
+  server->n_allocations++;
+
+  return alloc;
+}
+
+static void allocation_free (StundServer *server, StundAllocation *alloc)
+{
+  StundAllocation **prev;
+
+  for (prev = &server->allocations; *prev != NULL; prev = &(*prev)->next)
+  {
+    if (*prev == alloc)
+    {
+      *prev = alloc->next;
+      server->n_allocations--;
+      break;
+    }
+  }
+
+  close (alloc->relay_fd);
+  free (alloc);
+}
+
+/*
+ * Drops the allocations, permissions and channel bindings which were not
+ * refreshed in time.
+ */
+static void allocations_expire (StundServer *server, time_t now)
+{
+  StundAllocation *alloc, *next;
+  unsigned int i;
+
+  for (alloc = server->allocations; alloc != NULL; alloc = next)
+  {
+    next = alloc->next;
+
+    if (alloc->expires <= now)
+    {
+      allocation_free (server, alloc);
+      continue;
+    }
+
+    for (i = 0; i < alloc->n_permissions;)
+    {
+      if (alloc->permissions[i].expires <= now)
+        alloc->permissions[i] = alloc->permissions[--alloc->n_permissions];
+      else
+        i++;
+    }
+
+    for (i = 0; i < alloc->n_channels;)
+    {
+      if (alloc->channels[i].expires <= now)
+        alloc->channels[i] = alloc->channels[--alloc->n_channels];
+      else
+        i++;
+    }
+  }
+}
+
+
+/*
+ * TURN requests
+ */
+static size_t turn_error (StundServer *server, StunMessage *request,
+    StunError code)
+{
+  StunMessage response;
+
+  if (!stun_agent_init_error (&server->turnagent, &response, server->send_buf,
+          sizeof (server->send_buf), request, code))
+    return 0;
+
+  if (code == STUN_ERROR_UNAUTHORIZED)
+  {
+    stun_message_append_string (&response, STUN_ATTRIBUTE_REALM,
+        server->realm);
+    stun_message_append_string (&response, STUN_ATTRIBUTE_NONCE,
+        server->nonce);
+  }
+
+  return stun_agent_finish_message (&server->turnagent, &response, NULL, 0);
+}
+
+static uint32_t turn_requested_lifetime (StunMessage *request)
+{
+  uint32_t lifetime;
+
+  if (stun_message_find32 (request, STUN_ATTRIBUTE_LIFETIME, &lifetime) !=
+      STUN_MESSAGE_RETURN_SUCCESS)
+    return STUND_DEFAULT_LIFETIME;
+
+  if (lifetime > STUND_MAX_LIFETIME)
+    return STUND_MAX_LIFETIME;
+
+  return lifetime;
+}
+
+static size_t turn_allocate (StundServer *server, StundConnection *conn,
+    const StundAddress *from, socklen_t from_len, StunMessage *request,
+    time_t now)
+{
+  StunMessage response;
+  StundAllocation *alloc;
+  uint32_t transport;
+  uint32_t lifetime;
+
+  if (allocation_find (server, conn, from) != NULL)
+    return turn_error (server, request, STUN_ERROR_ALLOCATION_MISMATCH);
+
+  if (stun_message_find32 (request, STUN_ATTRIBUTE_REQUESTED_TRANSPORT,
+          &transport) != STUN_MESSAGE_RETURN_SUCCESS)
+    return turn_error (server, request, STUN_ERROR_BAD_REQUEST);
+
+  if ((transport >> 24) != IPPROTO_UDP)
+    return turn_error (server, request, STUN_ERROR_UNSUPPORTED_TRANSPORT);
+
+  lifetime = turn_requested_lifetime (request);
+  if (lifetime < STUND_DEFAULT_LIFETIME)
+    lifetime = STUND_DEFAULT_LIFETIME;
+
+  alloc = allocation_new (server, conn, from, from_len);
+  if (alloc == NULL)
+    return turn_error (server, request, STUN_ERROR_INSUFFICIENT_CAPACITY);
+  alloc->expires = now + lifetime;
+
+  stun_agent_init_response (&server->turnagent, &response, server->send_buf,
+      sizeof (server->send_buf), request);
+  stun_message_append_xor_addr (&response, STUN_ATTRIBUTE_XOR_RELAYED_ADDRESS,
+      &alloc->relay.storage, alloc->relay_len);
+  stun_message_append32 (&response, STUN_ATTRIBUTE_LIFETIME, lifetime);
+  stun_message_append_xor_addr (&response, STUN_ATTRIBUTE_XOR_MAPPED_ADDRESS,
+      &from->storage, from_len);
+
+  return stun_agent_finish_message (&server->turnagent, &response, NULL, 0);
+}
+
+static size_t turn_refresh (StundServer *server, StundAllocation *alloc,
+    StunMessage *request, time_t now)
+{
+  StunMessage response;
+  uint32_t lifetime;
+
+  if (alloc == NULL)
+    return turn_error (server, request, STUN_ERROR_ALLOCATION_MISMATCH);
+
+  lifetime = turn_requested_lifetime (request);
+  if (lifetime == 0)
+    allocation_free (server, alloc);
+  else
+    alloc->expires = now + lifetime;
+
+  stun_agent_init_response (&server->turnagent, &response, server->send_buf,
+      sizeof (server->send_buf), request);
+  stun_message_append32 (&response, STUN_ATTRIBUTE_LIFETIME, lifetime);
+
+  return stun_agent_finish_message (&server->turnagent, &response, NULL, 0);
+}
+
+/* Only the first XOR-PEER-ADDRESS of a request is installed, which is all
+ * libnice ever sends */
+static size_t turn_create_permission (StundServer *server,
+    StundAllocation *alloc, StunMessage *request, time_t now)
+{
+  StunMessage response;
+  StundAddress peer;
+  socklen_t peer_len = sizeof (peer.storage);
+
+  if (alloc == NULL)
+    return turn_error (server, request, STUN_ERROR_ALLOCATION_MISMATCH);
+
+  if (stun_message_find_xor_addr (request, STUN_ATTRIBUTE_XOR_PEER_ADDRESS,
+          &peer.storage, &peer_len) != STUN_MESSAGE_RETURN_SUCCESS)
+    return turn_error (server, request, STUN_ERROR_BAD_REQUEST);
+
+  if (!permission_install (alloc, &peer, peer_len, now))
+    return turn_error (server, request, STUN_ERROR_INSUFFICIENT_CAPACITY);
+
+  stun_agent_init_response (&server->turnagent, &response, server->send_buf,
+      sizeof (server->send_buf), request);
+
+  return stun_agent_finish_message (&server->turnagent, &response, NULL, 0);
+}
+
+static size_t turn_channel_bind (StundServer *server, StundAllocation *alloc,
+    StunMessage *request, time_t now)
+{
+  StunMessage response;
+  StundAddress peer;
+  socklen_t peer_len = sizeof (peer.storage);
+  StundChannel *channel, *other;
+  uint32_t value;
+  uint16_t number;
+
+  if (alloc == NULL)
+    return turn_error (server, request, STUN_ERROR_ALLOCATION_MISMATCH);
+
+  if (stun_message_find32 (request, STUN_ATTRIBUTE_CHANNEL_NUMBER, &value) !=
+      STUN_MESSAGE_RETURN_SUCCESS ||
+      stun_message_find_xor_addr (request, STUN_ATTRIBUTE_XOR_PEER_ADDRESS,
+          &peer.storage, &peer_len) != STUN_MESSAGE_RETURN_SUCCESS)
+    return turn_error (server, request, STUN_ERROR_BAD_REQUEST);
+
+  number = value >> 16;
+  if (number < 0x4000 || number > 0x7FFF)
+    return turn_error (server, request, STUN_ERROR_BAD_REQUEST);
+
+  /* A channel stays bound to one peer and a peer to one channel */
+  channel = channel_find_number (alloc, number);
+  other = channel_find_peer (alloc, &peer);
+  if ((channel != NULL && other != channel) ||
+      (channel == NULL && other != NULL))
+    return turn_error (server, request, STUN_ERROR_BAD_REQUEST);
+
+  if (channel == NULL)
+  {
+    if (alloc->n_channels == STUND_MAX_CHANNELS)
+      return turn_error (server, request, STUN_ERROR_INSUFFICIENT_CAPACITY);
+    channel = &alloc->channels[alloc->n_channels++];
+    channel->number = number;
+    channel->peer = peer;
+    channel->peer_len = peer_len;
+  }
+
+  if (!permission_install (alloc, &peer, peer_len, now))
+    return turn_error (server, request, STUN_ERROR_INSUFFICIENT_CAPACITY);
+  channel->expires = now + STUND_CHANNEL_LIFETIME;
+
+  stun_agent_init_response (&server->turnagent, &response, server->send_buf,
+      sizeof (server->send_buf), request);
+
+  return stun_agent_finish_message (&server->turnagent, &response, NULL, 0);
+}
+
+static void turn_send_indication (StundServer *server, StundAllocation *alloc,
+    StunMessage *indication)
+{
+  StundAddress peer;
+  socklen_t peer_len = sizeof (peer.storage);
+  const uint8_t *data;
+  uint16_t data_len;
+
+  if (alloc == NULL)
+    return;
+
+  if (stun_message_find_xor_addr (indication, STUN_ATTRIBUTE_XOR_PEER_ADDRESS,
+          &peer.storage, &peer_len) != STUN_MESSAGE_RETURN_SUCCESS)
+    return;
+
+  data = stun_message_find (indication, STUN_ATTRIBUTE_DATA, &data_len);
+  if (data == NULL || permission_find (alloc, &peer) == NULL)
+    return;
+
+  sendto (alloc->relay_fd, (const char *) data, data_len, 0, &peer.addr,
+      peer_len);
+}
+
+/* Relays the payload of a ChannelData message to the bound peer */
+static void turn_channel_data (StundServer *server, StundConnection *conn,
+    const StundAddress *from, const uint8_t *buf, size_t len)
+{
+  StundAllocation *alloc;
+  StundChannel *channel;
+  uint16_t number, data_len;
+
+  number = (buf[0] << 8) | buf[1];
+  data_len = (buf[2] << 8) | buf[3];
+  if (data_len > len - 4)
+    return;
+
+  alloc = allocation_find (server, conn, from);
+  if (alloc == NULL)
+    return;
+
+  channel = channel_find_number (alloc, number);
+  if (channel == NULL)
+    return;
+
+  sendto (alloc->relay_fd, (const char *) buf + 4, data_len, 0,
+      &channel->peer.addr, channel->peer_len);
+}
+
+static void turn_process (StundServer *server, StundConnection *conn,
+    const StundAddress *from, socklen_t from_len, uint8_t *buf, size_t len)
+{
+  StunMessage request;
+  StunMessage response;
+  StunValidationStatus validation;
+  StundAllocation *alloc;
+  char realm[128];
+  size_t out_len = 0;
+  time_t now = time (NULL);
+
+  validation = stun_agent_validate (&server->turnagent, &request, buf, len,
+      stun_agent_default_validater, server->credentials);
+
+  if (validation == STUN_VALIDATION_UNKNOWN_REQUEST_ATTRIBUTE)
+  {
+    out_len = stun_agent_build_unknown_attributes_error (&server->turnagent,
+        &response, server->send_buf, sizeof (server->send_buf), &request);
+    client_send (server, conn, from, from_len, server->send_buf, out_len);
+    return;
+  }
+
+  /* The realm is not part of what stun_agent_validate() checks */
+  if (validation == STUN_VALIDATION_SUCCESS &&
+      stun_message_get_class (&request) == STUN_REQUEST &&
+      (stun_message_find_string (&request, STUN_ATTRIBUTE_REALM, realm,
+          sizeof (realm)) != STUN_MESSAGE_RETURN_SUCCESS ||
+       strcmp (realm, server->realm) != 0))
+    validation = STUN_VALIDATION_UNAUTHORIZED;
+
+  if (validation == STUN_VALIDATION_UNAUTHORIZED ||
+      validation == STUN_VALIDATION_UNAUTHORIZED_BAD_REQUEST)
+  {
+    if (stun_message_get_class (&request) == STUN_REQUEST)
+    {
+      request.key = NULL;
+      request.key_len = 0;
+      request.long_term_valid = false;
+      out_len = turn_error (server, &request, STUN_ERROR_UNAUTHORIZED);
+      client_send (server, conn, from, from_len, server->send_buf, out_len);
+    }
+    return;
+  }
+
+  if (validation != STUN_VALIDATION_SUCCESS)
+    return;
+
+  alloc = allocation_find (server, conn, from);
+
+  if (stun_message_get_class (&request) == STUN_INDICATION)
+  {
+    if (stun_message_get_method (&request) == STUN_IND_SEND)
+      turn_send_indication (server, alloc, &request);
+    return;
+  }
+
+  if (stun_message_get_class (&request) != STUN_REQUEST)
+    return;
+
+  switch (stun_message_get_method (&request))
+  {
+    case STUN_ALLOCATE:
+      out_len = turn_allocate (server, conn, from, from_len, &request, now);
+      break;
+
+    case STUN_REFRESH:
+      out_len = turn_refresh (server, alloc, &request, now);
+      break;
+
+    case STUN_CREATEPERMISSION:
+      out_len = turn_create_permission (server, alloc, &request, now);
+      break;
+
+    case STUN_CHANNELBIND:
+      out_len = turn_channel_bind (server, alloc, &request, now);
+      break;
+
+    default:
+      out_len = turn_error (server, &request, STUN_ERROR_BAD_REQUEST);
+      break;
+  }
+
+  client_send (server, conn, from, from_len, server->send_buf, out_len);
+}
+
+
+static bool has_magic_cookie (const uint8_t *buf, size_t len)
+{
+  uint32_t cookie;
+
+  if (len < 8)
+    return false;
+
+  memcpy (&cookie, buf + 4, sizeof (cookie));
+  return ntohl (cookie) == STUN_MAGIC_COOKIE;
+}
+
+/*
+ * Handles one message from a client: a STUN message, or ChannelData when
+ * the relay is enabled.
+ */
+static void client_process (StundServer *server, StundConnection *conn,
+    const StundAddress *from, socklen_t from_len, uint8_t *buf, size_t len)
+{
+  StunMessage request;
+  StunMessage response;
+  StunValidationStatus validation;
+  StunAgent *agent = NULL;
+  size_t buf_len = 0;
+
+  if (server->relay && len >= 4 && (buf[0] & 0xC0) == 0x40)
+  {
+    turn_channel_data (server, conn, from, buf, len);
+    return;
+  }
+
+  if (server->relay && len >= 20 &&
+      stun_message_validate_buffer_length (buf, len, true) == (int) len)
+  {
+    request.buffer = buf;
+    request.buffer_len = len;
+    if (stun_message_get_method (&request) != STUN_BINDING)
+    {
+      turn_process (server, conn, from, from_len, buf, len);
+      return;
+    }
+  }
+
+  /* The magic cookie tells RFC 5389 requests from RFC 3489 ones, whose
+   * transaction ID is random there. Requests with a cookie which fail the
+   * FINGERPRINT check are still answered the RFC 3489 way. */
+  agent = has_magic_cookie (buf, len) ? &server->newagent : &server->oldagent;
+  validation = stun_agent_validate (agent, &request, buf, len, NULL, 0);
+
+  if (validation == STUN_VALIDATION_BAD_REQUEST && agent == &server->newagent)
+  {
+    agent = &server->oldagent;
+    validation = stun_agent_validate (agent, &request, buf, len, NULL, 0);
+  }
+
+  /* Unknown attributes */
+  if (validation == STUN_VALIDATION_UNKNOWN_REQUEST_ATTRIBUTE)
+  {
+    buf_len = stun_agent_build_unknown_attributes_error (agent, &response,
+        server->send_buf, sizeof (server->send_buf), &request);
+    goto send_buf;
+  }
+
+  /* Mal-formatted packets */
+  if (validation != STUN_VALIDATION_SUCCESS ||
+      stun_message_get_class (&request) != STUN_REQUEST) {
+    return;
+  }
+
+  switch (stun_message_get_method (&request))
+  {
+    case STUN_BINDING:
+      stun_agent_init_response (agent, &response, server->send_buf,
+          sizeof (server->send_buf), &request);
+      if (stun_message_has_cookie (&request))
+        stun_message_append_xor_addr (&response,
+            STUN_ATTRIBUTE_XOR_MAPPED_ADDRESS, &from->storage, from_len);
+      else
+         stun_message_append_addr (&response, STUN_ATTRIBUTE_MAPPED_ADDRESS,
+             &from->addr, from_len);
+      break;
+
+    case STUN_SHARED_SECRET:
+    case STUN_ALLOCATE:
+    case STUN_SEND:
+    case STUN_CONNECT:
+    case STUN_IND_SEND:
+    case STUN_IND_DATA:
+    case STUN_CREATEPERMISSION:
+    case STUN_CHANNELBIND:
+    default:
+      if (!stun_agent_init_error (agent, &response, server->send_buf,
+              sizeof (server->send_buf), &request, STUN_ERROR_BAD_REQUEST))
+        return;
+  }
+
+  buf_len = stun_agent_finish_message (agent, &response, NULL, 0);
+send_buf:
+  client_send (server, conn, from, from_len, server->send_buf, buf_len);
+}
+
+#ifdef STUND_USE_MMSG
+/* Reads up to a batch of datagrams in one go and answers them together */
+static void dgram_process (StundServer *server)
+{
+  struct mmsghdr msgs[STUND_BATCH];
+  struct iovec iov[STUND_BATCH];
+  int i, n;
+
+  for (i = 0; i < STUND_BATCH; i++)
+  {
+    StundDatagram *dgram = &server->dgram_in[i];
+
+    iov[i].iov_base = dgram->buf;
+    iov[i].iov_len = sizeof (dgram->buf);
+    memset (&msgs[i], 0, sizeof (msgs[i]));
+    msgs[i].msg_hdr.msg_name = &dgram->addr;
+    msgs[i].msg_hdr.msg_namelen = sizeof (dgram->addr.storage);
+    msgs[i].msg_hdr.msg_iov = &iov[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  n = recvmmsg (server->udp_fd, msgs, STUND_BATCH, MSG_DONTWAIT, NULL);
+  if (n <= 0)
+    return;
+
+  server->batching = true;
+  for (i = 0; i < n; i++)
+  {
+    StundDatagram *dgram = &server->dgram_in[i];
+
+    if (msgs[i].msg_len == 0 || (msgs[i].msg_hdr.msg_flags & MSG_TRUNC))
+      continue;
+
+    client_process (server, NULL, &dgram->addr, msgs[i].msg_hdr.msg_namelen,
+        dgram->buf, msgs[i].msg_len);
+  }
+  server->batching = false;
+
+  dgram_flush (server);
+}
+#else
+static void dgram_process (StundServer *server)
+{
+  StundAddress addr;
+  socklen_t addr_len = sizeof (addr.storage);
+  ssize_t len;
+
+  len = recvfrom (server->udp_fd, (char *) server->recv_buf,
+      sizeof (server->recv_buf), 0, &addr.addr, &addr_len);
+  if (len <= 0)
+    return;
+
+  client_process (server, NULL, &addr, addr_len, server->recv_buf, len);
+}
+#endif
+
+/*
+ * Data from a peer on a relayed transport address goes to the client in
+ * ChannelData if a channel is bound to the peer, or in a Data indication.
+ */
+static void relay_process (StundServer *server, StundAllocation *alloc)
+{
+  StunMessage indication;
+  StundAddress peer;
+  socklen_t peer_len = sizeof (peer.storage);
+  StundChannel *channel;
+  uint8_t *buf = server->recv_buf;
+  ssize_t len;
+  size_t out_len;
+
+  len = recvfrom (alloc->relay_fd, (char *) buf + 4,
+      sizeof (server->recv_buf) - 4, 0, &peer.addr, &peer_len);
+  if (len < 0 || len > 0xFFFF)
+    return;
+
+  if (permission_find (alloc, &peer) == NULL)
+    return;
+
+  channel = channel_find_peer (alloc, &peer);
+  if (channel != NULL)
+  {
+    buf[0] = channel->number >> 8;
+    buf[1] = channel->number & 0xFF;
+    buf[2] = len >> 8;
+    buf[3] = len & 0xFF;
+    client_send (server, alloc->conn, &alloc->client, alloc->client_len,
+        buf, len + 4);
+    return;
+  }
+
+  if (!stun_agent_init_indication (&server->turnagent, &indication,
+          server->send_buf, sizeof (server->send_buf), STUN_IND_DATA) ||
+      stun_message_append_xor_addr (&indication,
+          STUN_ATTRIBUTE_XOR_PEER_ADDRESS, &peer.storage, peer_len) !=
+      STUN_MESSAGE_RETURN_SUCCESS ||
+      stun_message_append_bytes (&indication, STUN_ATTRIBUTE_DATA, buf + 4,
+          len) != STUN_MESSAGE_RETURN_SUCCESS)
+    return;
+
+  out_len = stun_agent_finish_message (&server->turnagent, &indication,
+      NULL, 0);
+  client_send (server, alloc->conn, &alloc->client, alloc->client_len,
+      server->send_buf, out_len);
+}
+
+
+/*
+ * TCP connections carry STUN messages and ChannelData back to back, RFC 5766
+ * section 11.5. Returns the length of the message at the start of @buf and
+ * sets @frame_len to the length it takes on the wire including padding, 0 if
+ * more data is needed or -1 on garbage.
+ */
+static int connection_frame_length (const uint8_t *buf, size_t len,
+    size_t *frame_len)
+{
+  size_t msg_len;
+
+  if (len < 4)
+    return 0;
+
+  switch (buf[0] & 0xC0)
+  {
+    case 0x00:
+      msg_len = 20 + ((buf[2] << 8) | buf[3]);
+      break;
+
+    case 0x40:
+      msg_len = 4 + ((buf[2] << 8) | buf[3]);
+      break;
+
+    default:
+      return -1;
+  }
+
+  *frame_len = (msg_len + 3) & ~(size_t) 3;
+  if (*frame_len > len)
+    return 0;
+
+  return msg_len;
+}
+
+static void connection_close (StundServer *server, unsigned int idx)
+{
+  StundConnection *conn = server->connections[idx];
+  StundAllocation *alloc, *next;
+
+  for (alloc = server->allocations; alloc != NULL; alloc = next)
+  {
+    next = alloc->next;
+    if (alloc->conn == conn)
+      allocation_free (server, alloc);
+  }
+
+  close (conn->fd);
+  free (conn);
+  server->connections[idx] = NULL;
+}
+
+static void connection_accept (StundServer *server)
+{
+  StundConnection *conn;
+  StundAddress addr;
+  socklen_t addr_len = sizeof (addr.storage);
+  unsigned int i;
+  int fd;
+
+  fd = accept (server->tcp_fd, &addr.addr, &addr_len);
+  if (fd == -1)
+    return;
+
+  for (i = 0; i < STUND_MAX_CONNECTIONS; i++)
+    if (server->connections[i] == NULL)
+      break;
+
+  conn = (i < STUND_MAX_CONNECTIONS) ? malloc (sizeof (*conn)) : NULL;
+  if (conn == NULL)
+  {
+    close (fd);
+    return;
+  }
+
+  conn->fd = fd;
+  conn->addr = addr;
+  conn->addr_len = addr_len;
+  conn->len = 0;
+  server->connections[i] = conn;
+}
+
+static void connection_process (StundServer *server, unsigned int idx)
+{
+  StundConnection *conn = server->connections[idx];
+  size_t frame_len = 0;
+  ssize_t ret;
+  int msg_len;
+
+  ret = recv (conn->fd, (char *) conn->buf + conn->len,
+      sizeof (conn->buf) - conn->len, 0);
+  if (ret <= 0)
+  {
+    if (ret < 0 && errno == EINTR)
+      return;
+    connection_close (server, idx);
+    return;
+  }
+  conn->len += ret;
+
+  while ((msg_len = connection_frame_length (conn->buf, conn->len,
+              &frame_len)) > 0)
+  {
+    client_process (server, conn, &conn->addr, conn->addr_len, conn->buf,
+        msg_len);
+    conn->len -= frame_len;
+    memmove (conn->buf, conn->buf + frame_len, conn->len);
+  }
+
+  if (msg_len < 0)
+    connection_close (server, idx);
+}
+
+
+/*
+ * Server
+ */
+StundServer *stund_server_new (int family, unsigned int port)
+{
+  return stund_server_new_full (family, port, 0);
+}
+
+/*
+ * With %STUND_SERVER_FLAG_REUSE_PORT, several servers can listen on the same
+ * port and the kernel spreads clients over them by their address, so each
+ * one can run in its own thread.
+ */
+StundServer *stund_server_new_full (int family, unsigned int port,
+    unsigned int flags)
+{
+  bool reuse_port = (flags & STUND_SERVER_FLAG_REUSE_PORT) != 0;
+  StundServer *server;
+  StundAddress addr;
+  socklen_t addr_len = sizeof (addr.storage);
+
+  server = calloc (1, sizeof (*server));
+  if (server == NULL)
+    return NULL;
+
+  server->family = family;
+  server->tcp_fd = -1;
+  server->wakeup_fds[0] = server->wakeup_fds[1] = -1;
+  server->udp_fd = listen_socket_full (family, SOCK_DGRAM, IPPROTO_UDP, port,
+      reuse_port);
+  if (server->udp_fd == -1)
+    goto error;
+
+  if (getsockname (server->udp_fd, &addr.addr, &addr_len))
+    goto error;
+  server->port = ntohs (family == AF_INET ? addr.in.sin_port :
+      addr.in6.sin6_port);
+
+  /* TCP is best effort, the port may well be taken for it */
+  server->tcp_fd = listen_socket_full (family, SOCK_STREAM, IPPROTO_TCP,
+      server->port, reuse_port);
+
+#ifndef _WIN32
+  if (pipe (server->wakeup_fds))
+    goto error;
+  fcntl (server->wakeup_fds[0], F_SETFL, O_NONBLOCK);
+  fcntl (server->wakeup_fds[1], F_SETFL, O_NONBLOCK);
+  fcntl (server->wakeup_fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl (server->wakeup_fds[1], F_SETFD, FD_CLOEXEC);
+#endif
+
+  stun_agent_init (&server->oldagent, known_attributes,
+      STUN_COMPATIBILITY_RFC3489, 0);
+  stun_agent_init (&server->newagent, known_attributes,
+      STUN_COMPATIBILITY_RFC5389, STUN_AGENT_USAGE_USE_FINGERPRINT);
+  stun_agent_init (&server->turnagent, STUN_ALL_KNOWN_ATTRIBUTES,
+      STUN_COMPATIBILITY_RFC5389, STUN_AGENT_USAGE_LONG_TERM_CREDENTIALS);
+
+  return server;
+
+error:
+  if (server->tcp_fd != -1)
+    close (server->tcp_fd);
+  if (server->udp_fd != -1)
+    close (server->udp_fd);
+  free (server);
+  return NULL;
+}
+
+void stund_server_set_credentials (StundServer *server, const char *username,
+    const char *password, const char *realm)
+{
+  free (server->username);
+  free (server->password);
+  free (server->realm);
+
+  server->username = strdup (username);
+  server->password = strdup (password);
+  server->realm = strdup (realm);
+  snprintf (server->nonce, sizeof (server->nonce), "%08lx%08x",
+      (unsigned long) time (NULL), (unsigned int) rand ());
+
+  server->credentials[0].username = (uint8_t *) server->username;
+  server->credentials[0].username_len = strlen (server->username);
+  server->credentials[0].password = (uint8_t *) server->password;
+  server->credentials[0].password_len = strlen (server->password);
+  memset (&server->credentials[1], 0, sizeof (server->credentials[1]));
+
+  server->relay = true;
+}
+
+unsigned int stund_server_get_port (const StundServer *server)
+{
+  return server->port;
+}
+
+/*
+ * Waits up to @timeout_ms for traffic and handles it. Returns -1 on error.
+ */
+int stund_server_iterate (StundServer *server, int timeout_ms)
+{
+  struct pollfd fds[3 + STUND_MAX_CONNECTIONS + STUND_MAX_ALLOCATIONS];
+  StundAllocation *relays[STUND_MAX_ALLOCATIONS];
+  unsigned int conns[STUND_MAX_CONNECTIONS];
+  StundAllocation *alloc;
+  unsigned int n_fds = 0, n_relays = 0, n_conns = 0;
+  unsigned int i;
+  int ret;
+
+  allocations_expire (server, time (NULL));
+
+  fds[n_fds].fd = server->udp_fd;
+  fds[n_fds++].events = POLLIN;
+  fds[n_fds].fd = server->tcp_fd;
+  fds[n_fds++].events = POLLIN;
+
+  for (i = 0; i < STUND_MAX_CONNECTIONS; i++)
+  {
+    if (server->connections[i] == NULL)
+      continue;
+    conns[n_conns++] = i;
+    fds[n_fds].fd = server->connections[i]->fd;
+    fds[n_fds++].events = POLLIN;
+  }
+
+  for (alloc = server->allocations; alloc != NULL; alloc = alloc->next)
+  {
+    relays[n_relays++] = alloc;
+    fds[n_fds].fd = alloc->relay_fd;
+    fds[n_fds++].events = POLLIN;
+  }
+
+  if (server->wakeup_fds[0] != -1)
+  {
+    fds[n_fds].fd = server->wakeup_fds[0];
+    fds[n_fds++].events = POLLIN;
+  }
+
+  for (i = 0; i < n_fds; i++)
+    fds[i].revents = 0;
+
+  ret = poll (fds, n_fds, timeout_ms);
+  if (ret < 0)
+    return (errno == EINTR) ? 0 : -1;
+
+  if (stopping_get (server))
+    return 0;
+
+  /* Relayed sockets first: handling the other sockets may free allocations */
+  for (i = 0; i < n_relays; i++)
+    if (fds[2 + n_conns + i].revents & (POLLIN | POLLERR))
+      relay_process (server, relays[i]);
+
+  for (i = 0; i < n_conns; i++)
+    if (fds[2 + i].revents & (POLLIN | POLLERR | POLLHUP))
+      connection_process (server, conns[i]);
+
+  if (fds[0].revents & (POLLIN | POLLERR))
+    dgram_process (server);
+
+  if (fds[1].revents & POLLIN)
+    connection_accept (server);
+
+  return 0;
+}
+
+int stund_server_run (StundServer *server)
+{
+  while (!stopping_get (server))
+    if (stund_server_iterate (server, 1000) < 0)
+      return -1;
+
+  return 0;
+}
+
+/*
+ * Makes stund_server_run() return. May be called from another thread, it
+ * wakes the server up through its wakeup pipe, or on Windows with an empty
+ * datagram on the loopback interface.
+ */
+void stund_server_stop (StundServer *server)
+{
+  StundAddress addr;
+  socklen_t addr_len;
+  int fd;
+
+  stopping_set (server);
+
+  if (server->wakeup_fds[1] != -1)
+  {
+    /* A full pipe already has the server awake */
+    if (write (server->wakeup_fds[1], "", 1) < 0 && errno != EAGAIN)
+      perror ("write");
+    return;
+  }
+
+  memset (&addr, 0, sizeof (addr));
+  if (server->family == AF_INET)
+  {
+    addr.in.sin_family = AF_INET;
+    addr.in.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+    addr.in.sin_port = htons (server->port);
+    addr_len = sizeof (addr.in);
+  }
+  else
+  {
+    addr.in6.sin6_family = AF_INET6;
+    addr.in6.sin6_addr = in6addr_loopback;
+    addr.in6.sin6_port = htons (server->port);
+    addr_len = sizeof (addr.in6);
+  }
+
+  fd = socket (server->family, SOCK_DGRAM, IPPROTO_UDP);
+  if (fd == -1)
+    return;
+  sendto (fd, "", 0, 0, &addr.addr, addr_len);
+  close (fd);
+}
+
+void stund_server_free (StundServer *server)
+{
+  unsigned int i;
+
+  for (i = 0; i < STUND_MAX_CONNECTIONS; i++)
+    if (server->connections[i] != NULL)
+      connection_close (server, i);
+
+  while (server->allocations != NULL)
+    allocation_free (server, server->allocations);
+
+  if (server->tcp_fd != -1)
+    close (server->tcp_fd);
+  close (server->udp_fd);
+  if (server->wakeup_fds[0] != -1)
+  {
+    close (server->wakeup_fds[0]);
+    close (server->wakeup_fds[1]);
+  }
+
+  free (server->username);
+  free (server->password);
+  free (server->realm);
+  free (server);
+}
@@ -40,13 +40,7 @@
 # include <config.h>
 #endif
 
-#ifdef __sun
-#define _XPG4_2 1
-#endif
-
-#include <assert.h>
 #include <stdio.h>
-#include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 #include <signal.h>
@@ -57,237 +51,61 @@
 #include <winsock2.h>
 #else
 #include <sys/socket.h>
-#include <netdb.h>
-#include <netinet/in.h>
 #endif
 
-#ifdef HAVE_UNISTD_H
-# include <unistd.h>
-#else
-# define close(fd) _close(fd)
-#endif
-
-#include <errno.h>
-#include <limits.h>
-#include <stdio.h>
-
-#ifndef SOL_IP
-# define SOL_IP IPPROTO_IP
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
 #endif
 
-#ifndef SOL_IPV6
-# define SOL_IPV6 IPPROTO_IPV6
-#endif
-
-
-#ifndef IPV6_RECVPKTINFO
-# define IPV6_RECVPKTINFO IPV6_PKTINFO
-#endif
-
-/** Default port for STUN binding discovery */
-#define IPPORT_STUN  3478
-
-#include "stun/stunagent.h"
 #include "stund.h"
 
-static const uint16_t known_attributes[] =  {
-  0
-};
+/* Upper bound for -t */
+#define STUND_MAX_WORKERS 64
 
-/*
- * Creates a listening socket
- */
-int listen_socket (int fam, int type, int proto, unsigned int port)
-{
-  int yes = 1;
-  int fd = socket (fam, type, proto);
-  union {
-    struct sockaddr addr;
-    struct sockaddr_in in;
-    struct sockaddr_in6 in6;
-    struct sockaddr_storage storage;
-  } addr;
-
-  if (fd == -1)
-  {
-    perror ("Error opening IP port");
-    return -1;
-  }
-
-  memset (&addr, 0, sizeof (addr));
-  addr.storage.ss_family = fam;
-#ifdef HAVE_SA_LEN
-  addr.storage.ss_len = sizeof (addr);
-#endif
-
-  switch (fam)
-  {
-    case AF_INET:
-      addr.in.sin_port = htons (port);
-      break;
-
-    case AF_INET6:
-#ifdef IPV6_V6ONLY
-      setsockopt (fd, SOL_IPV6, IPV6_V6ONLY, (const char *) &yes, sizeof (yes));
-#endif
-      addr.in6.sin6_port = htons (port);
-      break;
-
-    default:
-      assert (0);  /* should never be reached */
-  }
-
-  if (bind (fd, &addr.addr, sizeof (struct sockaddr_storage)))
-  {
-    perror ("Error opening IP port");
-    goto error;
-  }
-
-  if ((type == SOCK_DGRAM) || (type == SOCK_RAW))
-  {
-    switch (fam)
-    {
-      case AF_INET:
-#ifdef IP_RECVERR
-        setsockopt (fd, SOL_IP, IP_RECVERR, (const char*) &yes, sizeof (yes));
-#endif
-        break;
-
-      case AF_INET6:
-#ifdef IPV6_RECVERR
-        setsockopt (fd, SOL_IPV6, IPV6_RECVERR, (const char*) &yes, sizeof (yes));
-#endif
-        break;
-
-      default:
-        assert (0);  /* should never be reached */
-    }
-  }
-  else
-  {
-    if (listen (fd, INT_MAX))
-    {
-      perror ("Error opening IP port");
-      goto error;
-    }
-  }
-
-  return fd;
-
-error:
-  close (fd);
-  return -1;
-}
-
-static int dgram_process (int sock, StunAgent *oldagent, StunAgent *newagent)
+/* Pretty useless dummy signal handler...
+ * But calling exit() is needed for gcov to work properly. */
+static void exit_handler (int signum)
 {
-  union {
-    struct sockaddr_storage storage;
-    struct sockaddr addr;
-  } addr;
-  socklen_t addr_len;
-  uint8_t buf[STUN_MAX_MESSAGE_SIZE];
-  size_t buf_len = 0;
-  size_t len = 0;
-  StunMessage request;
-  StunMessage response;
-  StunValidationStatus validation;
-  StunAgent *agent = NULL;
-
-  addr_len = sizeof (struct sockaddr_storage);
-  len = recvfrom (sock, buf, sizeof(buf), 0, &addr.addr, &addr_len);
-  if (len == (size_t)-1)
-    return -1;
-
-  validation = stun_agent_validate (newagent, &request, buf, len, NULL, 0);
-
-  if (validation == STUN_VALIDATION_SUCCESS) {
-    agent = newagent;
-  }
-  else {
-    validation = stun_agent_validate (oldagent, &request, buf, len, NULL, 0);
-    agent = oldagent;
-  }
-
-  /* Unknown attributes */
-  if (validation == STUN_VALIDATION_UNKNOWN_REQUEST_ATTRIBUTE)
-  {
-    buf_len = stun_agent_build_unknown_attributes_error (agent, &response, buf,
-        sizeof (buf), &request);
-    goto send_buf;
-  }
-
-  /* Mal-formatted packets */
-  if (validation != STUN_VALIDATION_SUCCESS ||
-      stun_message_get_class (&request) != STUN_REQUEST) {
-    return -1;
-  }
-
-  switch (stun_message_get_method (&request))
-  {
-    case STUN_BINDING:
-      stun_agent_init_response (agent, &response, buf, sizeof (buf), &request);
-      if (stun_message_has_cookie (&request))
-        stun_message_append_xor_addr (&response,
-            STUN_ATTRIBUTE_XOR_MAPPED_ADDRESS, &addr.storage, addr_len);
-      else
-         stun_message_append_addr (&response, STUN_ATTRIBUTE_MAPPED_ADDRESS,
-             &addr.addr, addr_len);
-      break;
-
-    case STUN_SHARED_SECRET:
-    case STUN_ALLOCATE:
-    case STUN_SEND:
-    case STUN_CONNECT:
-    case STUN_IND_SEND:
-    case STUN_IND_DATA:
-    case STUN_CREATEPERMISSION:
-    case STUN_CHANNELBIND:
-    default:
-      if (!stun_agent_init_error (agent, &response, buf, sizeof (buf),
-              &request, STUN_ERROR_BAD_REQUEST))
-        return -1;
-  }
-
-  buf_len = stun_agent_finish_message (agent, &response, NULL, 0);
-send_buf:
-  len = sendto (sock, buf, buf_len, 0, &addr.addr, addr_len);
-  return (len < buf_len) ? -1 : 0;
+  (void)signum;
+  exit (0);
 }
 
 
-static int run (int family, int protocol, unsigned port)
+static void usage (const char *prog)
 {
-  StunAgent oldagent;
-  StunAgent newagent;
-  int sock = listen_socket (family, SOCK_DGRAM, protocol, port);
-  if (sock == -1)
-    return -1;
-
-  stun_agent_init (&oldagent, known_attributes,
-      STUN_COMPATIBILITY_RFC3489, 0);
-  stun_agent_init (&newagent, known_attributes,
-      STUN_COMPATIBILITY_RFC5389, STUN_AGENT_USAGE_USE_FINGERPRINT);
-
-  for (;;)
-    dgram_process (sock, &oldagent, &newagent);
+  fprintf (stderr,
+      "Usage: %s [-4|-6] [-t threads] [-u username -p password [-r realm]]"
+      " [port]\n"
+      "\n"
+      "Answers STUN binding requests on UDP and TCP. With a username and\n"
+      "a password it also acts as a TURN relay (RFC 5766).\n"
+      "With several threads, each one serves its share of the clients on\n"
+      "its own SO_REUSEPORT sockets.\n", prog);
 }
 
 
-/* Pretty useless dummy signal handler...
- * But calling exit() is needed for gcov to work properly. */
-static void exit_handler (int signum)
+#ifdef HAVE_PTHREAD_H
+static void *worker_thread (void *data)
 {
-  (void)signum;
-  exit (0);
+  stund_server_run (data);
+  return NULL;
 }
+#endif
 
 
 int main (int argc, char *argv[])
 {
+  StundServer *servers[STUND_MAX_WORKERS];
+  unsigned int n_workers = 1;
+  unsigned int flags = 0;
   int family = AF_INET;
   unsigned port = IPPORT_STUN;
+  const char *username = NULL;
+  const char *password = NULL;
+  const char *realm = "stund";
+  int ret;
   int i;
+  unsigned int w;
 
 
 #ifdef _WIN32
@@ -313,6 +131,24 @@ int main (int argc, char *argv[])
     {
       family = AF_INET6;
     }
+    else if (strcmp (arg, "-u") == 0 || strcmp (arg, "-p") == 0 ||
+        strcmp (arg, "-r") == 0 || strcmp (arg, "-t") == 0)
+    {
+      if (++i >= argc)
+      {
+        usage (argv[0]);
+        return EXIT_FAILURE;
+      }
+
+      if (arg[1] == 'u')
+        username = argv[i];
+      else if (arg[1] == 'p')
+        password = argv[i];
+      else if (arg[1] == 'r')
+        realm = argv[i];
+      else
+        n_workers = atoi (argv[i]);
+    }
     else if (arg[0] < '0' || arg[0] > '9')
     {
       fprintf (stderr, "Unexpected command line argument '%s'", arg);
@@ -324,8 +160,60 @@ int main (int argc, char *argv[])
     }
   }
 
+  if ((username == NULL) != (password == NULL))
+  {
+    usage (argv[0]);
+    return EXIT_FAILURE;
+  }
+
+#ifndef HAVE_PTHREAD_H
+  if (n_workers > 1)
+  {
+    fprintf (stderr, "Threads are not supported on this platform\n");
+    n_workers = 1;
+  }
+#endif
+
+  if (n_workers < 1 || n_workers > STUND_MAX_WORKERS)
+  {
+    usage (argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (n_workers > 1)
+    flags |= STUND_SERVER_FLAG_REUSE_PORT;
+
+  for (w = 0; w < n_workers; w++)
+  {
+    servers[w] = stund_server_new_full (family, port, flags);
+    if (servers[w] == NULL)
+      return EXIT_FAILURE;
+
+    /* Let the other workers join the port the first one got */
+    port = stund_server_get_port (servers[w]);
+
+    if (username != NULL)
+      stund_server_set_credentials (servers[w], username, password, realm);
+  }
+
   signal (SIGINT, exit_handler);
   signal (SIGTERM, exit_handler);
-  return run (family, IPPROTO_UDP, port) ? EXIT_FAILURE : EXIT_SUCCESS;
-}
 
+#ifdef HAVE_PTHREAD_H
+  for (w = 1; w < n_workers; w++)
+  {
+    pthread_t thread;
+
+    if (pthread_create (&thread, NULL, worker_thread, servers[w]) != 0)
+    {
+      perror ("Error starting thread");
+      return EXIT_FAILURE;
+    }
+    pthread_detach (thread);
+  }
+#endif
+
+  ret = stund_server_run (servers[0]);
+
+  return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
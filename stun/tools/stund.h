@@ -39,8 +39,41 @@
 #ifndef NICE_STUN_STUND_H
 # define NICE_STUN_STUND_H 1
 
+#include <stdbool.h>
+
+/** Default port for STUN binding discovery */
+#define IPPORT_STUN  3478
+
+/*
+ * A STUN binding server which can optionally act as a minimal RFC 5766 TURN
+ * relay (allocations, permissions, channels, Send and Data indications) over
+ * UDP and TCP. It does not depend on GLib, so besides backing the stund
+ * binary it can be run as an in-process fixture from a test thread:
+ *
+ *   StundServer *server = stund_server_new (AF_INET, 0);
+ *   stund_server_set_credentials (server, "user", "pass", "realm");
+ *   port = stund_server_get_port (server);
+ *   ... stund_server_run (server) in a thread ...
+ *   stund_server_stop (server);
+ *   ... join the thread ...
+ *   stund_server_free (server);
+ */
+typedef struct _StundServer StundServer;
+
+/* Flags of stund_server_new_full() */
+#define STUND_SERVER_FLAG_REUSE_PORT (1 << 0)
+
 int listen_socket (int fam, int type, int proto, unsigned port);
-ssize_t send_safe (int fd, const struct msghdr *msg);
-ssize_t recv_safe (int fd, struct msghdr *msg);
+
+StundServer *stund_server_new (int family, unsigned int port);
+StundServer *stund_server_new_full (int family, unsigned int port,
+    unsigned int flags);
+void stund_server_set_credentials (StundServer *server, const char *username,
+    const char *password, const char *realm);
+unsigned int stund_server_get_port (const StundServer *server);
+int stund_server_iterate (StundServer *server, int timeout_ms);
+int stund_server_run (StundServer *server);
+void stund_server_stop (StundServer *server);
+void stund_server_free (StundServer *server);
 
 #endif
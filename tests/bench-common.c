@@ -0,0 +1,275 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * Shared helpers of the benchmarks.
+ *
+ * (C) 2026 Collabora Ltd
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ *
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "bench-common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WAIT_TIMEOUT_S 30
+
+static GMainContext *context;
+static GMainLoop *loop;
+static GThread *loop_thread;
+static GMutex mutex;
+static GCond cond;
+
+void
+bench_report (const gchar *benchmark, const gchar *metric,
+    const gchar *params, gdouble value, const gchar *unit)
+{
+  gchar value_str[G_ASCII_DTOSTR_BUF_SIZE];
+
+  /* Locale independent */
+  g_ascii_formatd (value_str, sizeof (value_str), "%.3f", value);
+  printf ("{\"benchmark\": \"%s\", \"metric\": \"%s\", \"value\": %s, "
+      "\"unit\": \"%s\", \"params\": \"%s\"}\n", benchmark, metric, value_str,
+      unit, params ? params : "");
+  fflush (stdout);
+}
+
+static gint
+compare_doubles (gconstpointer a, gconstpointer b)
+{
+  gdouble da = *(const gdouble *) a, db = *(const gdouble *) b;
+
+  return (da > db) - (da < db);
+}
+
+gdouble
+bench_percentile (gdouble *samples, guint n_samples, gdouble percentile)
+{
+  guint idx;
+
+  g_assert (n_samples > 0);
+
+  qsort (samples, n_samples, sizeof (gdouble),
+      (int (*)(const void *, const void *)) compare_doubles);
+  idx = MIN ((guint) (percentile / 100.0 * n_samples), n_samples - 1);
+
+  return samples[idx];
+}
+
+static gpointer
+loop_thread_cb (gpointer user_data)
+{
+  g_main_context_push_thread_default (context);
+  g_main_loop_run (loop);
+  g_main_context_pop_thread_default (context);
+
+  return NULL;
+}
+
+static gboolean
+timer_cb (gpointer user_data)
+{
+  g_error ("ERROR: benchmark has got stuck, aborting...");
+
+  return G_SOURCE_REMOVE;
+}
+
+GMainContext *
+bench_get_context (void)
+{
+  return context;
+}
+
+void
+bench_init (void)
+{
+#ifdef G_OS_WIN32
+  WSADATA w;
+
+  WSAStartup(0x0202, &w);
+#endif
+
+  context = g_main_context_new ();
+  loop = g_main_loop_new (context, FALSE);
+  loop_thread = g_thread_new ("bench loop", loop_thread_cb, NULL);
+}
+
+void
+bench_deinit (void)
+{
+  g_main_loop_quit (loop);
+  g_thread_join (loop_thread);
+  g_main_loop_unref (loop);
+  g_main_context_unref (context);
+
+#ifdef G_OS_WIN32
+  WSACleanup();
+#endif
+}
+
+/* Waits until *@counter reaches @target */
+static void
+wait_for (gint *counter, gint target)
+{
+  gint64 end_time;
+
+  end_time = g_get_monotonic_time () + WAIT_TIMEOUT_S * G_TIME_SPAN_SECOND;
+
+  g_mutex_lock (&mutex);
+  while (g_atomic_int_get (counter) < target) {
+    if (!g_cond_wait_until (&cond, &mutex, end_time))
+      timer_cb (NULL);
+  }
+  g_mutex_unlock (&mutex);
+}
+
+static void
+signal_counter (gint *counter)
+{
+  g_mutex_lock (&mutex);
+  g_atomic_int_inc (counter);
+  g_cond_broadcast (&cond);
+  g_mutex_unlock (&mutex);
+}
+
+static void
+cb_candidate_gathering_done (NiceAgent *agent, guint stream_id,
+    gpointer user_data)
+{
+  BenchPeer *peer = user_data;
+
+  signal_counter (&peer->n_gathered);
+}
+
+static void
+cb_component_state_changed (NiceAgent *agent, guint stream_id,
+    guint component_id, guint state, gpointer user_data)
+{
+  BenchPeer *peer = user_data;
+
+  if (state == NICE_COMPONENT_STATE_READY)
+    signal_counter (&peer->n_ready);
+  else if (state == NICE_COMPONENT_STATE_FAILED)
+    g_error ("Stream %u failed to connect", stream_id);
+}
+
+void
+bench_peer_init (BenchPeer *peer, gboolean controlling, gboolean reliable,
+    guint n_streams, NiceAgentRecvFunc recv_func, gpointer user_data)
+{
+  NiceAddress addr;
+  guint i;
+
+  memset (peer, 0, sizeof (*peer));
+
+  peer->agent = nice_agent_new_full (context, NICE_COMPATIBILITY_RFC5245,
+      reliable ? NICE_AGENT_OPTION_RELIABLE : 0);
+  g_object_set (peer->agent,
+      "controlling-mode", controlling,
+      "upnp", FALSE,
+      "ice-tcp", FALSE,
+      NULL);
+
+  nice_address_init (&addr);
+  g_assert (nice_address_set_from_string (&addr, "127.0.0.1"));
+  nice_agent_add_local_address (peer->agent, &addr);
+
+  g_signal_connect (peer->agent, "candidate-gathering-done",
+      G_CALLBACK (cb_candidate_gathering_done), peer);
+  g_signal_connect (peer->agent, "component-state-changed",
+      G_CALLBACK (cb_component_state_changed), peer);
+
+  peer->n_streams = n_streams;
+  peer->stream_ids = g_new0 (guint, n_streams);
+  for (i = 0; i < n_streams; i++) {
+    peer->stream_ids[i] = nice_agent_add_stream (peer->agent, 1);
+    if (recv_func)
+      nice_agent_attach_recv (peer->agent, peer->stream_ids[i],
+          NICE_COMPONENT_TYPE_RTP, context, recv_func, user_data);
+  }
+}
+
+void
+bench_peer_clear (BenchPeer *peer)
+{
+  g_object_unref (peer->agent);
+  g_free (peer->stream_ids);
+  memset (peer, 0, sizeof (*peer));
+}
+
+void
+bench_peers_gather (BenchPeer *lpeer, BenchPeer *rpeer)
+{
+  guint i;
+
+  for (i = 0; i < lpeer->n_streams; i++)
+    g_assert (nice_agent_gather_candidates (lpeer->agent,
+            lpeer->stream_ids[i]));
+  for (i = 0; i < rpeer->n_streams; i++)
+    g_assert (nice_agent_gather_candidates (rpeer->agent,
+            rpeer->stream_ids[i]));
+
+  wait_for (&lpeer->n_gathered, lpeer->n_streams);
+  wait_for (&rpeer->n_gathered, rpeer->n_streams);
+}
+
+static void
+transfer_candidates (BenchPeer *from, BenchPeer *to, guint idx)
+{
+  GSList *cands;
+  gchar *ufrag = NULL, *password = NULL;
+
+  nice_agent_get_local_credentials (from->agent, from->stream_ids[idx],
+      &ufrag, &password);
+  nice_agent_set_remote_credentials (to->agent, to->stream_ids[idx], ufrag,
+      password);
+  g_free (ufrag);
+  g_free (password);
+
+  cands = nice_agent_get_local_candidates (from->agent, from->stream_ids[idx],
+      NICE_COMPONENT_TYPE_RTP);
+  nice_agent_set_remote_candidates (to->agent, to->stream_ids[idx],
+      NICE_COMPONENT_TYPE_RTP, cands);
+  g_slist_free_full (cands, (GDestroyNotify) nice_candidate_free);
+}
+
+void
+bench_peers_connect (BenchPeer *lpeer, BenchPeer *rpeer)
+{
+  guint i;
+
+  g_assert_cmpuint (lpeer->n_streams, ==, rpeer->n_streams);
+
+  for (i = 0; i < lpeer->n_streams; i++) {
+    transfer_candidates (lpeer, rpeer, i);
+    transfer_candidates (rpeer, lpeer, i);
+  }
+
+  wait_for (&lpeer->n_ready, lpeer->n_streams);
+  wait_for (&rpeer->n_ready, rpeer->n_streams);
+}
@@ -0,0 +1,83 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * Shared helpers of the benchmarks.
+ *
+ * (C) 2026 Collabora Ltd
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ *
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+
+#ifndef _NICE_BENCH_COMMON_H
+#define _NICE_BENCH_COMMON_H
+
+#include "agent.h"
+
+/* A benchmark result, printed on stdout as one JSON object per line:
+ *
+ *   {"benchmark": "udp", "metric": "recv-pps", "value": 123456.0,
+ *    "unit": "packets/s", "params": "size=1200"}
+ *
+ * so that runs of `meson test --benchmark` can be collected and compared
+ * across releases. */
+void bench_report (const gchar *benchmark, const gchar *metric,
+    const gchar *params, gdouble value, const gchar *unit);
+
+/* Sorts @samples in place and returns the value at @percentile (0-100) */
+gdouble bench_percentile (gdouble *samples, guint n_samples,
+    gdouble percentile);
+
+/* The benchmarks drive their agents from a main loop running in a
+ * thread of its own, on this context, so that the measuring code can block.
+ * Started by bench_init(). */
+GMainContext *bench_get_context (void);
+
+void bench_init (void);
+void bench_deinit (void);
+
+typedef struct {
+  NiceAgent *agent;
+  guint n_streams;
+  guint *stream_ids;
+  gint n_gathered;   /* atomic */
+  gint n_ready;      /* atomic */
+} BenchPeer;
+
+/* Creates an agent with @n_streams single-component streams on the
+ * loopback interface. If @recv_func is not %NULL, it is attached to every
+ * component with @user_data; otherwise the components must be read with
+ * nice_agent_recv_messages() (which must then start before
+ * bench_peers_connect() so that connectivity checks are answered). */
+void bench_peer_init (BenchPeer *peer, gboolean controlling,
+    gboolean reliable, guint n_streams, NiceAgentRecvFunc recv_func,
+    gpointer user_data);
+void bench_peer_clear (BenchPeer *peer);
+
+/* Gathers the candidates of both peers and waits for them */
+void bench_peers_gather (BenchPeer *lpeer, BenchPeer *rpeer);
+
+/* Exchanges credentials and candidates, and waits until all the
+ * components of both peers are ready */
+void bench_peers_connect (BenchPeer *lpeer, BenchPeer *rpeer);
+
+#endif /* _NICE_BENCH_COMMON_H */
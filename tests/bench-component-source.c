@@ -0,0 +1,155 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * Benchmark of an idle main loop iteration against the number of pollable
+ * streams attached to it.
+ *
+ * (C) 2026 Collabora Ltd
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ *
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "bench-common.h"
+
+#include <gio/gio.h>
+
+#define N_ITERATIONS 20000
+
+static const guint n_streams[] = { 1, 50, 500 };
+
+typedef struct {
+  BenchPeer *peer;
+  gint stop;  /* atomic */
+} Contender;
+
+static gboolean
+source_cb (GObject *pollable_stream, gpointer user_data)
+{
+  /* Nothing is ever received */
+  return G_SOURCE_CONTINUE;
+}
+
+/* Keeps the agent lock busy the way the application does when it polls the
+ * agent from another thread */
+static gpointer
+contend_thread_cb (gpointer user_data)
+{
+  Contender *contender = user_data;
+  BenchPeer *peer = contender->peer;
+  guint i = 0;
+
+  while (!g_atomic_int_get (&contender->stop)) {
+    nice_agent_get_component_state (peer->agent,
+        peer->stream_ids[i++ % peer->n_streams], NICE_COMPONENT_TYPE_RTP);
+  }
+
+  return NULL;
+}
+
+/* Returns the mean duration of a non-blocking iteration of @context, in ns */
+static gdouble
+measure (GMainContext *context)
+{
+  gint64 start;
+  guint i;
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < N_ITERATIONS; i++)
+    g_main_context_iteration (context, FALSE);
+
+  return (gdouble) (g_get_monotonic_time () - start) * 1000 / N_ITERATIONS;
+}
+
+static void
+run (guint n)
+{
+  BenchPeer lpeer, rpeer;
+  GMainContext *context;
+  GIOStream **iostreams;
+  Contender contender = { 0, };
+  GThread *contend_thread;
+  gchar *params;
+  guint i;
+
+  bench_peer_init (&lpeer, TRUE, TRUE, n, NULL, NULL);
+  bench_peer_init (&rpeer, FALSE, TRUE, n, NULL, NULL);
+  bench_peers_gather (&lpeer, &rpeer);
+
+  context = g_main_context_new ();
+  iostreams = g_new0 (GIOStream *, n);
+  for (i = 0; i < n; i++) {
+    GInputStream *istream;
+    GSource *source;
+
+    iostreams[i] = nice_agent_get_io_stream (lpeer.agent, lpeer.stream_ids[i],
+        NICE_COMPONENT_TYPE_RTP);
+    istream = g_io_stream_get_input_stream (iostreams[i]);
+    source = g_pollable_input_stream_create_source (
+        G_POLLABLE_INPUT_STREAM (istream), NULL);
+    g_source_set_callback (source, (GSourceFunc) G_CALLBACK (source_cb), NULL,
+        NULL);
+    g_source_attach (source, context);
+    g_source_unref (source);
+  }
+
+  /* Let every source pick up the sockets of its component first */
+  g_main_context_iteration (context, FALSE);
+
+  params = g_strdup_printf ("streams=%u", n);
+  bench_report ("component-source", "idle-iteration", params,
+      measure (context), "ns");
+
+  contender.peer = &lpeer;
+  contend_thread = g_thread_new ("bench contend", contend_thread_cb,
+      &contender);
+  bench_report ("component-source", "contended-iteration", params,
+      measure (context), "ns");
+  g_atomic_int_set (&contender.stop, 1);
+  g_thread_join (contend_thread);
+  g_free (params);
+
+  for (i = 0; i < n; i++)
+    g_object_unref (iostreams[i]);
+  g_free (iostreams);
+  g_main_context_unref (context);
+
+  bench_peer_clear (&lpeer);
+  bench_peer_clear (&rpeer);
+}
+
+int main (void)
+{
+  guint i;
+
+  bench_init ();
+
+  for (i = 0; i < G_N_ELEMENTS (n_streams); i++)
+    run (n_streams[i]);
+
+  bench_deinit ();
+
+  return 0;
+}
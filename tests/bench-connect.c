@@ -0,0 +1,76 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * Benchmark of the ICE time to connected.
+ *
+ * (C) 2026 Collabora Ltd
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ *
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "bench-common.h"
+
+static const guint n_streams[] = { 1, 8, 32 };
+
+static void
+cb_nice_recv (NiceAgent *agent, guint stream_id, guint component_id,
+    guint len, gchar *buf, gpointer user_data)
+{
+}
+
+int main (void)
+{
+  guint i;
+
+  bench_init ();
+
+  for (i = 0; i < G_N_ELEMENTS (n_streams); i++) {
+    BenchPeer lpeer, rpeer;
+    gchar *params;
+    gint64 start;
+
+    bench_peer_init (&lpeer, TRUE, FALSE, n_streams[i], cb_nice_recv, NULL);
+    bench_peer_init (&rpeer, FALSE, FALSE, n_streams[i], cb_nice_recv, NULL);
+
+    bench_peers_gather (&lpeer, &rpeer);
+
+    /* From the moment both sides know each other's candidates */
+    start = g_get_monotonic_time ();
+    bench_peers_connect (&lpeer, &rpeer);
+
+    params = g_strdup_printf ("streams=%u", n_streams[i]);
+    bench_report ("ice", "time-to-connected", params,
+        (g_get_monotonic_time () - start) / 1000.0, "ms");
+    g_free (params);
+
+    bench_peer_clear (&lpeer);
+    bench_peer_clear (&rpeer);
+  }
+
+  bench_deinit ();
+
+  return 0;
+}
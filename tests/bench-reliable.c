@@ -0,0 +1,218 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * Benchmark of pseudo-TCP throughput and latency.
+ *
+ * (C) 2026 Collabora Ltd
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ *
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "bench-common.h"
+
+#include <string.h>
+
+#define TOTAL_BYTES (32 * 1024 * 1024)
+#define CHUNK_SIZE 16384
+#define N_PINGS 1000
+#define PING_SIZE 64
+
+typedef enum {
+  MODE_THROUGHPUT,
+  MODE_PING,
+} Mode;
+
+/* Only touched from the loop thread, except where noted */
+static BenchPeer lpeer, rpeer;
+static Mode mode;
+static guint8 buf[CHUNK_SIZE];
+static guint64 n_sent;
+static guint64 n_received;
+static gint64 start_time;
+static gint64 end_time;
+static gint64 ping_time;
+static gsize ping_received;
+static gdouble samples[N_PINGS];
+static guint n_samples;
+
+/* Protects done, set when a measurement is over */
+static GMutex mutex;
+static GCond cond;
+static gboolean done;
+
+static void
+signal_done (void)
+{
+  g_mutex_lock (&mutex);
+  done = TRUE;
+  g_cond_signal (&cond);
+  g_mutex_unlock (&mutex);
+}
+
+static void
+wait_done (void)
+{
+  g_mutex_lock (&mutex);
+  while (!done)
+    g_cond_wait (&cond, &mutex);
+  done = FALSE;
+  g_mutex_unlock (&mutex);
+}
+
+static void
+pump (void)
+{
+  while (mode == MODE_THROUGHPUT && n_sent < TOTAL_BYTES) {
+    gint n;
+
+    n = nice_agent_send (lpeer.agent, lpeer.stream_ids[0],
+        NICE_COMPONENT_TYPE_RTP, MIN (CHUNK_SIZE, TOTAL_BYTES - n_sent),
+        (const gchar *) buf);
+    /* Wait for reliable-transport-writable */
+    if (n <= 0)
+      break;
+    n_sent += n;
+  }
+}
+
+static void
+send_ping (void)
+{
+  ping_time = g_get_monotonic_time ();
+  g_assert_cmpint (nice_agent_send (lpeer.agent, lpeer.stream_ids[0],
+          NICE_COMPONENT_TYPE_RTP, PING_SIZE, (const gchar *) buf), ==,
+      PING_SIZE);
+}
+
+static gboolean
+start_cb (gpointer user_data)
+{
+  start_time = g_get_monotonic_time ();
+
+  if (mode == MODE_THROUGHPUT)
+    pump ();
+  else
+    send_ping ();
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+cb_writable (NiceAgent *agent, guint stream_id, guint component_id,
+    gpointer user_data)
+{
+  pump ();
+}
+
+/* Sender side: pongs */
+static void
+cb_lrecv (NiceAgent *agent, guint stream_id, guint component_id,
+    guint len, gchar *data, gpointer user_data)
+{
+  g_assert (mode == MODE_PING);
+
+  ping_received += len;
+  while (ping_received >= PING_SIZE) {
+    ping_received -= PING_SIZE;
+    samples[n_samples++] = g_get_monotonic_time () - ping_time;
+
+    if (n_samples == N_PINGS) {
+      end_time = g_get_monotonic_time ();
+      signal_done ();
+      return;
+    }
+    send_ping ();
+  }
+}
+
+/* Receiver side: counts bulk data, echoes pings */
+static void
+cb_rrecv (NiceAgent *agent, guint stream_id, guint component_id,
+    guint len, gchar *data, gpointer user_data)
+{
+  if (mode == MODE_PING) {
+    g_assert_cmpint (nice_agent_send (agent, stream_id, component_id, len,
+            data), ==, (gint) len);
+    return;
+  }
+
+  n_received += len;
+  if (n_received == TOTAL_BYTES) {
+    end_time = g_get_monotonic_time ();
+    signal_done ();
+  }
+}
+
+int main (void)
+{
+  gchar *params;
+  gdouble mean = 0;
+  guint i;
+
+  bench_init ();
+
+  bench_peer_init (&lpeer, TRUE, TRUE, 1, cb_lrecv, NULL);
+  bench_peer_init (&rpeer, FALSE, TRUE, 1, cb_rrecv, NULL);
+  g_signal_connect (lpeer.agent, "reliable-transport-writable",
+      G_CALLBACK (cb_writable), NULL);
+
+  bench_peers_gather (&lpeer, &rpeer);
+  bench_peers_connect (&lpeer, &rpeer);
+
+  /* Bulk transfer */
+  mode = MODE_THROUGHPUT;
+  g_main_context_invoke (bench_get_context (), start_cb, NULL);
+  wait_done ();
+
+  params = g_strdup_printf ("bytes=%u chunk=%u", TOTAL_BYTES, CHUNK_SIZE);
+  bench_report ("pseudotcp", "throughput", params,
+      (gdouble) TOTAL_BYTES * 8 / 1e6 * G_TIME_SPAN_SECOND /
+      MAX (end_time - start_time, 1), "Mbit/s");
+  g_free (params);
+
+  /* Ping-pong; the loop thread is idle until start_cb() runs */
+  mode = MODE_PING;
+  g_main_context_invoke (bench_get_context (), start_cb, NULL);
+  wait_done ();
+
+  for (i = 0; i < N_PINGS; i++)
+    mean += samples[i] / N_PINGS;
+
+  params = g_strdup_printf ("size=%u pings=%u", PING_SIZE, N_PINGS);
+  bench_report ("pseudotcp", "rtt-mean", params, mean, "us");
+  bench_report ("pseudotcp", "rtt-p50", params,
+      bench_percentile (samples, N_PINGS, 50), "us");
+  bench_report ("pseudotcp", "rtt-p99", params,
+      bench_percentile (samples, N_PINGS, 99), "us");
+  g_free (params);
+
+  bench_peer_clear (&lpeer);
+  bench_peer_clear (&rpeer);
+
+  bench_deinit ();
+
+  return 0;
+}
@@ -0,0 +1,120 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * Benchmark of STUN message encoding and validation.
+ *
+ * (C) 2026 Collabora Ltd
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ *
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "bench-common.h"
+
+#include "stun/stunagent.h"
+#include "stun/usages/ice.h"
+
+#include <string.h>
+
+#define N_ITERATIONS 200000
+
+#define USERNAME "remotefrag:localfrag"
+#define PASSWORD "0123456789abcdefghijkl"
+
+static void
+init_agent (StunAgent *agent)
+{
+  stun_agent_init (agent, STUN_ALL_KNOWN_ATTRIBUTES,
+      STUN_COMPATIBILITY_RFC5389,
+      STUN_AGENT_USAGE_SHORT_TERM_CREDENTIALS |
+      STUN_AGENT_USAGE_USE_FINGERPRINT);
+}
+
+static size_t
+create_check (StunAgent *agent, StunMessage *msg, uint8_t *buf, size_t len)
+{
+  return stun_usage_ice_conncheck_create (agent, msg, buf, len,
+      (const uint8_t *) USERNAME, strlen (USERNAME),
+      (const uint8_t *) PASSWORD, strlen (PASSWORD),
+      TRUE, TRUE, 0x6e7f1eff, 0x0123456789abcdefULL, NULL,
+      STUN_USAGE_ICE_COMPATIBILITY_RFC5245);
+}
+
+static void
+report (const gchar *metric, gint64 elapsed)
+{
+  bench_report ("stun", metric, "ice-conncheck",
+      (gdouble) N_ITERATIONS * G_TIME_SPAN_SECOND / MAX (elapsed, 1),
+      "ops/s");
+}
+
+int main (void)
+{
+  StunAgent client, server;
+  StunMessage msg, req;
+  StunTransactionId id;
+  StunDefaultValidaterData validater_data[] = {
+    { (uint8_t *) USERNAME, strlen (USERNAME),
+      (uint8_t *) PASSWORD, strlen (PASSWORD) },
+    { NULL, 0, NULL, 0 }
+  };
+  uint8_t buf[STUN_MAX_MESSAGE_SIZE_IPV6];
+  uint8_t check[STUN_MAX_MESSAGE_SIZE_IPV6];
+  size_t check_len = 0;
+  gint64 start;
+  guint i;
+
+  init_agent (&client);
+  init_agent (&server);
+
+  /* Encoding, including MESSAGE-INTEGRITY and FINGERPRINT */
+  start = g_get_monotonic_time ();
+  for (i = 0; i < N_ITERATIONS; i++) {
+    check_len = create_check (&client, &msg, check, sizeof (check));
+    g_assert_cmpuint (check_len, >, 0);
+    stun_message_id (&msg, id);
+    stun_agent_forget_transaction (&client, id);
+  }
+  report ("encode", g_get_monotonic_time () - start);
+
+  /* The cheap check done on every incoming packet */
+  start = g_get_monotonic_time ();
+  for (i = 0; i < N_ITERATIONS; i++)
+    g_assert_cmpint (stun_message_validate_buffer_length (check, check_len,
+            TRUE), ==, (gint) check_len);
+  report ("validate-length", g_get_monotonic_time () - start);
+
+  /* Full validation, including the HMAC */
+  start = g_get_monotonic_time ();
+  for (i = 0; i < N_ITERATIONS; i++) {
+    memcpy (buf, check, check_len);
+    g_assert_cmpint (stun_agent_validate (&server, &req, buf, check_len,
+            stun_agent_default_validater, validater_data), ==,
+        STUN_VALIDATION_SUCCESS);
+  }
+  report ("validate", g_get_monotonic_time () - start);
+
+  return 0;
+}
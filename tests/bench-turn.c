@@ -0,0 +1,249 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * Benchmark of TURN ChannelData relaying through a local relay stand-in.
+ *
+ * (C) 2026 Collabora Ltd
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ *
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "bench-common.h"
+
+#include "agent-priv.h"
+#include "socket.h"
+
+#include <string.h>
+
+#define N_PACKETS 100000
+#define BATCH 32
+#define PACKET_SIZE 1200
+#define TURN_USER "bench"
+#define TURN_PASS "password"
+#define TURN_REALM "libnice"
+#define RECV_TIMEOUT_US (5 * G_TIME_SPAN_SECOND)
+
+/* Messages received on a socket, into their own buffers */
+typedef struct {
+  NiceInputMessage messages[BATCH];
+  GInputVector vectors[BATCH];
+  NiceAddress from[BATCH];
+  guint8 data[BATCH][PACKET_SIZE + 64];
+} RecvBatch;
+
+static void
+recv_batch_init (RecvBatch *batch)
+{
+  guint i;
+
+  for (i = 0; i < BATCH; i++) {
+    batch->vectors[i].buffer = batch->data[i];
+    batch->vectors[i].size = sizeof (batch->data[i]);
+    batch->messages[i].buffers = &batch->vectors[i];
+    batch->messages[i].n_buffers = 1;
+    batch->messages[i].from = &batch->from[i];
+    batch->messages[i].length = 0;
+  }
+}
+
+/* Receives up to @n messages, blocking until at least one is there; TURN
+ * control messages count as received but have a length of 0 */
+static guint
+recv_some (NiceSocket *sock, RecvBatch *batch, guint n)
+{
+  gint ret;
+
+  do {
+    if (!g_socket_condition_timed_wait (sock->fileno, G_IO_IN,
+            RECV_TIMEOUT_US, NULL, NULL))
+      g_error ("Timed out receiving on socket %p", sock);
+
+    ret = nice_socket_recv_messages (sock, batch->messages, n);
+    g_assert_cmpint (ret, >=, 0);
+  } while (ret == 0);
+
+  return ret;
+}
+
+/* Plays the part of the TURN server for the ChannelBind request of
+ * nice_udp_turn_socket_set_peer() */
+static void
+relay_accept_channel_bind (NiceSocket *relay, RecvBatch *batch)
+{
+  StunAgent agent;
+  StunMessage request, response;
+  uint8_t buf[STUN_MAX_MESSAGE_SIZE_IPV6];
+  NiceOutputMessage message;
+  GOutputVector vector;
+  size_t len;
+
+  stun_agent_init (&agent, STUN_ALL_KNOWN_ATTRIBUTES,
+      STUN_COMPATIBILITY_RFC5389,
+      STUN_AGENT_USAGE_LONG_TERM_CREDENTIALS |
+      STUN_AGENT_USAGE_IGNORE_CREDENTIALS);
+
+  g_assert_cmpuint (recv_some (relay, batch, 1), ==, 1);
+  g_assert_cmpint (stun_agent_validate (&agent, &request, batch->data[0],
+          batch->messages[0].length, NULL, NULL), ==,
+      STUN_VALIDATION_SUCCESS);
+  g_assert_cmpint (stun_message_get_method (&request), ==, STUN_CHANNELBIND);
+
+  /* The client checks the integrity of the response with its long-term
+   * credentials, which are derived from these attributes */
+  g_assert (stun_agent_init_response (&agent, &response, buf, sizeof (buf),
+          &request));
+  stun_message_append_bytes (&response, STUN_ATTRIBUTE_USERNAME, TURN_USER,
+      strlen (TURN_USER));
+  stun_message_append_bytes (&response, STUN_ATTRIBUTE_REALM, TURN_REALM,
+      strlen (TURN_REALM));
+  len = stun_agent_finish_message (&agent, &response,
+      (const uint8_t *) TURN_PASS, strlen (TURN_PASS));
+  g_assert_cmpuint (len, >, 0);
+
+  vector.buffer = buf;
+  vector.size = len;
+  message.buffers = &vector;
+  message.n_buffers = 1;
+  g_assert_cmpint (nice_socket_send_messages (relay, &batch->from[0],
+          &message, 1), ==, 1);
+}
+
+int main (void)
+{
+  GMainContext *ctx;
+  NiceSocket *base, *relay, *turn;
+  NiceAddress addr, peer;
+  RecvBatch *relay_batch, *client_batch;
+  NiceOutputMessage out[BATCH];
+  GOutputVector out_vector, echo_vectors[BATCH];
+  NiceOutputMessage echo[BATCH];
+  guint8 payload[PACKET_SIZE];
+  gchar *params;
+  guint n_done = 0;
+  gint64 start, elapsed;
+  guint i;
+
+  bench_init ();
+
+  ctx = g_main_context_new ();
+  relay_batch = g_new (RecvBatch, 1);
+  client_batch = g_new (RecvBatch, 1);
+  recv_batch_init (relay_batch);
+  recv_batch_init (client_batch);
+
+  nice_address_init (&addr);
+  g_assert (nice_address_set_from_string (&addr, "127.0.0.1"));
+  peer = addr;
+  nice_address_set_port (&peer, 9);
+
+  base = nice_udp_bsd_socket_new (&addr);
+  relay = nice_udp_bsd_socket_new (&addr);
+  g_assert (base != NULL && relay != NULL);
+
+  turn = nice_udp_turn_socket_new (ctx, &base->addr, base, &relay->addr,
+      TURN_USER, TURN_PASS, NICE_TURN_SOCKET_COMPATIBILITY_RFC5766);
+  g_assert (turn != NULL);
+
+  /* Bind a channel to the peer, after which data goes as ChannelData */
+  g_assert (nice_udp_turn_socket_set_peer (turn, &peer));
+  relay_accept_channel_bind (relay, relay_batch);
+  g_assert_cmpuint (recv_some (turn, client_batch, 1), ==, 1);
+  g_assert_cmpuint (client_batch->messages[0].length, ==, 0);
+
+  memset (payload, 0x55, sizeof (payload));
+  out_vector.buffer = payload;
+  out_vector.size = sizeof (payload);
+  for (i = 0; i < BATCH; i++) {
+    out[i].buffers = &out_vector;
+    out[i].n_buffers = 1;
+    echo[i].buffers = &echo_vectors[i];
+    echo[i].n_buffers = 1;
+  }
+
+  /* The client sends a batch, the relay echoes it back as is, and the
+   * client decodes it */
+  start = g_get_monotonic_time ();
+  while (n_done < N_PACKETS) {
+    guint n_sent = 0, n_relayed = 0, n_received = 0;
+
+    while (n_sent < BATCH) {
+      gint ret = nice_socket_send_messages (turn, &peer, out + n_sent,
+          BATCH - n_sent);
+
+      g_assert_cmpint (ret, >=, 0);
+      n_sent += ret;
+    }
+
+    while (n_relayed < BATCH) {
+      guint n = recv_some (relay, relay_batch, BATCH - n_relayed);
+
+      for (i = 0; i < n; i++) {
+        /* ChannelData: channel number, length, then the payload */
+        g_assert_cmpuint (relay_batch->data[i][0] & 0xc0, ==, 0x40);
+        g_assert_cmpuint (relay_batch->messages[i].length, ==,
+            PACKET_SIZE + 4);
+        echo_vectors[i].buffer = relay_batch->data[i];
+        echo_vectors[i].size = relay_batch->messages[i].length;
+      }
+      g_assert_cmpint (nice_socket_send_messages (relay, &base->addr, echo,
+              n), ==, (gint) n);
+      n_relayed += n;
+    }
+
+    while (n_received < BATCH) {
+      guint n = recv_some (turn, client_batch, BATCH - n_received);
+
+      for (i = 0; i < n; i++) {
+        g_assert_cmpuint (client_batch->messages[i].length, ==, PACKET_SIZE);
+        g_assert (nice_address_equal (&client_batch->from[i], &peer));
+      }
+      n_received += n;
+    }
+
+    n_done += BATCH;
+  }
+  elapsed = g_get_monotonic_time () - start;
+
+  params = g_strdup_printf ("size=%u batch=%u compat=rfc5766", PACKET_SIZE,
+      BATCH);
+  bench_report ("turn", "channeldata-rate", params,
+      (gdouble) n_done * G_TIME_SPAN_SECOND / MAX (elapsed, 1), "packets/s");
+  bench_report ("turn", "channeldata-throughput", params,
+      (gdouble) n_done * PACKET_SIZE * 8 / 1e6 * G_TIME_SPAN_SECOND /
+      MAX (elapsed, 1), "Mbit/s");
+  g_free (params);
+
+  nice_socket_free (turn);
+  nice_socket_free (base);
+  nice_socket_free (relay);
+  g_free (relay_batch);
+  g_free (client_batch);
+  g_main_context_unref (ctx);
+
+  bench_deinit ();
+
+  return 0;
+}
@@ -0,0 +1,209 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * Benchmark of UDP packet rate through the agent API.
+ *
+ * (C) 2026 Collabora Ltd
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ *
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "bench-common.h"
+
+#include <string.h>
+
+#define N_PACKETS 100000
+#define BATCH 32
+#define MAX_PACKET_SIZE 1200
+/* The receiver is done when nothing arrived for this long */
+#define IDLE_TIMEOUT_US (500 * G_TIME_SPAN_MILLISECOND)
+
+static const guint packet_sizes[] = { 100, MAX_PACKET_SIZE };
+
+typedef struct {
+  BenchPeer *peer;
+  GCancellable *cancellable;
+  GMutex mutex;
+  guint n_received;
+  gint64 first_recv;
+  gint64 last_recv;
+} Receiver;
+
+static void
+cb_nice_recv (NiceAgent *agent, guint stream_id, guint component_id,
+    guint len, gchar *buf, gpointer user_data)
+{
+  /* The sender doesn't get any media */
+}
+
+static gpointer
+recv_thread_cb (gpointer user_data)
+{
+  Receiver *receiver = user_data;
+  NiceInputMessage messages[BATCH];
+  GInputVector vectors[BATCH];
+  guint8 *data;
+  guint i;
+
+  data = g_malloc (BATCH * MAX_PACKET_SIZE);
+  for (i = 0; i < BATCH; i++) {
+    vectors[i].buffer = data + i * MAX_PACKET_SIZE;
+    vectors[i].size = MAX_PACKET_SIZE;
+    messages[i].buffers = &vectors[i];
+    messages[i].n_buffers = 1;
+    messages[i].from = NULL;
+    messages[i].length = 0;
+  }
+
+  for (;;) {
+    GError *error = NULL;
+    gint n;
+
+    n = nice_agent_recv_messages (receiver->peer->agent,
+        receiver->peer->stream_ids[0], NICE_COMPONENT_TYPE_RTP, messages,
+        BATCH, receiver->cancellable, &error);
+    if (n < 0) {
+      g_assert (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED));
+      g_clear_error (&error);
+      break;
+    }
+
+    g_mutex_lock (&receiver->mutex);
+    receiver->last_recv = g_get_monotonic_time ();
+    if (receiver->first_recv == 0)
+      receiver->first_recv = receiver->last_recv;
+    receiver->n_received += n;
+    g_mutex_unlock (&receiver->mutex);
+  }
+
+  g_free (data);
+
+  return NULL;
+}
+
+static void
+run (guint packet_size)
+{
+  BenchPeer lpeer, rpeer;
+  Receiver receiver = { 0, };
+  NiceOutputMessage messages[BATCH];
+  GOutputVector vector;
+  GThread *recv_thread;
+  gchar *params;
+  guint8 *data;
+  guint n_sent = 0, n_received;
+  gint64 start, send_time, last_recv;
+  gboolean done;
+  guint i;
+
+  bench_peer_init (&lpeer, TRUE, FALSE, 1, cb_nice_recv, NULL);
+  bench_peer_init (&rpeer, FALSE, FALSE, 1, NULL, NULL);
+
+  receiver.peer = &rpeer;
+  g_mutex_init (&receiver.mutex);
+  receiver.cancellable = g_cancellable_new ();
+  recv_thread = g_thread_new ("bench recv", recv_thread_cb, &receiver);
+
+  bench_peers_gather (&lpeer, &rpeer);
+  bench_peers_connect (&lpeer, &rpeer);
+
+  data = g_malloc0 (packet_size);
+  vector.buffer = data;
+  vector.size = packet_size;
+  for (i = 0; i < BATCH; i++) {
+    messages[i].buffers = &vector;
+    messages[i].n_buffers = 1;
+  }
+
+  start = g_get_monotonic_time ();
+  while (n_sent < N_PACKETS) {
+    GError *error = NULL;
+    gint n;
+
+    n = nice_agent_send_messages_nonblocking (lpeer.agent,
+        lpeer.stream_ids[0], NICE_COMPONENT_TYPE_RTP, messages,
+        MIN (BATCH, N_PACKETS - n_sent), NULL, &error);
+    if (n < 0) {
+      g_assert (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK));
+      g_clear_error (&error);
+      n = 0;
+    }
+    if (n == 0)
+      g_thread_yield ();
+    n_sent += n;
+  }
+  send_time = g_get_monotonic_time () - start;
+
+  /* Let the receiver drain the socket */
+  do {
+    g_usleep (10 * G_TIME_SPAN_MILLISECOND);
+    g_mutex_lock (&receiver.mutex);
+    last_recv = MAX (receiver.last_recv, start + send_time);
+    done = receiver.n_received == N_PACKETS ||
+        g_get_monotonic_time () - last_recv >= IDLE_TIMEOUT_US;
+    g_mutex_unlock (&receiver.mutex);
+  } while (!done);
+
+  g_cancellable_cancel (receiver.cancellable);
+  g_thread_join (recv_thread);
+  g_object_unref (receiver.cancellable);
+  g_mutex_clear (&receiver.mutex);
+
+  n_received = receiver.n_received;
+  g_assert_cmpuint (n_received, >, 0);
+
+  params = g_strdup_printf ("size=%u batch=%u", packet_size, BATCH);
+  bench_report ("udp", "send-rate", params,
+      (gdouble) n_sent * G_TIME_SPAN_SECOND / MAX (send_time, 1),
+      "packets/s");
+  bench_report ("udp", "recv-rate", params,
+      (gdouble) n_received * G_TIME_SPAN_SECOND /
+      MAX (receiver.last_recv - receiver.first_recv, 1), "packets/s");
+  bench_report ("udp", "recv-throughput", params,
+      (gdouble) n_received * packet_size * 8 / 1e6 * G_TIME_SPAN_SECOND /
+      MAX (receiver.last_recv - receiver.first_recv, 1), "Mbit/s");
+  bench_report ("udp", "loss", params,
+      100.0 * (n_sent - n_received) / n_sent, "%");
+  g_free (params);
+
+  g_free (data);
+  bench_peer_clear (&lpeer);
+  bench_peer_clear (&rpeer);
+}
+
+int main (void)
+{
+  guint i;
+
+  bench_init ();
+
+  for (i = 0; i < G_N_ELEMENTS (packet_sizes); i++)
+    run (packet_sizes[i]);
+
+  bench_deinit ();
+
+  return 0;
+}
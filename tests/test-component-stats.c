@@ -0,0 +1,279 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * Unit test for the per-component and per-pair traffic counters.
+ *
+ * (C) 2026 Collabora Ltd
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ *
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "agent.h"
+
+#include <string.h>
+
+#define N_PACKETS 10
+#define PACKET_SIZE 100
+
+static GMainLoop *loop;
+static guint n_gathering_done;
+static guint n_ready;
+static guint n_received;
+static guint n_stats_signals;
+
+static gboolean
+timer_cb (gpointer user_data)
+{
+  g_error ("ERROR: test has got stuck, aborting...");
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+cb_nice_recv (NiceAgent *agent, guint stream_id, guint component_id,
+    guint len, gchar *buf, gpointer user_data)
+{
+  g_assert_cmpuint (len, ==, PACKET_SIZE);
+
+  if (++n_received == N_PACKETS)
+    g_main_loop_quit (loop);
+}
+
+static void
+cb_candidate_gathering_done (NiceAgent *agent, guint stream_id,
+    gpointer user_data)
+{
+  if (++n_gathering_done == 2)
+    g_main_loop_quit (loop);
+}
+
+static void
+cb_component_state_changed (NiceAgent *agent, guint stream_id,
+    guint component_id, guint state, gpointer user_data)
+{
+  if (state == NICE_COMPONENT_STATE_READY && ++n_ready == 2)
+    g_main_loop_quit (loop);
+}
+
+static void
+cb_component_stats (NiceAgent *agent, guint stream_id, guint component_id,
+    gpointer user_data)
+{
+  NiceComponentStats stats;
+
+  g_assert_cmpuint (stream_id, ==, GPOINTER_TO_UINT (user_data));
+  g_assert_cmpuint (component_id, ==, NICE_COMPONENT_TYPE_RTP);
+  g_assert (nice_agent_get_component_stats (agent, stream_id, component_id,
+          &stats));
+  g_assert_cmpuint (stats.media_packets_sent, ==, N_PACKETS);
+
+  n_stats_signals++;
+  g_main_loop_quit (loop);
+}
+
+static void
+transfer_candidates (NiceAgent *from, guint from_stream, NiceAgent *to,
+    guint to_stream)
+{
+  GSList *cands;
+  gchar *ufrag = NULL, *password = NULL;
+
+  nice_agent_get_local_credentials (from, from_stream, &ufrag, &password);
+  nice_agent_set_remote_credentials (to, to_stream, ufrag, password);
+  g_free (ufrag);
+  g_free (password);
+
+  cands = nice_agent_get_local_candidates (from, from_stream,
+      NICE_COMPONENT_TYPE_RTP);
+  nice_agent_set_remote_candidates (to, to_stream, NICE_COMPONENT_TYPE_RTP,
+      cands);
+  g_slist_free_full (cands, (GDestroyNotify) nice_candidate_free);
+}
+
+static NiceAgent *
+create_agent (NiceAddress *addr, gboolean controlling)
+{
+  NiceAgent *agent;
+
+  agent = g_object_new (NICE_TYPE_AGENT,
+      "compatibility", NICE_COMPATIBILITY_RFC5245,
+      "controlling-mode", controlling,
+      "upnp", FALSE,
+      "ice-tcp", FALSE,
+      NULL);
+  nice_agent_add_local_address (agent, addr);
+
+  g_signal_connect (agent, "candidate-gathering-done",
+      G_CALLBACK (cb_candidate_gathering_done), NULL);
+  g_signal_connect (agent, "component-state-changed",
+      G_CALLBACK (cb_component_state_changed), NULL);
+
+  return agent;
+}
+
+int main (void)
+{
+  NiceAgent *lagent, *ragent;
+  NiceAddress addr;
+  NiceComponentStats lstats, rstats;
+  gchar buf[PACKET_SIZE];
+  guint ls_id, rs_id;
+  guint timer_id;
+  GSList *pairs, *item;
+  guint n_selected = 0;
+  guint interval;
+  guint i;
+
+#ifdef G_OS_WIN32
+  WSADATA w;
+
+  WSAStartup(0x0202, &w);
+#endif
+
+  loop = g_main_loop_new (NULL, FALSE);
+  timer_id = g_timeout_add_seconds (30, timer_cb, NULL);
+
+  nice_address_init (&addr);
+  g_assert (nice_address_set_from_string (&addr, "127.0.0.1"));
+
+  lagent = create_agent (&addr, TRUE);
+  ragent = create_agent (&addr, FALSE);
+
+  ls_id = nice_agent_add_stream (lagent, 1);
+  rs_id = nice_agent_add_stream (ragent, 1);
+
+  /* Nothing has been sent yet */
+  g_assert (nice_agent_get_component_stats (lagent, ls_id,
+          NICE_COMPONENT_TYPE_RTP, &lstats));
+  g_assert_cmpuint (lstats.media_packets_sent, ==, 0);
+  g_assert_cmpuint (lstats.stun_packets_sent, ==, 0);
+  g_assert (!nice_agent_get_component_stats (lagent, ls_id, 2, &lstats));
+  g_assert (!nice_agent_get_component_stats (lagent, 1000,
+          NICE_COMPONENT_TYPE_RTP, &lstats));
+
+  nice_agent_attach_recv (lagent, ls_id, NICE_COMPONENT_TYPE_RTP, NULL,
+      cb_nice_recv, NULL);
+  nice_agent_attach_recv (ragent, rs_id, NICE_COMPONENT_TYPE_RTP, NULL,
+      cb_nice_recv, NULL);
+
+  g_assert (nice_agent_gather_candidates (lagent, ls_id));
+  g_assert (nice_agent_gather_candidates (ragent, rs_id));
+  g_main_loop_run (loop);
+
+  transfer_candidates (lagent, ls_id, ragent, rs_id);
+  transfer_candidates (ragent, rs_id, lagent, ls_id);
+  g_main_loop_run (loop);
+
+  /* Connectivity checks went both ways */
+  g_assert (nice_agent_get_component_stats (lagent, ls_id,
+          NICE_COMPONENT_TYPE_RTP, &lstats));
+  g_assert (nice_agent_get_component_stats (ragent, rs_id,
+          NICE_COMPONENT_TYPE_RTP, &rstats));
+  g_assert_cmpuint (lstats.stun_packets_sent, >, 0);
+  g_assert_cmpuint (lstats.stun_packets_received, >, 0);
+  g_assert_cmpuint (lstats.stun_bytes_sent, >=, 20 * lstats.stun_packets_sent);
+  g_assert_cmpuint (rstats.stun_packets_sent, >, 0);
+  g_assert_cmpuint (rstats.stun_packets_received, >, 0);
+
+  memset (buf, 0x55, sizeof (buf));
+  for (i = 0; i < N_PACKETS; i++)
+    g_assert_cmpint (nice_agent_send (lagent, ls_id, NICE_COMPONENT_TYPE_RTP,
+            sizeof (buf), buf), ==, sizeof (buf));
+  g_main_loop_run (loop);
+
+  g_assert (nice_agent_get_component_stats (lagent, ls_id,
+          NICE_COMPONENT_TYPE_RTP, &lstats));
+  g_assert (nice_agent_get_component_stats (ragent, rs_id,
+          NICE_COMPONENT_TYPE_RTP, &rstats));
+
+  g_assert_cmpuint (lstats.media_packets_sent, ==, N_PACKETS);
+  g_assert_cmpuint (lstats.media_bytes_sent, ==, N_PACKETS * PACKET_SIZE);
+  g_assert_cmpuint (lstats.media_packets_received, ==, 0);
+  g_assert_cmpuint (rstats.media_packets_received, ==, N_PACKETS);
+  g_assert_cmpuint (rstats.media_bytes_received, ==, N_PACKETS * PACKET_SIZE);
+  g_assert_cmpuint (rstats.media_packets_sent, ==, 0);
+
+  /* Host candidates only, no TURN and nothing reliable */
+  g_assert_cmpuint (lstats.relayed_packets_sent, ==, 0);
+  g_assert_cmpuint (rstats.relayed_packets_received, ==, 0);
+  g_assert_cmpuint (lstats.tcp_cwnd, ==, 0);
+  g_assert_cmpuint (lstats.tcp_retransmits, ==, 0);
+
+  /* The selected pair got all the traffic */
+  pairs = nice_agent_get_candidate_pair_stats (lagent, ls_id,
+      NICE_COMPONENT_TYPE_RTP);
+  g_assert (pairs != NULL);
+  for (item = pairs; item; item = item->next) {
+    NiceCandidatePairStats *stats = item->data;
+
+    g_assert (stats->local != NULL);
+    g_assert (stats->remote != NULL);
+    g_assert_cmpuint (stats->total_rtt, >=, stats->current_rtt);
+
+    if (!stats->selected) {
+      g_assert_cmpuint (stats->bytes_sent, ==, 0);
+      continue;
+    }
+
+    n_selected++;
+    g_assert (stats->nominated);
+    g_assert_cmpuint (stats->requests_sent, >, 0);
+    g_assert_cmpuint (stats->responses_received, >, 0);
+    g_assert_cmpuint (stats->responses_received, <=,
+        stats->requests_sent + stats->retransmissions);
+    g_assert_cmpint (stats->consent_expiry, >, g_get_monotonic_time ());
+    g_assert_cmpuint (stats->bytes_sent, ==, N_PACKETS * PACKET_SIZE);
+    g_assert_cmpuint (stats->bytes_received, ==, 0);
+  }
+  g_assert_cmpuint (n_selected, ==, 1);
+  g_slist_free_full (pairs, (GDestroyNotify) nice_candidate_pair_stats_free);
+
+  g_assert (nice_agent_get_candidate_pair_stats (lagent, 1000,
+          NICE_COMPONENT_TYPE_RTP) == NULL);
+
+  /* Periodic notification */
+  g_signal_connect (lagent, "component-stats",
+      G_CALLBACK (cb_component_stats), GUINT_TO_POINTER (ls_id));
+  g_object_set (lagent, "stats-interval", 20, NULL);
+  g_object_get (lagent, "stats-interval", &interval, NULL);
+  g_assert_cmpuint (interval, ==, 20);
+  g_main_loop_run (loop);
+  g_assert_cmpuint (n_stats_signals, >=, 1);
+
+  g_object_set (lagent, "stats-interval", 0, NULL);
+
+  g_object_unref (lagent);
+  g_object_unref (ragent);
+
+  g_source_remove (timer_id);
+  g_main_loop_unref (loop);
+
+#ifdef G_OS_WIN32
+  WSACleanup();
+#endif
+
+  return 0;
+}
@@ -0,0 +1,241 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * Unit test for the binary event log of the agent.
+ *
+ * (C) 2026 Collabora Ltd
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ *
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "agent.h"
+#include "eventlog-format.h"
+
+#include <string.h>
+
+static GMainLoop *loop;
+static guint n_gathering_done;
+static guint n_ready;
+
+static gboolean
+timer_cb (gpointer user_data)
+{
+  g_error ("ERROR: test has got stuck, aborting...");
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+cb_nice_recv (NiceAgent *agent, guint stream_id, guint component_id,
+    guint len, gchar *buf, gpointer user_data)
+{
+}
+
+static void
+cb_candidate_gathering_done (NiceAgent *agent, guint stream_id,
+    gpointer user_data)
+{
+  if (++n_gathering_done == 2)
+    g_main_loop_quit (loop);
+}
+
+static void
+cb_component_state_changed (NiceAgent *agent, guint stream_id,
+    guint component_id, guint state, gpointer user_data)
+{
+  if (state == NICE_COMPONENT_STATE_READY && ++n_ready == 2)
+    g_main_loop_quit (loop);
+}
+
+static void
+transfer_candidates (NiceAgent *from, guint from_stream, NiceAgent *to,
+    guint to_stream)
+{
+  GSList *cands;
+  gchar *ufrag = NULL, *password = NULL;
+
+  nice_agent_get_local_credentials (from, from_stream, &ufrag, &password);
+  nice_agent_set_remote_credentials (to, to_stream, ufrag, password);
+  g_free (ufrag);
+  g_free (password);
+
+  cands = nice_agent_get_local_candidates (from, from_stream,
+      NICE_COMPONENT_TYPE_RTP);
+  nice_agent_set_remote_candidates (to, to_stream, NICE_COMPONENT_TYPE_RTP,
+      cands);
+  g_slist_free_full (cands, (GDestroyNotify) nice_candidate_free);
+}
+
+static NiceAgent *
+create_agent (NiceAddress *addr, gboolean controlling, guint event_log_size)
+{
+  NiceAgent *agent;
+
+  agent = g_object_new (NICE_TYPE_AGENT,
+      "compatibility", NICE_COMPATIBILITY_RFC5245,
+      "controlling-mode", controlling,
+      "upnp", FALSE,
+      "ice-tcp", FALSE,
+      "event-log-size", event_log_size,
+      NULL);
+  nice_agent_add_local_address (agent, addr);
+
+  g_signal_connect (agent, "candidate-gathering-done",
+      G_CALLBACK (cb_candidate_gathering_done), NULL);
+  g_signal_connect (agent, "component-state-changed",
+      G_CALLBACK (cb_component_state_changed), NULL);
+
+  return agent;
+}
+
+static const NiceEventLogHeader *
+check_header (GBytes *bytes)
+{
+  const NiceEventLogHeader *header;
+  gsize size;
+
+  header = g_bytes_get_data (bytes, &size);
+  g_assert_cmpuint (size, >=, sizeof (NiceEventLogHeader));
+  g_assert (memcmp (header->magic, NICE_EVENT_LOG_MAGIC,
+          sizeof (header->magic)) == 0);
+  g_assert_cmpuint (header->version, ==, NICE_EVENT_LOG_VERSION);
+  g_assert_cmpuint (header->byte_order, ==, NICE_EVENT_LOG_BYTE_ORDER);
+  g_assert_cmpuint (header->record_size, ==, sizeof (NiceEventRecord));
+  g_assert_cmpuint (size, ==, sizeof (NiceEventLogHeader) +
+      header->n_records * sizeof (NiceEventRecord));
+  g_assert_cmpint (header->monotonic_time, <=, g_get_monotonic_time ());
+
+  return header;
+}
+
+int main (void)
+{
+  NiceAgent *lagent, *ragent;
+  NiceAddress addr;
+  GBytes *bytes;
+  const NiceEventLogHeader *header;
+  const NiceEventRecord *records;
+  guint n_events[NICE_EVENT_LAST] = { 0, };
+  guint ls_id, rs_id;
+  guint timer_id;
+  guint size;
+  gint64 last_time = 0;
+  guint i;
+
+#ifdef G_OS_WIN32
+  WSADATA w;
+
+  WSAStartup(0x0202, &w);
+#endif
+
+  loop = g_main_loop_new (NULL, FALSE);
+  timer_id = g_timeout_add_seconds (30, timer_cb, NULL);
+
+  nice_address_init (&addr);
+  g_assert (nice_address_set_from_string (&addr, "127.0.0.1"));
+
+  /* The right agent only keeps the last two events */
+  lagent = create_agent (&addr, TRUE, 1000);
+  ragent = create_agent (&addr, FALSE, 2);
+
+  g_object_get (lagent, "event-log-size", &size, NULL);
+  g_assert_cmpuint (size, ==, 1000);
+
+  ls_id = nice_agent_add_stream (lagent, 1);
+  rs_id = nice_agent_add_stream (ragent, 1);
+
+  nice_agent_attach_recv (lagent, ls_id, NICE_COMPONENT_TYPE_RTP, NULL,
+      cb_nice_recv, NULL);
+  nice_agent_attach_recv (ragent, rs_id, NICE_COMPONENT_TYPE_RTP, NULL,
+      cb_nice_recv, NULL);
+
+  g_assert (nice_agent_gather_candidates (lagent, ls_id));
+  g_assert (nice_agent_gather_candidates (ragent, rs_id));
+  g_main_loop_run (loop);
+
+  transfer_candidates (lagent, ls_id, ragent, rs_id);
+  transfer_candidates (ragent, rs_id, lagent, ls_id);
+  g_main_loop_run (loop);
+
+  bytes = nice_agent_dump_event_log (lagent);
+  header = check_header (bytes);
+  g_assert_cmpuint (header->n_records, >, 0);
+  g_assert_cmpuint (header->n_dropped, ==, 0);
+
+  records = (const NiceEventRecord *) (header + 1);
+  for (i = 0; i < header->n_records; i++) {
+    const NiceEventRecord *ev = &records[i];
+
+    g_assert_cmpuint (ev->type, >, NICE_EVENT_NONE);
+    g_assert_cmpuint (ev->type, <, NICE_EVENT_LAST);
+    g_assert_cmpuint (ev->stream_id, ==, ls_id);
+    g_assert_cmpuint (ev->component_id, ==, NICE_COMPONENT_TYPE_RTP);
+    /* Oldest first */
+    g_assert_cmpint (ev->time, >=, last_time);
+    last_time = ev->time;
+
+    n_events[ev->type]++;
+  }
+  g_bytes_unref (bytes);
+
+  g_assert_cmpuint (n_events[NICE_EVENT_CANDIDATE_GATHERED], >, 0);
+  g_assert_cmpuint (n_events[NICE_EVENT_REMOTE_CANDIDATE], >, 0);
+  g_assert_cmpuint (n_events[NICE_EVENT_COMPONENT_STATE], >, 0);
+  g_assert_cmpuint (n_events[NICE_EVENT_PAIR_STATE], >, 0);
+  g_assert_cmpuint (n_events[NICE_EVENT_CHECK_SENT], >, 0);
+  g_assert_cmpuint (n_events[NICE_EVENT_STUN_RECEIVED], >, 0);
+  g_assert_cmpuint (n_events[NICE_EVENT_SELECTED_PAIR], >=, 1);
+  g_assert_cmpuint (n_events[NICE_EVENT_TURN_ALLOCATE], ==, 0);
+
+  /* The small ring wrapped around */
+  bytes = nice_agent_dump_event_log (ragent);
+  header = check_header (bytes);
+  g_assert_cmpuint (header->n_records, ==, 2);
+  g_assert_cmpuint (header->n_dropped, >, 0);
+  g_bytes_unref (bytes);
+
+  /* Changing the size clears the log, and 0 disables it */
+  g_object_set (lagent, "event-log-size", 10, NULL);
+  bytes = nice_agent_dump_event_log (lagent);
+  header = check_header (bytes);
+  g_assert_cmpuint (header->n_records, ==, 0);
+  g_bytes_unref (bytes);
+
+  g_object_set (lagent, "event-log-size", 0, NULL);
+  g_assert (nice_agent_dump_event_log (lagent) == NULL);
+
+  g_object_unref (lagent);
+  g_object_unref (ragent);
+
+  g_source_remove (timer_id);
+  g_main_loop_unref (loop);
+
+#ifdef G_OS_WIN32
+  WSACleanup();
+#endif
+
+  return 0;
+}
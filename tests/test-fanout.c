@@ -0,0 +1,224 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * Unit test for sending one message to many components at once.
+ *
+ * (C) 2026 Collabora Ltd
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ *
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "agent.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define N_STREAMS 4
+#define PAYLOAD_SIZE 100
+
+static GMainLoop *loop;
+static guint n_gathering_done;
+static guint n_ready;
+static guint n_received;
+static gboolean received[N_STREAMS + 1];
+
+static gboolean
+timer_cb (gpointer user_data)
+{
+  g_error ("ERROR: test has got stuck, aborting...");
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Every stream receives its own one-byte header followed by the payload */
+static void
+cb_nice_recv (NiceAgent *agent, guint stream_id, guint component_id,
+    guint len, gchar *buf, gpointer user_data)
+{
+  guint i;
+
+  g_assert_cmpuint (len, ==, 1 + PAYLOAD_SIZE);
+  g_assert_cmpuint ((guint8) buf[0], ==, GPOINTER_TO_UINT (user_data));
+  for (i = 1; i < len; i++)
+    g_assert_cmpuint ((guint8) buf[i], ==, 0xaa);
+
+  g_assert (!received[GPOINTER_TO_UINT (user_data)]);
+  received[GPOINTER_TO_UINT (user_data)] = TRUE;
+
+  if (++n_received == N_STREAMS)
+    g_main_loop_quit (loop);
+}
+
+static void
+cb_sender_recv (NiceAgent *agent, guint stream_id, guint component_id,
+    guint len, gchar *buf, gpointer user_data)
+{
+}
+
+static void
+cb_candidate_gathering_done (NiceAgent *agent, guint stream_id,
+    gpointer user_data)
+{
+  if (++n_gathering_done == 2 * N_STREAMS)
+    g_main_loop_quit (loop);
+}
+
+static void
+cb_component_state_changed (NiceAgent *agent, guint stream_id,
+    guint component_id, guint state, gpointer user_data)
+{
+  if (state == NICE_COMPONENT_STATE_READY && ++n_ready == 2 * N_STREAMS)
+    g_main_loop_quit (loop);
+}
+
+static void
+transfer_candidates (NiceAgent *from, guint from_stream, NiceAgent *to,
+    guint to_stream)
+{
+  GSList *cands;
+  gchar *ufrag = NULL, *password = NULL;
+
+  nice_agent_get_local_credentials (from, from_stream, &ufrag, &password);
+  nice_agent_set_remote_credentials (to, to_stream, ufrag, password);
+  g_free (ufrag);
+  g_free (password);
+
+  cands = nice_agent_get_local_candidates (from, from_stream,
+      NICE_COMPONENT_TYPE_RTP);
+  nice_agent_set_remote_candidates (to, to_stream, NICE_COMPONENT_TYPE_RTP,
+      cands);
+  g_slist_free_full (cands, (GDestroyNotify) nice_candidate_free);
+}
+
+static NiceAgent *
+create_agent (NiceAddress *addr, gboolean controlling)
+{
+  NiceAgent *agent;
+
+  agent = g_object_new (NICE_TYPE_AGENT,
+      "compatibility", NICE_COMPATIBILITY_RFC5245,
+      "controlling-mode", controlling,
+      "upnp", FALSE,
+      "ice-tcp", FALSE,
+      NULL);
+  nice_agent_add_local_address (agent, addr);
+
+  g_signal_connect (agent, "candidate-gathering-done",
+      G_CALLBACK (cb_candidate_gathering_done), NULL);
+  g_signal_connect (agent, "component-state-changed",
+      G_CALLBACK (cb_component_state_changed), NULL);
+
+  return agent;
+}
+
+int main (void)
+{
+  NiceAgent *lagent, *ragent;
+  NiceAddress addr;
+  guint ls_ids[N_STREAMS], rs_ids[N_STREAMS];
+  NiceFanoutDestination destinations[N_STREAMS + 1];
+  guint8 headers[N_STREAMS];
+  guint8 payload_buf[PAYLOAD_SIZE];
+  GOutputVector payload_vector = { payload_buf, sizeof (payload_buf) };
+  NiceOutputMessage payload = { &payload_vector, 1 };
+  guint timer_id;
+  guint i;
+
+#ifdef G_OS_WIN32
+  WSADATA w;
+
+  WSAStartup(0x0202, &w);
+#endif
+
+  loop = g_main_loop_new (NULL, FALSE);
+  timer_id = g_timeout_add_seconds (30, timer_cb, NULL);
+
+  nice_address_init (&addr);
+  g_assert (nice_address_set_from_string (&addr, "127.0.0.1"));
+
+  lagent = create_agent (&addr, TRUE);
+  ragent = create_agent (&addr, FALSE);
+
+  for (i = 0; i < N_STREAMS; i++) {
+    ls_ids[i] = nice_agent_add_stream (lagent, 1);
+    rs_ids[i] = nice_agent_add_stream (ragent, 1);
+
+    nice_agent_attach_recv (lagent, ls_ids[i], NICE_COMPONENT_TYPE_RTP, NULL,
+        cb_sender_recv, NULL);
+    nice_agent_attach_recv (ragent, rs_ids[i], NICE_COMPONENT_TYPE_RTP, NULL,
+        cb_nice_recv, GUINT_TO_POINTER (i + 1));
+
+    g_assert (nice_agent_gather_candidates (lagent, ls_ids[i]));
+    g_assert (nice_agent_gather_candidates (ragent, rs_ids[i]));
+  }
+  g_main_loop_run (loop);
+
+  for (i = 0; i < N_STREAMS; i++) {
+    transfer_candidates (lagent, ls_ids[i], ragent, rs_ids[i]);
+    transfer_candidates (ragent, rs_ids[i], lagent, ls_ids[i]);
+  }
+  g_main_loop_run (loop);
+
+  memset (payload_buf, 0xaa, sizeof (payload_buf));
+
+  for (i = 0; i < N_STREAMS; i++) {
+    headers[i] = i + 1;
+    destinations[i].stream_id = ls_ids[i];
+    destinations[i].component_id = NICE_COMPONENT_TYPE_RTP;
+    destinations[i].header.buffer = &headers[i];
+    destinations[i].header.size = 1;
+  }
+
+  /* A stream which doesn’t exist doesn’t prevent sending to the others */
+  destinations[N_STREAMS].stream_id = 1000;
+  destinations[N_STREAMS].component_id = NICE_COMPONENT_TYPE_RTP;
+  destinations[N_STREAMS].header.buffer = NULL;
+  destinations[N_STREAMS].header.size = 0;
+
+  g_assert_cmpint (nice_agent_send_fanout (lagent, &payload, destinations,
+          G_N_ELEMENTS (destinations)), ==, N_STREAMS);
+
+  for (i = 0; i < N_STREAMS; i++)
+    g_assert (destinations[i].sent);
+  g_assert (!destinations[N_STREAMS].sent);
+
+  g_main_loop_run (loop);
+
+  for (i = 1; i <= N_STREAMS; i++)
+    g_assert (received[i]);
+
+  g_object_unref (lagent);
+  g_object_unref (ragent);
+
+  g_source_remove (timer_id);
+  g_main_loop_unref (loop);
+
+#ifdef G_OS_WIN32
+  WSACleanup();
+#endif
+
+  return 0;
+}
@@ -39,6 +39,11 @@
 #define RTP_HEADER_SIZE 12
 #define RTP_PAYLOAD_SIZE 1024
 
+#define THROUGHPUT_PACKETS 20000
+#define THROUGHPUT_BATCH 16
+/* Packets allowed in flight, kept well below the default socket buffer */
+#define THROUGHPUT_WINDOW 64
+
 static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_SRC,
     GST_PAD_ALWAYS,
@@ -55,6 +60,8 @@ static gint ready = 0;
 
 static GCond cond;
 static guint bytes_received;
+static guint buffers_received;
+static guint pushes_received;
 static guint data_size;
 
 
@@ -66,6 +73,7 @@ count_bytes (GstBuffer ** buffer, guint idx, gpointer data)
   g_debug ("received %" G_GSIZE_FORMAT " bytes", size);
   g_mutex_lock(&mutex);
   bytes_received += size;
+  buffers_received++;
   g_cond_signal (&cond);
   g_mutex_unlock (&mutex);
 
@@ -76,6 +84,10 @@ static GstFlowReturn
 sink_chain_list_function (GstPad * pad, GstObject * parent,
     GstBufferList * list)
 {
+  g_mutex_lock (&mutex);
+  pushes_received++;
+  g_mutex_unlock (&mutex);
+
   gst_buffer_list_foreach (list, count_bytes, NULL);
 
   gst_buffer_list_unref (list);
@@ -91,6 +103,8 @@ sink_chain_function (GstPad * pad, GstObject * parent, GstBuffer * buffer)
   g_debug ("received %" G_GSIZE_FORMAT " bytes", size);
   g_mutex_lock(&mutex);
   bytes_received += size;
+  buffers_received++;
+  pushes_received++;
   g_cond_signal (&cond);
   g_mutex_unlock (&mutex);
 
@@ -211,89 +225,133 @@ cb_component_state_changed (NiceAgent * agent, guint stream_id,
   }
 }
 
-GST_START_TEST (buffer_list_test)
+typedef struct
 {
-  GstSegment segment;
+  NiceAddress *addr;
+  NiceAgent *sink_agent, *src_agent;
   GstElement *nicesink, *nicesrc;
   GstPad *srcpad, *sinkpad;
-  GstBufferList *list;
-  NiceAgent *sink_agent, *src_agent;
+} TestPipeline;
+
+/* Connects two agents over loopback and wires a nicesink fed from @srcpad to
+ * a nicesrc draining into @sinkpad, both elements PLAYING */
+static void
+test_pipeline_setup (TestPipeline * p, gboolean reliable)
+{
+  GstSegment segment;
   guint sink_stream, src_stream;
-  NiceAddress *addr;
 
   loop = g_main_loop_new (NULL, TRUE);
+  ready = 0;
+  bytes_received = 0;
+  buffers_received = 0;
+  pushes_received = 0;
 
   /* Initialize nice agents */
-  addr = nice_address_new ();
-  nice_address_set_from_string (addr, "127.0.0.1");
-
-  sink_agent = nice_agent_new (NULL, NICE_COMPATIBILITY_RFC5245);
-  src_agent = nice_agent_new (NULL, NICE_COMPATIBILITY_RFC5245);
+  p->addr = nice_address_new ();
+  nice_address_set_from_string (p->addr, "127.0.0.1");
+
+  if (reliable) {
+    p->sink_agent = nice_agent_new_reliable (NULL, NICE_COMPATIBILITY_RFC5245);
+    p->src_agent = nice_agent_new_reliable (NULL, NICE_COMPATIBILITY_RFC5245);
+  } else {
+    p->sink_agent = nice_agent_new (NULL, NICE_COMPATIBILITY_RFC5245);
+    p->src_agent = nice_agent_new (NULL, NICE_COMPATIBILITY_RFC5245);
+  }
 
-  g_object_set (G_OBJECT (sink_agent), "upnp", FALSE, NULL);
-  g_object_set (G_OBJECT (src_agent), "upnp", FALSE, NULL);
+  g_object_set (G_OBJECT (p->sink_agent), "upnp", FALSE, NULL);
+  g_object_set (G_OBJECT (p->src_agent), "upnp", FALSE, NULL);
 
-  nice_agent_add_local_address (sink_agent, addr);
-  nice_agent_add_local_address (src_agent, addr);
+  nice_agent_add_local_address (p->sink_agent, p->addr);
+  nice_agent_add_local_address (p->src_agent, p->addr);
 
-  sink_stream = nice_agent_add_stream (sink_agent, 1);
-  src_stream = nice_agent_add_stream (src_agent, 1);
+  sink_stream = nice_agent_add_stream (p->sink_agent, 1);
+  src_stream = nice_agent_add_stream (p->src_agent, 1);
 
-  nice_agent_attach_recv (sink_agent, sink_stream, NICE_COMPONENT_TYPE_RTP,
+  nice_agent_attach_recv (p->sink_agent, sink_stream, NICE_COMPONENT_TYPE_RTP,
       NULL, recv_cb, NULL);
-  nice_agent_attach_recv (src_agent, src_stream, NICE_COMPONENT_TYPE_RTP,
+  nice_agent_attach_recv (p->src_agent, src_stream, NICE_COMPONENT_TYPE_RTP,
       NULL, recv_cb, NULL);
 
-  g_signal_connect (G_OBJECT (sink_agent), "candidate-gathering-done",
-      G_CALLBACK (cb_candidate_gathering_done), src_agent);
-  g_signal_connect (G_OBJECT (src_agent), "candidate-gathering-done",
-      G_CALLBACK (cb_candidate_gathering_done), sink_agent);
+  g_signal_connect (G_OBJECT (p->sink_agent), "candidate-gathering-done",
+      G_CALLBACK (cb_candidate_gathering_done), p->src_agent);
+  g_signal_connect (G_OBJECT (p->src_agent), "candidate-gathering-done",
+      G_CALLBACK (cb_candidate_gathering_done), p->sink_agent);
 
-  g_signal_connect (G_OBJECT (sink_agent), "component-state-changed",
+  g_signal_connect (G_OBJECT (p->sink_agent), "component-state-changed",
       G_CALLBACK (cb_component_state_changed), NULL);
-  g_signal_connect (G_OBJECT (src_agent), "component-state-changed",
+  g_signal_connect (G_OBJECT (p->src_agent), "component-state-changed",
       G_CALLBACK (cb_component_state_changed), NULL);
 
-  credentials_negotiation (sink_agent, src_agent, sink_stream, src_stream);
-  credentials_negotiation (src_agent, sink_agent, src_stream, src_stream);
+  credentials_negotiation (p->sink_agent, p->src_agent, sink_stream,
+      src_stream);
+  credentials_negotiation (p->src_agent, p->sink_agent, src_stream,
+      src_stream);
 
-  nice_agent_gather_candidates (sink_agent, sink_stream);
-  nice_agent_gather_candidates (src_agent, src_stream);
+  nice_agent_gather_candidates (p->sink_agent, sink_stream);
+  nice_agent_gather_candidates (p->src_agent, src_stream);
 
   /* Create gstreamer elements */
-  nicesink = gst_check_setup_element ("nicesink");
-  nicesrc = gst_check_setup_element ("nicesrc");
+  p->nicesink = gst_check_setup_element ("nicesink");
+  p->nicesrc = gst_check_setup_element ("nicesrc");
 
-  g_object_set (nicesink, "agent", sink_agent, "stream", sink_stream,
+  g_object_set (p->nicesink, "agent", p->sink_agent, "stream", sink_stream,
+      "component", 1, NULL);
+  g_object_set (p->nicesrc, "agent", p->src_agent, "stream", src_stream,
       "component", 1, NULL);
-  g_object_set (nicesrc, "agent", src_agent, "stream", src_stream, "component",
-      1, NULL);
 
-  srcpad = gst_check_setup_src_pad_by_name (nicesink, &srctemplate, "sink");
-  sinkpad = gst_check_setup_sink_pad_by_name (nicesrc, &sinktemplate, "src");
+  p->srcpad = gst_check_setup_src_pad_by_name (p->nicesink, &srctemplate,
+      "sink");
+  p->sinkpad = gst_check_setup_sink_pad_by_name (p->nicesrc, &sinktemplate,
+      "src");
 
-  gst_pad_set_chain_list_function_full (sinkpad, sink_chain_list_function, NULL,
+  gst_pad_set_chain_list_function_full (p->sinkpad, sink_chain_list_function,
+      NULL, NULL);
+  gst_pad_set_chain_function_full (p->sinkpad, sink_chain_function, NULL,
       NULL);
-  gst_pad_set_chain_function_full (sinkpad, sink_chain_function, NULL, NULL);
 
-  gst_element_set_state (nicesink, GST_STATE_PLAYING);
-  gst_pad_set_active (srcpad, TRUE);
+  gst_element_set_state (p->nicesink, GST_STATE_PLAYING);
+  gst_pad_set_active (p->srcpad, TRUE);
 
-  gst_element_set_state (nicesrc, GST_STATE_PLAYING);
-  gst_pad_set_active (sinkpad, TRUE);
+  gst_element_set_state (p->nicesrc, GST_STATE_PLAYING);
+  gst_pad_set_active (p->sinkpad, TRUE);
 
-  gst_pad_push_event (srcpad, gst_event_new_stream_start ("test"));
+  gst_pad_push_event (p->srcpad, gst_event_new_stream_start ("test"));
 
   gst_segment_init (&segment, GST_FORMAT_TIME);
-  gst_pad_push_event (srcpad, gst_event_new_segment (&segment));
-
-  list = create_buffer_list ();
+  gst_pad_push_event (p->srcpad, gst_event_new_segment (&segment));
 
   g_debug ("Waiting for agents to be ready ready");
 
   g_main_loop_run (loop);
+}
 
-  fail_unless_equals_int (gst_pad_push_list (srcpad, list), GST_FLOW_OK);
+static void
+test_pipeline_teardown (TestPipeline * p)
+{
+  gst_check_teardown_pad_by_name (p->nicesink, "sink");
+  gst_check_teardown_element (p->nicesink);
+
+  gst_check_teardown_pad_by_name (p->nicesrc, "src");
+  gst_check_teardown_element (p->nicesrc);
+
+  g_object_unref (p->sink_agent);
+  g_object_unref (p->src_agent);
+
+  nice_address_free (p->addr);
+  g_main_loop_unref (loop);
+}
+
+GST_START_TEST (buffer_list_test)
+{
+  TestPipeline p;
+  GstBufferList *list;
+
+  test_pipeline_setup (&p, FALSE);
+
+  list = create_buffer_list ();
+
+  fail_unless_equals_int (gst_pad_push_list (p.srcpad, list), GST_FLOW_OK);
 
   g_debug ("Waiting for buffers");
 
@@ -308,14 +366,102 @@ GST_START_TEST (buffer_list_test)
 
   fail_unless_equals_int (data_size, bytes_received);
 
-  gst_check_teardown_pad_by_name (nicesink, "sink");
-  gst_check_teardown_element (nicesink);
+  test_pipeline_teardown (&p);
+}
 
-  gst_check_teardown_pad_by_name (nicesrc, "src");
-  gst_check_teardown_element (nicesrc);
+GST_END_TEST;
 
-  nice_address_free (addr);
-  g_main_loop_unref (loop);
+/* Pushes a steady stream of RTP-sized packets through nicesink -> nicesrc
+ * and reports packet rate and how many packets nicesrc pushed per wakeup */
+GST_START_TEST (throughput_test)
+{
+  TestPipeline p;
+  guint packet_size = RTP_HEADER_SIZE + RTP_PAYLOAD_SIZE;
+  guint sent = 0;
+  gint64 start, elapsed;
+
+  test_pipeline_setup (&p, FALSE);
+
+  start = g_get_monotonic_time ();
+
+  while (sent < THROUGHPUT_PACKETS) {
+    GstBufferList *list = gst_buffer_list_new ();
+    guint i;
+
+    for (i = 0; i < THROUGHPUT_BATCH; i++) {
+      GstBuffer *buffer = gst_buffer_new_allocate (NULL, packet_size, NULL);
+
+      gst_buffer_memset (buffer, 0, 0, packet_size);
+      gst_buffer_list_add (list, buffer);
+    }
+    sent += THROUGHPUT_BATCH;
+
+    fail_unless_equals_int (gst_pad_push_list (p.srcpad, list), GST_FLOW_OK);
+
+    /* Loopback UDP drops when the receive socket buffer overflows, so don't
+     * run too far ahead of nicesrc */
+    g_mutex_lock (&mutex);
+    while (buffers_received + THROUGHPUT_WINDOW < sent)
+      g_cond_wait (&cond, &mutex);
+    g_mutex_unlock (&mutex);
+  }
+
+  g_mutex_lock (&mutex);
+  while (buffers_received < sent)
+    g_cond_wait (&cond, &mutex);
+  g_mutex_unlock (&mutex);
+
+  elapsed = g_get_monotonic_time () - start;
+
+  fail_unless_equals_int (bytes_received, sent * packet_size);
+
+  g_print ("nicesrc throughput: %u packets in %" G_GINT64_FORMAT " us "
+      "(%.0f packets/s), %.2f packets per push\n", buffers_received, elapsed,
+      buffers_received * (gdouble) G_USEC_PER_SEC / MAX (elapsed, 1),
+      (gdouble) buffers_received / MAX (pushes_received, 1));
+
+  test_pipeline_teardown (&p);
+}
+
+GST_END_TEST;
+
+static gboolean
+check_data_received (gpointer user_data)
+{
+  gboolean done;
+
+  g_mutex_lock (&mutex);
+  done = (bytes_received >= data_size);
+  g_mutex_unlock (&mutex);
+
+  if (done)
+    g_main_loop_quit (loop);
+
+  return !done;
+}
+
+/* With max-queued-bytes set, nicesink must not block while the pseudo-TCP
+ * connection is not writable yet, but queue and flush once it is */
+GST_START_TEST (reliable_queue_test)
+{
+  TestPipeline p;
+  GstBufferList *list;
+
+  test_pipeline_setup (&p, TRUE);
+
+  g_object_set (p.nicesink, "max-queued-bytes", 64 * 1024, NULL);
+
+  list = create_buffer_list ();
+  fail_unless_equals_int (gst_pad_push_list (p.srcpad, list), GST_FLOW_OK);
+
+  /* The agents' context must keep running for pseudo-TCP ACKs and the
+   * reliable-transport-writable signal */
+  g_timeout_add (10, check_data_received, NULL);
+  g_main_loop_run (loop);
+
+  fail_unless_equals_int (data_size, bytes_received);
+
+  test_pipeline_teardown (&p);
 }
 
 GST_END_TEST;
@@ -329,6 +475,8 @@ udpsink_suite (void)
   suite_add_tcase (s, tc_chain);
 
   tcase_add_test (tc_chain, buffer_list_test);
+  tcase_add_test (tc_chain, throughput_test);
+  tcase_add_test (tc_chain, reliable_queue_test);
 
   return s;
 }
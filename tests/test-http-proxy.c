@@ -0,0 +1,166 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * Unit test for the pass-through of an HTTP proxy socket once connected.
+ *
+ * (C) 2026 Collabora Ltd
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ *
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <string.h>
+#include <gio/gnetworking.h>
+
+#include "socket.h"
+
+#define TIMEOUT_US (10 * G_TIME_SPAN_SECOND)
+
+static const gchar PROXY_REPLY[] =
+    "HTTP/1.1 200 Connection established\r\n"
+    "Content-Length: 0\r\n"
+    "\r\n";
+/* Sent by the server behind the proxy in the same segment as the reply */
+static const gchar LEFTOVER[] = "leftover";
+
+/* Receives exactly @len bytes from @sock, @chunk bytes at a time at most */
+static void
+recv_all (NiceSocket *sock, gchar *buf, gsize len, gsize chunk,
+    NiceAddress *from)
+{
+  gint64 end_time = g_get_monotonic_time () + TIMEOUT_US;
+  gsize received = 0;
+
+  while (received < len) {
+    gssize ret;
+
+    ret = nice_socket_recv (sock, from, MIN (chunk, len - received),
+        buf + received);
+    g_assert_cmpint (ret, >=, 0);
+    received += ret;
+
+    if (ret == 0) {
+      g_assert (g_get_monotonic_time () < end_time);
+      g_usleep (1000);
+    }
+  }
+}
+
+int
+main (void)
+{
+  NiceAddress bind_addr, target, from;
+  NiceSocket *passive_sock, *active_sock, *client, *server, *http;
+  gint64 end_time;
+  GError *error = NULL;
+  GString *request;
+  gchar buf[64];
+  gsize i;
+
+  g_networking_init ();
+
+  nice_address_init (&bind_addr);
+  g_assert (nice_address_set_from_string (&bind_addr, "127.0.0.1"));
+
+  nice_address_init (&target);
+  g_assert (nice_address_set_from_string (&target, "192.0.2.1"));
+  nice_address_set_port (&target, 3478);
+
+  nice_address_init (&from);
+
+  /* The passive socket plays the proxy */
+  passive_sock = nice_tcp_passive_socket_new (NULL, &bind_addr, &error);
+  g_assert_no_error (error);
+  g_assert (passive_sock);
+
+  active_sock = nice_tcp_active_socket_new (NULL, &bind_addr);
+  g_assert (active_sock);
+  client = nice_tcp_active_socket_connect (active_sock, &passive_sock->addr);
+  g_assert (client);
+  nice_socket_free (active_sock);
+
+  end_time = g_get_monotonic_time () + TIMEOUT_US;
+  while ((server = nice_tcp_passive_socket_accept (passive_sock)) == NULL) {
+    g_assert (g_get_monotonic_time () < end_time);
+    g_usleep (1000);
+  }
+
+  http = nice_http_socket_new (client, &target, NULL, NULL);
+  g_assert (http);
+
+  /* Not connected yet: queued until the proxy replies */
+  g_assert (nice_socket_get_passthrough (http, &from) == http);
+  g_assert_cmpint (nice_socket_send_reliable (http, &target, 5, "early"), ==,
+      5);
+
+  /* Read the CONNECT request */
+  request = g_string_new (NULL);
+  while (!g_str_has_suffix (request->str, "\r\n\r\n")) {
+    recv_all (server, buf, 1, 1, NULL);
+    g_string_append_len (request, buf, 1);
+  }
+  g_assert (g_str_has_prefix (request->str, "CONNECT 192.0.2.1:3478 "));
+  g_string_free (request, TRUE);
+
+  memcpy (buf, PROXY_REPLY, strlen (PROXY_REPLY));
+  memcpy (buf + strlen (PROXY_REPLY), LEFTOVER, strlen (LEFTOVER));
+  g_assert_cmpint (nice_socket_send (server, NULL,
+          strlen (PROXY_REPLY) + strlen (LEFTOVER), buf), ==,
+      strlen (PROXY_REPLY) + strlen (LEFTOVER));
+
+  /* The bytes behind the reply come out first, whatever the size of the
+   * buffers, and the proxy can only be skipped once they are all out */
+  for (i = 0; i < strlen (LEFTOVER); i += 3) {
+    gsize len = MIN (3, strlen (LEFTOVER) - i);
+
+    g_assert (nice_socket_get_passthrough (http, &from) == http);
+
+    nice_address_init (&from);
+    recv_all (http, buf, len, len, &from);
+    g_assert (memcmp (buf, LEFTOVER + i, len) == 0);
+    g_assert (nice_address_equal (&from, &target));
+  }
+
+  /* The queued data was flushed once connected */
+  recv_all (server, buf, 5, 5, NULL);
+  g_assert (memcmp (buf, "early", 5) == 0);
+
+  /* From now on, the I/O can go straight to the TCP socket, as long as the
+   * data is reported to come from the target */
+  g_assert (nice_socket_get_passthrough (http, &from) == client);
+  g_assert (nice_address_equal (&from, &target));
+
+  g_assert_cmpint (nice_socket_send (server, NULL, 5, "media"), ==, 5);
+  nice_address_init (&from);
+  recv_all (http, buf, 5, 5, &from);
+  g_assert (memcmp (buf, "media", 5) == 0);
+  g_assert (nice_address_equal (&from, &target));
+
+  nice_socket_free (http);
+  nice_socket_free (server);
+  nice_socket_free (passive_sock);
+
+  return 0;
+}
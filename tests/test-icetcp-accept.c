@@ -0,0 +1,260 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * Unit test for accepting connections on passive ICE-TCP candidates.
+ *
+ * (C) 2026 Collabora Ltd
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ *
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "agent.h"
+
+#include "stun/stunagent.h"
+#include "stun/usages/ice.h"
+
+#include <string.h>
+
+/* NICE_COMPONENT_MAX_TCP_HALF_OPEN */
+#define MAX_HALF_OPEN 32
+#define N_FLOOD (MAX_HALF_OPEN + 8)
+#define CONNECT_BATCH 8
+
+static gboolean gathering_done;
+
+static gboolean
+timer_cb (gpointer user_data)
+{
+  g_error ("ERROR: test has got stuck, aborting...");
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+cb_candidate_gathering_done (NiceAgent *agent, guint stream_id,
+    gpointer user_data)
+{
+  gathering_done = TRUE;
+}
+
+static void
+cb_nice_recv (NiceAgent *agent, guint stream_id, guint component_id,
+    guint len, gchar *buf, gpointer user_data)
+{
+}
+
+static guint64
+get_accepted (NiceAgent *agent, guint stream_id, guint64 *evicted)
+{
+  NiceComponentStats stats;
+
+  g_assert (nice_agent_get_component_stats (agent, stream_id,
+          NICE_COMPONENT_TYPE_RTP, &stats));
+  if (evicted)
+    *evicted = stats.ice_tcp_evicted;
+
+  return stats.ice_tcp_accepted;
+}
+
+static void
+wait_for_accepted (NiceAgent *agent, guint stream_id, guint64 n)
+{
+  while (get_accepted (agent, stream_id, NULL) < n)
+    g_main_context_iteration (NULL, TRUE);
+}
+
+static void
+wait_for_readable (GSocket *sock)
+{
+  while (g_socket_condition_check (sock, G_IO_IN | G_IO_HUP) == 0) {
+    if (!g_main_context_iteration (NULL, FALSE))
+      g_usleep (1000);
+  }
+}
+
+static GSocket *
+connect_to (NiceAddress *addr)
+{
+  union {
+    struct sockaddr_storage storage;
+    struct sockaddr addr;
+  } name;
+  GSocketAddress *gaddr;
+  GSocket *sock;
+
+  nice_address_copy_to_sockaddr (addr, &name.addr);
+  gaddr = g_socket_address_new_from_native (&name.addr, sizeof (name));
+
+  sock = g_socket_new (G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_STREAM,
+      G_SOCKET_PROTOCOL_TCP, NULL);
+  g_assert_nonnull (sock);
+  g_assert (g_socket_connect (sock, gaddr, NULL, NULL));
+  g_object_unref (gaddr);
+
+  return sock;
+}
+
+/* Sends an authenticated connectivity check, framed as in RFC 4571 */
+static void
+send_check (GSocket *sock, NiceAgent *agent, guint stream_id)
+{
+  StunAgent stun_agent;
+  StunMessage msg;
+  guint8 buf[512];
+  gchar *ufrag = NULL, *password = NULL;
+  gchar *username;
+  gsize len;
+
+  g_assert (nice_agent_get_local_credentials (agent, stream_id, &ufrag,
+          &password));
+  username = g_strdup_printf ("%s:peer", ufrag);
+
+  stun_agent_init (&stun_agent, STUN_ALL_KNOWN_ATTRIBUTES,
+      STUN_COMPATIBILITY_RFC5389,
+      STUN_AGENT_USAGE_SHORT_TERM_CREDENTIALS |
+      STUN_AGENT_USAGE_USE_FINGERPRINT);
+  len = stun_usage_ice_conncheck_create (&stun_agent, &msg, buf + 2,
+      sizeof (buf) - 2, (const uint8_t *) username, strlen (username),
+      (const uint8_t *) password, strlen (password),
+      FALSE, FALSE, 0x6e7f1eff, 0x0123456789abcdefULL, NULL,
+      STUN_USAGE_ICE_COMPATIBILITY_RFC5245);
+  g_assert_cmpuint (len, >, 0);
+
+  buf[0] = len >> 8;
+  buf[1] = len & 0xff;
+  g_assert_cmpint (g_socket_send (sock, (gchar *) buf, len + 2, NULL, NULL),
+      ==, len + 2);
+
+  g_free (username);
+  g_free (ufrag);
+  g_free (password);
+}
+
+static gboolean
+is_closed (GSocket *sock)
+{
+  gchar buf[1500];
+
+  if (g_socket_condition_check (sock, G_IO_IN | G_IO_HUP) == 0)
+    return FALSE;
+
+  return g_socket_receive (sock, buf, sizeof (buf), NULL, NULL) <= 0;
+}
+
+int main (void)
+{
+  NiceAgent *agent;
+  NiceAddress addr, passive_addr;
+  GSList *cands, *i;
+  GSocket *checked;
+  GSocket *flood[N_FLOOD];
+  gchar buf[1500];
+  guint stream_id, n;
+  guint64 evicted;
+  guint timer_id;
+
+#ifdef G_OS_WIN32
+  WSADATA w;
+
+  WSAStartup(0x0202, &w);
+#endif
+
+  nice_address_init (&addr);
+  g_assert (nice_address_set_from_string (&addr, "127.0.0.1"));
+
+  agent = g_object_new (NICE_TYPE_AGENT,
+      "compatibility", NICE_COMPATIBILITY_RFC5245,
+      "controlling-mode", TRUE,
+      "upnp", FALSE,
+      "ice-udp", FALSE,
+      "ice-tcp", TRUE,
+      NULL);
+  nice_agent_add_local_address (agent, &addr);
+  g_signal_connect (agent, "candidate-gathering-done",
+      G_CALLBACK (cb_candidate_gathering_done), NULL);
+
+  timer_id = g_timeout_add_seconds (30, timer_cb, NULL);
+
+  stream_id = nice_agent_add_stream (agent, 1);
+  nice_agent_attach_recv (agent, stream_id, NICE_COMPONENT_TYPE_RTP,
+      NULL, cb_nice_recv, NULL);
+  g_assert (nice_agent_gather_candidates (agent, stream_id));
+  while (!gathering_done)
+    g_main_context_iteration (NULL, TRUE);
+
+  nice_address_init (&passive_addr);
+  cands = nice_agent_get_local_candidates (agent, stream_id,
+      NICE_COMPONENT_TYPE_RTP);
+  for (i = cands; i; i = i->next) {
+    NiceCandidate *cand = i->data;
+
+    if (cand->transport == NICE_CANDIDATE_TRANSPORT_TCP_PASSIVE)
+      passive_addr = cand->addr;
+  }
+  g_slist_free_full (cands, (GDestroyNotify) nice_candidate_free);
+  g_assert (nice_address_is_valid (&passive_addr));
+
+  /* A connection which carries a check is no longer half-open */
+  checked = connect_to (&passive_addr);
+  wait_for_accepted (agent, stream_id, 1);
+  send_check (checked, agent, stream_id);
+  wait_for_readable (checked);
+  g_assert_cmpint (g_socket_receive (checked, buf, sizeof (buf), NULL, NULL),
+      >, 0);
+
+  /* Connections which never send anything get evicted, oldest first */
+  for (n = 0; n < N_FLOOD; n++) {
+    flood[n] = connect_to (&passive_addr);
+    if ((n + 1) % CONNECT_BATCH == 0)
+      wait_for_accepted (agent, stream_id, n + 2);
+  }
+  wait_for_accepted (agent, stream_id, N_FLOOD + 1);
+
+  g_assert_cmpuint (get_accepted (agent, stream_id, &evicted), ==,
+      N_FLOOD + 1);
+  g_assert_cmpuint (evicted, ==, N_FLOOD - MAX_HALF_OPEN);
+
+  for (n = 0; n < N_FLOOD - MAX_HALF_OPEN; n++) {
+    wait_for_readable (flood[n]);
+    g_assert (is_closed (flood[n]));
+  }
+  for (; n < N_FLOOD; n++)
+    g_assert (!is_closed (flood[n]));
+  g_assert (!is_closed (checked));
+
+  for (n = 0; n < N_FLOOD; n++)
+    g_object_unref (flood[n]);
+  g_object_unref (checked);
+
+  g_object_unref (agent);
+  g_source_remove (timer_id);
+
+#ifdef G_OS_WIN32
+  WSACleanup();
+#endif
+
+  return 0;
+}
@@ -105,6 +105,26 @@ write_thread_cb (GOutputStream *output_stream, TestIOStreamThreadData *data)
 
     memset (buf, user_data->send_count + '1', MESSAGE_SIZE);
 
+#if GLIB_CHECK_VERSION (2, 60, 0)
+    /* Alternate with vectored writes, split unevenly across the buffer */
+    if (user_data->send_count % 2) {
+      GOutputVector vectors[] = {
+        { buf, 1 },
+        { buf + 1, MESSAGE_SIZE / 2 },
+        { buf + 1 + MESSAGE_SIZE / 2, MESSAGE_SIZE - 1 - MESSAGE_SIZE / 2 },
+      };
+      gsize written;
+
+      G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+      g_output_stream_writev_all (output_stream, vectors,
+          G_N_ELEMENTS (vectors), &written, NULL, &error);
+      G_GNUC_END_IGNORE_DEPRECATIONS
+      g_assert_no_error (error);
+      g_assert_cmpuint (written, ==, MESSAGE_SIZE);
+      continue;
+    }
+#endif
+
     g_output_stream_write (output_stream, buf, sizeof (buf), NULL, &error);
     g_assert_no_error (error);
   }
@@ -0,0 +1,172 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * Unit test for socket buffer sizes and kernel drop accounting.
+ *
+ * (C) 2026 Collabora Ltd
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ *
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "agent.h"
+
+#include <string.h>
+
+#define N_FLOOD 1000
+#define FLOOD_SIZE 1200
+
+static GMainLoop *loop;
+
+static gboolean
+timer_cb (gpointer user_data)
+{
+  g_error ("ERROR: test has got stuck, aborting...");
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+tick_cb (gpointer user_data)
+{
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+cb_nice_recv (NiceAgent *agent, guint stream_id, guint component_id,
+    guint len, gchar *buf, gpointer user_data)
+{
+}
+
+static void
+cb_candidate_gathering_done (NiceAgent *agent, guint stream_id,
+    gpointer user_data)
+{
+  g_main_loop_quit (loop);
+}
+
+static void
+send_datagrams (GSocket *gsock, GSocketAddress *to, guint n)
+{
+  gchar buf[FLOOD_SIZE];
+  guint i;
+
+  memset (buf, 0x55, sizeof (buf));
+
+  for (i = 0; i < n; i++)
+    g_socket_send_to (gsock, to, buf, sizeof (buf), NULL, NULL);
+}
+
+int main (void)
+{
+  NiceAgent *agent;
+  NiceAddress addr;
+  NiceCandidate *cand;
+  GSList *cands;
+  GSocket *gsock;
+  GSocketAddress *to;
+  union {
+    struct sockaddr_storage storage;
+    struct sockaddr addr;
+  } sa;
+  guint stream_id;
+  guint recv_size;
+  guint timer_id, tick_id;
+
+  loop = g_main_loop_new (NULL, FALSE);
+
+  nice_address_init (&addr);
+  g_assert (nice_address_set_from_string (&addr, "127.0.0.1"));
+
+  /* Small enough for the flood below to overflow it */
+  agent = g_object_new (NICE_TYPE_AGENT,
+      "compatibility", NICE_COMPATIBILITY_RFC5245,
+      "upnp", FALSE,
+      "ice-tcp", FALSE,
+      "recv-buffer-size", 4096,
+      NULL);
+  g_object_get (agent, "recv-buffer-size", &recv_size, NULL);
+  g_assert_cmpuint (recv_size, ==, 4096);
+
+  nice_agent_add_local_address (agent, &addr);
+  g_signal_connect (agent, "candidate-gathering-done",
+      G_CALLBACK (cb_candidate_gathering_done), NULL);
+
+  stream_id = nice_agent_add_stream (agent, 1);
+  nice_agent_set_stream_buffer_sizes (agent, stream_id, 0, 65536);
+  nice_agent_attach_recv (agent, stream_id, NICE_COMPONENT_TYPE_RTP,
+      g_main_loop_get_context (loop), cb_nice_recv, NULL);
+
+  timer_id = g_timeout_add_seconds (30, timer_cb, NULL);
+
+  g_assert (nice_agent_gather_candidates (agent, stream_id));
+  g_main_loop_run (loop);
+
+  g_assert_cmpuint (nice_agent_get_component_kernel_drops (agent, stream_id,
+          NICE_COMPONENT_TYPE_RTP), ==, 0);
+
+  cands = nice_agent_get_local_candidates (agent, stream_id,
+      NICE_COMPONENT_TYPE_RTP);
+  g_assert (cands != NULL);
+  cand = cands->data;
+  nice_address_copy_to_sockaddr (&cand->addr, &sa.addr);
+  to = g_socket_address_new_from_native (&sa, sizeof (sa));
+  g_slist_free_full (cands, (GDestroyNotify) nice_candidate_free);
+
+  gsock = g_socket_new (G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_DATAGRAM,
+      G_SOCKET_PROTOCOL_UDP, NULL);
+  g_assert (gsock != NULL);
+
+  /* Nothing is read while the main context isn't iterated */
+  send_datagrams (gsock, to, N_FLOOD);
+  while (g_main_context_iteration (NULL, FALSE));
+
+  /* The kernel stamps the drop count on datagrams as they are queued, so the
+   * ones already queued during the flood still carried 0 */
+  send_datagrams (gsock, to, 1);
+
+  tick_id = g_timeout_add (10, tick_cb, NULL);
+
+#ifdef __linux__
+  while (nice_agent_get_component_kernel_drops (agent, stream_id,
+          NICE_COMPONENT_TYPE_RTP) == 0)
+    g_main_context_iteration (NULL, TRUE);
+#else
+  while (g_main_context_iteration (NULL, FALSE));
+  g_assert_cmpuint (nice_agent_get_component_kernel_drops (agent, stream_id,
+          NICE_COMPONENT_TYPE_RTP), ==, 0);
+#endif
+
+  g_source_remove (tick_id);
+  g_source_remove (timer_id);
+
+  g_object_unref (to);
+  g_object_unref (gsock);
+  g_object_unref (agent);
+  g_main_loop_unref (loop);
+
+  return 0;
+}
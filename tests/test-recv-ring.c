@@ -0,0 +1,238 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * Unit test for receiving through network threads and receive rings.
+ *
+ * (C) 2026 Collabora Ltd
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ *
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "agent.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define N_PACKETS 32
+#define PACKET_SIZE 200
+
+static GMainLoop *loop;
+static volatile gint n_gathering_done;
+static volatile gint n_ready;
+
+static gboolean
+timer_cb (gpointer user_data)
+{
+  g_error ("ERROR: test has got stuck, aborting...");
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+cb_nice_recv (NiceAgent *agent, guint stream_id, guint component_id,
+    guint len, gchar *buf, gpointer user_data)
+{
+}
+
+static void
+cb_candidate_gathering_done (NiceAgent *agent, guint stream_id,
+    gpointer user_data)
+{
+  if (g_atomic_int_add (&n_gathering_done, 1) == 1)
+    g_main_loop_quit (loop);
+}
+
+/* May be emitted from the receiving agent’s network thread */
+static void
+cb_component_state_changed (NiceAgent *agent, guint stream_id,
+    guint component_id, guint state, gpointer user_data)
+{
+  if (state == NICE_COMPONENT_STATE_READY &&
+      g_atomic_int_add (&n_ready, 1) == 1)
+    g_main_loop_quit (loop);
+}
+
+static void
+transfer_candidates (NiceAgent *from, guint from_stream, NiceAgent *to,
+    guint to_stream)
+{
+  GSList *cands;
+  gchar *ufrag = NULL, *password = NULL;
+
+  nice_agent_get_local_credentials (from, from_stream, &ufrag, &password);
+  nice_agent_set_remote_credentials (to, to_stream, ufrag, password);
+  g_free (ufrag);
+  g_free (password);
+
+  cands = nice_agent_get_local_candidates (from, from_stream,
+      NICE_COMPONENT_TYPE_RTP);
+  nice_agent_set_remote_candidates (to, to_stream, NICE_COMPONENT_TYPE_RTP,
+      cands);
+  g_slist_free_full (cands, (GDestroyNotify) nice_candidate_free);
+}
+
+static NiceAgent *
+create_agent (NiceAddress *addr, gboolean controlling, guint io_threads)
+{
+  NiceAgent *agent;
+
+  agent = g_object_new (NICE_TYPE_AGENT,
+      "compatibility", NICE_COMPATIBILITY_RFC5245,
+      "controlling-mode", controlling,
+      "upnp", FALSE,
+      "ice-tcp", FALSE,
+      "io-threads", io_threads,
+      NULL);
+  nice_agent_add_local_address (agent, addr);
+
+  g_signal_connect (agent, "candidate-gathering-done",
+      G_CALLBACK (cb_candidate_gathering_done), NULL);
+  g_signal_connect (agent, "component-state-changed",
+      G_CALLBACK (cb_component_state_changed), NULL);
+
+  return agent;
+}
+
+/* Connects an agent using an I/O callback to one receiving through a ring
+ * with @slot_size byte slots, so connectivity checks only succeed if STUN is
+ * handled on the network thread, then sends it some packets. */
+static void
+test_recv_ring (NiceAddress *addr, gsize slot_size)
+{
+  NiceAgent *lagent, *ragent;
+  NiceRecvRing *ring;
+  guint ls_id, rs_id;
+  guint8 send_buf[PACKET_SIZE];
+  guint8 recv_bufs[8][PACKET_SIZE];
+  GInputVector vectors[8];
+  NiceInputMessage messages[8];
+  NiceAddress from[8];
+  GError *error = NULL;
+  guint n_received = 0;
+  guint i;
+  gint n;
+
+  n_gathering_done = 0;
+  n_ready = 0;
+
+  lagent = create_agent (addr, TRUE, 1);
+  ragent = create_agent (addr, FALSE, 2);
+
+  ls_id = nice_agent_add_stream (lagent, 1);
+  rs_id = nice_agent_add_stream (ragent, 1);
+
+  nice_agent_attach_recv (lagent, ls_id, NICE_COMPONENT_TYPE_RTP, NULL,
+      cb_nice_recv, NULL);
+  ring = nice_agent_attach_recv_ring (ragent, rs_id, NICE_COMPONENT_TYPE_RTP,
+      N_PACKETS, slot_size);
+  g_assert (ring != NULL);
+
+  g_assert (nice_agent_gather_candidates (lagent, ls_id));
+  g_assert (nice_agent_gather_candidates (ragent, rs_id));
+  g_main_loop_run (loop);
+
+  transfer_candidates (lagent, ls_id, ragent, rs_id);
+  transfer_candidates (ragent, rs_id, lagent, ls_id);
+  g_main_loop_run (loop);
+
+  /* Nothing has been sent yet */
+  n = nice_recv_ring_recv_messages (ring, messages, 1, 0, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK);
+  g_assert_cmpint (n, ==, -1);
+  g_clear_error (&error);
+
+  for (i = 0; i < N_PACKETS; i++) {
+    memset (send_buf, i, sizeof (send_buf));
+    g_assert_cmpint (nice_agent_send (lagent, ls_id, NICE_COMPONENT_TYPE_RTP,
+            sizeof (send_buf), (const gchar *) send_buf), ==, sizeof (send_buf));
+  }
+
+  while (n_received < N_PACKETS) {
+    for (i = 0; i < G_N_ELEMENTS (messages); i++) {
+      vectors[i].buffer = recv_bufs[i];
+      vectors[i].size = sizeof (recv_bufs[i]);
+      messages[i].buffers = &vectors[i];
+      messages[i].n_buffers = 1;
+      messages[i].from = &from[i];
+      messages[i].length = 0;
+    }
+
+    n = nice_recv_ring_recv_messages (ring, messages, G_N_ELEMENTS (messages),
+        5 * G_USEC_PER_SEC, &error);
+    g_assert_no_error (error);
+    g_assert_cmpint (n, >, 0);
+
+    for (i = 0; i < (guint) n; i++, n_received++) {
+      g_assert_cmpuint (messages[i].length, ==, PACKET_SIZE);
+      g_assert_cmpuint (recv_bufs[i][0], ==, n_received);
+      g_assert (nice_address_equal_no_port (&from[i], addr));
+    }
+  }
+
+  g_assert_cmpuint (nice_recv_ring_get_n_dropped (ring), ==, 0);
+
+  /* Removing the stream closes the ring */
+  nice_agent_remove_stream (ragent, rs_id);
+  n = nice_recv_ring_recv_messages (ring, messages, 1, -1, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_BROKEN_PIPE);
+  g_assert_cmpint (n, ==, -1);
+  g_clear_error (&error);
+
+  nice_recv_ring_unref (ring);
+  g_object_unref (lagent);
+  g_object_unref (ragent);
+}
+
+int main (void)
+{
+  NiceAddress addr;
+  guint timer_id;
+
+#ifdef G_OS_WIN32
+  WSADATA w;
+
+  WSAStartup(0x0202, &w);
+#endif
+
+  loop = g_main_loop_new (NULL, FALSE);
+  timer_id = g_timeout_add_seconds (30, timer_cb, NULL);
+
+  nice_address_init (&addr);
+  g_assert (nice_address_set_from_string (&addr, "127.0.0.1"));
+
+  test_recv_ring (&addr, 1500);
+  /* Slots too small for some STUN packets */
+  test_recv_ring (&addr, 256);
+
+  g_source_remove (timer_id);
+  g_main_loop_unref (loop);
+
+#ifdef G_OS_WIN32
+  WSACleanup();
+#endif
+
+  return 0;
+}
@@ -0,0 +1,232 @@
+/*
+ * This file is part of the Nice GLib ICE library.
+ *
+ * Unit test for emitting agent signals on a separate main context.
+ *
+ * (C) 2026 Collabora Ltd
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ *
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * the GNU Lesser General Public License Version 2.1 (the "LGPL"), in which
+ * case the provisions of LGPL are applicable instead of those above. If you
+ * wish to allow use of your version of this file only under the terms of the
+ * LGPL and not to allow others to use your version of this file under the
+ * MPL, indicate your decision by deleting the provisions above and replace
+ * them with the notice and other provisions required by the LGPL. If you do
+ * not delete the provisions above, a recipient may use your version of this
+ * file under either the MPL or the LGPL.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "agent.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static GMainLoop *loop;
+static GMainContext *signal_context;
+static GThread *signal_thread;
+static guint n_gathering_done;
+static guint n_ready;
+static guint lagent_last_state;
+static gboolean lagent_got_pair;
+
+static gboolean
+timer_cb (gpointer user_data)
+{
+  g_error ("ERROR: test has got stuck, aborting...");
+
+  return G_SOURCE_REMOVE;
+}
+
+static gpointer
+signal_thread_func (gpointer user_data)
+{
+  GMainLoop *signal_loop = user_data;
+
+  g_main_loop_run (signal_loop);
+
+  return NULL;
+}
+
+static gboolean
+quit_loop_cb (gpointer user_data)
+{
+  g_main_loop_quit (loop);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Quits the test’s main loop from any thread */
+static void
+quit_loop (void)
+{
+  g_idle_add (quit_loop_cb, NULL);
+}
+
+static void
+cb_nice_recv (NiceAgent *agent, guint stream_id, guint component_id,
+    guint len, gchar *buf, gpointer user_data)
+{
+}
+
+static void
+cb_candidate_gathering_done (NiceAgent *agent, guint stream_id,
+    gpointer user_data)
+{
+  if (GPOINTER_TO_UINT (user_data) == 1)
+    g_assert (g_thread_self () == signal_thread);
+
+  if (g_atomic_int_add (&n_gathering_done, 1) == 1)
+    quit_loop ();
+}
+
+static void
+cb_new_selected_pair (NiceAgent *agent, guint stream_id, guint component_id,
+    NiceCandidate *lcandidate, NiceCandidate *rcandidate, gpointer user_data)
+{
+  if (GPOINTER_TO_UINT (user_data) == 1) {
+    g_assert (g_thread_self () == signal_thread);
+    g_assert (lcandidate != NULL && rcandidate != NULL);
+    g_atomic_int_set (&lagent_got_pair, TRUE);
+  }
+}
+
+static void
+cb_component_state_changed (NiceAgent *agent, guint stream_id,
+    guint component_id, guint state, gpointer user_data)
+{
+  if (GPOINTER_TO_UINT (user_data) == 1) {
+    g_assert (g_thread_self () == signal_thread);
+    g_atomic_int_set (&lagent_last_state, state);
+  }
+
+  if (state == NICE_COMPONENT_STATE_READY &&
+      g_atomic_int_add (&n_ready, 1) == 1)
+    quit_loop ();
+}
+
+static void
+transfer_candidates (NiceAgent *from, guint from_stream, NiceAgent *to,
+    guint to_stream)
+{
+  GSList *cands;
+  gchar *ufrag = NULL, *password = NULL;
+
+  nice_agent_get_local_credentials (from, from_stream, &ufrag, &password);
+  nice_agent_set_remote_credentials (to, to_stream, ufrag, password);
+  g_free (ufrag);
+  g_free (password);
+
+  cands = nice_agent_get_local_candidates (from, from_stream,
+      NICE_COMPONENT_TYPE_RTP);
+  nice_agent_set_remote_candidates (to, to_stream, NICE_COMPONENT_TYPE_RTP,
+      cands);
+  g_slist_free_full (cands, (GDestroyNotify) nice_candidate_free);
+}
+
+static NiceAgent *
+create_agent (NiceAddress *addr, gboolean controlling, GMainContext *context,
+    guint id)
+{
+  NiceAgent *agent;
+
+  agent = g_object_new (NICE_TYPE_AGENT,
+      "compatibility", NICE_COMPATIBILITY_RFC5245,
+      "controlling-mode", controlling,
+      "upnp", FALSE,
+      "ice-tcp", FALSE,
+      "signal-context", context,
+      NULL);
+  nice_agent_add_local_address (agent, addr);
+
+  g_signal_connect (agent, "candidate-gathering-done",
+      G_CALLBACK (cb_candidate_gathering_done), GUINT_TO_POINTER (id));
+  g_signal_connect (agent, "component-state-changed",
+      G_CALLBACK (cb_component_state_changed), GUINT_TO_POINTER (id));
+  g_signal_connect (agent, "new-selected-pair-full",
+      G_CALLBACK (cb_new_selected_pair), GUINT_TO_POINTER (id));
+
+  return agent;
+}
+
+int main (void)
+{
+  NiceAgent *lagent, *ragent;
+  NiceAddress addr;
+  GMainLoop *signal_loop;
+  guint ls_id, rs_id;
+  guint timer_id;
+
+#ifdef G_OS_WIN32
+  WSADATA w;
+
+  WSAStartup(0x0202, &w);
+#endif
+
+  loop = g_main_loop_new (NULL, FALSE);
+  timer_id = g_timeout_add_seconds (30, timer_cb, NULL);
+
+  signal_context = g_main_context_new ();
+  signal_loop = g_main_loop_new (signal_context, FALSE);
+  signal_thread = g_thread_new ("signals", signal_thread_func, signal_loop);
+
+  nice_address_init (&addr);
+  g_assert (nice_address_set_from_string (&addr, "127.0.0.1"));
+
+  /* L emits its signals on the signal thread, R directly */
+  lagent = create_agent (&addr, TRUE, signal_context, 1);
+  ragent = create_agent (&addr, FALSE, NULL, 2);
+
+  ls_id = nice_agent_add_stream (lagent, 1);
+  rs_id = nice_agent_add_stream (ragent, 1);
+
+  nice_agent_attach_recv (lagent, ls_id, NICE_COMPONENT_TYPE_RTP, NULL,
+      cb_nice_recv, NULL);
+  nice_agent_attach_recv (ragent, rs_id, NICE_COMPONENT_TYPE_RTP, NULL,
+      cb_nice_recv, NULL);
+
+  g_assert (nice_agent_gather_candidates (lagent, ls_id));
+  g_assert (nice_agent_gather_candidates (ragent, rs_id));
+  g_main_loop_run (loop);
+
+  transfer_candidates (lagent, ls_id, ragent, rs_id);
+  transfer_candidates (ragent, rs_id, lagent, ls_id);
+  g_main_loop_run (loop);
+
+  /* However the state changes were coalesced, the last one is reported */
+  g_assert_cmpuint (g_atomic_int_get (&lagent_last_state), ==,
+      NICE_COMPONENT_STATE_READY);
+  g_assert (g_atomic_int_get (&lagent_got_pair));
+
+  g_object_unref (lagent);
+  g_object_unref (ragent);
+
+  g_main_loop_quit (signal_loop);
+  g_thread_join (signal_thread);
+  g_main_loop_unref (signal_loop);
+  g_main_context_unref (signal_context);
+
+  g_source_remove (timer_id);
+  g_main_loop_unref (loop);
+
+#ifdef G_OS_WIN32
+  WSACleanup();
+#endif
+
+  return 0;
+}
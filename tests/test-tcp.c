@@ -42,6 +42,11 @@
 
 #include "socket.h"
 
+/* More than the kernel socket buffers take at once, so that most of it goes
+ * through the send queue */
+#define BURST_MESSAGES 4000
+#define BURST_MESSAGE_SIZE 1500
+
 GMainLoop *mainloop = NULL;
 NiceSocket *active_sock, *client;
 NiceSocket *passive_sock, *server;
@@ -81,6 +86,56 @@ on_client_input_available (gpointer user_data)
   return FALSE;
 }
 
+static void
+on_client_writable (NiceSocket *sock, gpointer user_data)
+{
+  gboolean *writable = user_data;
+
+  *writable = TRUE;
+}
+
+/* Checks that reliable data queued behind a full socket comes out intact and
+ * in order */
+static void
+test_burst (void)
+{
+  guint8 msg[BURST_MESSAGE_SIZE];
+  guint8 in[BURST_MESSAGE_SIZE];
+  NiceAddress from;
+  gsize n_received = 0;
+  gboolean queued, writable = FALSE;
+  guint i;
+
+  nice_address_init (&from);
+  nice_socket_set_writable_callback (client, on_client_writable, &writable);
+
+  for (i = 0; i < BURST_MESSAGES; i++) {
+    memset (msg, i & 0xff, sizeof (msg));
+    g_assert_cmpint (nice_socket_send_reliable (client, &tmp, sizeof (msg),
+            (const gchar *) msg), ==, sizeof (msg));
+  }
+  queued = !nice_socket_can_send (client, &tmp);
+
+  while (n_received < BURST_MESSAGES * BURST_MESSAGE_SIZE) {
+    gint len, j;
+
+    g_main_context_iteration (g_main_loop_get_context (mainloop), FALSE);
+
+    len = nice_socket_recv (server, &from, sizeof (in), (gchar *) in);
+    g_assert_cmpint (len, >=, 0);
+
+    for (j = 0; j < len; j++, n_received++)
+      g_assert_cmpuint (in[j], ==, (n_received / BURST_MESSAGE_SIZE) & 0xff);
+  }
+
+  /* The queue was drained */
+  g_assert (nice_socket_can_send (client, &tmp));
+  if (queued)
+    g_assert (writable);
+
+  nice_socket_set_writable_callback (client, NULL, NULL);
+}
+
 int
 main (void)
 {
@@ -149,6 +204,8 @@ main (void)
   g_main_loop_run (mainloop); /* -> on_client_input_available */
   g_assert (0 == strncmp (buf, "uryyb", 5));
 
+  test_burst ();
+
   nice_socket_free (client);
   nice_socket_free (server);
   nice_socket_free (passive_sock);
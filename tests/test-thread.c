@@ -188,8 +188,12 @@ static void cb_component_state_changed (NiceAgent *agent,
 }
 
 
-int main (void)
+/* Runs the test with both agents having the boolean property @data set, if
+ * not %NULL */
+static void
+run_test (gconstpointer data)
 {
+  const gchar *property = data;
   NiceAgent *lagent, *ragent;      /* agent's L and R */
   NiceAddress baseaddr;
   const char *stun_server = NULL, *stun_server_port = NULL;
@@ -201,10 +205,10 @@ int main (void)
   GMainLoop *ldmainloop, *rdmainloop;
   GThread *ldthread, *rdthread;
 
-#ifdef G_OS_WIN32
-  WSADATA w;
-  WSAStartup(0x0202, &w);
-#endif
+  g_atomic_int_set (&global_lagent_cands, 0);
+  g_atomic_int_set (&global_ragent_cands, 0);
+  global_lagent_buffers = 0;
+  global_ragent_buffers = 0;
 
   lmainctx = g_main_context_new ();
   rmainctx = g_main_context_new ();
@@ -216,9 +220,17 @@ int main (void)
   ldmainloop = g_main_loop_new (ldmainctx, FALSE);
   rdmainloop = g_main_loop_new (rdmainctx, FALSE);
 
-  /* step: create the agents L and R */
-  lagent = nice_agent_new (lmainctx, NICE_COMPATIBILITY_MSN);
-  ragent = nice_agent_new (rmainctx, NICE_COMPATIBILITY_MSN);
+  /* step: create the agents L and R (a NULL @property ends the list) */
+  lagent = g_object_new (NICE_TYPE_AGENT,
+      "compatibility", NICE_COMPATIBILITY_MSN,
+      "main-context", lmainctx,
+      property, TRUE,
+      NULL);
+  ragent = g_object_new (NICE_TYPE_AGENT,
+      "compatibility", NICE_COMPATIBILITY_MSN,
+      "main-context", rmainctx,
+      property, TRUE,
+      NULL);
 
   g_object_set_data (G_OBJECT (lagent), "other-agent", ragent);
   g_object_set_data (G_OBJECT (ragent), "other-agent", lagent);
@@ -353,8 +365,36 @@ int main (void)
   g_main_loop_unref (ldmainloop);
   g_main_loop_unref (rdmainloop);
 
+  g_main_context_unref (lmainctx);
+  g_main_context_unref (rmainctx);
+  g_main_context_unref (ldmainctx);
+  g_main_context_unref (rdmainctx);
+}
+
+int main (int argc, char **argv)
+{
+  int ret;
+
+#ifdef G_OS_WIN32
+  WSADATA w;
+  WSAStartup(0x0202, &w);
+#endif
+
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_data_func ("/nice/thread", NULL, run_test);
+  /* Both fall back to the default sockets and sources where the platform
+   * lacks io_uring or epoll */
+  g_test_add_data_func ("/nice/thread/io-uring", "io-uring", run_test);
+  /* Includes moving the sockets to the contexts given to
+   * nice_agent_attach_recv() */
+  g_test_add_data_func ("/nice/thread/shared-socket-source",
+      "shared-socket-source", run_test);
+
+  ret = g_test_run ();
+
 #ifdef G_OS_WIN32
   WSACleanup();
 #endif
-  return 0;
+  return ret;
 }
@@ -204,6 +204,55 @@ tcp_turn_fragmentation (void)
   nice_socket_free (testsock);
 }
 
+/* Control messages awaiting a response are kept in right-sized buffers */
+static void
+turn_control_message_memory (void)
+{
+  NiceAddress addr, peer;
+  NiceSocket *basesock, *serversock, *turnsock;
+  NiceUdpTurnMemoryUsage usage;
+  gchar data[] = "data";
+  guint i;
+
+  nice_address_set_from_string (&addr, "127.0.0.1");
+
+  basesock = nice_udp_bsd_socket_new (&addr);
+  serversock = nice_udp_bsd_socket_new (&addr);
+  g_assert (basesock != NULL && serversock != NULL);
+
+  turnsock = nice_udp_turn_socket_new (NULL, &basesock->addr,
+      basesock, &serversock->addr, "username", "password",
+      NICE_TURN_SOCKET_COMPATIBILITY_RFC5766);
+
+  nice_udp_turn_socket_get_memory_usage (turnsock, &usage);
+  g_assert_cmpuint (usage.control_bytes, ==, 0);
+
+  /* One ChannelBind, the second binding waits for it to complete */
+  peer = addr;
+  nice_address_set_port (&peer, 10000);
+  g_assert (nice_udp_turn_socket_set_peer (turnsock, &peer));
+  nice_address_set_port (&peer, 10001);
+  nice_udp_turn_socket_set_peer (turnsock, &peer);
+
+  /* One CreatePermission per peer */
+  for (i = 0; i < 3; i++) {
+    nice_address_set_port (&peer, 20000 + i);
+    nice_socket_send (turnsock, &peer, sizeof (data), data);
+  }
+
+  nice_udp_turn_socket_get_memory_usage (turnsock, &usage);
+  g_assert_cmpuint (usage.n_allocs, ==, 4);
+  g_assert_cmpuint (usage.n_reuses, ==, 0);
+  g_assert_cmpuint (usage.control_bytes, >, 0);
+  g_assert_cmpuint (usage.control_bytes, <=, 4 * 2048);
+  g_assert_cmpuint (usage.control_bytes_peak, ==, usage.control_bytes);
+  g_assert_cmpuint (usage.pooled_bytes, ==, 0);
+
+  nice_socket_free (turnsock);
+  nice_socket_free (serversock);
+  nice_socket_free (basesock);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -217,6 +266,8 @@ main (int argc, char *argv[])
   mainloop = g_main_loop_new (NULL, TRUE);
 
   g_test_add_func ("/udp-turn/tcp-fragmentation", tcp_turn_fragmentation);
+  g_test_add_func ("/udp-turn/control-message-memory",
+      turn_control_message_memory);
 
   g_test_run ();
 